@@ -27,7 +27,10 @@ PHP_ARG_ENABLE(async_mysql, enable async_mysql support,
 [  --enable-async-mysql    Do you have mysqli and mysqlnd?], no, no)
 
 PHP_ARG_ENABLE(async_redis, enable async_redis support,
-[  --enable-async-redis    Do you have hiredis?], no, no)
+[  --enable-async-redis    Obsolete, swoole_redis is always built and no longer needs hiredis], no, no)
+
+PHP_ARG_ENABLE(http_lazy_request, enable lazy swoole_http_request arrays,
+[  --enable-http-lazy-request  Build the arrays of swoole_http_request on first access?], no, no)
 
 PHP_ARG_ENABLE(async_httpclient, enable async_httpclient support,
 [  --enable-async-httpclient  Enable async httpclient support?], no, no)
@@ -155,6 +158,10 @@ if test "$PHP_SWOOLE" != "no"; then
 	if test "$PHP_ASYNC_HTTPCLIENT" = "yes"; then
 		AC_DEFINE(SW_ASYNC_HTTPCLIENT, 1, [enable async_httpclient support])
     fi
+
+    if test "$PHP_HTTP_LAZY_REQUEST" = "yes"; then
+		AC_DEFINE(SW_HTTP_LAZY_REQUEST, 1, [enable lazy swoole_http_request arrays])
+    fi
         
     AC_SWOOLE_CPU_AFFINITY
     AC_SWOOLE_HAVE_REUSEPORT
@@ -179,6 +186,7 @@ if test "$PHP_SWOOLE" != "no"; then
     AC_CHECK_LIB(c, kqueue, AC_DEFINE(HAVE_KQUEUE, 1, [have kqueue]))
     AC_CHECK_LIB(c, daemon, AC_DEFINE(HAVE_DAEMON, 1, [have daemon]))
     AC_CHECK_LIB(c, mkostemp, AC_DEFINE(HAVE_MKOSTEMP, 1, [have mkostemp]))
+    AC_CHECK_LIB(c, sendmmsg, AC_DEFINE(HAVE_MMSG, 1, [have recvmmsg and sendmmsg]))
     AC_CHECK_LIB(c, inotify_init, AC_DEFINE(HAVE_INOTIFY, 1, [have inotify]))
     AC_CHECK_LIB(c, inotify_init1, AC_DEFINE(HAVE_INOTIFY_INIT1, 1, [have inotify_init1]))
     AC_CHECK_LIB(pthread, pthread_rwlock_init, AC_DEFINE(HAVE_RWLOCK, 1, [have pthread_rwlock_init]))
@@ -187,7 +195,6 @@ if test "$PHP_SWOOLE" != "no"; then
     AC_CHECK_LIB(pthread, pthread_barrier_init, AC_DEFINE(HAVE_PTHREAD_BARRIER, 1, [have pthread_barrier_init]))
     AC_CHECK_LIB(ssl, SSL_library_init, AC_DEFINE(HAVE_OPENSSL, 1, [have openssl]))
     AC_CHECK_LIB(pcre, pcre_compile, AC_DEFINE(HAVE_PCRE, 1, [have pcre]))
-    AC_CHECK_LIB(hiredis, redisConnect, AC_DEFINE(HAVE_HIREDIS, 1, [have hiredis]))
     
     AC_CHECK_LIB(z, gzgets, [
         AC_DEFINE(SW_HAVE_ZLIB, 1, [have zlib])
@@ -213,10 +220,9 @@ if test "$PHP_SWOOLE" != "no"; then
     fi
 
     if test "$PHP_ASYNC_REDIS" = "yes"; then
-        AC_DEFINE(SW_USE_REDIS, 1, [enable async-redis support])
-        PHP_ADD_LIBRARY(hiredis, 1, SWOOLE_SHARED_LIBADD)
+        AC_MSG_WARN([--enable-async-redis is obsolete, swoole_redis is always built and hiredis is not linked])
     fi
-    
+
     swoole_source_file="swoole.c \
         swoole_server.c \
         swoole_atomic.c \
@@ -244,6 +250,7 @@ if test "$PHP_SWOOLE" != "no"; then
         src/core/list.c \
         src/memory/ShareMemory.c \
         src/memory/MemoryGlobal.c \
+        src/memory/SlabPool.c \
         src/memory/RingBuffer.c \
         src/memory/FixedPool.c \
         src/memory/Malloc.c \
@@ -268,6 +275,7 @@ if test "$PHP_SWOOLE" != "no"; then
         src/network/Server.c \
         src/network/TaskWorker.c \
         src/network/Client.c \
+        src/network/ClientPool.c \
         src/network/Connection.c \
         src/network/ProcessPool.c \
         src/network/ThreadPool.c \
@@ -275,6 +283,7 @@ if test "$PHP_SWOOLE" != "no"; then
         src/network/ReactorProcess.c \
         src/network/Manager.c \
         src/network/Worker.c \
+        src/network/IPCChannel.c \
         src/network/EventTimer.c \
         src/os/base.c \
         src/os/linux_aio.c \
@@ -3,6 +3,9 @@
 $serv = new swoole_server("0.0.0.0", 9502, SWOOLE_PROCESS, SWOOLE_SOCK_UDP);
 $serv->set(array(
 	'dispatch_mode' => 1,
+	//SO_REUSEPORT receiving threads, each drains its socket with recvmmsg
+	'dgram_thread_num' => 2,
+	'dgram_batch' => 32,
 //    'worker_num' => 1,    //worker process num
 //    //'log_file' => '/tmp/swoole.log',
 //    //'daemonize' => true,
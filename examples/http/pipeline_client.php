@@ -0,0 +1,23 @@
+<?php
+$cli = new swoole_http_client('127.0.0.1', 80);
+$cli->set(['keep_alive' => 1, 'pipeline' => true]);
+
+$cli->on('close', function ($cli) {
+    echo "close\n";
+});
+$cli->on('error', function ($cli) {
+    echo "error\n";
+});
+
+//requests are sent on the same connection without waiting for the response
+for ($i = 0; $i < 10; $i++)
+{
+    $cli->execute('/dump.php?i=' . $i, function ($cli) {
+        echo $cli->body;
+    });
+}
+
+//large body is written to the file
+$cli->download('/test.jpg', '/tmp/test.jpg', function ($cli) {
+    echo "download finish\n";
+});
@@ -19,6 +19,9 @@ $http->set([
 //'daemonize' => true,
 //    'ssl_cert_file' => $key_dir.'/ssl.crt',
 //    'ssl_key_file' => $key_dir.'/ssl.key',
+//    'http_body_stream' => true,
+//    'package_max_length' => 64 * 1024 * 1024,
+//    'http_response_header' => ['X-Frame-Options' => 'SAMEORIGIN', 'Cache-Control' => 'no-cache'],
 ]);
 
 function chunk(swoole_http_request $request, swoole_http_response $response)
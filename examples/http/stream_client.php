@@ -0,0 +1,11 @@
+<?php
+$cli = new swoole_http_client('127.0.0.1', 80);
+$cli->set(['keep_alive' => 1]);
+
+//the body is not buffered, $cli->body is empty in the finish callback
+$cli->on('data', function ($cli, $data) {
+    echo "recv ", strlen($data), " bytes\n";
+});
+$cli->execute('/big_file.txt', function ($cli) {
+    echo "finish\n";
+});
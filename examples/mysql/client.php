@@ -0,0 +1,53 @@
+<?php
+$server = array(
+    'host' => '127.0.0.1',
+    'port' => 3306,
+    'user' => 'root',
+    'password' => 'root',
+    'database' => 'test',
+    'charset' => 'utf8',
+    //the authenticated connections are kept in the worker and reused by the next connect()
+    'pool_size' => 16,
+    //send the queued queries without waiting for the responses
+    'pipeline' => true,
+);
+
+$db = new swoole_mysql;
+$db->on('close', function (swoole_mysql $db) {
+    echo "mysql connection is closed\n";
+});
+
+$db->connect($server, function (swoole_mysql $db, $result) {
+    if ($result === false)
+    {
+        var_dump($db->connect_errno, $db->connect_error);
+        return;
+    }
+    //text protocol
+    $db->query("SELECT * FROM `userinfo` LIMIT 0, 10", function (swoole_mysql $db, $r) {
+        if ($r === false)
+        {
+            var_dump($db->errno, $db->error);
+        }
+        else
+        {
+            var_dump($r);
+        }
+    });
+    $db->query("UPDATE `userinfo` SET `passwd` = '999999' WHERE `id` = 2", function (swoole_mysql $db, $r) {
+        var_dump($r, $db->affected_rows, $db->insert_id);
+    });
+    //binary protocol
+    $db->prepare("SELECT * FROM `userinfo` WHERE `id` > ? AND `name` = ?", function (swoole_mysql $db, $stmt) {
+        if ($stmt === false)
+        {
+            var_dump($db->errno, $db->error);
+            return;
+        }
+        $db->execute($stmt, array(1, 'jack'), function (swoole_mysql $db, $r) {
+            var_dump($r);
+            //the connection is given back to the pool
+            $db->close();
+        });
+    });
+});
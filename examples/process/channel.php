@@ -0,0 +1,40 @@
+<?php
+//shared memory channel, the workers push the results to the master
+$channel = new swoole_process(function () {}, false, false);
+//8M ring, the message is up to 1M
+$channel->useChannel(8 * 1024 * 1024, 1024 * 1024);
+
+$workers = [];
+for ($i = 0; $i < 4; $i++)
+{
+    $process = new swoole_process(function (swoole_process $worker) use ($channel, $i) {
+        for ($j = 0; $j < 1000; $j++)
+        {
+            $channel->push(str_repeat("$i", 1000 + $j));
+        }
+        $worker->exit(0);
+    }, false, false);
+    $pid = $process->start();
+    $workers[$pid] = $process;
+}
+
+$count = 0;
+//the channel_fd is readable when there is new data
+swoole_event_add($channel->channel_fd, function ($fd) use ($channel, &$count) {
+    foreach ($channel->popMulti(128) as $data)
+    {
+        $count++;
+    }
+    if ($count == 4000)
+    {
+        echo "recv $count messages\n";
+        swoole_event_del($fd);
+    }
+});
+
+swoole_process::signal(SIGCHLD, function ($sig) {
+    while ($ret = swoole_process::wait(false))
+    {
+        echo "worker[{$ret['pid']}] exit\n";
+    }
+});
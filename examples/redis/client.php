@@ -1,13 +1,24 @@
 <?php
 $client = new swoole_redis;
+$client->on('close', function (swoole_redis $client) {
+    echo "redis connection is closed\n";
+});
 $client->connect('127.0.0.1', 6379, function (swoole_redis $client, $result) {
     echo "connect\n";
     var_dump($result);
-    $client->set('key', 'swoole', function (swoole_redis $client, $result) {
+    //the commands issued in one callback are sent with one write, the replies are received in order
+    for ($i = 0; $i < 10; $i++)
+    {
+        $client->set('key_' . $i, 'swoole_' . $i);
+    }
+    $client->execute('MGET key_0 key_1 key_2', function (swoole_redis $client, $result) {
+        var_dump($result);
+    });
+    $client->execute(array('HMSET', 'hash', 'name', 'swoole', 'version', 1.8), function (swoole_redis $client, $result) {
+        var_dump($result);
+    });
+    $client->get('key_9', function (swoole_redis $client, $result) {
         var_dump($result);
-        $client->get('key', function (swoole_redis $client, $result) {
-            var_dump($result);
-            $client->close();
-        });
+        $client->close();
     });
 });
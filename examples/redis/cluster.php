@@ -0,0 +1,18 @@
+<?php
+//the commands are sent to the node which owns the slot of the key
+$client = new swoole_redis(array('cluster' => true, 'timeout' => 0.5));
+$client->connect('127.0.0.1', 7000, function (swoole_redis $client, $result) {
+    if ($result === false)
+    {
+        var_dump($client->errCode, $client->errMsg);
+        return;
+    }
+    //the keys of a transaction must be in the same slot, use a hash tag
+    $client->multi();
+    $client->incr('{user:1000}.visits');
+    $client->lpush('{user:1000}.history', 'index.php');
+    $client->exec(function (swoole_redis $client, $result) {
+        var_dump($result);
+        $client->close();
+    });
+});
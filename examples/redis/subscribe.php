@@ -0,0 +1,15 @@
+<?php
+$client = new swoole_redis;
+$client->on('message', function (swoole_redis $client, $result) {
+    //array('message', 'msg_0', 'hello'), array('subscribe', 'msg_0', 1)
+    var_dump($result);
+});
+$client->connect('127.0.0.1', 6379, function (swoole_redis $client, $result) {
+    if ($result === false)
+    {
+        var_dump($client->errCode, $client->errMsg);
+        return;
+    }
+    //only (P)SUBSCRIBE and (P)UNSUBSCRIBE can be used until all of the channels are unsubscribed
+    $client->subscribe('msg_0', 'msg_1');
+});
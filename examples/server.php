@@ -13,6 +13,8 @@ class G
         'group' => 'www-data',
         'chroot' => '/opt/tmp',
         //'task_ipc_mode' => 1,
+        //reactor threads and workers use the shared memory rings
+        //'ipc_mode' => SWOOLE_IPC_CHANNEL,
         //'dispatch_mode' => 1,
         //'log_file' => '/tmp/swoole.log',
         'heartbeat_check_interval' => 30,
@@ -0,0 +1,17 @@
+<?php
+//the rows not used recently are evicted when the table is full
+$table = new swoole_table(1024, 1024, swoole_table::EVICT_LRU);
+$table->column('value', swoole_table::TYPE_STRING, 64);
+$table->create();
+
+for ($i = 0; $i < 10000; $i++)
+{
+    $table->set("key_$i", array('value' => "value_$i"));
+}
+echo "rows: " . count($table) . "\n";
+
+//expires after 1 second
+$table->set('session', array('value' => 'rango'), 1);
+var_dump($table->get('session'));
+sleep(2);
+var_dump($table->get('session'));
@@ -0,0 +1,29 @@
+<?php
+$table = new swoole_table(1024);
+$table->column('count', swoole_table::TYPE_INT, 8);
+$table->column('version', swoole_table::TYPE_INT, 4);
+$table->create();
+
+$workers = array();
+for ($i = 0; $i < 4; $i++)
+{
+    $process = new swoole_process(function () use ($table)
+    {
+        for ($j = 0; $j < 100000; $j++)
+        {
+            //the atomic instruction, the row is not locked
+            $table->incr('requests', 'count');
+        }
+    });
+    $process->start();
+}
+for ($i = 0; $i < 4; $i++)
+{
+    swoole_process::wait();
+}
+var_dump($table->get('requests'));
+
+//optimistic update: it fails when the others changed the version
+$table->set('config', array('version' => 1));
+var_dump($table->cas('config', 'version', 1, 2));
+var_dump($table->cas('config', 'version', 1, 3));
@@ -0,0 +1,25 @@
+<?php
+$table = new swoole_table(1024);
+$table->column('id', swoole_table::TYPE_INT, 4);
+$table->column('name', swoole_table::TYPE_STRING, 64);
+$table->column('score', swoole_table::TYPE_FLOAT);
+$table->create();
+
+for ($i = 0; $i < 100; $i++)
+{
+    $table->set('user_' . $i, array('id' => $i, 'name' => 'rango_' . $i, 'score' => $i / 2));
+}
+
+//id > 10 and id < 20 and name like 'rango_1%'
+$rows = $table->find(array(
+    array('id', swoole_table::FIND_GT, 10),
+    array('id', swoole_table::FIND_LT, 20),
+    array('name', swoole_table::FIND_LEFTLIKE, 'rango_1'),
+));
+var_dump($rows);
+
+//only the name column, 5 rows from the 3rd
+var_dump($table->find(array(array('score', swoole_table::FIND_GT, 40)), array('name'), 5, 2));
+
+//only the keys (crc32)
+var_dump($table->find(array(array('name', swoole_table::FIND_RIGHTLIKE, '9')), array()));
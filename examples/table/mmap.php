@@ -0,0 +1,17 @@
+<?php
+$table = new swoole_table(1024);
+$table->column('id', swoole_table::TYPE_INT, 4);
+$table->column('name', swoole_table::TYPE_STRING, 64);
+//the rows of the last run are still in the file
+$table->create('/tmp/swoole_table.data');
+
+echo "rows: " . count($table) . "\n";
+$table->set('user_' . time(), array('id' => time(), 'name' => 'rango'));
+
+foreach ($table as $key => $row)
+{
+    echo "$key => {$row['id']}\n";
+}
+
+//attach in constant time next run, without it the table is recovered from the rows
+$table->destroy();
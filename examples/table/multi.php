@@ -0,0 +1,16 @@
+<?php
+$table = new swoole_table(1024);
+$table->column('id', swoole_table::TYPE_INT, 4);
+$table->column('name', swoole_table::TYPE_STRING, 64);
+$table->create();
+
+//key => row
+$table->setMulti(array(
+    'user_1' => array('id' => 1, 'name' => 'rango'),
+    'user_2' => array('id' => 2, 'name' => 'tianfenghan'),
+    'user_3' => array('id' => 3, 'name' => 'swoole'),
+));
+
+//the keys not found are not in the result
+var_dump($table->getMulti(array('user_1', 'user_3', 'user_4')));
+echo "deleted: " . $table->delMulti(array('user_1', 'user_2', 'user_4')) . "\n";
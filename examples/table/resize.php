@@ -0,0 +1,24 @@
+<?php
+//1024 rows at first, the table grows to 1M rows while it is filled
+$table = new swoole_table(1024, 1024 * 1024);
+$table->column('id', swoole_table::TYPE_INT, 4);
+$table->create();
+
+for ($i = 0; $i < 4; $i++)
+{
+    $process = new swoole_process(function () use ($table, $i)
+    {
+        for ($j = 0; $j < 100000; $j++)
+        {
+            $table->set("key_{$i}_{$j}", array('id' => $j));
+        }
+    });
+    $process->start();
+}
+
+for ($i = 0; $i < 4; $i++)
+{
+    swoole_process::wait();
+}
+echo "rows: " . count($table) . "\n";
+var_dump($table->get('key_3_99999'));
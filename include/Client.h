@@ -69,6 +69,13 @@ typedef struct _swClient
 	uint32_t wait_length;
     uint32_t buffer_input_size;
 
+    /**
+     * connection pool, for long connection
+     */
+    struct _swClientPool *pool;
+    time_t create_time;
+    time_t last_time;
+
 #ifdef SW_USE_OPENSSL
     uint8_t open_ssl :1;
     uint8_t ssl_disable_compress :1;
@@ -93,6 +100,56 @@ typedef struct _swClient
 } swClient;
 
 int swClient_create(swClient *cli, int type, int async);
+
+typedef struct _swClientPool
+{
+    char *key;
+    uint16_t key_len;
+
+    /**
+     * idle connections kept alive even after idle_timeout
+     */
+    uint32_t min_size;
+    uint32_t max_size;
+
+    /**
+     * seconds, 0 means never expire
+     */
+    uint32_t idle_timeout;
+    uint32_t max_lifetime;
+
+    /**
+     * total connections, idle and borrowed
+     */
+    uint32_t num;
+
+    swLinkedList *idle_list;
+
+    /**
+     * stats
+     */
+    uint64_t create_count;
+    uint64_t reuse_count;
+    uint64_t close_count;
+    uint64_t probe_fail_count;
+    uint64_t full_count;
+
+    void (*onFree)(swClient *cli);
+} swClientPool;
+
+swClientPool* swClientPool_new(char *key, uint16_t key_len, uint32_t min_size, uint32_t max_size);
+swClient* swClientPool_get(swClientPool *pool);
+void swClientPool_add(swClientPool *pool, swClient *cli);
+int swClientPool_release(swClientPool *pool, swClient *cli);
+void swClientPool_remove(swClientPool *pool, swClient *cli);
+int swClientPool_check(swClientPool *pool);
+void swClientPool_free(swClientPool *pool);
+
+static sw_inline int swClientPool_full(swClientPool *pool)
+{
+    return pool->max_size > 0 && pool->num >= pool->max_size;
+}
+
 #ifdef SW_USE_OPENSSL
 int swClient_enable_ssl_encrypt(swClient *cli);
 int swClient_ssl_handshake(swClient *cli);
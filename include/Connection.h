@@ -36,7 +36,7 @@ swString* swConnection_get_string_buffer(swConnection *conn);
 void swConnection_clear_string_buffer(swConnection *conn);
 swBuffer_trunk* swConnection_get_out_buffer(swConnection *conn, uint32_t type);
 swBuffer_trunk* swConnection_get_in_buffer(swConnection *conn);
-int swConnection_sendfile(swConnection *conn, char *filename);
+int swConnection_sendfile(swConnection *conn, char *filename, off_t offset, size_t length);
 int swConnection_onSendfile(swConnection *conn, swBuffer_trunk *chunk);
 void swConnection_sendfile_destructor(swBuffer_trunk *chunk);
 char* swConnection_get_ip(swConnection *conn);
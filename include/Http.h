@@ -44,6 +44,61 @@ enum swHttpVersion
     HTTP_VERSION_11,
 };
 
+enum swHttpIndex_flag
+{
+    SW_HTTP_INDEX_CHUNKED        = 1,
+    SW_HTTP_INDEX_EXPECT         = 2,
+    /**
+     * more headers than SW_HTTP_INDEX_HEADER_MAX, the worker parses the request again
+     */
+    SW_HTTP_INDEX_OVERFLOW       = 4,
+    SW_HTTP_INDEX_CONTENT_LENGTH = 8,
+    /**
+     * the body is not behind the head, it comes in the SW_EVENT_HTTP_BODY events
+     */
+    SW_HTTP_INDEX_STREAM         = 16,
+};
+
+/**
+ * the offsets from the start of the request, the head is less than SW_HTTP_HEADER_MAX_SIZE
+ */
+typedef struct _swHttpIndex_header
+{
+    uint16_t name;
+    uint16_t name_length;
+    uint16_t value;
+    uint16_t value_length;
+} swHttpIndex_header;
+
+/**
+ * parsed by the reactor thread while framing, sent to the worker behind the request
+ */
+typedef struct _swHttpIndex
+{
+    uint8_t method;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t header_num;
+    uint16_t uri;
+    uint16_t uri_length;
+    /**
+     * the uri before '?'
+     */
+    uint16_t path_length;
+    uint16_t reserved;
+    uint32_t body;
+    uint32_t content_length;
+    swHttpIndex_header headers[SW_HTTP_INDEX_HEADER_MAX];
+} swHttpIndex;
+
+typedef struct _swHttpIndex_trailer
+{
+    uint32_t length;
+    uint32_t magic;
+} swHttpIndex_trailer;
+
+#define SW_HTTP_INDEX_MAGIC  0x78644948
+
 typedef struct _swHttpRequest
 {
     uint8_t method;
@@ -58,16 +113,55 @@ typedef struct _swHttpRequest
 
     uint8_t opcode;
 
+    /**
+     * the head parser: 0 request line, 1 headers
+     */
+    uint8_t state;
+    uint8_t expect_sent;
+    /**
+     * the head is sent, the body is sent to stream_worker_id when it is received
+     */
+    uint8_t stream;
+    uint16_t stream_worker_id;
+    uint32_t stream_length;
+    /**
+     * the start of the current line, the bytes before scan have no '\n'
+     */
+    uint32_t line;
+    uint32_t scan;
+    swHttpIndex index;
+
 } swHttpRequest;
 
-int swHttpRequest_get_protocol(swHttpRequest *request);
-int swHttpRequest_get_content_length(swHttpRequest *request);
-int swHttpRequest_get_header_length(swHttpRequest *request);
-int swHttpRequest_have_content_length(swHttpRequest *request);
+#define SW_HTTP_STATUS_MIN   100
+#define SW_HTTP_STATUS_MAX   600
+
+/**
+ * the byte range of the file, from the Range header
+ */
+typedef struct _swHttpRange
+{
+    off_t offset;
+    off_t length;
+} swHttpRange;
+
+#define SW_HTTP_OFFSET_MAX   ((off_t) 0x7fffffffffffffffLL)
+
+int swHttpRequest_parse(swHttpRequest *request);
+int swHttpRequest_append_index(swHttpRequest *request);
+int swHttpIndex_get(char *data, uint32_t *length, swHttpIndex *index);
 void swHttpRequest_free(swConnection *conn);
-#ifdef SW_HTTP_100_CONTINUE
-int swHttpRequest_has_expect_header(swHttpRequest *request);
-#endif
+
+/**
+ * the lines of the response head, ending with "\r\n"
+ */
+char* swHttp_get_status_message(int code);
+char* swHttp_get_status_line(int code, uint32_t *length);
+char* swHttp_get_date(time_t now, uint32_t *length);
+int swHttp_format_date(char *buf, size_t size, time_t time);
+
+int swHttp_parse_range(char *value, uint32_t length, off_t filesize, swHttpRange *ranges, int max);
+int swHttp_match_etag(char *value, uint32_t length, char *etag, uint32_t etag_length);
 
 #ifdef __cplusplus
 }
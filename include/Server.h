@@ -58,6 +58,13 @@ enum swEventType
     //proxy
     SW_EVENT_PROXY_START     = 16,
     SW_EVENT_PROXY_END       = 17,
+    //udp packets packed by the dgram thread
+    SW_EVENT_DGRAM_BATCH     = 18,
+    //length check packages of one connection
+    SW_EVENT_PACKAGE_BATCH   = 19,
+    //http request body, sent in chunks after the head
+    SW_EVENT_HTTP_BODY       = 20,
+    SW_EVENT_HTTP_BODY_END   = 21,
 };
 
 #define SW_HOST_MAXSIZE            128
@@ -122,10 +129,46 @@ typedef struct _swReactorThread
 #ifdef SW_USE_RINGBUFFER
     int *pipe_read_list;
 #endif
+    /**
+     * SW_IPC_CHANNEL: the messages which can not be put into the full rings, one for each worker
+     */
+    swBuffer **channel_buffer;
+    /**
+     * the connections paused by the congested workers, one list of session_id for each worker
+     */
+    swLinkedList **pause_list;
+    uint32_t pause_num;
     swLock lock;
     int c_udp_fd;
 } swReactorThread;
 
+/**
+ * SW_IPC_CHANNEL: a shared memory ring for each reactor thread and worker pair
+ */
+typedef struct _swIPCChannel
+{
+    swChannel *chan;
+    /**
+     * the ring was full, the consumer wakes up the producer to flush its buffer
+     */
+    sw_atomic_t blocked;
+} swIPCChannel;
+
+typedef struct _swIPCNotify
+{
+    /**
+     * the consumer is not draining the rings, the producers must write the eventfd
+     */
+    sw_atomic_t parked;
+    /**
+     * adaptive spin count before the consumer parks
+     */
+    uint32_t spin;
+    swPipe pipe;
+} swIPCNotify;
+
+typedef int (*swIPCChannel_drain)(swReactor *reactor);
+
 typedef struct _swListenPort
 {
     struct _swListenPort *next, *prev;
@@ -133,7 +176,11 @@ typedef struct _swListenPort
     uint8_t ssl;
     int port;
     int sock;
-    pthread_t thread_id;
+    /**
+     * dgram port, a socket and a thread for each of serv->dgram_thread_num
+     */
+    int *socks;
+    pthread_t *threads;
     char host[SW_HOST_MAXSIZE];
 } swListenPort;
 
@@ -147,10 +194,23 @@ typedef struct {
 	char *filename;
 	uint16_t name_len;
 	int fd;
-	off_t filesize;
+	/**
+	 * the range [begin, end) of the file
+	 */
+	off_t begin;
+	off_t end;
 	off_t offset;
 } swTask_sendfile;
 
+/**
+ * the data of SW_EVENT_SENDFILE, length 0 is to the end of the file
+ */
+typedef struct {
+	off_t offset;
+	size_t length;
+	char filename[0];
+} swSendFile_request;
+
 typedef struct
 {
     uint16_t num;
@@ -235,6 +295,20 @@ struct _swServer
 
     uint8_t dgram_port_num;
 
+    /**
+     * receiving threads of each udp port, they bind their own socket with SO_REUSEPORT
+     */
+    uint16_t dgram_thread_num;
+    /**
+     * recvmmsg batch size, the packets are packed into one event for each worker
+     */
+    uint16_t dgram_batch;
+
+    uint8_t websocket_compression_level;
+    uint8_t websocket_client_max_window_bits;
+    uint8_t websocket_server_max_window_bits;
+    uint32_t websocket_compression_threshold;
+
     /**
      * swoole packet mode
      */
@@ -361,6 +435,17 @@ struct _swServer
      */
     uint32_t http_parse_post :1;
 
+    /**
+     * the http request body is sent to the worker in chunks, the reactor does not buffer the request
+     */
+    uint32_t http_body_stream :1;
+
+    /**
+     * websocket permessage-deflate, the client stream can take over the context
+     */
+    uint32_t websocket_compression :1;
+    uint32_t websocket_client_no_context_takeover :1;
+
     uint32_t enable_unsafe_event :1;
 
     /**
@@ -411,6 +496,15 @@ struct _swServer
 
     uint32_t pipe_buffer_size;
 
+    /**
+     * reactor and worker IPC, SW_IPC_UNSOCK or SW_IPC_CHANNEL
+     */
+    uint8_t ipc_mode;
+    swIPCChannel *channel_to_worker;
+    swIPCChannel *channel_to_reactor;
+    swIPCNotify *worker_notify;
+    swIPCNotify *reactor_notify;
+
 #ifdef SW_USE_OPENSSL
     uint8_t open_ssl;
     char *ssl_cert_file;
@@ -514,9 +608,10 @@ int swServer_free(swServer *serv);
 int swServer_shutdown(swServer *serv);
 
 int swServer_udp_send(swServer *serv, swSendData *resp);
+int swServer_dgram_listen(swServer *serv);
 int swServer_tcp_send(swServer *serv, int fd, void *data, uint32_t length);
 int swServer_tcp_sendwait(swServer *serv, int fd, void *data, uint32_t length);
-int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len);
+int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len, off_t offset, size_t length);
 
 //UDP, UDP必然超过0x1000000
 //原因：IPv4的第4字节最小为1,而这里的conn_fd是网络字节序
@@ -536,6 +631,22 @@ static sw_inline int swEventData_is_dgram(uint8_t type)
     }
 }
 
+/**
+ * size of a packet in the SW_EVENT_DGRAM_BATCH event, the headers are aligned to 4 bytes
+ */
+static sw_inline uint32_t swDgramPacket_size(uint32_t length)
+{
+    return (sizeof(swDgramPacket) + length + 3) & ~3;
+}
+
+/**
+ * size of a package in the SW_EVENT_PACKAGE_BATCH event, the length field is aligned to 4 bytes
+ */
+static sw_inline uint32_t swPackage_batch_size(uint32_t length)
+{
+    return (sizeof(uint32_t) + length + 3) & ~3;
+}
+
 static sw_inline int swEventData_is_stream(uint8_t type)
 {
     switch (type)
@@ -546,6 +657,9 @@ static sw_inline int swEventData_is_stream(uint8_t type)
     case SW_EVENT_PACKAGE_START:
     case SW_EVENT_PACKAGE:
     case SW_EVENT_PACKAGE_END:
+    case SW_EVENT_PACKAGE_BATCH:
+    case SW_EVENT_HTTP_BODY:
+    case SW_EVENT_HTTP_BODY_END:
     case SW_EVENT_CONNECT:
     case SW_EVENT_CLOSE:
         return SW_TRUE;
@@ -623,6 +737,8 @@ int swTaskWorker_finish(swServer *serv, char *data, int data_len, int flags);
 #define swServer_get_minfd(serv) (serv->connection_list[SW_SERVER_MIN_FD_INDEX].fd)
 
 #define swServer_get_thread(serv, reactor_id)    (&(serv->reactor_threads[reactor_id]))
+#define swServer_channel_to_worker(serv, reactor_id, worker_id)    (&(serv->channel_to_worker[(reactor_id) * serv->worker_num + (worker_id)]))
+#define swServer_channel_to_reactor(serv, worker_id, reactor_id)    (&(serv->channel_to_reactor[(worker_id) * serv->reactor_num + (reactor_id)]))
 
 static sw_inline swConnection* swServer_connection_get(swServer *serv, int fd)
 {
@@ -819,6 +935,8 @@ void swWorker_onStop(swServer *serv);
 int swWorker_loop(swFactory *factory, int worker_pti);
 int swWorker_send2reactor(swEventData *ev_data, size_t sendn, int fd);
 int swWorker_send2worker(swWorker *dst_worker, void *buf, int n, int flag);
+int swWorker_sendto(int sock, struct sockaddr *addr, socklen_t addr_len, char *data, uint32_t length);
+void swWorker_sendto_flush(void);
 void swWorker_signal_handler(int signo);
 void swWorker_clean(void);
 
@@ -837,6 +955,14 @@ int swReactorProcess_create(swServer *serv);
 int swReactorProcess_start(swServer *serv);
 int swReactorProcess_onClose(swReactor *reactor, swEvent *event);
 
+int swIPCChannel_create(swServer *serv);
+void swIPCChannel_free(swServer *serv);
+int swIPCChannel_push(swIPCChannel *channel, swIPCNotify *consumer, swBuffer **buffer_ptr, void *data, int length);
+int swIPCChannel_pop(swIPCChannel *channel, swIPCNotify *producer, void *out, int buffer_length);
+int swIPCChannel_flush(swIPCChannel *channel, swIPCNotify *consumer, swBuffer *buffer);
+void swIPCChannel_wakeup(swIPCNotify *notify);
+int swIPCChannel_consume(swReactor *reactor, swIPCNotify *notify, swIPCChannel_drain drain);
+
 int swManager_start(swFactory *factory);
 pid_t swManager_spawn_user_worker(swServer *serv, swWorker* worker);
 int swManager_wait_user_worker(swProcessPool *pool, pid_t pid);
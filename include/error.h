@@ -20,6 +20,8 @@
 enum swErrorCode
 {
     SW_ERROR_SERVER_MUST_CREATED_BEFORE_CLIENT   = 9001,
+    SW_ERROR_CLIENT_POOL_FULL                    = 9002,
+    SW_ERROR_CHANNEL_FULL                        = 9003,
     SW_ERROR_SESSION_CLOSED_BY_SERVER            = 1001,
     SW_ERROR_SESSION_CLOSED_BY_CLIENT            = 1002,
     SW_ERROR_OUTPUT_BUFFER_OVERFLOW              = 1003,
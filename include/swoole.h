@@ -188,6 +188,7 @@ enum swFd_type
     SW_FD_SIGNAL          = 11, //signalfd
     SW_FD_DNS_RESOLVER    = 12, //dns resolver
     SW_FD_INOTIFY         = 13, //server socket
+    SW_FD_CHANNEL         = 14, //ipc channel notify
     SW_FD_USER            = 15, //SW_FD_USER or SW_FD_USER+n: for custom event
     SW_FD_CLIENT          = 16, //swClient
 };
@@ -430,6 +431,10 @@ typedef struct _swConnection
 
     uint32_t removed :1;
     uint32_t overflow :1;
+    /**
+     * the worker pipe is congested, stop reading from the socket
+     */
+    uint32_t paused :1;
 
     uint32_t tcp_nopush :1;
     uint32_t tcp_nodelay :1;
@@ -487,6 +492,23 @@ typedef struct _swConnection
      */
     uint8_t websocket_status;
 
+    /**
+     * permessage-deflate negotiated by the worker, the flags and the window bits of the streams
+     */
+    uint8_t websocket_compression;
+    uint8_t websocket_client_window_bits;
+    uint8_t websocket_server_window_bits;
+
+    /**
+     * the inflate stream of the reactor thread
+     */
+    void *websocket_inflate;
+
+    /**
+     * the fragmented message in reassembly
+     */
+    swString *websocket_message;
+
 #ifdef SW_USE_OPENSSL
     SSL *ssl;
     uint32_t ssl_state;
@@ -509,6 +531,10 @@ typedef struct _swProtocol
     uint32_t package_max_length;
 
     int (*onPackage)(swConnection *conn, char *data, uint32_t length);
+    /**
+     * the complete packages found in one read, optional
+     */
+    int (*onPackageBatch)(swConnection *conn, char *data, uint32_t *lengths, int n);
     int (*get_package_length)(struct _swProtocol *protocol, swConnection *conn, char *data, uint32_t length);
 } swProtocol;
 //------------------------------String--------------------------------
@@ -751,7 +777,7 @@ typedef struct _swCond
 
 typedef struct _swShareMemory_mmap
 {
-    int size;
+    size_t size;
     char mapfile[SW_SHM_MMAP_FILE_LEN];
     int tmpfd;
     int key;
@@ -759,7 +785,28 @@ typedef struct _swShareMemory_mmap
     void *mem;
 } swShareMemory;
 
-void *swShareMemory_mmap_create(swShareMemory *object, int size, char *mapfile);
+enum swShareMemory_hugepage
+{
+    SW_HUGEPAGE_NONE        = 0,
+    /**
+     * madvise(MADV_HUGEPAGE), the kernel merges the pages when shmem_enabled is advise
+     */
+    SW_HUGEPAGE_TRANSPARENT = 1,
+    /**
+     * MAP_HUGETLB from the reserved pool (vm.nr_hugepages), transparent when it is empty
+     */
+    SW_HUGEPAGE_EXPLICIT    = 2,
+};
+
+enum swShareMemory_numa
+{
+    SW_NUMA_NONE       = 0,
+    SW_NUMA_INTERLEAVE = 1,
+    SW_NUMA_BIND       = 2,
+};
+
+void *swShareMemory_mmap_create(swShareMemory *object, size_t size, char *mapfile);
+int swShareMemory_parse_nodes(char *str, uint64_t *nodes);
 void *swShareMemory_sysv_create(swShareMemory *object, int size, int key);
 int swShareMemory_sysv_free(swShareMemory *object, int rm);
 int swShareMemory_mmap_free(swShareMemory *object);
@@ -828,6 +875,44 @@ swMemoryPool *swRingBuffer_new(uint32_t size, uint8_t shared);
  */
 swMemoryPool* swMemoryGlobal_new(int pagesize, char shared);
 
+/**
+ * SlabPool, random alloc/free of any size, the memory is returned to the size class and reused
+ */
+typedef struct _swSlabPool_stats
+{
+    size_t size;
+    uint32_t page_num;
+    uint32_t page_used;
+    /**
+     * pages of the allocations bigger than the largest size class
+     */
+    uint32_t page_large;
+    /**
+     * bytes of the live objects, rounded up to their size classes
+     */
+    size_t used;
+    /**
+     * bytes of the free objects kept in the per-process magazines
+     */
+    size_t cached;
+    /**
+     * bytes of the free objects in the used pages
+     */
+    size_t free;
+    uint64_t alloc_num;
+    uint64_t free_num;
+    uint64_t fail_num;
+    /**
+     * free / (used + cached + free) of the size classes which have live objects, 0 when nothing is allocated
+     */
+    double fragmentation;
+} swSlabPool_stats;
+
+swMemoryPool* swSlabPool_new(size_t size, uint8_t shared);
+int swSlabPool_contains(swMemoryPool *pool, void *ptr);
+void swSlabPool_flush(swMemoryPool *pool);
+void swSlabPool_get_stats(swMemoryPool *pool, swSlabPool_stats *stats);
+
 void swFixedPool_debug(swMemoryPool *pool);
 
 /**
@@ -836,6 +921,7 @@ void swFixedPool_debug(swMemoryPool *pool);
 void* sw_shm_malloc(size_t size);
 void sw_shm_free(void *ptr);
 void* sw_shm_calloc(size_t num, size_t _size);
+void* sw_shm_mmap(char *mapfile, size_t size);
 void* sw_shm_realloc(void *ptr, size_t new_size);
 #ifdef HAVE_RWLOCK
 int swRWLock_create(swLock *lock, int use_in_process);
@@ -946,39 +1032,30 @@ static sw_inline int32_t swoole_unpack(char type, void *data)
     }
 }
 
-static inline char* swoole_strnstr(char *haystack, char *needle, uint32_t length)
-{
-    int i;
-    uint32_t needle_length = strlen(needle);
-    assert(needle_length > 0);
-
-    for (i = 0; i < (int) (length - needle_length + 1); i++)
-    {
-        if ((haystack[0] == needle[0]) && (0 == memcmp(haystack, needle, needle_length)))
-        {
-            return (char *) haystack;
-        }
-        haystack++;
-    }
-
-    return NULL;
-}
+/**
+ * substring search kernels, swoole_strnpos_handler is resolved by the cpu features on the first call.
+ * the haystacks shorter than SW_STRNPOS_SIMD_MIN always go to swoole_strnpos_generic
+ */
+typedef int (*swoole_strnpos_t)(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length);
+extern swoole_strnpos_t swoole_strnpos_handler;
+int swoole_strnpos_generic(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length);
+int swoole_strnpos_sse2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length);
+int swoole_strnpos_avx2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length);
 
 static inline int swoole_strnpos(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
 {
     assert(needle_length > 0);
-    uint32_t i;
-
-    for (i = 0; i < (int) (haystack_length - needle_length + 1); i++)
+    if (haystack_length < SW_STRNPOS_SIMD_MIN)
     {
-        if ((haystack[0] == needle[0]) && (0 == memcmp(haystack, needle, needle_length)))
-        {
-            return i;
-        }
-        haystack++;
+        return swoole_strnpos_generic(haystack, haystack_length, needle, needle_length);
     }
+    return swoole_strnpos_handler(haystack, haystack_length, needle, needle_length);
+}
 
-    return -1;
+static inline char* swoole_strnstr(char *haystack, char *needle, uint32_t length)
+{
+    int pos = swoole_strnpos(haystack, length, needle, strlen(needle));
+    return pos < 0 ? NULL : haystack + pos;
 }
 
 static inline int swoole_strrnpos(char *haystack, char *needle, uint32_t length)
@@ -1014,6 +1091,7 @@ int swoole_tmpfile(char *filename);
 swString* swoole_file_get_contents(char *filename);
 void swoole_open_remote_debug(void);
 char *swoole_dec2hex(int value, int base);
+int swoole_itoa(char *buf, long value);
 int swoole_version_compare(char *version1, char *version2);
 
 void swoole_ioctl_set_block(int sock, int nonblock);
@@ -1245,6 +1323,11 @@ struct _swWorker
 
 	swMsgQueue *queue;
 
+	/**
+	 * shared memory channel of swoole_process
+	 */
+	struct _swChannel *channel;
+
 	/**
 	 * redirect stdout to pipe_master
 	 */
@@ -1379,7 +1462,7 @@ static sw_inline int swReactor_event_error(int fdtype)
 
 static sw_inline int swReactor_fdtype(int fdtype)
 {
-    return fdtype & (~SW_EVENT_READ) & (~SW_EVENT_WRITE) & (~SW_EVENT_ERROR);
+    return fdtype & (~SW_EVENT_DEAULT) & (~SW_EVENT_READ) & (~SW_EVENT_WRITE) & (~SW_EVENT_ERROR);
 }
 
 static sw_inline int swReactor_events(int fdtype)
@@ -1426,7 +1509,8 @@ static sw_inline int swReactor_del_event(swReactor *reactor, int fd, enum swEven
     swConnection *conn = swReactor_get(reactor, fd);
     if (conn->events & event_type)
     {
-        return reactor->set(reactor, fd, conn->fdtype | (conn->events & (~event_type)));
+        //SW_EVENT_DEAULT: a bare fdtype means SW_EVENT_READ, keep the fd without any event
+        return reactor->set(reactor, fd, conn->fdtype | SW_EVENT_DEAULT | (conn->events & (~event_type)));
     }
     return SW_OK;
 }
@@ -1463,14 +1547,20 @@ enum SW_CHANNEL_FLAGS
 
 typedef struct _swChannel
 {
-	int head;    //头部，出队列方向
-	int tail;    //尾部，入队列方向
+	volatile uint64_t head;    //头部，出队列方向
+	volatile uint64_t tail;    //尾部，入队列方向, reserved by the producers
 	int size;    //队列总尺寸
-	char head_tag;
-	char tail_tag;
-	int num;
+	sw_atomic_t num;
+	/**
+	 * the eventfd has been written and not read yet
+	 */
+	sw_atomic_t notified;
 	int flag;
 	int maxlen;
+	/**
+	 * the process which created the channel, the lock is destroyed by it
+	 */
+	pid_t pid;
 	void *mem;   //内存块
 	swLock lock;
 	swPipe notify_fd;
@@ -1481,7 +1571,7 @@ int swChannel_pop(swChannel *object, void *out, int buffer_length);
 int swChannel_push(swChannel *object, void *in, int data_length);
 int swChannel_out(swChannel *object, void *out, int buffer_length);
 int swChannel_in(swChannel *object, void *in, int data_length);
-int swChannel_wait(swChannel *object);
+int swChannel_wait(swChannel *object, int timeout_ms);
 int swChannel_notify(swChannel *object);
 void swChannel_free(swChannel *object);
 
@@ -1734,6 +1824,16 @@ typedef struct
     swFactory *factory;
 
     swMemoryPool *memory_pool;
+    /**
+     * shared memory which is freed at runtime, NULL when it is not created
+     */
+    swMemoryPool *slab_pool;
+    /**
+     * the large anonymous shared memory regions, set before they are created
+     */
+    uint8_t shm_hugepage;
+    uint8_t shm_numa;
+    uint64_t shm_numa_nodes;
     swReactor *main_reactor;
 
     swPipe *task_notify;
@@ -1751,6 +1851,8 @@ typedef struct
     sw_atomic_t close_count;
     sw_atomic_t tasking_num;
     sw_atomic_t request_count;
+    sw_atomic_t pause_count;
+    sw_atomic_t resume_count;
 } swServerStats;
 
 extern swServerG SwooleG;              //Local Global Variable
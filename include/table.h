@@ -37,11 +37,21 @@ typedef struct _swTableRow
      */
     uint8_t active;
 
+    /**
+     * the reference bit of the clock, set when the row is read or written
+     */
+    uint8_t visited;
+
     /**
      * iterator
      */
     uint32_t list_index;
 
+    /**
+     * unix time, 0: never expire
+     */
+    uint32_t expire;
+
     /**
      * next slot
      */
@@ -59,6 +69,47 @@ typedef struct
     swTableRow *tmp_row;
 } swTable_iterator;
 
+/**
+ * the head of the table memory, the table is validated by it when the file is mapped again
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t max_size;
+    uint32_t item_size;
+    uint32_t layout;
+
+    /**
+     * (size << 32) | split, the buckets [0, size + split) are used, read in one word
+     */
+    volatile uint64_t state;
+
+    /**
+     * the conflict rows allocated from the pool, the freed rows are linked by next
+     */
+    uint32_t pool_n;
+    swTableRow *free_list;
+
+    /**
+     * the bucket of the clock hand, the rows with ttl are written to the table
+     */
+    sw_atomic_t clock;
+    uint8_t expire;
+
+    /**
+     * saved by swTable_free in the creating process, valid when clean=1
+     */
+    uint32_t row_num;
+    uint32_t list_n;
+    uint8_t clean;
+
+    /**
+     * the address of the table memory when it was mapped last time
+     */
+    void *memory;
+    size_t memory_size;
+} swTable_header;
+
 typedef struct
 {
     swHashMap *columns;
@@ -68,13 +119,29 @@ typedef struct
     uint32_t mask;
     uint32_t item_size;
 
+    /**
+     * the buckets grow to max_size, only one process splits the buckets
+     */
+    uint32_t max_size;
+    sw_atomic_t resize_lock;
+
+    /**
+     * SW_TABLE_EVICT_LRU: the rows are evicted when the table is full
+     */
+    uint8_t evict;
+
     /**
      * total rows that in active state(shm)
      */
     sw_atomic_t row_num;
 
     swTableRow **rows;
-    swMemoryPool *pool;
+
+    /**
+     * the rows for conflict
+     */
+    void *pool;
+    uint32_t pool_size;
 
     /**
      * for iterator
@@ -86,6 +153,10 @@ typedef struct
     swTable_iterator *iterator;
 
     void *memory;
+    /**
+     * the process created the table memory
+     */
+    pid_t pid;
 } swTable;
 
 typedef struct
@@ -109,6 +180,12 @@ enum swoole_table_type
     SW_TABLE_STRING,
 };
 
+enum swoole_table_evict
+{
+    SW_TABLE_EVICT_NONE = 0,
+    SW_TABLE_EVICT_LRU,
+};
+
 enum swoole_table_find
 {
     SW_TABLE_FIND_EQ = 1,
@@ -120,8 +197,33 @@ enum swoole_table_find
     SW_TABLE_FIND_LIKE,
 };
 
-swTable* swTable_new(uint32_t rows_size);
+/**
+ * the predicate of swTable_find, lval/dval/str is used by the column type
+ */
+typedef struct
+{
+    swTableColumn *column;
+    uint8_t op;
+    int64_t lval;
+    double dval;
+    char *str;
+    uint32_t str_len;
+} swTable_condition;
+
+/**
+ * the keys of the batch operations
+ */
+typedef struct
+{
+    char *str;
+    uint32_t length;
+} swTable_key;
+
+typedef void (*swTableRow_handler)(swTable *table, swTableRow *row, int index, void *arg);
+
+swTable* swTable_new(uint32_t rows_size, uint32_t max_size);
 int swTable_create(swTable *table);
+int swTable_create_mmap(swTable *table, char *mapfile);
 void swTable_free(swTable *table);
 int swTableColumn_add(swTable *table, char *name, int len, int type, int size);
 swTableRow* swTableRow_set(swTable *table, char *key, int keylen);
@@ -131,14 +233,91 @@ void swTable_iterator_rewind(swTable *table);
 swTableRow* swTable_iterator_current(swTable *table);
 void swTable_iterator_forward(swTable *table);
 int swTableRow_del(swTable *table, char *key, int keylen);
+void swTableRow_set_ttl(swTable *table, swTableRow *row, uint32_t ttl);
+int swTable_sweep(swTable *table, uint32_t n);
+int swTableRow_incr(swTable *table, char *key, int keylen, swTableColumn *col, int64_t incrby, int64_t *value);
+int swTableRow_incr_float(swTable *table, char *key, int keylen, swTableColumn *col, double incrby, double *value);
+int swTableRow_cas(swTable *table, char *key, int keylen, swTableColumn *col, int64_t expect, int64_t value);
+int swTableRow_cas_float(swTable *table, char *key, int keylen, swTableColumn *col, double expect, double value);
+int swTableRow_get_multi(swTable *table, swTable_key *keys, int n, swTableRow_handler handler, void *arg);
+int swTableRow_set_multi(swTable *table, swTable_key *keys, int n, swTableRow_handler handler, void *arg);
+int swTableRow_del_multi(swTable *table, swTable_key *keys, int n);
+int swTable_find(swTable *table, swTable_condition *conds, int cond_n, uint32_t offset, uint32_t limit, swTableRow **rows);
 
 static sw_inline swTableColumn* swTableColumn_get(swTable *table, char *column_key, int keylen)
 {
     return swHashMap_find(table->columns, column_key, keylen);
 }
 
+/**
+ * swTableRow_set() and swTableRow_get() return the row locked.
+ * lock=1: locked by a writer, the shared holders add 2 to it.
+ */
+static sw_inline void swTableRow_lock(swTableRow *row)
+{
+    sw_spinlock(&row->lock);
+}
+
+static sw_inline void swTableRow_unlock(swTableRow *row)
+{
+    //the shared holders may add to it at the same time
+    sw_atomic_fetch_sub(&row->lock, 1);
+}
+
+/**
+ * the rows of the bucket are not moved or freed while the root row is locked shared
+ */
+static sw_inline void swTableRow_lock_shared(swTableRow *row)
+{
+    while (sw_atomic_fetch_add(&row->lock, 2) & 1)
+    {
+        sw_atomic_fetch_sub(&row->lock, 2);
+        while (row->lock & 1)
+        {
+            swYield();
+        }
+    }
+}
+
+static sw_inline void swTableRow_unlock_shared(swTableRow *row)
+{
+    sw_atomic_fetch_sub(&row->lock, 2);
+}
+
+/**
+ * the copy of the i-th row returned by swTable_find()
+ */
+static sw_inline swTableRow* swTable_find_row(swTable *table, swTableRow *rows, uint32_t i)
+{
+    return (swTableRow *) ((char *) rows + (sizeof(swTableRow) + table->item_size) * i);
+}
+
 typedef uint32_t swTable_string_length_t;
 
+static sw_inline int64_t swTableRow_get_long(swTableRow *row, swTableColumn *col)
+{
+    int8_t v8;
+    int16_t v16;
+    int32_t v32;
+    int64_t v64;
+
+    switch(col->type)
+    {
+    case SW_TABLE_INT8:
+        memcpy(&v8, row->data + col->index, 1);
+        return v8;
+    case SW_TABLE_INT16:
+        memcpy(&v16, row->data + col->index, 2);
+        return v16;
+    case SW_TABLE_INT32:
+        memcpy(&v32, row->data + col->index, 4);
+        return v32;
+    default:
+        memcpy(&v64, row->data + col->index, 8);
+        return v64;
+    }
+}
+
 static sw_inline void swTableRow_set_value(swTableRow *row, swTableColumn * col, void *value, int vlen)
 {
     switch(col->type)
@@ -172,4 +351,66 @@ static sw_inline void swTableRow_set_value(swTableRow *row, swTableColumn * col,
     }
 }
 
+/**
+ * the numeric columns are aligned, they are updated by the atomic instructions
+ */
+static sw_inline int64_t swTableRow_atomic_add(swTableRow *row, swTableColumn *col, int64_t incrby)
+{
+    void *ptr = row->data + col->index;
+
+    switch(col->type)
+    {
+    case SW_TABLE_INT8:
+        return (int8_t) __sync_add_and_fetch((int8_t *) ptr, (int8_t) incrby);
+    case SW_TABLE_INT16:
+        return (int16_t) __sync_add_and_fetch((int16_t *) ptr, (int16_t) incrby);
+    case SW_TABLE_INT32:
+        return (int32_t) __sync_add_and_fetch((int32_t *) ptr, (int32_t) incrby);
+    default:
+        return __sync_add_and_fetch((int64_t *) ptr, incrby);
+    }
+}
+
+static sw_inline int swTableRow_atomic_cas(swTableRow *row, swTableColumn *col, int64_t expect, int64_t value)
+{
+    void *ptr = row->data + col->index;
+
+    switch(col->type)
+    {
+    case SW_TABLE_INT8:
+        return __sync_bool_compare_and_swap((int8_t *) ptr, (int8_t) expect, (int8_t) value);
+    case SW_TABLE_INT16:
+        return __sync_bool_compare_and_swap((int16_t *) ptr, (int16_t) expect, (int16_t) value);
+    case SW_TABLE_INT32:
+        return __sync_bool_compare_and_swap((int32_t *) ptr, (int32_t) expect, (int32_t) value);
+    default:
+        return __sync_bool_compare_and_swap((int64_t *) ptr, expect, value);
+    }
+}
+
+/**
+ * the double is compared and swapped as the 64 bits integer
+ */
+static sw_inline int swTableRow_atomic_cas_float(swTableRow *row, swTableColumn *col, double expect, double value)
+{
+    int64_t old, set;
+
+    memcpy(&old, &expect, sizeof(old));
+    memcpy(&set, &value, sizeof(set));
+    return __sync_bool_compare_and_swap((int64_t *) (row->data + col->index), old, set);
+}
+
+static sw_inline double swTableRow_atomic_add_float(swTableRow *row, swTableColumn *col, double incrby)
+{
+    double old, value;
+
+    do
+    {
+        memcpy(&old, row->data + col->index, sizeof(old));
+        value = old + incrby;
+    } while (!swTableRow_atomic_cas_float(row, col, old, value));
+
+    return value;
+}
+
 #endif /* SW_TABLE_H_ */
@@ -34,8 +34,11 @@ swUnitTest(mem_test1);
 swUnitTest(mem_test2);
 swUnitTest(mem_test3);
 swUnitTest(mem_test4);
+swUnitTest(mem_test5);
+swUnitTest(mem_test6);
 
 swUnitTest(client_test);
+swUnitTest(client_pool_test1);
 swUnitTest(server_test);
 
 swUnitTest(hashmap_test1);
@@ -43,6 +46,14 @@ swUnitTest(ds_test2);
 swUnitTest(ds_test1);
 
 swUnitTest(chan_test);
+swUnitTest(ipc_test1);
+swUnitTest(ipc_test2);
+swUnitTest(table_test1);
+swUnitTest(table_test2);
+swUnitTest(table_test3);
+swUnitTest(table_test4);
+swUnitTest(table_test5);
+swUnitTest(table_test6);
 
 swUnitTest(u1_test2);
 swUnitTest(u1_test1);
@@ -56,9 +67,15 @@ swUnitTest(aio_test);
 swUnitTest(aio_test2);
 
 swUnitTest(ws_test1);
+swUnitTest(ws_test2);
+swUnitTest(ws_test3);
 
 swUnitTest(http_test1);
 swUnitTest(http_test2);
+swUnitTest(http_test3);
+swUnitTest(http_test4);
+swUnitTest(http_test5);
+swUnitTest(http_test6);
 
 swUnitTest(heap_test1);
 swUnitTest(linkedlist_test);
@@ -69,4 +86,11 @@ swUnitTest(pool_thread);
 
 swUnitTest(ringbuffer_test1);
 
+swUnitTest(string_test1);
+
+swUnitTest(udp_test1);
+
+swUnitTest(protocol_test1);
+swUnitTest(protocol_test2);
+
 #endif /* SW_TESTS_H_ */
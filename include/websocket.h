@@ -24,6 +24,10 @@ extern "C"
 
 #include "Http.h"
 
+#ifdef SW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #define SW_WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 #define SW_WEBSOCKET_HEADER_LEN  2
 #define SW_WEBSOCKET_MASK_LEN    4
@@ -37,6 +41,12 @@ extern "C"
 #define FRAME_SET_MASK(BYTE) (((BYTE) & 0x01) << 7)
 #define FRAME_SET_LENGTH(X64, IDX) (unsigned char)(((X64) >> ((IDX)*8)) & 0xFF)
 
+/**
+ * RSV1 of the first frame, the message is compressed by permessage-deflate
+ */
+#define SW_WEBSOCKET_RSV1          0x40
+#define SW_WEBSOCKET_DEFLATE_TAIL  "\x00\x00\xff\xff"
+
 enum swWebsocketStatus
 {
     WEBSOCKET_STATUS_CONNECTION = 1,
@@ -44,6 +54,27 @@ enum swWebsocketStatus
     WEBSOCKET_STATUS_ACTIVE = 3,
 };
 
+enum swWebsocketDeflate_flag
+{
+    SW_WEBSOCKET_DEFLATE                      = 1,
+    SW_WEBSOCKET_CLIENT_NO_CONTEXT_TAKEOVER   = 2,
+    /**
+     * the fragmented message in reassembly is compressed
+     */
+    SW_WEBSOCKET_INFLATING                    = 4,
+};
+
+/**
+ * the parameters of permessage-deflate, 0 window bits if the parameter is absent
+ */
+typedef struct
+{
+    uint8_t server_no_context_takeover;
+    uint8_t client_no_context_takeover;
+    uint8_t server_max_window_bits;
+    uint8_t client_max_window_bits;
+} swWebSocket_deflate_param;
+
 typedef struct
 {
     /**
@@ -93,6 +124,15 @@ int swWebSocket_get_package_length(swProtocol *protocol, swConnection *conn, cha
 void swWebSocket_encode(swString *buffer, char *data, size_t length, char opcode, int fin, int isMask);
 void swWebSocket_decode(swWebSocket_frame *frame, swString *data);
 void swWebSocket_print_frame(swWebSocket_frame *frm);
+int swWebSocket_check_utf8(char *data, size_t length);
+int swWebSocket_get_close_code(char *payload, size_t length);
+
+int swWebSocket_parse_deflate_offer(char *value, size_t length, swWebSocket_deflate_param *offer);
+int swWebSocket_accept_deflate_offer(swWebSocket_deflate_param *offer, swWebSocket_deflate_param *setting, char *buf, size_t size);
+#ifdef SW_HAVE_ZLIB
+int swWebSocket_inflate(z_stream *stream, char *data, size_t length, int fin, swString *out, size_t max_length);
+int swWebSocket_deflate(z_stream *stream, char *data, size_t length, swString *out);
+#endif
 
 #ifdef __cplusplus
 }
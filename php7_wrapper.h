@@ -62,6 +62,8 @@ static inline int sw_zend_hash_find(HashTable *ht, char *k, int len, void **v)
 #define sw_add_assoc_stringl                  add_assoc_stringl
 #define sw_add_assoc_double_ex                add_assoc_double_ex
 #define sw_add_assoc_long_ex                  add_assoc_long_ex
+#define sw_add_assoc_zval_ex                  add_assoc_zval_ex
+#define sw_add_next_index_stringl             add_next_index_stringl
 
 #define sw_zval_ptr_dtor                      zval_ptr_dtor
 #define sw_zend_hash_copy                     zend_hash_copy
@@ -152,6 +154,7 @@ static sw_inline int sw_add_assoc_stringl_ex(zval *arg, const char *key, size_t
     return add_assoc_stringl_ex(arg, key, key_len - 1, str, length);
 }
 #define sw_add_assoc_double_ex(arg, key, key_len, d)     add_assoc_double_ex(arg, key, key_len - 1, d)
+#define sw_add_assoc_zval_ex(arg, key, key_len, zv)     add_assoc_zval_ex(arg, key, key_len - 1, zv)
 static sw_inline int sw_add_assoc_long_ex(zval *arg, const char *key, size_t key_len, long value)
 {
     return add_assoc_long_ex(arg, key, key_len - 1, value);
@@ -222,6 +225,7 @@ static inline char * sw_php_url_encode(char *value, size_t value_len, int* exten
 
 #define SW_RETURN_STRING(val, duplicate)     RETURN_STRING(val)
 #define sw_add_assoc_string(array, key, value, duplicate)   add_assoc_string(array, key, value)
+#define sw_add_next_index_stringl(array, value, length, duplicate)   add_next_index_stringl(array, value, length)
 #define sw_zend_hash_copy(target,source,pCopyConstructor,tmp,size) zend_hash_copy(target,source,pCopyConstructor)
 #define sw_zend_register_internal_class_ex(entry,parent_ptr,str)    zend_register_internal_class_ex(entry,parent_ptr)
 #define sw_zend_call_method_with_2_params(obj,ptr,what,char,return,name,cb)     zend_call_method_with_2_params(*obj,ptr,what,char,*return,name,cb)
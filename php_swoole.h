@@ -182,6 +182,8 @@ extern zend_class_entry *swoole_lock_class_entry_ptr;
 extern zend_class_entry *swoole_process_class_entry_ptr;
 extern zend_class_entry *swoole_client_class_entry_ptr;
 extern zend_class_entry *swoole_http_client_class_entry_ptr;
+extern zend_class_entry *swoole_mysql_class_entry_ptr;
+extern zend_class_entry *swoole_redis_class_entry_ptr;
 extern zend_class_entry *swoole_server_class_entry_ptr;
 extern zend_class_entry *swoole_connection_iterator_class_entry_ptr;
 extern zend_class_entry *swoole_buffer_class_entry_ptr;
@@ -288,6 +290,7 @@ PHP_FUNCTION(swoole_mysql_query);
 #endif
 
 PHP_FUNCTION(swoole_client_select);
+PHP_FUNCTION(swoole_client_pool_stats);
 
 void swoole_destory_table(zend_resource *rsrc TSRMLS_DC);
 
@@ -299,9 +302,7 @@ void swoole_client_init(int module_number TSRMLS_DC);
 #ifdef SW_ASYNC_HTTPCLIENT
 void swoole_http_client_init(int module_number TSRMLS_DC);
 #endif
-#ifdef SW_USE_REDIS
 void swoole_redis_init(int module_number TSRMLS_DC);
-#endif
 void swoole_process_init(int module_number TSRMLS_DC);
 void swoole_http_init(int module_number TSRMLS_DC);
 void swoole_websocket_init(int module_number TSRMLS_DC);
@@ -314,8 +315,13 @@ void php_swoole_check_reactor();
 void php_swoole_event_init();
 void php_swoole_event_wait();
 void php_swoole_check_timer(int interval);
+
+typedef void (*php_swoole_timer_handler)(void *object);
+long php_swoole_add_timer_internal(int ms, php_swoole_timer_handler handler, void *object, int is_tick);
+int php_swoole_del_timer_internal(long id);
 void php_swoole_register_callback(swServer *serv);
 swClient* php_swoole_client_create_socket(zval *object, char *host, int host_len, int port);
+void php_swoole_client_pool_free(zval *object, swClient *cli TSRMLS_DC);
 
 static sw_inline void* swoole_get_object(zval *object)
 {
@@ -359,6 +365,9 @@ ZEND_BEGIN_MODULE_GLOBALS(swoole)
     zend_bool cli;
     key_t message_queue_key;
     uint32_t socket_buffer_size;
+    char *shm_hugepage;
+    char *shm_numa;
+    char *shm_numa_nodes;
 ZEND_END_MODULE_GLOBALS(swoole)
 
 extern ZEND_DECLARE_MODULE_GLOBALS(swoole);
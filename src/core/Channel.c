@@ -17,13 +17,27 @@
 #include "swoole.h"
 
 #define SW_CHANNEL_MIN_MEM (1024*64)   //最小内存分配
+#define SW_CHANNEL_ALIGN(size)   (((size) + 7) & ~7)
 
-#define swChannel_empty(q) (q->num == 0)
-#define swChannel_full(q) ((q->head == q->tail) && (q->tail_tag != q->head_tag))
+#define swChannel_empty(q) (q->head == q->tail)
+
+enum swChannel_item_flag
+{
+    /**
+     * reserved by the producer, the data is not written
+     */
+    SW_CHANNEL_ITEM_EMPTY = 0,
+    SW_CHANNEL_ITEM_READY = 1,
+    /**
+     * the padding to the end of the ring, the item does not fit in it
+     */
+    SW_CHANNEL_ITEM_SKIP  = 2,
+};
 
 typedef struct _swChannel_item
 {
-    int length;
+    uint32_t length;
+    volatile uint32_t flag;
     char data[0];
 } swChannel_item;
 
@@ -31,13 +45,13 @@ int swChannel_pop(swChannel *object, void *out, int buffer_length);
 int swChannel_push(swChannel *object, void *in, int data_length);
 int swChannel_out(swChannel *object, void *out, int buffer_length);
 int swChannel_in(swChannel *object, void *in, int data_length);
-int swChannel_wait(swChannel *object);
+int swChannel_wait(swChannel *object, int timeout_ms);
 int swChannel_notify(swChannel *object);
 void swChannel_free(swChannel *object);
 
 void swChannel_debug(swChannel *chan)
 {
-    printf("RingBuffer: num=%d|head=%d|tail=%d|tail_tag=%d|head_tag=%d\n", chan->num, chan->head, chan->tail, (int)chan->tail_tag, (int)chan->head_tag);
+    printf("RingBuffer: num=%d|head=%ld|tail=%ld|size=%d\n", chan->num, (long) chan->head, (long) chan->tail, chan->size);
 }
 
 swChannel* swChannel_new(int size, int maxlen, int flag)
@@ -66,11 +80,13 @@ swChannel* swChannel_new(int size, int maxlen, int flag)
 
     bzero(object, sizeof(swChannel));
 
-    //overflow space
-    object->size = size - maxlen;
+    //the item is never split, the space of the items must be zero before they are written
+    object->size = (size - sizeof(swChannel)) & ~7;
     object->mem = mem;
     object->maxlen = maxlen;
     object->flag = flag;
+    object->pid = getpid();
+    bzero(object->mem, object->size);
 
     //use lock
     if (flag & SW_CHAN_LOCK)
@@ -85,7 +101,7 @@ swChannel* swChannel_new(int size, int maxlen, int flag)
     //use notify
     if (flag & SW_CHAN_NOTIFY)
     {
-        ret = swPipeNotify_auto(&object->notify_fd, 1, 1);
+        ret = swPipeNotify_auto(&object->notify_fd, 0, 0);
         if (ret < 0)
         {
             swWarn("swChannel_create: notify_fd init fail");
@@ -96,108 +112,153 @@ swChannel* swChannel_new(int size, int maxlen, int flag)
 }
 
 /**
- * push data(no lock)
+ * push data, the producers reserve the space with CAS and need no lock
  */
 int swChannel_in(swChannel *object, void *in, int data_length)
 {
-    assert(data_length < object->maxlen);
-    //队列满了
-    if (swChannel_full(object))
-    {
-        swWarn("queue full");
-        swChannel_debug(object);
-        //这里非常重要,避免此线程再次获得锁
-        swYield();
+    uint64_t head, tail;
+    uint32_t offset, padding;
+    uint32_t msize = SW_CHANNEL_ALIGN(sizeof(swChannel_item) + data_length);
+    swChannel_item *item;
+
+    if (data_length > object->maxlen)
+    {
+        swWarn("data is too big, maxlen=%d.", object->maxlen);
         return SW_ERR;
     }
-    swChannel_item *item;
-    int msize = sizeof(item->length) + data_length;
 
-    if (object->tail < object->head)
+    while (1)
     {
-        if ((object->head - object->tail) < msize)
+        tail = object->tail;
+        head = object->head;
+        offset = tail % object->size;
+        padding = (offset + msize > object->size) ? object->size - offset : 0;
+        //full
+        if (tail + padding + msize - head > object->size)
         {
-            //空间不足
+            SwooleG.error = SW_ERROR_CHANNEL_FULL;
             return SW_ERR;
         }
-        item = object->mem + object->tail;
-        object->tail += msize;
-    }
-    //这里tail必然小于size,无需判断,因为每次分配完会计算超过size后转到开始
-    else
-    {
-        item = object->mem + object->tail;
-        object->tail += msize;
-        if (object->tail >= object->size)
+        if (sw_atomic_cmp_set(&object->tail, tail, tail + padding + msize))
         {
-            object->tail = 0;
-            object->tail_tag = 1 - object->tail_tag;
+            break;
         }
+        sw_atomic_cpu_pause();
     }
-    object->num++;
+
+    if (padding > 0)
+    {
+        item = object->mem + offset;
+        item->length = padding;
+        sw_atomic_memory_barrier();
+        item->flag = SW_CHANNEL_ITEM_SKIP;
+        offset = 0;
+    }
+
+    item = object->mem + offset;
     item->length = data_length;
     memcpy(item->data, in, data_length);
+    //the consumer must see the data before the flag
+    sw_atomic_memory_barrier();
+    item->flag = SW_CHANNEL_ITEM_READY;
+    sw_atomic_fetch_add(&object->num, 1);
     return SW_OK;
 }
 
 /**
- * pop data(no lock)
+ * pop data (one consumer or lock)
  */
 int swChannel_out(swChannel *object, void *out, int buffer_length)
 {
-    //队列为空
-    if (swChannel_empty(object))
+    swChannel_item *item;
+    uint32_t msize;
+    int length;
+
+    while (1)
     {
-        swWarn("queue empty");
-        swChannel_debug(object);
-        //这里非常重要,避免此线程再次获得锁
-        swYield();
-        return SW_ERR;
+        if (swChannel_empty(object))
+        {
+            return SW_ERR;
+        }
+        item = object->mem + (object->head % object->size);
+        //the producer has not finished writing
+        if (item->flag == SW_CHANNEL_ITEM_EMPTY)
+        {
+            return SW_ERR;
+        }
+        sw_atomic_memory_barrier();
+        if (item->flag == SW_CHANNEL_ITEM_SKIP)
+        {
+            msize = item->length;
+            bzero(item, msize);
+            sw_atomic_memory_barrier();
+            object->head += msize;
+            continue;
+        }
+        break;
     }
-    swChannel_item *item = object->mem + object->head;
-    assert(buffer_length >= item->length);
-//    swWarn("out,len=%d|data=%s", item->length, item->data);
-    memcpy(out, item->data, item->length);
-    object->head += (item->length + sizeof(item->length));
-    if (object->head >= object->size)
+
+    length = item->length;
+    if (buffer_length < length)
     {
-        object->head = 0;
-        object->head_tag = 1 - object->head_tag;
+        swWarn("buffer is too small, length=%d, buffer_length=%d.", length, buffer_length);
+        return SW_ERR;
     }
-    object->num--;
-    return item->length;
+    memcpy(out, item->data, length);
+
+    msize = SW_CHANNEL_ALIGN(sizeof(swChannel_item) + length);
+    //the space can be reserved by the producers after head is moved
+    bzero(item, msize);
+    sw_atomic_memory_barrier();
+    object->head += msize;
+    sw_atomic_fetch_sub(&object->num, 1);
+    return length;
 }
 
 /**
- * wait notify
+ * wait notify, timeout_ms = -1 blocks until there is a notification, 0 returns immediately
  */
-int swChannel_wait(swChannel *object)
+int swChannel_wait(swChannel *object, int timeout_ms)
 {
     assert(object->flag & SW_CHAN_NOTIFY);
     uint64_t flag;
-    return object->notify_fd.read(&object->notify_fd, &flag, sizeof(flag));
+    int fd = object->notify_fd.getFd(&object->notify_fd, 0);
+    int ret = SW_OK;
+
+    if (timeout_ms != 0 && swSocket_wait(fd, timeout_ms, SW_EVENT_READ) < 0)
+    {
+        ret = SW_ERR;
+    }
+    else if (object->notify_fd.read(&object->notify_fd, &flag, sizeof(flag)) < 0)
+    {
+        ret = SW_ERR;
+    }
+    //the next push must notify again, the caller pops after this
+    object->notified = 0;
+    sw_atomic_memory_barrier();
+    return ret;
 }
 
 /**
- * new data coming, notify to customer
+ * new data coming, notify to customer. only the first push after the wait writes the eventfd.
  */
 int swChannel_notify(swChannel *object)
 {
     assert(object->flag & SW_CHAN_NOTIFY);
     uint64_t flag = 1;
+    if (!sw_atomic_cmp_set(&object->notified, 0, 1))
+    {
+        return SW_OK;
+    }
     return object->notify_fd.write(&object->notify_fd, &flag, sizeof(flag));
 }
 
 /**
- * push data (lock)
+ * push data, the producers need no lock
  */
 int swChannel_push(swChannel *object, void *in, int data_length)
 {
-    assert(object->flag & SW_CHAN_LOCK);
-    object->lock.lock(&object->lock);
-    int ret = swChannel_in(object, in, data_length);
-    object->lock.unlock(&object->lock);
-    return ret;
+    return swChannel_in(object, in, data_length);
 }
 
 /**
@@ -205,6 +266,12 @@ int swChannel_push(swChannel *object, void *in, int data_length)
  */
 void swChannel_free(swChannel *object)
 {
+    //the lock and the notify pipe in shared memory are still used by the other processes
+    if ((object->flag & SW_CHAN_SHM) && object->pid != getpid())
+    {
+        sw_shm_free(object);
+        return;
+    }
     if (object->flag & SW_CHAN_LOCK)
     {
         object->lock.free(&object->lock);
@@ -234,4 +301,3 @@ int swChannel_pop(swChannel *object, void *out, int buffer_length)
     object->lock.unlock(&object->lock);
     return n;
 }
-
@@ -61,6 +61,12 @@ void swoole_init(void)
         printf("[Master] Fatal Error: create global memory failed.");
         exit(1);
     }
+    //the pages are mapped when they are used, the subsystems use sw_shm_malloc without it
+    SwooleG.slab_pool = swSlabPool_new(SW_SLAB_POOL_SIZE, 1);
+    if (SwooleG.slab_pool == NULL)
+    {
+        swWarn("create slab memory pool failed.");
+    }
     SwooleGS = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swServerGS));
     if (SwooleGS == NULL)
     {
@@ -108,6 +114,11 @@ void swoole_clean(void)
     {
         SwooleG.memory_pool->destroy(SwooleG.memory_pool);
         SwooleG.memory_pool = NULL;
+        if (SwooleG.slab_pool != NULL)
+        {
+            SwooleG.slab_pool->destroy(SwooleG.slab_pool);
+            SwooleG.slab_pool = NULL;
+        }
         if (SwooleG.timer.fd > 0)
         {
             SwooleG.timer.free(&SwooleG.timer);
@@ -264,6 +275,31 @@ char* swoole_dec2hex(int value, int base)
     return strndup(ptr, end - ptr);
 }
 
+/**
+ * decimal digits without the terminating zero, buf has 20 bytes at least
+ */
+int swoole_itoa(char *buf, long value)
+{
+    char tmp[20];
+    char *ptr = tmp + sizeof(tmp);
+    unsigned long n = value < 0 ? -(unsigned long) value : value;
+    int length;
+
+    do
+    {
+        *--ptr = '0' + n % 10;
+        n /= 10;
+    } while (n);
+
+    if (value < 0)
+    {
+        *--ptr = '-';
+    }
+    length = tmp + sizeof(tmp) - ptr;
+    memcpy(buf, ptr, length);
+    return length;
+}
+
 int swoole_sync_writefile(int fd, void *data, int len)
 {
     int n = 0;
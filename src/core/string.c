@@ -16,6 +16,15 @@
 
 #include "swoole.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SW_STRNPOS_SIMD 1
+#include <immintrin.h>
+#endif
+
+static int swoole_strnpos_resolve(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length);
+
+swoole_strnpos_t swoole_strnpos_handler = swoole_strnpos_resolve;
+
 swString *swString_new(size_t size)
 {
     swString *str = sw_malloc(sizeof(swString));
@@ -209,3 +218,197 @@ size_t swoole_utf8_length(u_char *p, size_t n)
     return len;
 }
 
+/**
+ * memchr the first byte, then compare the rest
+ */
+int swoole_strnpos_generic(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    if (haystack_length < needle_length)
+    {
+        return -1;
+    }
+
+    char *p = haystack;
+    char *end = haystack + haystack_length - needle_length + 1;
+
+    while (p < end)
+    {
+        p = memchr(p, needle[0], end - p);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        if (memcmp(p + 1, needle + 1, needle_length - 1) == 0)
+        {
+            return p - haystack;
+        }
+        p++;
+    }
+    return -1;
+}
+
+#ifdef SW_STRNPOS_SIMD
+/**
+ * memchr is faster while the first byte of the needle is rare,
+ * the kernels take over after SW_STRNPOS_MEMCHR_MISS false candidates.
+ * return -2 and the offset to continue from when it gives up.
+ */
+static sw_inline int swoole_strnpos_memchr(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length, uint32_t *offset)
+{
+    int miss = 0;
+    char *p = haystack;
+    char *end = haystack + haystack_length - needle_length + 1;
+
+    while (p < end)
+    {
+        p = memchr(p, needle[0], end - p);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        if (memcmp(p + 1, needle + 1, needle_length - 1) == 0)
+        {
+            return p - haystack;
+        }
+        if (++miss == SW_STRNPOS_MEMCHR_MISS)
+        {
+            *offset = p - haystack + 1;
+            return -2;
+        }
+        p++;
+    }
+    return -1;
+}
+
+/**
+ * compare the first and the last byte of the needle at 16 positions at once,
+ * only the candidates matching both are checked with memcmp
+ */
+int swoole_strnpos_sse2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    uint32_t i = 0;
+    uint32_t mask;
+    int n;
+    char *p;
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    __m128i block_first, block_last;
+
+    if (haystack_length < needle_length)
+    {
+        return -1;
+    }
+    if (needle_length == 1)
+    {
+        p = memchr(haystack, needle[0], haystack_length);
+        return p == NULL ? -1 : p - haystack;
+    }
+    n = swoole_strnpos_memchr(haystack, haystack_length, needle, needle_length, &i);
+    if (n != -2)
+    {
+        return n;
+    }
+
+    //never read past the end of the haystack, it is not terminated
+    for (; (uint64_t) i + needle_length + 15 <= haystack_length; i += 16)
+    {
+        block_first = _mm_loadu_si128((__m128i *) (haystack + i));
+        block_last = _mm_loadu_si128((__m128i *) (haystack + i + needle_length - 1));
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+        while (mask)
+        {
+            n = __builtin_ctz(mask);
+            if (needle_length <= 2 || memcmp(haystack + i + n + 1, needle + 1, needle_length - 2) == 0)
+            {
+                return i + n;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    n = swoole_strnpos_generic(haystack + i, haystack_length - i, needle, needle_length);
+    return n < 0 ? -1 : (int) i + n;
+}
+
+__attribute__((target("avx2")))
+int swoole_strnpos_avx2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    uint32_t i = 0;
+    uint64_t mask;
+    int n;
+    char *p;
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+    __m256i eq0, eq1;
+
+    if (haystack_length < needle_length)
+    {
+        return -1;
+    }
+    if (needle_length == 1)
+    {
+        p = memchr(haystack, needle[0], haystack_length);
+        return p == NULL ? -1 : p - haystack;
+    }
+    n = swoole_strnpos_memchr(haystack, haystack_length, needle, needle_length, &i);
+    if (n != -2)
+    {
+        return n;
+    }
+
+    //64 positions per round, the masks are only extracted when there is a candidate
+    for (; (uint64_t) i + needle_length + 63 <= haystack_length; i += 64)
+    {
+        eq0 = _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_loadu_si256((__m256i *) (haystack + i))),
+                _mm256_cmpeq_epi8(last, _mm256_loadu_si256((__m256i *) (haystack + i + needle_length - 1))));
+        eq1 = _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_loadu_si256((__m256i *) (haystack + i + 32))),
+                _mm256_cmpeq_epi8(last, _mm256_loadu_si256((__m256i *) (haystack + i + 32 + needle_length - 1))));
+        if (_mm256_testz_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq0, eq1)))
+        {
+            continue;
+        }
+        mask = (uint32_t) _mm256_movemask_epi8(eq0) | ((uint64_t) (uint32_t) _mm256_movemask_epi8(eq1) << 32);
+        while (mask)
+        {
+            n = __builtin_ctzll(mask);
+            if (needle_length <= 2 || memcmp(haystack + i + n + 1, needle + 1, needle_length - 2) == 0)
+            {
+                return i + n;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    //less than 64 bytes left
+    n = swoole_strnpos_generic(haystack + i, haystack_length - i, needle, needle_length);
+    return n < 0 ? -1 : (int) i + n;
+}
+#else
+int swoole_strnpos_sse2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    return swoole_strnpos_generic(haystack, haystack_length, needle, needle_length);
+}
+
+int swoole_strnpos_avx2(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    return swoole_strnpos_generic(haystack, haystack_length, needle, needle_length);
+}
+#endif
+
+static int swoole_strnpos_resolve(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+#ifdef SW_STRNPOS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        swoole_strnpos_handler = swoole_strnpos_avx2;
+    }
+    else
+    {
+        swoole_strnpos_handler = swoole_strnpos_sse2;
+    }
+#else
+    swoole_strnpos_handler = swoole_strnpos_generic;
+#endif
+    return swoole_strnpos_handler(haystack, haystack_length, needle, needle_length);
+}
@@ -16,6 +16,17 @@
 
 #include "swoole.h"
 #include <sys/shm.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#ifndef MPOL_BIND
+#define MPOL_BIND          2
+#define MPOL_INTERLEAVE    3
+#endif
+
+static void *swShareMemory_mmap_anon(size_t *size, int flag, int fd);
 
 void* sw_shm_malloc(size_t size)
 {
@@ -35,13 +46,33 @@ void* sw_shm_malloc(size_t size)
     }
 }
 
+/**
+ * same as sw_shm_malloc, the memory is backed by the file and kept after the processes exit
+ */
+void* sw_shm_mmap(char *mapfile, size_t size)
+{
+    swShareMemory object;
+    void *mem;
+    size += sizeof(swShareMemory);
+    mem = swShareMemory_mmap_create(&object, size, mapfile);
+    if (mem == NULL)
+    {
+        return NULL;
+    }
+    else
+    {
+        memcpy(mem, &object, sizeof(swShareMemory));
+        return mem + sizeof(swShareMemory);
+    }
+}
+
 void* sw_shm_calloc(size_t num, size_t _size)
 {
     swShareMemory object;
     void *mem;
     void *ret_mem;
     //object对象需要保存在头部
-    int size = sizeof(swShareMemory) + (num * _size);
+    size_t size = sizeof(swShareMemory) + (num * _size);
     mem = swShareMemory_mmap_create(&object, size, NULL);
     if (mem == NULL)
     {
@@ -83,26 +114,77 @@ void* sw_shm_realloc(void *ptr, size_t new_size)
     }
     else
     {
-        memcpy(new_ptr, ptr, object->size);
+        //object->size is the size of the mapping, which is rounded up for the huge pages
+        memcpy(new_ptr, ptr, object->size - sizeof(swShareMemory) < new_size ? object->size - sizeof(swShareMemory) : new_size);
         sw_shm_free(ptr);
         return new_ptr;
     }
 }
 
-void *swShareMemory_mmap_create(swShareMemory *object, int size, char *mapfile)
+/**
+ * The file is mapped at the address of the last time when possible (it is saved in the swShareMemory at the head
+ * of the file by sw_shm_mmap), so the pointers in the memory are still valid.
+ */
+static void *swShareMemory_mmap_file(swShareMemory *object, size_t size, char *mapfile)
+{
+    swShareMemory last;
+    struct stat file_stat;
+    void *addr = NULL;
+    void *mem;
+
+    int fd = open(mapfile, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        swWarn("open(%s) failed. Error: %s[%d]", mapfile, strerror(errno), errno);
+        return NULL;
+    }
+    if (fstat(fd, &file_stat) < 0)
+    {
+        swWarn("fstat(%s) failed. Error: %s[%d]", mapfile, strerror(errno), errno);
+        close(fd);
+        return NULL;
+    }
+    if ((size_t) file_stat.st_size == size && pread(fd, &last, sizeof(last), 0) == sizeof(last) && last.size == size)
+    {
+        addr = last.mem;
+    }
+    else if (ftruncate(fd, size) < 0)
+    {
+        swWarn("ftruncate(%s, %ld) failed. Error: %s[%d]", mapfile, size, strerror(errno), errno);
+        close(fd);
+        return NULL;
+    }
+
+    mem = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        swWarn("mmap(%s) failed. Error: %s[%d]", mapfile, strerror(errno), errno);
+        return NULL;
+    }
+    strncpy(object->mapfile, mapfile, SW_SHM_MMAP_FILE_LEN - 1);
+    object->tmpfd = -1;
+    object->size = size;
+    object->mem = mem;
+    return mem;
+}
+
+void *swShareMemory_mmap_create(swShareMemory *object, size_t size, char *mapfile)
 {
     void *mem;
     int tmpfd = -1;
     int flag = MAP_SHARED;
     bzero(object, sizeof(swShareMemory));
 
+    if (mapfile != NULL)
+    {
+        return swShareMemory_mmap_file(object, size, mapfile);
+    }
+
 #ifdef MAP_ANONYMOUS
     flag |= MAP_ANONYMOUS;
 #else
-    if(mapfile == NULL)
-    {
-        mapfile = "/dev/zero";
-    }
+    mapfile = "/dev/zero";
     if((tmpfd = open(mapfile, O_RDWR)) < 0)
     {
         return NULL;
@@ -111,7 +193,7 @@ void *swShareMemory_mmap_create(swShareMemory *object, int size, char *mapfile)
     object->tmpfd = tmpfd;
 #endif
 
-    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flag, tmpfd, 0);
+    mem = swShareMemory_mmap_anon(&size, flag, tmpfd);
 #ifdef MAP_FAILED
     if (mem == MAP_FAILED)
 #else
@@ -129,6 +211,133 @@ void *swShareMemory_mmap_create(swShareMemory *object, int size, char *mapfile)
     }
 }
 
+/**
+ * "0-3,6": the nodes in the format of /sys/devices/system/node/online
+ */
+int swShareMemory_parse_nodes(char *str, uint64_t *nodes)
+{
+    long start, end;
+    char *p = str;
+
+    *nodes = 0;
+    while (*p)
+    {
+        start = end = strtol(p, &p, 10);
+        if (*p == '-')
+        {
+            end = strtol(p + 1, &p, 10);
+        }
+        if (start < 0 || end < start || end >= 64)
+        {
+            return SW_ERR;
+        }
+        for (; start <= end; start++)
+        {
+            *nodes |= 1ULL << start;
+        }
+        while (*p == ',' || *p == ' ' || *p == '\n')
+        {
+            p++;
+        }
+    }
+    return *nodes == 0 ? SW_ERR : SW_OK;
+}
+
+/**
+ * the pages are placed by the policy when they are touched the first time
+ */
+static void swShareMemory_numa(void *mem, size_t size)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    static uint64_t online = 0;
+    char buf[128];
+    uint64_t nodes = SwooleG.shm_numa_nodes;
+    unsigned long mask;
+    int mode = SwooleG.shm_numa == SW_NUMA_BIND ? MPOL_BIND : MPOL_INTERLEAVE;
+
+    if (nodes == 0)
+    {
+        if (online == 0)
+        {
+            int n = -1, fd = open("/sys/devices/system/node/online", O_RDONLY);
+            if (fd >= 0)
+            {
+                n = read(fd, buf, sizeof(buf) - 1);
+                close(fd);
+            }
+            buf[n > 0 ? n : 0] = 0;
+            if (n <= 0 || swShareMemory_parse_nodes(buf, &online) < 0)
+            {
+                online = 1;
+            }
+        }
+        nodes = online;
+    }
+    //a single node, nothing to interleave
+    if (mode == MPOL_INTERLEAVE && (nodes & (nodes - 1)) == 0)
+    {
+        return;
+    }
+    mask = (unsigned long) nodes;
+    if (syscall(SYS_mbind, mem, size, mode, &mask, sizeof(mask) * 8 + 1, 0) < 0)
+    {
+        swWarn("mbind(%s, 0x%lx) failed. Error: %s[%d]", mode == MPOL_BIND ? "bind" : "interleave", mask,
+                strerror(errno), errno);
+    }
+#endif
+}
+
+/**
+ * the huge pages are used for the large regions only, the mapping falls back to the normal pages
+ */
+static void *swShareMemory_mmap_anon(size_t *size, int flag, int fd)
+{
+    static int hugetlb_failed = 0;
+    void *mem = MAP_FAILED;
+
+    int hugepage = *size >= SW_HUGEPAGE_MIN ? SwooleG.shm_hugepage : SW_HUGEPAGE_NONE;
+
+#ifdef MAP_HUGETLB
+    if (hugepage == SW_HUGEPAGE_EXPLICIT && !hugetlb_failed)
+    {
+        size_t huge_size = (*size + SW_HUGEPAGE_SIZE - 1) & ~((size_t) SW_HUGEPAGE_SIZE - 1);
+        mem = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, flag | MAP_HUGETLB, fd, 0);
+        if (mem != MAP_FAILED)
+        {
+            *size = huge_size;
+        }
+        else
+        {
+            //the pool is empty, do not try again
+            hugetlb_failed = 1;
+            swWarn("mmap(MAP_HUGETLB, %ld) failed, use the transparent huge pages. Error: %s[%d]", huge_size,
+                    strerror(errno), errno);
+        }
+    }
+#endif
+
+    if (mem == MAP_FAILED)
+    {
+        mem = mmap(NULL, *size, PROT_READ | PROT_WRITE, flag, fd, 0);
+        if (mem == MAP_FAILED)
+        {
+            return mem;
+        }
+#ifdef MADV_HUGEPAGE
+        //not supported by the kernel, the normal pages are used
+        if (hugepage != SW_HUGEPAGE_NONE)
+        {
+            madvise(mem, *size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    if (SwooleG.shm_numa != SW_NUMA_NONE)
+    {
+        swShareMemory_numa(mem, *size);
+    }
+    return mem;
+}
+
 int swShareMemory_mmap_free(swShareMemory *object)
 {
     return munmap(object->mem, object->size);
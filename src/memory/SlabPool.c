@@ -0,0 +1,571 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+
+/**
+ * 16, 24, 32, 48, 64, 96 ... 12288, 16384
+ */
+#define SW_SLAB_CLASS_NUM      21
+#define SW_SLAB_MIN_SIZE       16
+#define SW_SLAB_MAX_SIZE       16384
+
+enum swSlabPool_page_type
+{
+    SW_SLAB_PAGE_FREE  = 0,
+    /**
+     * 1 ... SW_SLAB_CLASS_NUM: the page is cut into the objects of the size class (type - 1)
+     */
+    SW_SLAB_PAGE_LARGE = 0xfe,
+    /**
+     * the following pages of a large allocation
+     */
+    SW_SLAB_PAGE_SPAN  = 0xff,
+};
+
+typedef struct _swSlabPool_page
+{
+    uint8_t type;
+    uint32_t span;
+} swSlabPool_page;
+
+typedef struct _swSlabPool_class
+{
+    uint32_t size;
+    /**
+     * objects kept by a magazine of this class
+     */
+    uint32_t capacity;
+    void *free_list;
+    uint32_t page_num;
+    uint32_t object_num;
+    uint32_t free_num;
+    /**
+     * objects in the magazines of all the processes, updated when they are refilled or flushed
+     */
+    uint32_t cached_num;
+} swSlabPool_class;
+
+/**
+ * in the shared memory, all the fields are protected by the lock
+ */
+typedef struct _swSlabPool_header
+{
+    swLock lock;
+    void *memory;
+    uint32_t page_num;
+    uint32_t page_used;
+    uint32_t page_large;
+    uint32_t page_hint;
+    uint64_t alloc_num;
+    uint64_t free_num;
+    uint64_t fail_num;
+    swSlabPool_class classes[SW_SLAB_CLASS_NUM];
+    swSlabPool_page pages[0];
+} swSlabPool_header;
+
+typedef struct _swSlabPool_magazine
+{
+    uint32_t num;
+    /**
+     * num at the last time the counters were moved into the header
+     */
+    uint32_t synced;
+    uint32_t alloc_num;
+    uint32_t free_num;
+    void *objects[SW_SLAB_MAGAZINE_SIZE];
+} swSlabPool_magazine;
+
+/**
+ * in the memory of the process, the magazines are taken without the shared lock
+ */
+typedef struct _swSlabPool
+{
+    swSlabPool_header *header;
+    size_t size;
+    uint8_t shared;
+    /**
+     * the magazines are copied by fork, the objects in them belong to the parent process
+     */
+    pid_t pid;
+    /**
+     * the threads of the process, a thread which can not get it uses the shared lock
+     */
+    sw_atomic_t lock;
+    swSlabPool_magazine magazines[SW_SLAB_CLASS_NUM];
+} swSlabPool;
+
+static void* swSlabPool_alloc(swMemoryPool *pool, uint32_t size);
+static void swSlabPool_free(swMemoryPool *pool, void *ptr);
+static void swSlabPool_destroy(swMemoryPool *pool);
+
+static sw_inline int swSlabPool_class_index(uint32_t size)
+{
+    if (size <= SW_SLAB_MIN_SIZE)
+    {
+        return 0;
+    }
+    uint32_t s = size - 1;
+    int bit = 31 - __builtin_clz(s);
+    return (bit - 4) * 2 + ((s >> (bit - 1)) & 1) + 1;
+}
+
+/**
+ * create new SlabPool, the pages are mapped when they are used the first time
+ */
+swMemoryPool* swSlabPool_new(size_t size, uint8_t shared)
+{
+    uint32_t i, page_num = size / SW_SLAB_PAGE_SIZE;
+    size_t header_size = (sizeof(swSlabPool_header) + sizeof(swSlabPool_page) * page_num + 4095) & ~4095;
+
+    if (page_num == 0)
+    {
+        swWarn("swSlabPool_new: size=%ld is less than a page.", size);
+        return NULL;
+    }
+
+    swSlabPool_header *header;
+    size = header_size + (size_t) page_num * SW_SLAB_PAGE_SIZE;
+    header = (shared == 1) ? sw_shm_malloc(size) : sw_malloc(size);
+    if (header == NULL)
+    {
+        swWarn("swSlabPool_new: malloc(%ld) failed.", size);
+        return NULL;
+    }
+    bzero(header, header_size);
+    header->memory = (void *) header + header_size;
+    header->page_num = page_num;
+
+    for (i = 0; i < SW_SLAB_CLASS_NUM; i++)
+    {
+        header->classes[i].size = i == 0 ? SW_SLAB_MIN_SIZE : (1 << ((i - 1) / 2 + 4)) + (((i - 1) % 2) + 1) * (1 << ((i - 1) / 2 + 3));
+        //the large objects are not kept too much by the idle processes
+        header->classes[i].capacity = SW_SLAB_PAGE_SIZE / 2 / header->classes[i].size;
+        if (header->classes[i].capacity > SW_SLAB_MAGAZINE_SIZE)
+        {
+            header->classes[i].capacity = SW_SLAB_MAGAZINE_SIZE;
+        }
+        else if (header->classes[i].capacity < 2)
+        {
+            header->classes[i].capacity = 2;
+        }
+    }
+
+    if (swMutex_create(&header->lock, shared) < 0)
+    {
+        swWarn("swSlabPool_new: mutex create failed.");
+        goto fail;
+    }
+
+    swMemoryPool *pool = sw_malloc(sizeof(swMemoryPool) + sizeof(swSlabPool));
+    if (pool == NULL)
+    {
+        swWarn("swSlabPool_new: malloc failed.");
+        goto fail;
+    }
+    swSlabPool *object = (swSlabPool *) (pool + 1);
+    bzero(object, sizeof(swSlabPool));
+    object->header = header;
+    object->size = size;
+    object->shared = shared;
+    object->pid = getpid();
+
+    pool->object = object;
+    pool->alloc = swSlabPool_alloc;
+    pool->free = swSlabPool_free;
+    pool->destroy = swSlabPool_destroy;
+    return pool;
+
+    fail:
+    if (shared == 1)
+    {
+        sw_shm_free(header);
+    }
+    else
+    {
+        sw_free(header);
+    }
+    return NULL;
+}
+
+/**
+ * first fit, the single pages are searched from the last freed or used position
+ */
+static void* swSlabPool_alloc_pages(swSlabPool_header *header, uint32_t n, uint8_t type)
+{
+    uint32_t i, j, run, start = (n == 1) ? header->page_hint : 0;
+
+    while (1)
+    {
+        for (i = start, run = 0; i < header->page_num; i++)
+        {
+            if (header->pages[i].type != SW_SLAB_PAGE_FREE)
+            {
+                run = 0;
+                continue;
+            }
+            if (++run < n)
+            {
+                continue;
+            }
+            i = i + 1 - n;
+            header->pages[i].type = type;
+            header->pages[i].span = n;
+            for (j = 1; j < n; j++)
+            {
+                header->pages[i + j].type = SW_SLAB_PAGE_SPAN;
+            }
+            header->page_used += n;
+            header->page_hint = i + n;
+            return header->memory + (size_t) i * SW_SLAB_PAGE_SIZE;
+        }
+        if (start == 0)
+        {
+            return NULL;
+        }
+        start = 0;
+    }
+}
+
+/**
+ * cut a new page into the objects when the free list is empty
+ */
+static void* swSlabPool_pop(swSlabPool_header *header, int index)
+{
+    swSlabPool_class *cls = &header->classes[index];
+    void *object;
+    uint32_t i, n;
+
+    if (cls->free_list == NULL)
+    {
+        void *page = swSlabPool_alloc_pages(header, 1, index + 1);
+        if (page == NULL)
+        {
+            return NULL;
+        }
+        n = SW_SLAB_PAGE_SIZE / cls->size;
+        for (i = 0; i < n; i++)
+        {
+            object = page + (size_t) (n - 1 - i) * cls->size;
+            *(void **) object = cls->free_list;
+            cls->free_list = object;
+        }
+        cls->page_num++;
+        cls->object_num += n;
+        cls->free_num += n;
+    }
+
+    object = cls->free_list;
+    cls->free_list = *(void **) object;
+    cls->free_num--;
+    return object;
+}
+
+static sw_inline void swSlabPool_push(swSlabPool_header *header, int index, void *object)
+{
+    swSlabPool_class *cls = &header->classes[index];
+    *(void **) object = cls->free_list;
+    cls->free_list = object;
+    cls->free_num++;
+}
+
+/**
+ * move the counters of the magazine into the header, with the lock
+ */
+static sw_inline void swSlabPool_sync(swSlabPool_header *header, int index, swSlabPool_magazine *mag)
+{
+    header->classes[index].cached_num += (int32_t) (mag->num - mag->synced);
+    header->alloc_num += mag->alloc_num;
+    header->free_num += mag->free_num;
+    mag->alloc_num = 0;
+    mag->free_num = 0;
+    mag->synced = mag->num;
+}
+
+static void swSlabPool_refill(swSlabPool *object, int index)
+{
+    swSlabPool_header *header = object->header;
+    swSlabPool_magazine *mag = &object->magazines[index];
+    uint32_t half = header->classes[index].capacity / 2;
+    void *ptr;
+
+    header->lock.lock(&header->lock);
+    swSlabPool_sync(header, index, mag);
+    while (mag->num < half && (ptr = swSlabPool_pop(header, index)) != NULL)
+    {
+        mag->objects[mag->num++] = ptr;
+    }
+    swSlabPool_sync(header, index, mag);
+    header->lock.unlock(&header->lock);
+}
+
+static void swSlabPool_release(swSlabPool *object, int index, uint32_t n)
+{
+    swSlabPool_header *header = object->header;
+    swSlabPool_magazine *mag = &object->magazines[index];
+
+    header->lock.lock(&header->lock);
+    swSlabPool_sync(header, index, mag);
+    while (n-- > 0 && mag->num > 0)
+    {
+        swSlabPool_push(header, index, mag->objects[--mag->num]);
+    }
+    swSlabPool_sync(header, index, mag);
+    header->lock.unlock(&header->lock);
+}
+
+/**
+ * the private lock is held
+ */
+static sw_inline void swSlabPool_check_pid(swSlabPool *object)
+{
+    pid_t pid = getpid();
+    if (object->pid != pid)
+    {
+        bzero(object->magazines, sizeof(object->magazines));
+        object->pid = pid;
+    }
+}
+
+static void* swSlabPool_alloc_large(swSlabPool *object, uint32_t size)
+{
+    swSlabPool_header *header = object->header;
+    uint32_t n = (size + SW_SLAB_PAGE_SIZE - 1) / SW_SLAB_PAGE_SIZE;
+
+    header->lock.lock(&header->lock);
+    void *ptr = swSlabPool_alloc_pages(header, n, SW_SLAB_PAGE_LARGE);
+    if (ptr)
+    {
+        header->page_large += n;
+        header->alloc_num++;
+    }
+    else
+    {
+        header->fail_num++;
+    }
+    header->lock.unlock(&header->lock);
+    return ptr;
+}
+
+static void* swSlabPool_alloc(swMemoryPool *pool, uint32_t size)
+{
+    swSlabPool *object = pool->object;
+    swSlabPool_header *header = object->header;
+    swSlabPool_magazine *mag;
+    void *ptr;
+
+    if (size > SW_SLAB_MAX_SIZE)
+    {
+        return swSlabPool_alloc_large(object, size);
+    }
+
+    int index = swSlabPool_class_index(size);
+    //another thread of the process is using the magazines
+    if (!sw_atomic_cmp_set(&object->lock, 0, 1))
+    {
+        header->lock.lock(&header->lock);
+        ptr = swSlabPool_pop(header, index);
+        if (ptr)
+        {
+            header->alloc_num++;
+        }
+        else
+        {
+            header->fail_num++;
+        }
+        header->lock.unlock(&header->lock);
+        return ptr;
+    }
+
+    swSlabPool_check_pid(object);
+    mag = &object->magazines[index];
+    if (mag->num == 0)
+    {
+        swSlabPool_refill(object, index);
+        if (mag->num == 0)
+        {
+            sw_spinlock_release(&object->lock);
+            header->lock.lock(&header->lock);
+            header->fail_num++;
+            header->lock.unlock(&header->lock);
+            swWarn("swSlabPool_alloc: no memory for %d bytes.", size);
+            return NULL;
+        }
+    }
+    ptr = mag->objects[--mag->num];
+    mag->alloc_num++;
+    sw_spinlock_release(&object->lock);
+    return ptr;
+}
+
+static void swSlabPool_free(swMemoryPool *pool, void *ptr)
+{
+    swSlabPool *object = pool->object;
+    swSlabPool_header *header = object->header;
+    swSlabPool_magazine *mag;
+    uint32_t i;
+
+    if (!swSlabPool_contains(pool, ptr))
+    {
+        swWarn("swSlabPool_free: %p is not in the pool.", ptr);
+        return;
+    }
+
+    swSlabPool_page *page = &header->pages[(ptr - header->memory) / SW_SLAB_PAGE_SIZE];
+    if (page->type == SW_SLAB_PAGE_LARGE)
+    {
+        header->lock.lock(&header->lock);
+        for (i = 0; i < page->span; i++)
+        {
+            page[i].type = SW_SLAB_PAGE_FREE;
+        }
+        i = page - header->pages;
+        if (i < header->page_hint)
+        {
+            header->page_hint = i;
+        }
+        header->page_used -= page->span;
+        header->page_large -= page->span;
+        header->free_num++;
+        header->lock.unlock(&header->lock);
+        return;
+    }
+    else if (page->type == SW_SLAB_PAGE_FREE || page->type == SW_SLAB_PAGE_SPAN)
+    {
+        swWarn("swSlabPool_free: %p is not allocated.", ptr);
+        return;
+    }
+
+    int index = page->type - 1;
+    if (!sw_atomic_cmp_set(&object->lock, 0, 1))
+    {
+        header->lock.lock(&header->lock);
+        swSlabPool_push(header, index, ptr);
+        header->free_num++;
+        header->lock.unlock(&header->lock);
+        return;
+    }
+
+    swSlabPool_check_pid(object);
+    mag = &object->magazines[index];
+    if (mag->num == header->classes[index].capacity)
+    {
+        swSlabPool_release(object, index, mag->num / 2);
+    }
+    mag->objects[mag->num++] = ptr;
+    mag->free_num++;
+    sw_spinlock_release(&object->lock);
+}
+
+int swSlabPool_contains(swMemoryPool *pool, void *ptr)
+{
+    swSlabPool_header *header = ((swSlabPool *) pool->object)->header;
+    return ptr >= header->memory && ptr < header->memory + (size_t) header->page_num * SW_SLAB_PAGE_SIZE;
+}
+
+/**
+ * return the objects cached by the current process, call it before the process exits
+ */
+void swSlabPool_flush(swMemoryPool *pool)
+{
+    swSlabPool *object = pool->object;
+    int i;
+
+    sw_spinlock(&object->lock);
+    swSlabPool_check_pid(object);
+    for (i = 0; i < SW_SLAB_CLASS_NUM; i++)
+    {
+        if (object->magazines[i].num > 0 || object->magazines[i].alloc_num > 0 || object->magazines[i].free_num > 0)
+        {
+            swSlabPool_release(object, i, object->magazines[i].num);
+        }
+    }
+    sw_spinlock_release(&object->lock);
+}
+
+/**
+ * the magazines of the other processes are counted when they were refilled or flushed the last time
+ */
+void swSlabPool_get_stats(swMemoryPool *pool, swSlabPool_stats *stats)
+{
+    swSlabPool *object = pool->object;
+    swSlabPool_header *header = object->header;
+    swSlabPool_class *cls;
+    size_t live, partial = 0;
+    int i, own = 0;
+
+    bzero(stats, sizeof(swSlabPool_stats));
+    if (sw_atomic_cmp_set(&object->lock, 0, 1))
+    {
+        swSlabPool_check_pid(object);
+        own = 1;
+    }
+
+    header->lock.lock(&header->lock);
+    for (i = 0; i < SW_SLAB_CLASS_NUM; i++)
+    {
+        cls = &header->classes[i];
+        if (own)
+        {
+            swSlabPool_sync(header, i, &object->magazines[i]);
+        }
+        live = (size_t) (cls->object_num - cls->free_num - cls->cached_num) * cls->size;
+        stats->used += live;
+        stats->cached += (size_t) cls->cached_num * cls->size;
+        //the tail of the page which is less than an object
+        stats->free += (size_t) cls->free_num * cls->size + (size_t) cls->page_num * SW_SLAB_PAGE_SIZE
+                - (size_t) cls->object_num * cls->size;
+        //the pages of a class without live objects are reusable, they are not fragmented
+        if (live > 0)
+        {
+            stats->fragmentation += (double) ((size_t) cls->free_num * cls->size + (size_t) cls->page_num * SW_SLAB_PAGE_SIZE
+                    - (size_t) cls->object_num * cls->size);
+            partial += (size_t) cls->page_num * SW_SLAB_PAGE_SIZE;
+        }
+    }
+    stats->size = (size_t) header->page_num * SW_SLAB_PAGE_SIZE;
+    stats->page_num = header->page_num;
+    stats->page_used = header->page_used;
+    stats->page_large = header->page_large;
+    stats->used += (size_t) header->page_large * SW_SLAB_PAGE_SIZE;
+    stats->alloc_num = header->alloc_num;
+    stats->free_num = header->free_num;
+    stats->fail_num = header->fail_num;
+    header->lock.unlock(&header->lock);
+
+    if (own)
+    {
+        sw_spinlock_release(&object->lock);
+    }
+    stats->fragmentation = partial > 0 ? stats->fragmentation / partial : 0;
+}
+
+static void swSlabPool_destroy(swMemoryPool *pool)
+{
+    swSlabPool *object = pool->object;
+    swSlabPool_header *header = object->header;
+
+    header->lock.free(&header->lock);
+    if (object->shared == 1)
+    {
+        sw_shm_free(header);
+    }
+    else
+    {
+        sw_free(header);
+    }
+    sw_free(pool);
+}
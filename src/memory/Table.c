@@ -17,6 +17,9 @@
 #include "swoole.h"
 #include "table.h"
 
+#define SW_TABLE_MAGIC     0x53775464
+#define SW_TABLE_PREFETCH_LINE  64
+
 #ifdef SW_TABLE_DEBUG
 static int conflict_count = 0;
 static int insert_count = 0;
@@ -24,6 +27,7 @@ static int insert_count = 0;
 
 static void swTable_compress_list(swTable *table);
 static void swTableColumn_free(swTableColumn *col);
+static int swTable_split(swTable *table);
 
 static void swTableColumn_free(swTableColumn *col)
 {
@@ -35,7 +39,7 @@ static void swTable_compress_list(swTable *table)
 {
     table->lock.lock(&table->lock);
 
-    swTableRow **tmp = sw_malloc(sizeof(swTableRow *) * table->size);
+    swTableRow **tmp = sw_malloc(sizeof(swTableRow *) * (table->list_n + 1));
     if (!tmp)
     {
         swWarn("malloc() failed, cannot compress the jump table.");
@@ -56,31 +60,49 @@ static void swTable_compress_list(swTable *table)
     memcpy(table->rows_list, tmp, sizeof(swTableRow *) * tmp_i);
     sw_free(tmp);
     table->list_n = tmp_i;
+    table->iterator->skip_count = 0;
 
     unlock: table->lock.unlock(&table->lock);
 }
 
-swTable* swTable_new(uint32_t rows_size)
+static sw_inline uint32_t swTable_size_align(uint32_t size)
 {
-    if (rows_size >= 0x80000000)
+    if (size >= 0x80000000)
     {
-        rows_size = 0x80000000;
+        return 0x80000000;
     }
-    else
+    uint32_t i = 10;
+    while ((1U << i) < size)
     {
-        uint32_t i = 10;
-        while ((1U << i) < rows_size)
-        {
-            i++;
-        }
-        rows_size = 1 << i;
+        i++;
     }
+    return 1 << i;
+}
+
+/**
+ * max_size > rows_size: the buckets grow to max_size when the table is filled, the memory is reserved
+ * and used when the buckets are split.
+ */
+swTable* swTable_new(uint32_t rows_size, uint32_t max_size)
+{
+    rows_size = swTable_size_align(rows_size);
+    max_size = max_size > rows_size ? swTable_size_align(max_size) : rows_size;
 
-    swTable *table = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swTable));
+    swTable *table = NULL;
+    //the table can be freed when it is allocated from the slab pool
+    if (SwooleG.slab_pool)
+    {
+        table = SwooleG.slab_pool->alloc(SwooleG.slab_pool, sizeof(swTable));
+    }
+    if (table == NULL)
+    {
+        table = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swTable));
+    }
     if (table == NULL)
     {
         return NULL;
     }
+    bzero(table, sizeof(swTable));
     if (swMutex_create(&table->lock, 1) < 0)
     {
         swWarn("mutex create failed.");
@@ -100,6 +122,7 @@ swTable* swTable_new(uint32_t rows_size)
 
     table->size = rows_size;
     table->mask = rows_size - 1;
+    table->max_size = max_size;
 
     bzero(table->iterator, sizeof(swTable_iterator));
     table->memory = NULL;
@@ -151,351 +174,1611 @@ int swTableColumn_add(swTable *table, char *name, int len, int type, int size)
         swWarn("unkown column type.");
         return SW_ERR;
     }
-    col->index = table->item_size;
-    table->item_size += col->size;
+    //the numeric columns are aligned for the atomic operations
+    if (col->type == SW_TABLE_STRING)
+    {
+        col->index = table->item_size;
+    }
+    else
+    {
+        col->index = (table->item_size + col->size - 1) & ~(col->size - 1);
+    }
+    table->item_size = col->index + col->size;
     table->column_num ++;
     return swHashMap_add(table->columns, name, len, col, NULL);
 }
 
-int swTable_create(swTable *table)
+static size_t swTable_get_memory_size(swTable *table)
 {
-    uint32_t row_num = table->size * (1 + SW_TABLE_CONFLICT_PROPORTION);
+    //the rows are aligned to 8 bytes
+    table->item_size = (table->item_size + 7) & ~7;
     uint32_t row_memory_size = sizeof(swTableRow) + table->item_size;
+    uint32_t pool_size = table->max_size * SW_TABLE_CONFLICT_PROPORTION;
 
     /**
-     * row data & header
+     * header
      */
-    size_t memory_size = row_num * row_memory_size;
+    size_t memory_size = sizeof(swTable_header);
 
     /**
-     * row point
+     * for iterator & row point
      */
-    memory_size += table->size * sizeof(swTableRow *);
+    memory_size += table->max_size * sizeof(swTableRow *) * 2;
 
     /**
-     * memory pool for conflict rows
+     * row data & header, the rows for conflict
      */
-    memory_size += sizeof(swMemoryPool) + sizeof(swFixedPool) + ((row_num - table->size) * sizeof(swFixedPool_slice));
+    memory_size += (size_t) (table->max_size + pool_size) * row_memory_size;
 
-    /**
-     * for iterator, Iterate through all the elements
-     */
-    memory_size += table->size * sizeof(swTableRow *);
+    return memory_size;
+}
 
-    void *memory = sw_shm_malloc(memory_size);
-    if (memory == NULL)
+static uint32_t swTable_get_layout(swTable *table)
+{
+    swTableColumn *col;
+    uint32_t layout = table->column_num;
+    char *k;
+
+    while ((col = swHashMap_each(table->columns, &k)) != NULL)
     {
-        return SW_ERR;
+        layout ^= swoole_crc32(col->name->str, col->name->length) ^ (col->type << 24) ^ (col->index << 8) ^ col->size;
     }
+    return layout;
+}
+
+/**
+ * set the pointers to the parts of the table memory
+ */
+static void swTable_layout(swTable *table)
+{
+    void *memory = table->memory + sizeof(swTable_header);
 
-    memset(memory, 0, memory_size);
-    table->memory = memory;
     table->compress_threshold = table->size * SW_TABLE_COMPRESS_PROPORTION;
     table->rows_list = memory;
-
-    memory += table->size * sizeof(swTableRow *);
-    memory_size -= table->size * sizeof(swTableRow *);
+    memory += table->max_size * sizeof(swTableRow *);
 
     table->rows = memory;
-    memory += table->size * sizeof(swTableRow *);
-    memory_size -= table->size * sizeof(swTableRow *);
+    memory += table->max_size * sizeof(swTableRow *);
+
+    memory += (size_t) (sizeof(swTableRow) + table->item_size) * table->max_size;
+    table->pool = memory;
+    table->pool_size = table->max_size * SW_TABLE_CONFLICT_PROPORTION;
+}
+
+/**
+ * the root row of the bucket
+ */
+static sw_inline swTableRow* swTable_root(swTable *table, uint32_t index)
+{
+    void *memory = (void *) table->rows + table->max_size * sizeof(swTableRow *);
+    return memory + (size_t) (sizeof(swTableRow) + table->item_size) * index;
+}
 
+static void swTable_init(swTable *table, size_t memory_size)
+{
+    swTable_header *header = table->memory;
     int i;
+
+    header->memory_size = memory_size;
+    swTable_layout(table);
+
     for (i = 0; i < table->size; i++)
     {
-        table->rows[i] = memory + (row_memory_size * i);
+        table->rows[i] = swTable_root(table, i);
     }
-    memory += row_memory_size * table->size;
-    memory_size -= row_memory_size * table->size;
-    table->pool = swFixedPool_new2(row_memory_size, memory, memory_size);
-    return SW_OK;
+    table->pid = getpid();
+
+    header->state = (uint64_t) table->size << 32;
+    header->max_size = table->max_size;
+    header->item_size = table->item_size;
+    header->layout = swTable_get_layout(table);
+    header->memory = table->memory;
+    //the header is valid after the memory is initialized
+    sw_atomic_memory_barrier();
+    header->magic = SW_TABLE_MAGIC;
 }
 
-void swTable_free(swTable *table)
+/**
+ * the conflict rows, the freed rows are linked by next
+ */
+static swTableRow* swTable_alloc_row(swTable *table)
 {
+    swTable_header *header = table->memory;
+    swTableRow *row = NULL;
+
+    table->lock.lock(&table->lock);
+    if (header->free_list)
+    {
+        row = header->free_list;
+        header->free_list = row->next;
+    }
+    else if (header->pool_n < table->pool_size)
+    {
+        row = table->pool + (size_t) (sizeof(swTableRow) + table->item_size) * header->pool_n;
+        header->pool_n++;
+    }
 #ifdef SW_TABLE_DEBUG
-    printf("swoole_table: size=%d, conflict_count=%d, insert_count=%d\n", table->size, conflict_count, insert_count);
+    conflict_count ++;
 #endif
+    table->lock.unlock(&table->lock);
 
-    swHashMap_free(table->columns);
-    sw_free(table->iterator);
-    if (table->memory)
+    if (row)
     {
-        sw_shm_free(table->memory);
+        bzero(row, sizeof(swTableRow));
     }
+    return row;
 }
 
-static sw_inline swTableRow* swTable_hash(swTable *table, char *key, int keylen)
+static void swTable_free_row(swTable *table, swTableRow *row)
 {
-#ifdef SW_TABLE_USE_PHP_HASH
-    uint64_t hashv = swoole_hash_php(key, keylen);
-#else
-    uint64_t hashv = swoole_hash_austin(key, keylen);
-#endif
-    uint32_t index = hashv & table->mask;
-    assert(index < table->size);
-    return table->rows[index];
+    swTable_header *header = table->memory;
+
+    bzero(row, sizeof(swTableRow));
+    table->lock.lock(&table->lock);
+    row->next = header->free_list;
+    header->free_list = row;
+    table->lock.unlock(&table->lock);
 }
 
-swTableRow* swTableRow_get(swTable *table, char *key, int keylen)
+/**
+ * The memory was not detached cleanly (the processes crashed), or it is mapped at another address.
+ * The pointers are moved, the locks are released, and the lists and the counters are rebuilt from the rows.
+ * The conflict rows being inserted when the process crashed are dropped.
+ */
+static void swTable_recover(swTable *table)
 {
-    swTableRow *row = swTable_hash(table, key, keylen);
-    uint32_t crc32 = swoole_crc32(key, keylen);
-    sw_atomic_t *lock = &row->lock;
+    swTable_header *header = table->memory;
+    uint32_t row_memory_size = sizeof(swTableRow) + table->item_size;
+    ssize_t offset = table->memory - header->memory;
+    uint32_t bucket_num = (header->state >> 32) + (uint32_t) header->state;
+    swTableRow *row, *tmp, *next;
+    size_t index;
+    uint32_t i;
 
-    swTrace("row=%p, crc32=%u, key=%s\n", row, crc32, key);
+    if (header->pool_n > table->pool_size)
+    {
+        header->pool_n = table->pool_size;
+    }
+    uint8_t *used = sw_calloc(header->pool_n + 1, sizeof(uint8_t));
+    if (used == NULL)
+    {
+        swWarn("calloc(%d) failed.", header->pool_n + 1);
+        return;
+    }
 
-    sw_spinlock(lock);
-    for (;;)
+    table->size = header->state >> 32;
+    table->mask = table->size - 1;
+    table->row_num = 0;
+    table->list_n = 0;
+
+    //the next bucket is active when the process crashed while splitting
+    for (i = 0; i <= bucket_num && i < table->max_size; i++)
     {
-        if (row->crc32 == crc32)
+        row = swTable_root(table, i);
+        table->rows[i] = row;
+        row->lock = 0;
+        if (!row->active)
         {
-            if (!row->active)
-            {
-                row = NULL;
-            }
-            break;
+            bzero(row, sizeof(swTableRow));
+            continue;
         }
-        else if (row->next == NULL)
+
+        table->rows_list[table->list_n] = row;
+        row->list_index = table->list_n++;
+        table->row_num++;
+
+        for (tmp = row; tmp->next != NULL; tmp = next)
         {
-            row = NULL;
-            break;
+            next = (void *) tmp->next + offset;
+            index = ((void *) next - table->pool) / row_memory_size;
+            if ((void *) next < table->pool || index >= header->pool_n || (void *) next != table->pool + index * row_memory_size
+                    || !next->active || used[index])
+            {
+                tmp->next = NULL;
+                break;
+            }
+            used[index] = 1;
+            tmp->next = next;
+            next->lock = 0;
+            table->row_num++;
         }
-        else
+    }
+
+    header->free_list = NULL;
+    for (i = 0; i < header->pool_n; i++)
+    {
+        if (!used[i])
         {
-            row = row->next;
+            row = table->pool + (size_t) row_memory_size * i;
+            bzero(row, sizeof(swTableRow));
+            row->next = header->free_list;
+            header->free_list = row;
         }
     }
-    sw_spinlock_release(lock);
-    return row;
+    sw_free(used);
+    header->memory = table->memory;
+
+    if (bucket_num < table->max_size && table->rows[bucket_num]->active)
+    {
+        swTable_split(table);
+    }
 }
 
-void swTable_iterator_rewind(swTable *table)
+static void swTable_attach(swTable *table)
 {
-    bzero(table->iterator, sizeof(swTable_iterator));
+    swTable_header *header = table->memory;
+
+    swTable_layout(table);
+    if (header->clean && header->memory == table->memory)
+    {
+        table->size = header->state >> 32;
+        table->mask = table->size - 1;
+        table->row_num = header->row_num;
+        table->list_n = header->list_n;
+    }
+    else
+    {
+        swTable_recover(table);
+    }
+
+    table->pid = getpid();
+    header->memory = table->memory;
+    header->clean = 0;
 }
 
-swTableRow* swTable_iterator_current(swTable *table)
+int swTable_create(swTable *table)
 {
-    swTableRow *row = NULL;
+    size_t memory_size = swTable_get_memory_size(table);
+    //the pages are zero and used when the buckets grow
+    void *memory = sw_shm_malloc(memory_size);
+    if (memory == NULL)
+    {
+        return SW_ERR;
+    }
 
-    for (; table->iterator->absolute_index < table->list_n; table->iterator->absolute_index++)
+    table->memory = memory;
+    swTable_init(table, memory_size);
+    return SW_OK;
+}
+
+/**
+ * The table memory is backed by the file. When the server restarts, the table in the file is attached
+ * if the size and the columns are not changed.
+ */
+int swTable_create_mmap(swTable *table, char *mapfile)
+{
+    size_t memory_size = swTable_get_memory_size(table);
+    void *memory = sw_shm_mmap(mapfile, memory_size);
+    if (memory == NULL)
     {
-        row = table->rows_list[table->iterator->absolute_index];
-        if (row == NULL)
-        {
-            table->iterator->skip_count++;
-            continue;
-        }
-        else
+        return SW_ERR;
+    }
+
+    table->memory = memory;
+    swTable_header *header = memory;
+
+    if (header->magic == SW_TABLE_MAGIC && header->max_size == table->max_size && header->item_size == table->item_size
+            && header->layout == swTable_get_layout(table) && header->memory_size == memory_size)
+    {
+        swTable_attach(table);
+        return SW_OK;
+    }
+    if (header->magic != 0)
+    {
+        swWarn("the table in file[%s] does not match the columns, it is created again.", mapfile);
+        //the new file is filled with zero
+        sw_shm_free(memory);
+        unlink(mapfile);
+        memory = sw_shm_mmap(mapfile, memory_size);
+        if (memory == NULL)
         {
-            break;
+            return SW_ERR;
         }
+        table->memory = memory;
     }
 
-    if (table->iterator->collision_index == 0)
+    swTable_init(table, memory_size);
+    return SW_OK;
+}
+
+void swTable_free(swTable *table)
+{
+#ifdef SW_TABLE_DEBUG
+    printf("swoole_table: size=%d, conflict_count=%d, insert_count=%d\n", table->size, conflict_count, insert_count);
+#endif
+
+    swHashMap_free(table->columns);
+    sw_free(table->iterator);
+    if (table->memory)
     {
-        return row;
+        //the counters are saved for the next swTable_create_mmap
+        if (table->pid == getpid())
+        {
+            swTable_header *header = table->memory;
+            header->row_num = table->row_num;
+            header->list_n = table->list_n;
+            sw_atomic_memory_barrier();
+            header->clean = 1;
+        }
+        sw_shm_free(table->memory);
     }
-    int i;
-    for (i = 0; i < table->iterator->collision_index; i++)
+    //the other processes only unmap their copy
+    if (SwooleG.slab_pool && swSlabPool_contains(SwooleG.slab_pool, table)
+            && (table->memory == NULL || table->pid == getpid()))
     {
-        row = row->next;
+        SwooleG.slab_pool->free(SwooleG.slab_pool, table);
     }
-    return row;
 }
 
-void swTable_iterator_forward(swTable *table)
+/**
+ * linear hashing: the buckets before split are addressed with one more bit of the hash
+ */
+static sw_inline uint32_t swTable_bucket(uint64_t state, uint32_t hashv)
 {
-    for ( ; table->iterator->absolute_index < table->list_n; table->iterator->absolute_index++)
+    uint32_t size = state >> 32;
+    uint32_t index = hashv & (size - 1);
+
+    if (index < (uint32_t) state)
     {
-        swTableRow *row = table->rows_list[table->iterator->absolute_index];
+        index = hashv & (size * 2 - 1);
+    }
+    return index;
+}
 
-        if (row == NULL)
-        {
-            continue;
-        }
-        else if (row->next == NULL)
-        {
-            table->iterator->absolute_index++;
-            return;
-        }
-        else
+/**
+ * Lock the bucket of the hash. The bucket may be split before it is locked,
+ * then the hash is in another bucket, lock it again.
+ */
+static sw_inline swTableRow* swTable_hash_lock(swTable *table, uint32_t hashv)
+{
+    swTable_header *header = table->memory;
+    swTableRow *row;
+    uint32_t index;
+
+    for (;;)
+    {
+        index = swTable_bucket(header->state, hashv);
+        row = table->rows[index];
+        swTableRow_lock(row);
+        if (swTable_bucket(header->state, hashv) == index)
         {
-            int i = 0;
-            for (;; i++)
-            {
-                row = row->next;
-                if (i == table->iterator->collision_index)
-                {
-                    if (row == NULL)
-                    {
-                        table->iterator->absolute_index++;
-                        table->iterator->collision_index = 0;
-                    }
-                    else
-                    {
-                        table->iterator->collision_index++;
-                    }
-                    return;
-                }
-            }
+            return row;
         }
+        swTableRow_unlock(row);
     }
 }
 
-swTableRow* swTableRow_set(swTable *table, char *key, int keylen)
+/**
+ * Find the row with the bucket locked shared, the rows are not moved or freed until the bucket is unlocked.
+ * The row written by swTableRow_set() at the same time may be found.
+ */
+static swTableRow* swTable_lookup_shared(swTable *table, uint32_t crc32, swTableRow **root)
 {
-    swTableRow *row = swTable_hash(table, key, keylen);
-    uint32_t crc32 = swoole_crc32(key, keylen);
-    sw_atomic_t *lock = &row->lock;
+    swTable_header *header = table->memory;
+    swTableRow *row;
+    uint32_t index;
 
-    sw_spinlock(lock);
-    if (row->active)
+    for (;;)
     {
-        for (;;)
+        index = swTable_bucket(header->state, crc32);
+        row = table->rows[index];
+        swTableRow_lock_shared(row);
+        if (swTable_bucket(header->state, crc32) == index)
         {
-            if (row->crc32 == crc32)
-            {
-                break;
-            }
-            else if (row->next == NULL)
-            {
-                table->lock.lock(&table->lock);
-                swTableRow *new_row = table->pool->alloc(table->pool, 0);
-
-#ifdef SW_TABLE_DEBUG
-                conflict_count ++;
-#endif
-                table->lock.unlock(&table->lock);
+            break;
+        }
+        swTableRow_unlock_shared(row);
+    }
 
-                if (!new_row)
-                {
-                    sw_spinlock_release(lock);
-                    return NULL;
-                }
-                //add row_num
-                bzero(new_row, sizeof(swTableRow));
-                sw_atomic_fetch_add(&(table->row_num), 1);
-                row->next = new_row;
-                row = new_row;
-                break;
+    *root = row;
+    for (; row != NULL && row->active; row = row->next)
+    {
+        if (row->crc32 == crc32)
+        {
+            if (row->expire && row->expire <= time(NULL))
+            {
+                return NULL;
             }
-            else
+            if (!row->visited)
             {
-                row = row->next;
+                row->visited = 1;
             }
+            return row;
         }
     }
-    else
-    {
-#ifdef SW_TABLE_DEBUG
-        insert_count ++;
-#endif
-
-        sw_atomic_fetch_add(&(table->row_num), 1);
-
-        // when the root node become active, we may need compress the jump table
-        if (table->list_n >= table->size - 1)
-        {
-            swTable_compress_list(table);
-        }
+    return NULL;
+}
 
-        table->rows_list[table->list_n] = row;
-        row->list_index = table->list_n;
-        sw_atomic_fetch_add(&table->list_n, 1);
+static sw_inline void swTable_list_add(swTable *table, swTableRow *row)
+{
+    // when the root node become active, we may need compress the jump table
+    if (table->list_n >= table->max_size - 1)
+    {
+        swTable_compress_list(table);
     }
 
-    row->crc32 = crc32;
-    row->active = 1;
-
-    swTrace("row=%p, crc32=%u, key=%s\n", row, crc32, key);
-    sw_spinlock_release(lock);
-
-    return row;
+    uint32_t index = sw_atomic_fetch_add(&table->list_n, 1);
+    table->rows_list[index] = row;
+    row->list_index = index;
 }
 
-int swTableRow_del(swTable *table, char *key, int keylen)
+static sw_inline void swTable_list_del(swTable *table, swTableRow *row)
 {
-    swTableRow *row = swTable_hash(table, key, keylen);
-    uint32_t crc32 = swoole_crc32(key, keylen);
-    sw_atomic_t *lock = &row->lock;
+    table->rows_list[row->list_index] = NULL;
+    table->iterator->skip_count++;
+    row->active = 0;
+    row->crc32 = 0;
+    row->expire = 0;
+    row->next = NULL;
+}
 
-    //no exists
-    if (!row->active)
-    {
-        return SW_ERR;
-    }
+static sw_inline void swTableRow_copy(swTable *table, swTableRow *dst, swTableRow *src)
+{
+    dst->crc32 = src->crc32;
+    dst->expire = src->expire;
+    dst->visited = src->visited;
+    memcpy(dst->data, src->data, table->item_size);
+    dst->active = 1;
+}
 
-    sw_spinlock(lock);
+/**
+ * Remove the row from the locked bucket, prev is the row before it in the collision list.
+ * When the root is removed, the next row is moved to the root.
+ */
+static void swTable_remove(swTable *table, swTableRow *root, swTableRow *prev, swTableRow *row)
+{
+    swTableRow *next;
 
-    if (row->next == NULL)
+    if (row == root)
     {
-        if (row->crc32 == crc32)
+        if (root->next == NULL)
         {
-            table->rows_list[row->list_index] = NULL;
+            swTable_list_del(table, root);
             if (table->iterator->skip_count > table->compress_threshold)
             {
                 swTable_compress_list(table);
             }
-            bzero(row, sizeof(swTableRow));
             goto delete_element;
         }
+        //when the deleting element is root, we should move the first element's data to root,
+        //and remove the element from the collision list.
+        next = root->next;
+        swTableRow_lock(next);
+        swTableRow_copy(table, root, next);
+        root->next = next->next;
+        row = next;
+    }
+    else
+    {
+        //wait for the readers of the row
+        swTableRow_lock(row);
+        prev->next = row->next;
+    }
+    swTable_free_row(table, row);
+
+    delete_element:
+    sw_atomic_fetch_sub(&(table->row_num), 1);
+}
+
+enum swTable_clock_evict
+{
+    SW_TABLE_EVICT_ANY = 1,
+    SW_TABLE_EVICT_CONFLICT = 2,
+};
+
+static sw_inline int swTableRow_expired(swTableRow *row, uint32_t now)
+{
+    return row->expire != 0 && row->expire <= now;
+}
+
+/**
+ * Divide the bucket [split] into itself and the bucket [size + split] by one more bit of the hash.
+ * Both buckets are locked, so the other processes wait for it, and look up the bucket again.
+ * The overflow rows are moved by the pointers, a spare row is needed when the root row is moved.
+ */
+static int swTable_split(swTable *table)
+{
+    swTable_header *header = table->memory;
+    uint64_t state = header->state;
+    uint32_t size = state >> 32;
+    uint32_t split = (uint32_t) state;
+    uint32_t mask = size * 2 - 1;
+    swTableRow *root, *nroot, *tail, *row, *prev, *next, *spare;
+
+    if (size + split >= table->max_size)
+    {
+        return SW_ERR;
+    }
+    spare = swTable_alloc_row(table);
+    if (spare == NULL)
+    {
+        return SW_ERR;
+    }
+
+    root = table->rows[split];
+    nroot = swTable_root(table, size + split);
+    table->rows[size + split] = nroot;
+    tail = nroot;
+    while (tail->active && tail->next)
+    {
+        tail = tail->next;
+    }
+
+    swTableRow_lock(root);
+    swTableRow_lock(nroot);
+
+    prev = NULL;
+    row = root;
+    while (row != NULL && root->active)
+    {
+        if ((row->crc32 & mask) == split)
+        {
+            prev = row;
+            row = row->next;
+            continue;
+        }
+
+        if (row != root)
+        {
+            next = row->next;
+            prev->next = next;
+            if (!nroot->active)
+            {
+                //wait for the readers of the row
+                swTableRow_lock(row);
+                swTableRow_copy(table, nroot, row);
+                swTable_list_add(table, nroot);
+                swTable_free_row(table, row);
+            }
+            else
+            {
+                row->next = NULL;
+                tail->next = row;
+                tail = row;
+            }
+            row = next;
+            continue;
+        }
+
+        if (!nroot->active)
+        {
+            swTableRow_copy(table, nroot, root);
+            swTable_list_add(table, nroot);
+        }
         else
         {
-            goto not_exists;
+            swTableRow_copy(table, spare, root);
+            tail->next = spare;
+            tail = spare;
+            spare = NULL;
+        }
+
+        //the next row is moved to the root
+        next = root->next;
+        if (next == NULL)
+        {
+            swTable_list_del(table, root);
+            break;
+        }
+        swTableRow_lock(next);
+        swTableRow_copy(table, root, next);
+        root->next = next->next;
+        if (spare == NULL)
+        {
+            bzero(next, sizeof(swTableRow));
+            spare = next;
+        }
+        else
+        {
+            swTable_free_row(table, next);
+        }
+        prev = NULL;
+        row = root;
+    }
+
+    if (split + 1 == size)
+    {
+        table->size = size * 2;
+        table->mask = size * 2 - 1;
+        state = (uint64_t) (size * 2) << 32;
+    }
+    else
+    {
+        state++;
+    }
+    sw_atomic_memory_barrier();
+    header->state = state;
+
+    swTableRow_unlock(nroot);
+    swTableRow_unlock(root);
+
+    if (spare)
+    {
+        swTable_free_row(table, spare);
+    }
+    return SW_OK;
+}
+
+/**
+ * The process inserting the rows splits a few buckets, only one process splits at a time.
+ */
+static void swTable_resize(swTable *table)
+{
+    swTable_header *header = table->memory;
+    uint64_t state;
+    int i;
+
+    if (!sw_atomic_cmp_set(&table->resize_lock, 0, 1))
+    {
+        return;
+    }
+    for (i = 0; i < SW_TABLE_RESIZE_STEP; i++)
+    {
+        state = header->state;
+        if (table->row_num <= ((state >> 32) + (uint32_t) state) * SW_TABLE_RESIZE_LOAD || swTable_split(table) < 0)
+        {
+            break;
+        }
+    }
+    sw_spinlock_release(&table->resize_lock);
+}
+
+/**
+ * The clock hand moves to the next bucket, the expired rows in it are removed.
+ * With evict, the first row not visited since the hand passed it last time is removed,
+ * the visited rows before it get a second chance. SW_TABLE_EVICT_CONFLICT only evicts in the buckets
+ * with the conflict rows, one of them is returned to the pool. Return the number of the removed rows.
+ */
+static int swTable_clock(swTable *table, uint32_t now, int evict)
+{
+    swTable_header *header = table->memory;
+    uint64_t state = header->state;
+    uint32_t index = sw_atomic_fetch_add(&header->clock, 1) % ((state >> 32) + (uint32_t) state);
+    swTableRow *root = table->rows[index];
+    swTableRow *row, *prev = NULL;
+    int n = 0;
+
+    if (!root->active)
+    {
+        return 0;
+    }
+    swTableRow_lock(root);
+    if (evict == SW_TABLE_EVICT_CONFLICT && root->next == NULL)
+    {
+        evict = 0;
+    }
+    row = root;
+    while (row != NULL && root->active)
+    {
+        if (swTableRow_expired(row, now) || (evict && !row->visited))
+        {
+            if (!swTableRow_expired(row, now))
+            {
+                evict = 0;
+            }
+            swTable_remove(table, root, prev, row);
+            n++;
+            //the next row is moved to the root
+            row = prev ? prev->next : root;
+            continue;
+        }
+        if (evict)
+        {
+            row->visited = 0;
+        }
+        prev = row;
+        row = row->next;
+    }
+    swTableRow_unlock(root);
+    return n;
+}
+
+/**
+ * free one row for the new row, the hand goes round the buckets twice at most
+ */
+static int swTable_evict(swTable *table, uint32_t now, int evict)
+{
+    swTable_header *header = table->memory;
+    uint64_t state = header->state;
+    uint32_t i, n = ((state >> 32) + (uint32_t) state) * 2;
+
+    for (i = 0; i < n; i++)
+    {
+        if (swTable_clock(table, now, evict) > 0)
+        {
+            return SW_OK;
+        }
+    }
+    return SW_ERR;
+}
+
+/**
+ * The row not visited in the locked bucket is written as the new row, or the last row when all are visited.
+ * The row is returned locked, the bucket is unlocked.
+ */
+static swTableRow* swTable_replace(swTable *table, swTableRow *root, uint32_t crc32)
+{
+    swTableRow *row = root;
+
+    while (row->visited && row->next != NULL)
+    {
+        row->visited = 0;
+        row = row->next;
+    }
+    if (row != root)
+    {
+        swTableRow_lock(row);
+        swTableRow_unlock(root);
+    }
+    bzero(row->data, table->item_size);
+    row->crc32 = crc32;
+    row->expire = 0;
+    row->visited = 1;
+    return row;
+}
+
+/**
+ * remove the expired rows in the next n buckets, called by the writers and the timers
+ */
+int swTable_sweep(swTable *table, uint32_t n)
+{
+    uint32_t now = time(NULL);
+    int count = 0;
+
+    while (n-- > 0)
+    {
+        count += swTable_clock(table, now, 0);
+    }
+    return count;
+}
+
+/**
+ * ttl=0: the row never expires
+ */
+void swTableRow_set_ttl(swTable *table, swTableRow *row, uint32_t ttl)
+{
+    swTable_header *header = table->memory;
+
+    if (ttl == 0)
+    {
+        row->expire = 0;
+        return;
+    }
+    row->expire = time(NULL) + ttl;
+    if (!header->expire)
+    {
+        header->expire = 1;
+    }
+}
+
+/**
+ * look up the row in the locked bucket, the expired row is removed when it is accessed
+ */
+static swTableRow* swTable_lookup(swTable *table, swTableRow *root, uint32_t crc32)
+{
+    swTableRow *row = root;
+    swTableRow *prev = NULL;
+
+    for (; row != NULL && row->active; prev = row, row = row->next)
+    {
+        if (row->crc32 != crc32)
+        {
+            continue;
+        }
+        if (row->expire && swTableRow_expired(row, time(NULL)))
+        {
+            swTable_remove(table, root, prev, row);
+            return NULL;
+        }
+        if (!row->visited)
+        {
+            row->visited = 1;
+        }
+        return row;
+    }
+    return NULL;
+}
+
+/**
+ * the row is returned locked, swTableRow_unlock() must be called after it is read
+ */
+swTableRow* swTableRow_get(swTable *table, char *key, int keylen)
+{
+    uint32_t crc32 = swoole_crc32(key, keylen);
+    swTableRow *root = swTable_hash_lock(table, crc32);
+    swTableRow *row = swTable_lookup(table, root, crc32);
+
+    swTrace("row=%p, crc32=%u, key=%s\n", row, crc32, key);
+
+    //the lock of the root row is the lock of the bucket
+    if (row != root)
+    {
+        if (row)
+        {
+            swTableRow_lock(row);
+        }
+        swTableRow_unlock(root);
+    }
+    return row;
+}
+
+void swTable_iterator_rewind(swTable *table)
+{
+    bzero(table->iterator, sizeof(swTable_iterator));
+}
+
+swTableRow* swTable_iterator_current(swTable *table)
+{
+    swTableRow *row = NULL;
+
+    for (; table->iterator->absolute_index < table->list_n; table->iterator->absolute_index++)
+    {
+        row = table->rows_list[table->iterator->absolute_index];
+        if (row == NULL)
+        {
+            table->iterator->skip_count++;
+            continue;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (table->iterator->collision_index == 0)
+    {
+        return row;
+    }
+    int i;
+    for (i = 0; i < table->iterator->collision_index; i++)
+    {
+        row = row->next;
+    }
+    return row;
+}
+
+void swTable_iterator_forward(swTable *table)
+{
+    for ( ; table->iterator->absolute_index < table->list_n; table->iterator->absolute_index++)
+    {
+        swTableRow *row = table->rows_list[table->iterator->absolute_index];
+
+        if (row == NULL)
+        {
+            continue;
+        }
+        else if (row->next == NULL)
+        {
+            table->iterator->absolute_index++;
+            return;
+        }
+        else
+        {
+            int i = 0;
+            for (;; i++)
+            {
+                row = row->next;
+                if (i == table->iterator->collision_index)
+                {
+                    if (row == NULL)
+                    {
+                        table->iterator->absolute_index++;
+                        table->iterator->collision_index = 0;
+                    }
+                    else
+                    {
+                        table->iterator->collision_index++;
+                    }
+                    return;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * split, sweep and evict before the row is written, no bucket is locked. return the time if it is used
+ */
+static uint32_t swTable_prepare(swTable *table)
+{
+    swTable_header *header = table->memory;
+    uint64_t state = header->state;
+    uint32_t now = 0;
+    int i;
+
+    if ((state >> 32) + (uint32_t) state < table->max_size
+            && table->row_num > ((state >> 32) + (uint32_t) state) * SW_TABLE_RESIZE_LOAD)
+    {
+        swTable_resize(table);
+    }
+    if (header->expire || table->evict == SW_TABLE_EVICT_LRU)
+    {
+        now = time(NULL);
+    }
+    if (header->expire)
+    {
+        for (i = 0; i < SW_TABLE_SWEEP_STEP; i++)
+        {
+            swTable_clock(table, now, 0);
+        }
+    }
+    //the table is full, the evicted row is reused
+    if (table->evict == SW_TABLE_EVICT_LRU)
+    {
+        if (table->row_num >= table->max_size)
+        {
+            swTable_evict(table, now, SW_TABLE_EVICT_ANY);
+        }
+        //keep a conflict row for the new row
+        if (header->free_list == NULL && header->pool_n >= table->pool_size)
+        {
+            swTable_evict(table, now, SW_TABLE_EVICT_CONFLICT);
+        }
+    }
+    return now;
+}
+
+/**
+ * find or add the row in the locked bucket, NULL when there is no conflict row left
+ */
+static swTableRow* swTable_insert(swTable *table, swTableRow *root, uint32_t crc32, uint32_t now)
+{
+    swTableRow *row = root;
+
+    if (row->active)
+    {
+        for (;;)
+        {
+            if (row->crc32 == crc32)
+            {
+                //the expired row is written as a new row
+                if (row->expire && swTableRow_expired(row, now ? now : time(NULL)))
+                {
+                    bzero(row->data, table->item_size);
+                    row->expire = 0;
+                }
+                break;
+            }
+            else if (row->next == NULL)
+            {
+                swTableRow *new_row = swTable_alloc_row(table);
+                if (!new_row)
+                {
+                    return NULL;
+                }
+                //add row_num
+                sw_atomic_fetch_add(&(table->row_num), 1);
+                bzero(new_row->data, table->item_size);
+                row->next = new_row;
+                row = new_row;
+                break;
+            }
+            else
+            {
+                row = row->next;
+            }
         }
     }
     else
     {
-        swTableRow *tmp = row;
-        swTableRow *prev = NULL;
+#ifdef SW_TABLE_DEBUG
+        insert_count ++;
+#endif
+
+        sw_atomic_fetch_add(&(table->row_num), 1);
+        bzero(row->data, table->item_size);
+        swTable_list_add(table, row);
+    }
+
+    row->crc32 = crc32;
+    row->active = 1;
+    row->visited = 1;
+    return row;
+}
+
+/**
+ * the row is returned locked, swTableRow_unlock() must be called after it is written
+ */
+swTableRow* swTableRow_set(swTable *table, char *key, int keylen)
+{
+    uint32_t now = swTable_prepare(table);
+    uint32_t crc32 = swoole_crc32(key, keylen);
+    swTableRow *root = swTable_hash_lock(table, crc32);
+    swTableRow *row = swTable_insert(table, root, crc32, now);
+
+    if (row == NULL)
+    {
+        //no conflict row left, a row of the bucket is replaced
+        if (table->evict == SW_TABLE_EVICT_LRU)
+        {
+            return swTable_replace(table, root, crc32);
+        }
+        swTableRow_unlock(root);
+        return NULL;
+    }
+
+    swTrace("row=%p, crc32=%u, key=%s\n", row, crc32, key);
+    if (row != root)
+    {
+        swTableRow_lock(row);
+        swTableRow_unlock(root);
+    }
+    return row;
+}
+
+/**
+ * remove the row in the locked bucket
+ */
+static int swTable_delete(swTable *table, swTableRow *root, uint32_t crc32)
+{
+    swTableRow *row = root;
+    swTableRow *prev = NULL;
+
+    //no exists
+    if (!root->active)
+    {
+        return SW_ERR;
+    }
+    while (row)
+    {
+        if (row->crc32 == crc32)
+        {
+            swTable_remove(table, root, prev, row);
+            return SW_OK;
+        }
+        prev = row;
+        row = row->next;
+    }
+    return SW_ERR;
+}
+
+int swTableRow_del(swTable *table, char *key, int keylen)
+{
+    uint32_t crc32 = swoole_crc32(key, keylen);
+    swTableRow *root = swTable_hash_lock(table, crc32);
+    int ret = swTable_delete(table, root, crc32);
+
+    swTableRow_unlock(root);
+    return ret;
+}
+
+typedef struct
+{
+    char *rows;
+    uint32_t row_size;
+    uint32_t num;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t limit;
+} swTable_result;
+
+/**
+ * copy the row into the result, the bucket must be locked.
+ * return 1 when the limit is reached
+ */
+static int swTable_result_add(swTable_result *result, swTableRow *row)
+{
+    swTableRow *copy;
+
+    if (result->offset > 0)
+    {
+        result->offset--;
+        return 0;
+    }
+    if (result->num == result->size)
+    {
+        uint32_t size = result->size == 0 ? SW_TABLE_FIND_BLOCK : result->size * 2;
+        char *rows = sw_realloc(result->rows, (size_t) result->row_size * size);
+        if (rows == NULL)
+        {
+            swWarn("realloc(%ld) failed.", (size_t) result->row_size * size);
+            return 1;
+        }
+        result->rows = rows;
+        result->size = size;
+    }
+    copy = (swTableRow *) (result->rows + (size_t) result->row_size * result->num++);
+    memcpy(copy, row, result->row_size);
+    copy->lock = 0;
+    copy->next = NULL;
+    return result->limit > 0 && result->num >= result->limit;
+}
+
+static sw_inline int swTable_compare(int op, int cmp)
+{
+    switch (op)
+    {
+    case SW_TABLE_FIND_EQ:
+        return cmp == 0;
+    case SW_TABLE_FIND_NEQ:
+        return cmp != 0;
+    case SW_TABLE_FIND_GT:
+        return cmp > 0;
+    case SW_TABLE_FIND_LT:
+        return cmp < 0;
+    default:
+        return 0;
+    }
+}
+
+static int swTableRow_match(swTableRow *row, swTable_condition *conds, int cond_n)
+{
+    swTable_condition *cond;
+    swTable_string_length_t vlen;
+    int64_t lval;
+    double dval;
+    char *str;
+    int i, cmp;
 
-        while (tmp)
+    for (i = 0; i < cond_n; i++)
+    {
+        cond = &conds[i];
+        if (cond->column->type == SW_TABLE_STRING)
         {
-            if (tmp->crc32 == crc32)
+            memcpy(&vlen, row->data + cond->column->index, sizeof(vlen));
+            str = row->data + cond->column->index + sizeof(vlen);
+
+            switch (cond->op)
             {
+            case SW_TABLE_FIND_LEFTLIKE:
+                if (vlen < cond->str_len || memcmp(str, cond->str, cond->str_len) != 0)
+                {
+                    return 0;
+                }
+                continue;
+            case SW_TABLE_FIND_RIGHTLIKE:
+                if (vlen < cond->str_len || memcmp(str + vlen - cond->str_len, cond->str, cond->str_len) != 0)
+                {
+                    return 0;
+                }
+                continue;
+            case SW_TABLE_FIND_LIKE:
+                if (cond->str_len > 0 && (vlen < cond->str_len || swoole_strnpos(str, vlen, cond->str, cond->str_len) < 0))
+                {
+                    return 0;
+                }
+                continue;
+            default:
+                cmp = memcmp(str, cond->str, vlen < cond->str_len ? vlen : cond->str_len);
+                if (cmp == 0)
+                {
+                    cmp = (vlen > cond->str_len) - (vlen < cond->str_len);
+                }
                 break;
             }
-            prev = tmp;
-            tmp = tmp->next;
         }
+        else if (cond->column->type == SW_TABLE_FLOAT)
+        {
+            memcpy(&dval, row->data + cond->column->index, sizeof(dval));
+            cmp = (dval > cond->dval) - (dval < cond->dval);
+        }
+        else
+        {
+            lval = swTableRow_get_long(row, cond->column);
+            cmp = (lval > cond->lval) - (lval < cond->lval);
+        }
+        if (!swTable_compare(cond->op, cmp))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Compare an integer column of a batch of root rows. The values are gathered into an array first,
+ * so that the compiler can vectorize the comparison loops.
+ */
+static void swTable_match_block(swTableRow **rows, int n, swTable_condition *cond, uint8_t *match)
+{
+    int64_t values[SW_TABLE_FIND_BLOCK];
+    int64_t lval = cond->lval;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        values[i] = swTableRow_get_long(rows[i], cond->column);
+    }
+
+    switch (cond->op)
+    {
+    case SW_TABLE_FIND_EQ:
+        for (i = 0; i < n; i++)
+        {
+            match[i] = values[i] == lval;
+        }
+        break;
+    case SW_TABLE_FIND_NEQ:
+        for (i = 0; i < n; i++)
+        {
+            match[i] = values[i] != lval;
+        }
+        break;
+    case SW_TABLE_FIND_GT:
+        for (i = 0; i < n; i++)
+        {
+            match[i] = values[i] > lval;
+        }
+        break;
+    default:
+        for (i = 0; i < n; i++)
+        {
+            match[i] = values[i] < lval;
+        }
+        break;
+    }
+}
+
+/**
+ * Scan the rows, the conditions are ANDed. The matched rows are copied in the order of the buckets,
+ * use swTable_find_row() to get them, *rows must be freed by the caller. limit=0 is no limit.
+ *
+ * The conditions are checked and the rows are copied while the bucket is locked shared,
+ * so the rows can not be changed, moved or freed by the writers at the same time.
+ * The batch compare of the first condition reads the root rows without the lock, it only skips the buckets.
+ * The expired rows are skipped, they are removed by the writers.
+ */
+int swTable_find(swTable *table, swTable_condition *conds, int cond_n, uint32_t offset, uint32_t limit, swTableRow **rows)
+{
+    swTableRow *block[SW_TABLE_FIND_BLOCK];
+    uint8_t match[SW_TABLE_FIND_BLOCK];
+    swTableRow *row, *tmp;
+    swTable_result result;
+    uint32_t i, now = time(NULL);
+    int j, n, batch = 0;
 
-        if (tmp == NULL)
+    for (j = 0; j < cond_n; j++)
+    {
+        if (conds[j].op < SW_TABLE_FIND_EQ || conds[j].op > SW_TABLE_FIND_LIKE
+                || (conds[j].op > SW_TABLE_FIND_LT && conds[j].column->type != SW_TABLE_STRING))
         {
-            not_exists:
-            sw_spinlock_release(lock);
+            swWarn("invalid operator[%d] for column[%s].", conds[j].op, conds[j].column->name->str);
             return SW_ERR;
         }
+    }
 
-        //when the deleting element is root, we should move the first element's data to root,
-        //and remove the element from the collision list.
-        if (tmp == row)
+    bzero(&result, sizeof(result));
+    result.row_size = sizeof(swTableRow) + table->item_size;
+    result.offset = offset;
+    result.limit = limit;
+    *rows = NULL;
+
+    //the first integer condition is compared in batch
+    if (cond_n > 0 && conds[0].column->type != SW_TABLE_STRING && conds[0].column->type != SW_TABLE_FLOAT)
+    {
+        batch = 1;
+    }
+
+    for (i = 0; i < table->list_n; )
+    {
+        n = 0;
+        for (; n < SW_TABLE_FIND_BLOCK && i < table->list_n; i++)
+        {
+            row = table->rows_list[i];
+            if (row == NULL)
+            {
+                continue;
+            }
+            if (i + SW_TABLE_FIND_BLOCK < table->list_n)
+            {
+                __builtin_prefetch(table->rows_list[i + SW_TABLE_FIND_BLOCK]);
+            }
+            if (row->active)
+            {
+                block[n++] = row;
+            }
+        }
+        if (n == 0)
         {
-            tmp = tmp->next;
-            row->next = tmp->next;
-            row->crc32 = tmp->crc32;
+            continue;
+        }
+        if (batch)
+        {
+            swTable_match_block(block, n, &conds[0], match);
+        }
 
-            if (table->iterator->skip_count > table->compress_threshold)
+        for (j = 0; j < n; j++)
+        {
+            row = block[j];
+            if (batch && !match[j] && row->next == NULL)
             {
-                swTable_compress_list(table);
+                continue;
             }
 
-            memcpy(row->data, tmp->data, table->item_size);
+            swTableRow_lock_shared(row);
+            for (tmp = row; tmp != NULL && tmp->active; tmp = tmp->next)
+            {
+                if (!swTableRow_expired(tmp, now) && swTableRow_match(tmp, conds, cond_n)
+                        && swTable_result_add(&result, tmp))
+                {
+                    swTableRow_unlock_shared(row);
+                    goto _end;
+                }
+            }
+            swTableRow_unlock_shared(row);
         }
-        if (prev)
+    }
+
+    _end:
+    *rows = (swTableRow *) result.rows;
+    return result.num;
+}
+
+/**
+ * Add to the column by the atomic instruction, the bucket is still locked shared, it is not lock-free.
+ * The shared lock keeps the row from being moved or freed, the updaters of a hot key do not wait for each other.
+ * The row is created by swTableRow_set() when it does not exist.
+ */
+int swTableRow_incr(swTable *table, char *key, int keylen, swTableColumn *col, int64_t incrby, int64_t *value)
+{
+    uint32_t crc32 = swoole_crc32(key, keylen);
+    swTableRow *root;
+    swTableRow *row = swTable_lookup_shared(table, crc32, &root);
+
+    if (row)
+    {
+        *value = swTableRow_atomic_add(row, col, incrby);
+        swTableRow_unlock_shared(root);
+        return SW_OK;
+    }
+    swTableRow_unlock_shared(root);
+
+    row = swTableRow_set(table, key, keylen);
+    if (row == NULL)
+    {
+        return SW_ERR;
+    }
+    //the others may have found the new row
+    *value = swTableRow_atomic_add(row, col, incrby);
+    swTableRow_unlock(row);
+    return SW_OK;
+}
+
+int swTableRow_incr_float(swTable *table, char *key, int keylen, swTableColumn *col, double incrby, double *value)
+{
+    uint32_t crc32 = swoole_crc32(key, keylen);
+    swTableRow *root;
+    swTableRow *row = swTable_lookup_shared(table, crc32, &root);
+
+    if (row)
+    {
+        *value = swTableRow_atomic_add_float(row, col, incrby);
+        swTableRow_unlock_shared(root);
+        return SW_OK;
+    }
+    swTableRow_unlock_shared(root);
+
+    row = swTableRow_set(table, key, keylen);
+    if (row == NULL)
+    {
+        return SW_ERR;
+    }
+    *value = swTableRow_atomic_add_float(row, col, incrby);
+    swTableRow_unlock(row);
+    return SW_OK;
+}
+
+/**
+ * set the column to value when it equals expect, SW_ERR when the row does not exist or it is changed
+ */
+int swTableRow_cas(swTable *table, char *key, int keylen, swTableColumn *col, int64_t expect, int64_t value)
+{
+    swTableRow *root;
+    swTableRow *row = swTable_lookup_shared(table, swoole_crc32(key, keylen), &root);
+    int ret = SW_ERR;
+
+    if (row && swTableRow_atomic_cas(row, col, expect, value))
+    {
+        ret = SW_OK;
+    }
+    swTableRow_unlock_shared(root);
+    return ret;
+}
+
+int swTableRow_cas_float(swTable *table, char *key, int keylen, swTableColumn *col, double expect, double value)
+{
+    swTableRow *root;
+    swTableRow *row = swTable_lookup_shared(table, swoole_crc32(key, keylen), &root);
+    int ret = SW_ERR;
+
+    if (row && swTableRow_atomic_cas_float(row, col, expect, value))
+    {
+        ret = SW_OK;
+    }
+    swTableRow_unlock_shared(root);
+    return ret;
+}
+
+enum swTable_batch_op
+{
+    SW_TABLE_BATCH_GET,
+    SW_TABLE_BATCH_SET,
+    SW_TABLE_BATCH_DEL,
+};
+
+typedef struct
+{
+    uint32_t crc32;
+    uint32_t bucket;
+    uint32_t index;
+    uint8_t retry;
+} swTable_batch_item;
+
+/**
+ * the batch is small, insertion sort by the bucket is faster than qsort()
+ */
+static void swTable_batch_sort(swTable_batch_item *items, int n)
+{
+    swTable_batch_item tmp;
+    int i, j;
+
+    for (i = 1; i < n; i++)
+    {
+        tmp = items[i];
+        for (j = i; j > 0 && items[j - 1].bucket > tmp.bucket; j--)
         {
-            prev->next = tmp->next;
+            items[j] = items[j - 1];
         }
-        table->lock.lock(&table->lock);
-        bzero(tmp, sizeof(swTableRow));
-        table->pool->free(table->pool, tmp);
-        table->lock.unlock(&table->lock);
+        items[j] = tmp;
     }
+}
 
-    delete_element:
-    sw_atomic_fetch_sub(&(table->row_num), 1);
-    sw_spinlock_release(lock);
+/**
+ * The keys are hashed up front and the root rows are prefetched, so the cache misses of the keys
+ * are overlapped. The keys in one bucket are done with one lock.
+ * The bucket may be split after it is hashed, the key is done alone later.
+ */
+static int swTable_batch(swTable *table, swTable_key *keys, int n, int op, swTableRow_handler handler, void *arg)
+{
+    swTable_header *header = table->memory;
+    swTable_batch_item *items, *item;
+    swTableRow *root, *row;
+    uint64_t state;
+    uint32_t bucket, now = 0;
+    int i, j, count = 0;
 
-    return SW_OK;
+    if (n <= 0)
+    {
+        return 0;
+    }
+    items = sw_malloc(sizeof(swTable_batch_item) * n);
+    if (items == NULL)
+    {
+        swWarn("malloc(%ld) failed.", sizeof(swTable_batch_item) * n);
+        return SW_ERR;
+    }
+    if (op == SW_TABLE_BATCH_SET)
+    {
+        for (i = 0; i < n; i++)
+        {
+            now = swTable_prepare(table);
+        }
+    }
+
+    state = header->state;
+    for (i = 0; i < n; i++)
+    {
+        items[i].crc32 = swoole_crc32(keys[i].str, keys[i].length);
+        items[i].bucket = swTable_bucket(state, items[i].crc32);
+        items[i].index = i;
+        items[i].retry = 0;
+        //the root rows are not moved, no need to load the bucket pointer
+        root = swTable_root(table, items[i].bucket);
+        __builtin_prefetch(root);
+        __builtin_prefetch((void *) root + SW_TABLE_PREFETCH_LINE);
+    }
+    swTable_batch_sort(items, n);
+
+    for (i = 0; i < n; i = j)
+    {
+        bucket = items[i].bucket;
+        root = swTable_root(table, bucket);
+        swTableRow_lock(root);
+        state = header->state;
+
+        for (j = i; j < n && items[j].bucket == bucket; j++)
+        {
+            item = &items[j];
+            if (swTable_bucket(state, item->crc32) != bucket)
+            {
+                item->retry = 1;
+                continue;
+            }
+            if (op == SW_TABLE_BATCH_DEL)
+            {
+                if (swTable_delete(table, root, item->crc32) == SW_OK)
+                {
+                    count++;
+                }
+                continue;
+            }
+            if (op == SW_TABLE_BATCH_GET)
+            {
+                row = swTable_lookup(table, root, item->crc32);
+            }
+            else
+            {
+                row = swTable_insert(table, root, item->crc32, now);
+                //no conflict row left, swTableRow_set() evicts one
+                if (row == NULL)
+                {
+                    item->retry = table->evict == SW_TABLE_EVICT_LRU;
+                    continue;
+                }
+            }
+            if (row == NULL)
+            {
+                continue;
+            }
+            if (row != root)
+            {
+                swTableRow_lock(row);
+            }
+            handler(table, row, item->index, arg);
+            if (row != root)
+            {
+                swTableRow_unlock(row);
+            }
+            count++;
+        }
+        swTableRow_unlock(root);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (!items[i].retry)
+        {
+            continue;
+        }
+        j = items[i].index;
+        if (op == SW_TABLE_BATCH_DEL)
+        {
+            if (swTableRow_del(table, keys[j].str, keys[j].length) == SW_OK)
+            {
+                count++;
+            }
+            continue;
+        }
+        if (op == SW_TABLE_BATCH_GET)
+        {
+            row = swTableRow_get(table, keys[j].str, keys[j].length);
+        }
+        else
+        {
+            row = swTableRow_set(table, keys[j].str, keys[j].length);
+        }
+        if (row)
+        {
+            handler(table, row, j, arg);
+            swTableRow_unlock(row);
+            count++;
+        }
+    }
+
+    sw_free(items);
+    return count;
+}
+
+/**
+ * the handler is called with the row locked for the keys found, return the number of them
+ */
+int swTableRow_get_multi(swTable *table, swTable_key *keys, int n, swTableRow_handler handler, void *arg)
+{
+    return swTable_batch(table, keys, n, SW_TABLE_BATCH_GET, handler, arg);
+}
+
+/**
+ * the handler writes the row, return the number of the rows written
+ */
+int swTableRow_set_multi(swTable *table, swTable_key *keys, int n, swTableRow_handler handler, void *arg)
+{
+    return swTable_batch(table, keys, n, SW_TABLE_BATCH_SET, handler, arg);
+}
+
+/**
+ * return the number of the rows deleted
+ */
+int swTableRow_del_multi(swTable *table, swTable_key *keys, int n)
+{
+    return swTable_batch(table, keys, n, SW_TABLE_BATCH_DEL, NULL, NULL);
 }
@@ -474,7 +474,7 @@ static int swClient_tcp_sendfile_sync(swClient *cli, char *filename)
 
 static int swClient_tcp_sendfile_async(swClient *cli, char *filename)
 {
-    if (swConnection_sendfile(cli->socket, filename) < 0)
+    if (swConnection_sendfile(cli->socket, filename, 0, 0) < 0)
     {
         SwooleG.error = errno;
         return SW_ERR;
@@ -756,6 +756,7 @@ static int swClient_onWrite(swReactor *reactor, swEvent *event)
     }
     else
     {
+        SwooleG.error = error;
         connect_fail:
         if (cli->onError)
         {
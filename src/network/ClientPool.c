@@ -0,0 +1,229 @@
+/*
+ +----------------------------------------------------------------------+
+ | Swoole                                                               |
+ +----------------------------------------------------------------------+
+ | This source file is subject to version 2.0 of the Apache license,    |
+ | that is bundled with this package in the file LICENSE, and is        |
+ | available through the world-wide-web at the following url:           |
+ | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+ | If you did not receive a copy of the Apache2.0 license and are unable|
+ | to obtain it through the world-wide-web, please send a note to       |
+ | license@swoole.com so we can mail you a copy immediately.            |
+ +----------------------------------------------------------------------+
+ | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+ +----------------------------------------------------------------------+
+ */
+
+#include "swoole.h"
+#include "Client.h"
+
+static int swClientPool_is_alive(swClientPool *pool, swClient *cli, time_t now);
+static void swClientPool_close(swClientPool *pool, swClient *cli);
+
+swClientPool* swClientPool_new(char *key, uint16_t key_len, uint32_t min_size, uint32_t max_size)
+{
+    swClientPool *pool = sw_malloc(sizeof(swClientPool));
+    if (pool == NULL)
+    {
+        swWarn("malloc(%ld) failed.", sizeof(swClientPool));
+        return NULL;
+    }
+    bzero(pool, sizeof(swClientPool));
+
+    pool->idle_list = swLinkedList_new();
+    if (pool->idle_list == NULL)
+    {
+        sw_free(pool);
+        return NULL;
+    }
+
+    pool->key = sw_malloc(key_len + 1);
+    if (pool->key == NULL)
+    {
+        swWarn("malloc(%d) failed.", key_len + 1);
+        sw_free(pool->idle_list);
+        sw_free(pool);
+        return NULL;
+    }
+    memcpy(pool->key, key, key_len);
+    pool->key[key_len] = 0;
+    pool->key_len = key_len;
+
+    pool->min_size = min_size;
+    pool->max_size = max_size;
+    pool->idle_timeout = SW_CLIENT_POOL_IDLE_TIMEOUT;
+    pool->max_lifetime = 0;
+
+    return pool;
+}
+
+/**
+ * check the idle connection without blocking, the peer may have closed it.
+ */
+static int swClientPool_is_alive(swClientPool *pool, swClient *cli, time_t now)
+{
+    uint64_t tmp_buf;
+    int ret;
+
+    if (cli->closed || !cli->socket || !cli->socket->active)
+    {
+        return SW_FALSE;
+    }
+    if (pool->max_lifetime > 0 && now - cli->create_time >= pool->max_lifetime)
+    {
+        return SW_FALSE;
+    }
+    if (!swSocket_is_stream(cli->type))
+    {
+        return SW_TRUE;
+    }
+
+    ret = recv(cli->socket->fd, &tmp_buf, sizeof(tmp_buf), MSG_DONTWAIT | MSG_PEEK);
+    if (ret == 0 || (ret < 0 && swConnection_error(errno) == SW_CLOSE))
+    {
+        pool->probe_fail_count++;
+        return SW_FALSE;
+    }
+    //clear history data
+    if (ret > 0)
+    {
+        swSocket_clean(cli->socket->fd);
+    }
+    return SW_TRUE;
+}
+
+static void swClientPool_close(swClientPool *pool, swClient *cli)
+{
+    pool->num--;
+    pool->close_count++;
+    cli->pool = NULL;
+
+    if (!cli->closed)
+    {
+        cli->close(cli);
+    }
+    if (pool->onFree)
+    {
+        pool->onFree(cli);
+    }
+}
+
+/**
+ * borrow an idle connection, return NULL if there is no usable one.
+ */
+swClient* swClientPool_get(swClientPool *pool)
+{
+    swClient *cli;
+    time_t now = time(NULL);
+
+    //LIFO, keep the most recently used connections warm
+    while (pool->idle_list->num > 0)
+    {
+        cli = swLinkedList_pop(pool->idle_list);
+        if (pool->idle_timeout > 0 && now - cli->last_time >= pool->idle_timeout && pool->num > pool->min_size)
+        {
+            swClientPool_close(pool, cli);
+            continue;
+        }
+        if (!swClientPool_is_alive(pool, cli, now))
+        {
+            swClientPool_close(pool, cli);
+            continue;
+        }
+        cli->last_time = now;
+        pool->reuse_count++;
+        return cli;
+    }
+    return NULL;
+}
+
+/**
+ * a new connection was created for this pool, it is borrowed now.
+ */
+void swClientPool_add(swClientPool *pool, swClient *cli)
+{
+    pool->num++;
+    pool->create_count++;
+    cli->pool = pool;
+    cli->create_time = cli->last_time = time(NULL);
+}
+
+/**
+ * give back the connection, return SW_ERR if it has been closed and freed.
+ */
+int swClientPool_release(swClientPool *pool, swClient *cli)
+{
+    time_t now = time(NULL);
+
+    if (!swClientPool_is_alive(pool, cli, now))
+    {
+        swClientPool_close(pool, cli);
+        return SW_ERR;
+    }
+    cli->last_time = now;
+    if (swLinkedList_append(pool->idle_list, cli) < 0)
+    {
+        swClientPool_close(pool, cli);
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+/**
+ * the borrowed connection was closed, the owner will free it.
+ */
+void swClientPool_remove(swClientPool *pool, swClient *cli)
+{
+    if (cli->pool != pool)
+    {
+        return;
+    }
+    pool->num--;
+    pool->close_count++;
+    cli->pool = NULL;
+}
+
+/**
+ * liveness probe and expiration for the idle connections, return the number of closed connections.
+ */
+int swClientPool_check(swClientPool *pool)
+{
+    swClient *cli;
+    time_t now = time(NULL);
+    int n = pool->idle_list->num;
+    int closed = 0;
+
+    while (n-- > 0)
+    {
+        cli = swLinkedList_shift(pool->idle_list);
+        if (pool->idle_timeout > 0 && now - cli->last_time >= pool->idle_timeout && pool->num > pool->min_size)
+        {
+            goto close_cli;
+        }
+        if (!swClientPool_is_alive(pool, cli, now))
+        {
+            goto close_cli;
+        }
+        if (swLinkedList_append(pool->idle_list, cli) == SW_OK)
+        {
+            continue;
+        }
+        close_cli:
+        swClientPool_close(pool, cli);
+        closed++;
+    }
+    return closed;
+}
+
+void swClientPool_free(swClientPool *pool)
+{
+    swClient *cli;
+    while (pool->idle_list->num > 0)
+    {
+        cli = swLinkedList_pop(pool->idle_list);
+        swClientPool_close(pool, cli);
+    }
+    sw_free(pool->idle_list);
+    sw_free(pool->key);
+    sw_free(pool);
+}
@@ -34,7 +34,7 @@ int swConnection_onSendfile(swConnection *conn, swBuffer_trunk *chunk)
     swTask_sendfile *task = chunk->store.ptr;
 
 #ifdef HAVE_TCP_NOPUSH
-    if (task->offset == 0 && conn->tcp_nopush)
+    if (task->offset == task->begin && conn->tcp_nopush)
     {
         /**
          * disable tcp_nodelay
@@ -57,9 +57,9 @@ int swConnection_onSendfile(swConnection *conn, swBuffer_trunk *chunk)
     }
 #endif
 
-    int sendn = (task->filesize - task->offset > SW_SENDFILE_TRUNK) ? SW_SENDFILE_TRUNK : task->filesize - task->offset;
+    int sendn = (task->end - task->offset > SW_SENDFILE_TRUNK) ? SW_SENDFILE_TRUNK : task->end - task->offset;
     ret = swoole_sendfile(conn->fd, task->fd, &task->offset, sendn);
-    swTrace("ret=%d|task->offset=%ld|sendn=%d|filesize=%ld", ret, task->offset, sendn, task->filesize);
+    swTrace("ret=%d|task->offset=%ld|sendn=%d|end=%ld", ret, task->offset, sendn, task->end);
 
     if (ret <= 0)
     {
@@ -78,7 +78,7 @@ int swConnection_onSendfile(swConnection *conn, swBuffer_trunk *chunk)
     }
 
     //sendfile finish
-    if (task->offset >= task->filesize)
+    if (task->offset >= task->end)
     {
         swBuffer_pop_trunk(conn->out_buffer, chunk);
 
@@ -216,7 +216,7 @@ void swConnection_sendfile_destructor(swBuffer_trunk *chunk)
     sw_free(task);
 }
 
-int swConnection_sendfile(swConnection *conn, char *filename)
+int swConnection_sendfile(swConnection *conn, char *filename, off_t offset, size_t length)
 {
     if (conn->out_buffer == NULL)
     {
@@ -240,9 +240,9 @@ int swConnection_sendfile(swConnection *conn, char *filename)
     int file_fd = open(filename, O_RDONLY);
     if (file_fd < 0)
     {
+        swSysError("open(%s) failed.", filename);
         free(task->filename);
         free(task);
-        swSysError("open(%s) failed.", task->filename);
         return SW_ERR;
     }
     task->fd = file_fd;
@@ -255,7 +255,23 @@ int swConnection_sendfile(swConnection *conn, char *filename)
         swConnection_sendfile_destructor(&error_chunk);
         return SW_ERR;
     }
-    task->filesize = file_stat.st_size;
+    if (offset < 0 || offset > file_stat.st_size)
+    {
+        swWarn("sendfile(%s) offset[%ld] is out of the file size[%ld].", filename, (long) offset, (long) file_stat.st_size);
+        error_chunk.store.ptr = task;
+        swConnection_sendfile_destructor(&error_chunk);
+        return SW_ERR;
+    }
+    task->begin = offset;
+    task->offset = offset;
+    if (length == 0 || offset + length > file_stat.st_size)
+    {
+        task->end = file_stat.st_size;
+    }
+    else
+    {
+        task->end = offset + length;
+    }
 
     swBuffer_trunk *chunk = swBuffer_new_trunk(conn->out_buffer, SW_CHUNK_SENDFILE, 0);
     if (chunk == NULL)
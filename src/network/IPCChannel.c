@@ -0,0 +1,269 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+
+static sw_inline int swIPCChannel_in(swIPCChannel *channel, void *data, int length)
+{
+    if (swChannel_in(channel->chan, data, length) == SW_OK)
+    {
+        return SW_OK;
+    }
+    //the consumer must wake up the producer after it reads
+    channel->blocked = 1;
+    sw_atomic_memory_barrier();
+    return swChannel_in(channel->chan, data, length);
+}
+
+/**
+ * SW_IPC_CHANNEL: create the rings before the manager process fork
+ */
+int swIPCChannel_create(swServer *serv)
+{
+    int i;
+    int n = serv->reactor_num * serv->worker_num;
+    size_t size = sizeof(swIPCChannel) * n * 2 + sizeof(swIPCNotify) * (serv->reactor_num + serv->worker_num);
+    swIPCNotify *notify;
+
+    void *mem = sw_shm_calloc(1, size);
+    if (mem == NULL)
+    {
+        swWarn("sw_shm_calloc(%ld) for channels failed.", size);
+        return SW_ERR;
+    }
+
+    serv->channel_to_worker = mem;
+    serv->channel_to_reactor = serv->channel_to_worker + n;
+    serv->worker_notify = (swIPCNotify *) (serv->channel_to_reactor + n);
+    serv->reactor_notify = serv->worker_notify + serv->worker_num;
+
+    for (i = 0; i < n; i++)
+    {
+        serv->channel_to_worker[i].chan = swChannel_new(SW_IPC_CHANNEL_SIZE, sizeof(swEventData), SW_CHAN_SHM);
+        serv->channel_to_reactor[i].chan = swChannel_new(SW_IPC_CHANNEL_SIZE, sizeof(swEventData), SW_CHAN_SHM);
+        if (serv->channel_to_worker[i].chan == NULL || serv->channel_to_reactor[i].chan == NULL)
+        {
+            return SW_ERR;
+        }
+    }
+
+    for (i = 0; i < serv->reactor_num + serv->worker_num; i++)
+    {
+        notify = &serv->worker_notify[i];
+        if (swPipeNotify_auto(&notify->pipe, 0, 0) < 0)
+        {
+            swWarn("create notify pipe failed.");
+            return SW_ERR;
+        }
+        //the consumer is not started, the first push must wake it up
+        notify->parked = 1;
+        notify->spin = SW_IPC_CHANNEL_SPIN_MIN;
+    }
+    return SW_OK;
+}
+
+void swIPCChannel_free(swServer *serv)
+{
+    int i;
+    int n = serv->reactor_num * serv->worker_num;
+
+    if (serv->channel_to_worker == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (serv->channel_to_worker[i].chan)
+        {
+            swChannel_free(serv->channel_to_worker[i].chan);
+        }
+        if (serv->channel_to_reactor[i].chan)
+        {
+            swChannel_free(serv->channel_to_reactor[i].chan);
+        }
+    }
+    for (i = 0; i < serv->reactor_num + serv->worker_num; i++)
+    {
+        if (serv->worker_notify[i].pipe.object)
+        {
+            serv->worker_notify[i].pipe.close(&serv->worker_notify[i].pipe);
+        }
+    }
+    sw_shm_free(serv->channel_to_worker);
+    serv->channel_to_worker = NULL;
+}
+
+/**
+ * write the eventfd only when the consumer is not draining the rings
+ */
+void swIPCChannel_wakeup(swIPCNotify *notify)
+{
+    uint64_t flag = 1;
+    sw_atomic_memory_barrier();
+    if (notify->parked && sw_atomic_cmp_set(&notify->parked, 1, 0))
+    {
+        notify->pipe.write(&notify->pipe, &flag, sizeof(flag));
+    }
+}
+
+/**
+ * move the buffered messages into the ring, return the length left in the buffer
+ */
+int swIPCChannel_flush(swIPCChannel *channel, swIPCNotify *consumer, swBuffer *buffer)
+{
+    swBuffer_trunk *trunk;
+    int n = 0;
+
+    while (!swBuffer_empty(buffer))
+    {
+        trunk = swBuffer_get_trunk(buffer);
+        if (swIPCChannel_in(channel, trunk->store.ptr, trunk->length) < 0)
+        {
+            break;
+        }
+        swBuffer_pop_trunk(buffer, trunk);
+        n++;
+    }
+    if (n > 0)
+    {
+        swIPCChannel_wakeup(consumer);
+    }
+    return buffer == NULL ? 0 : buffer->length;
+}
+
+/**
+ * [Producer] the message is copied into the ring, or into the buffer when the ring is full and into the ring
+ * later by swIPCChannel_flush. This is a copying ring: the data is copied in here and out by swIPCChannel_pop,
+ * the same two copies as the write and read of the pipe, only the system calls are saved.
+ * Same as the pipe, the reactor thread pauses the connections when the buffer exceeds pipe_buffer_size.
+ */
+int swIPCChannel_push(swIPCChannel *channel, swIPCNotify *consumer, swBuffer **buffer_ptr, void *data, int length)
+{
+    swBuffer *buffer = *buffer_ptr;
+
+    //the buffered messages must be sent first
+    if (swBuffer_empty(buffer) && swIPCChannel_in(channel, data, length) == SW_OK)
+    {
+        swIPCChannel_wakeup(consumer);
+        return SW_OK;
+    }
+
+    if (buffer == NULL)
+    {
+        buffer = swBuffer_new(sizeof(swEventData));
+        if (buffer == NULL)
+        {
+            swWarn("create buffer failed.");
+            return SW_ERR;
+        }
+        *buffer_ptr = buffer;
+    }
+
+    if (swIPCChannel_flush(channel, consumer, buffer) == 0 && swIPCChannel_in(channel, data, length) == SW_OK)
+    {
+        swIPCChannel_wakeup(consumer);
+        return SW_OK;
+    }
+    if (swBuffer_append(buffer, data, length) < 0)
+    {
+        swWarn("append to pipe_buffer failed.");
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+/**
+ * [Consumer] the message is copied out, the space is released before it is handled.
+ * The producer is woken up when the full ring is drained to half.
+ */
+int swIPCChannel_pop(swIPCChannel *channel, swIPCNotify *producer, void *out, int buffer_length)
+{
+    swChannel *chan = channel->chan;
+    int n = swChannel_out(chan, out, buffer_length);
+
+    if (n > 0 && channel->blocked && chan->tail - chan->head < chan->size / 2
+            && sw_atomic_cmp_set(&channel->blocked, 1, 0))
+    {
+        swIPCChannel_wakeup(producer);
+    }
+    return n;
+}
+
+/**
+ * [Consumer] the eventfd is readable, drain the rings and spin for a while before parking.
+ * The spin count grows when the data comes while spinning, and shrinks when it is wasted.
+ */
+int swIPCChannel_consume(swReactor *reactor, swIPCNotify *notify, swIPCChannel_drain drain)
+{
+    uint64_t flag;
+    uint32_t spin = 0;
+    int n, count = 0;
+
+    notify->pipe.read(&notify->pipe, &flag, sizeof(flag));
+    notify->parked = 0;
+    sw_atomic_memory_barrier();
+
+    while (reactor->running)
+    {
+        n = drain(reactor);
+        if (n > 0)
+        {
+            count += n;
+            if (spin > 0 && notify->spin < SW_IPC_CHANNEL_SPIN_MAX)
+            {
+                notify->spin <<= 1;
+            }
+            spin = 0;
+            //let the other events run, the eventfd brings us back in the next loop
+            if (count >= SW_IPC_CHANNEL_BATCH)
+            {
+                flag = 1;
+                notify->pipe.write(&notify->pipe, &flag, sizeof(flag));
+                return SW_OK;
+            }
+            continue;
+        }
+
+        //spinning on a single cpu only delays the producer
+        if (spin < notify->spin && SW_CPU_NUM > 1)
+        {
+            spin++;
+            sw_atomic_cpu_pause();
+            continue;
+        }
+        if (notify->spin > SW_IPC_CHANNEL_SPIN_MIN)
+        {
+            notify->spin >>= 1;
+        }
+
+        notify->parked = 1;
+        sw_atomic_memory_barrier();
+        //the producers may have pushed before they saw parked
+        n = drain(reactor);
+        if (n == 0)
+        {
+            return SW_OK;
+        }
+        count += n;
+        notify->parked = 0;
+        sw_atomic_memory_barrier();
+        spin = 0;
+    }
+    //the reactor is stopped, the next consumer will be woken up by the producers
+    notify->parked = 1;
+    return SW_OK;
+}
@@ -62,6 +62,13 @@ int swManager_start(swFactory *factory)
         swServer_pipe_set(serv, serv->workers[i].pipe_object);
     }
 
+    //reactor threads and workers use the shared memory rings
+    if (serv->factory_mode == SW_MODE_PROCESS && serv->ipc_mode == SW_IPC_CHANNEL && swIPCChannel_create(serv) < 0)
+    {
+        swError("create ipc channels failed.");
+        return SW_ERR;
+    }
+
     if (SwooleG.task_worker_num > 0)
     {
         key_t key = 0;
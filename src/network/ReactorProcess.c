@@ -440,7 +440,7 @@ static int swReactorProcess_send2client(swFactory *factory, swSendData *_send)
         else if (_send->info.type == SW_EVENT_SENDFILE)
         {
             memcpy(&proxy_msg.info, &_send->info, sizeof(proxy_msg.info));
-            memcpy(proxy_msg.data, _send->data, _send->length);
+            memcpy(proxy_msg.data, _send->data, _send->info.len);
             return SwooleG.main_reactor->write(SwooleG.main_reactor, worker->pipe_master, &proxy_msg, sizeof(proxy_msg.info) + proxy_msg.info.len);
         }
         else
@@ -26,6 +26,7 @@ static int swReactorThread_loop_stream(swThreadParam *param);
 static int swReactorThread_onPipeWrite(swReactor *reactor, swEvent *ev);
 static int swReactorThread_onClose(swReactor *reactor, swEvent *event);
 static int swReactorThread_websocket_onPackage(swConnection *conn, char *data, uint32_t length);
+static void swReactorThread_websocket_free(swConnection *conn);
 static int swReactorThread_onReceive_no_buffer(swReactor *reactor, swEvent *event);
 static int swReactorThread_onReceive_buffer_check_length(swReactor *reactor, swEvent *event);
 static int swReactorThread_onReceive_buffer_check_eof(swReactor *reactor, swEvent *event);
@@ -35,9 +36,26 @@ static int swReactorThread_onPackage(swReactor *reactor, swEvent *event);
 static int swReactorThread_onWrite(swReactor *reactor, swEvent *ev);
 
 static int swReactorThread_dispatch_string_buffer(swConnection *conn, char *data, uint32_t length);
+#ifndef SW_USE_RINGBUFFER
+static int swReactorThread_dispatch_string_batch(swConnection *conn, char *data, uint32_t *lengths, int n);
+#endif
 #if 0
 static int swReactorThread_dispatch_array_buffer(swReactorThread *thread, swConnection *conn);
 #endif
+#ifdef SW_HAVE_ZLIB
+static swString* swReactorThread_websocket_inflate(swConnection *conn, char *data, size_t length);
+static void swReactorThread_inflate_release(swConnection *conn);
+
+/**
+ * the idle inflate streams are reused by the connections without context takeover
+ */
+static __thread struct
+{
+    z_stream *pool[SW_WEBSOCKET_INFLATE_POOL_SIZE];
+    int pool_num;
+    swString *buffer;
+} swReactorThread_inflate;
+#endif
 
 #ifdef SW_USE_RINGBUFFER
 static sw_inline void swReactorThread_yield(swReactorThread *thread)
@@ -132,21 +150,47 @@ static sw_inline int swReactorThread_check_ssl_state(swConnection *conn)
 #endif
 
 /**
- * for udp
+ * fill the header of the packet, return the key to dispatch it
  */
-static int swReactorThread_onPackage(swReactor *reactor, swEvent *event)
+static sw_inline int swReactorThread_dgram_header(int socket_type, swSocketAddress *info, swDgramPacket *pkt)
 {
-    int fd = event->fd;
-    int ret;
+    int key = 0;
 
-    swServer *serv = SwooleG.serv;
+    //IPv4
+    if (socket_type == SW_SOCK_UDP)
+    {
+        pkt->port = ntohs(info->addr.inet_v4.sin_port);
+        pkt->addr.v4.s_addr = info->addr.inet_v4.sin_addr.s_addr;
+        key = pkt->addr.v4.s_addr;
+    }
+    //IPv6
+    else if (socket_type == SW_SOCK_UDP6)
+    {
+        pkt->port = ntohs(info->addr.inet_v6.sin6_port);
+        memcpy(&pkt->addr.v6, &info->addr.inet_v6.sin6_addr, sizeof(info->addr.inet_v6.sin6_addr));
+        memcpy(&key, &info->addr.inet_v6.sin6_addr, sizeof(key));
+    }
+    //Unix Dgram
+    else
+    {
+        pkt->addr.un.path_length = strlen(info->addr.un.sun_path) + 1;
+        pkt->length += pkt->addr.un.path_length;
+        pkt->port = 0;
+        memcpy(&key, info->addr.un.sun_path + pkt->addr.un.path_length - 6, sizeof(key));
+    }
+    return key;
+}
+
+/**
+ * dispatch a packet, it is split into SW_BUFFER_SIZE chunks
+ */
+static int swReactorThread_dispatch_packet(swServer *serv, int fd, swSocketAddress *info, char *packet, int length)
+{
     swConnection *server_sock = &serv->connection_list[fd];
     swDispatchData task;
-    swSocketAddress info;
     swDgramPacket pkt;
     swFactory *factory = &serv->factory;
 
-    info.len = sizeof(info.addr);
     bzero(&task.data.info, sizeof(task.data.info));
     task.data.info.from_fd = fd;
     task.data.info.from_id = SwooleTG.id;
@@ -166,104 +210,200 @@ static int swReactorThread_onPackage(swReactor *reactor, swEvent *event)
         break;
     }
 
-    char packet[SW_BUFFER_SIZE_UDP];
-    ret = recvfrom(fd, packet, SW_BUFFER_SIZE_UDP, 0, (struct sockaddr *) &info.addr, &info.len);
+    pkt.length = length;
+    task.data.info.fd = swReactorThread_dgram_header(socket_type, info, &pkt);
+    task.target_worker_id = -1;
+    uint32_t header_size = sizeof(pkt);
 
-    if (ret > 0)
+    //dgram header
+    memcpy(task.data.data, &pkt, sizeof(pkt));
+    //unix dgram
+    if (socket_type == SW_SOCK_UNIX_DGRAM )
     {
-        pkt.length = ret;
-
-        //IPv4
-        if (socket_type == SW_SOCK_UDP)
-        {
-            pkt.port = ntohs(info.addr.inet_v4.sin_port);
-            pkt.addr.v4.s_addr = info.addr.inet_v4.sin_addr.s_addr;
-            task.data.info.fd = pkt.addr.v4.s_addr;
-        }
-        //IPv6
-        else if (socket_type == SW_SOCK_UDP6)
-        {
-            pkt.port = ntohs(info.addr.inet_v6.sin6_port);
-            memcpy(&pkt.addr.v6, &info.addr.inet_v6.sin6_addr, sizeof(info.addr.inet_v6.sin6_addr));
-            memcpy(&task.data.info.fd, &info.addr.inet_v6.sin6_addr, sizeof(task.data.info.fd));
-        }
-        //Unix Dgram
-        else
-        {
-            pkt.addr.un.path_length = strlen(info.addr.un.sun_path) + 1;
-            pkt.length += pkt.addr.un.path_length;
-            pkt.port = 0;
-            memcpy(&task.data.info.fd, info.addr.un.sun_path + pkt.addr.un.path_length - 6, sizeof(task.data.info.fd));
-        }
+        header_size += pkt.addr.un.path_length;
+        memcpy(task.data.data + sizeof(pkt), info->addr.un.sun_path, pkt.addr.un.path_length);
+    }
+    //dgram body
+    if (pkt.length > SW_BUFFER_SIZE - sizeof(pkt))
+    {
+        task.data.info.len = SW_BUFFER_SIZE;
+    }
+    else
+    {
+        task.data.info.len = pkt.length + sizeof(pkt);
+    }
+    //dispatch packet header
+    memcpy(task.data.data + header_size, packet, task.data.info.len - header_size);
 
-        task.target_worker_id = -1;
-        uint32_t header_size = sizeof(pkt);
+    uint32_t send_n = pkt.length + header_size;
+    uint32_t offset = 0;
 
-        //dgram header
-        memcpy(task.data.data, &pkt, sizeof(pkt));
-        //unix dgram
-        if (socket_type == SW_SOCK_UNIX_DGRAM )
-        {
-            header_size += pkt.addr.un.path_length;
-            memcpy(task.data.data + sizeof(pkt), info.addr.un.sun_path, pkt.addr.un.path_length);
-        }
-        //dgram body
-        if (pkt.length > SW_BUFFER_SIZE - sizeof(pkt))
-        {
-            task.data.info.len = SW_BUFFER_SIZE;
-        }
-        else
-        {
-            task.data.info.len = pkt.length + sizeof(pkt);
-        }
-        //dispatch packet header
-        memcpy(task.data.data + header_size, packet, task.data.info.len - header_size);
+    /**
+     * lock target
+     */
+    SwooleTG.factory_lock_target = 1;
 
-        uint32_t send_n = pkt.length + header_size;
-        uint32_t offset = 0;
+    if (factory->dispatch(factory, &task) < 0)
+    {
+        return SW_ERR;
+    }
 
+    send_n -= task.data.info.len;
+    if (send_n == 0)
+    {
         /**
-         * lock target
+         * unlock
          */
-        SwooleTG.factory_lock_target = 1;
+        SwooleTG.factory_target_worker = -1;
+        SwooleTG.factory_lock_target = 0;
+        return SW_OK;
+    }
+
+    offset = SW_BUFFER_SIZE - header_size;
+    while (send_n > 0)
+    {
+        task.data.info.len = send_n > SW_BUFFER_SIZE ? SW_BUFFER_SIZE : send_n;
+        memcpy(task.data.data, packet + offset, task.data.info.len);
+        send_n -= task.data.info.len;
+        offset += task.data.info.len;
 
         if (factory->dispatch(factory, &task) < 0)
         {
-            return SW_ERR;
+            break;
         }
+    }
+    /**
+     * unlock
+     */
+    SwooleTG.factory_target_worker = -1;
+    SwooleTG.factory_lock_target = 0;
+    return SW_OK;
+}
 
-        send_n -= task.data.info.len;
-        if (send_n == 0)
+/**
+ * for udp
+ */
+static int swReactorThread_onPackage(swReactor *reactor, swEvent *event)
+{
+    int fd = event->fd;
+    swSocketAddress info;
+    char packet[SW_BUFFER_SIZE_UDP];
+
+    info.len = sizeof(info.addr);
+    int ret = recvfrom(fd, packet, SW_BUFFER_SIZE_UDP, 0, (struct sockaddr *) &info.addr, &info.len);
+    if (ret > 0 && swReactorThread_dispatch_packet(SwooleG.serv, fd, &info, packet, ret) < 0)
+    {
+        return SW_ERR;
+    }
+    return ret;
+}
+
+#ifdef HAVE_MMSG
+/**
+ * udp thread: drain the socket with recvmmsg, the packets going to the same worker
+ * are packed into a SW_EVENT_DGRAM_BATCH event and written to the worker once
+ */
+static void swReactorThread_loop_dgram_batch(swServer *serv, int fd)
+{
+    struct mmsghdr msgs[SW_DGRAM_BATCH_MAX];
+    struct iovec iov[SW_DGRAM_BATCH_MAX];
+    swSocketAddress addrs[SW_DGRAM_BATCH_MAX];
+    swDgramPacket pkt;
+    swDispatchData *task;
+    swFactory *factory = &serv->factory;
+    int socket_type = serv->connection_list[fd].socket_type;
+    int batch = serv->dgram_batch > SW_DGRAM_BATCH_MAX ? SW_DGRAM_BATCH_MAX : serv->dgram_batch;
+    int i, n, worker_id, key, dirty_n = 0;
+    uint32_t size;
+
+    char *packets = sw_malloc(batch * SW_BUFFER_SIZE_UDP);
+    swDispatchData *pending = sw_calloc(serv->worker_num, sizeof(swDispatchData));
+    uint16_t *dirty = sw_calloc(serv->worker_num, sizeof(uint16_t));
+    if (packets == NULL || pending == NULL || dirty == NULL)
+    {
+        swError("malloc for the dgram batch failed.");
+        return;
+    }
+
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        pending[i].target_worker_id = i;
+        pending[i].data.info.type = SW_EVENT_DGRAM_BATCH;
+        pending[i].data.info.fd = socket_type == SW_SOCK_UDP6 ? SW_EVENT_UDP6 : SW_EVENT_UDP;
+        pending[i].data.info.from_fd = fd;
+        pending[i].data.info.from_id = SwooleTG.id;
+    }
+    bzero(msgs, sizeof(msgs));
+    for (i = 0; i < batch; i++)
+    {
+        iov[i].iov_base = packets + i * SW_BUFFER_SIZE_UDP;
+        iov[i].iov_len = SW_BUFFER_SIZE_UDP;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i].addr;
+    }
+
+    while (SwooleG.running == 1)
+    {
+        for (i = 0; i < batch; i++)
+        {
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i].addr);
+        }
+        //block for the first packet, then take what is queued
+        n = recvmmsg(fd, msgs, batch, MSG_WAITFORONE, NULL);
+        if (n < 0)
         {
-            /**
-             * unlock
-             */
-            SwooleTG.factory_target_worker = -1;
-            SwooleTG.factory_lock_target = 0;
-            return ret;
+            if (errno != EINTR)
+            {
+                swSysError("recvmmsg(%d) failed.", fd);
+            }
+            continue;
         }
 
-        offset = SW_BUFFER_SIZE - header_size;
-        while (send_n > 0)
+        for (i = 0; i < n; i++)
         {
-            task.data.info.len = send_n > SW_BUFFER_SIZE ? SW_BUFFER_SIZE : send_n;
-            memcpy(task.data.data, packet + offset, task.data.info.len);
-            send_n -= task.data.info.len;
-            offset += task.data.info.len;
+            addrs[i].len = msgs[i].msg_hdr.msg_namelen;
+            size = swDgramPacket_size(msgs[i].msg_len);
+            //too large to be packed
+            if (size > SW_BUFFER_SIZE)
+            {
+                swReactorThread_dispatch_packet(serv, fd, &addrs[i], iov[i].iov_base, msgs[i].msg_len);
+                continue;
+            }
 
-            if (factory->dispatch(factory, &task) < 0)
+            pkt.length = msgs[i].msg_len;
+            key = swReactorThread_dgram_header(socket_type, &addrs[i], &pkt);
+            worker_id = swServer_worker_schedule(serv, key);
+            task = &pending[worker_id];
+
+            if (task->data.info.len + size > SW_BUFFER_SIZE)
             {
-                break;
+                factory->dispatch(factory, task);
+                task->data.info.len = 0;
             }
+            else if (task->data.info.len == 0)
+            {
+                dirty[dirty_n++] = worker_id;
+            }
+            memcpy(task->data.data + task->data.info.len, &pkt, sizeof(pkt));
+            memcpy(task->data.data + task->data.info.len + sizeof(pkt), iov[i].iov_base, pkt.length);
+            task->data.info.len += size;
         }
-        /**
-         * unlock
-         */
-        SwooleTG.factory_target_worker = -1;
-        SwooleTG.factory_lock_target = 0;
+
+        for (i = 0; i < dirty_n; i++)
+        {
+            task = &pending[dirty[i]];
+            factory->dispatch(factory, task);
+            task->data.info.len = 0;
+        }
+        dirty_n = 0;
     }
-    return ret;
+
+    sw_free(packets);
+    sw_free(pending);
+    sw_free(dirty);
 }
+#endif
 
 /**
  * close connection
@@ -313,6 +453,10 @@ int swReactorThread_close(swReactor *reactor, int fd)
                 swString *str = (swString *) conn->object;
                 swString_free(str);
                 conn->websocket_status = 0;
+                swReactorThread_websocket_free(conn);
+#ifdef SW_HAVE_ZLIB
+                swReactorThread_inflate_release(conn);
+#endif
             }
             else
             {
@@ -404,6 +548,46 @@ static int swReactorThread_onClose(swReactor *reactor, swEvent *event)
     }
 }
 
+/**
+ * send the response of the worker to the client
+ */
+static void swReactorThread_onResponse(swEventData *resp)
+{
+    swSendData _send;
+    swPackage_response pkg_resp;
+    swWorker *worker;
+
+    memcpy(&_send.info, &resp->info, sizeof(resp->info));
+    if (_send.info.from_fd == SW_RESPONSE_SMALL)
+    {
+        _send.data = resp->data;
+        _send.length = resp->info.len;
+        swReactorThread_send(&_send);
+    }
+    else
+    {
+        memcpy(&pkg_resp, resp->data, sizeof(pkg_resp));
+        worker = swServer_get_worker(SwooleG.serv, pkg_resp.worker_id);
+
+        _send.data = worker->send_shm;
+        _send.length = pkg_resp.length;
+
+#if 0
+        struct
+        {
+            uint32_t worker;
+            uint32_t index;
+            uint32_t serid;
+        } pkg_header;
+
+        memcpy(&pkg_header, _send.data + 4, sizeof(pkg_header));
+        swWarn("fd=%d, worker=%d, index=%d, serid=%d", _send.info.fd, pkg_header.worker, pkg_header.index, pkg_header.serid);
+#endif
+        swReactorThread_send(&_send);
+        worker->lock.unlock(&worker->lock);
+    }
+}
+
 /**
  * receive data from worker process pipe
  */
@@ -411,10 +595,6 @@ static int swReactorThread_onPipeReceive(swReactor *reactor, swEvent *ev)
 {
     int n;
     swEventData resp;
-    swSendData _send;
-
-    swPackage_response pkg_resp;
-    swWorker *worker;
 
 #ifdef SW_REACTOR_RECV_AGAIN
     while (1)
@@ -423,35 +603,7 @@ static int swReactorThread_onPipeReceive(swReactor *reactor, swEvent *ev)
         n = read(ev->fd, &resp, sizeof(resp));
         if (n > 0)
         {
-            memcpy(&_send.info, &resp.info, sizeof(resp.info));
-            if (_send.info.from_fd == SW_RESPONSE_SMALL)
-            {
-                _send.data = resp.data;
-                _send.length = resp.info.len;
-                swReactorThread_send(&_send);
-            }
-            else
-            {
-                memcpy(&pkg_resp, resp.data, sizeof(pkg_resp));
-                worker = swServer_get_worker(SwooleG.serv, pkg_resp.worker_id);
-
-                _send.data = worker->send_shm;
-                _send.length = pkg_resp.length;
-
-#if 0
-                struct
-                {
-                    uint32_t worker;
-                    uint32_t index;
-                    uint32_t serid;
-                } pkg_header;
-
-                memcpy(&pkg_header, _send.data + 4, sizeof(pkg_header));
-                swWarn("fd=%d, worker=%d, index=%d, serid=%d", _send.info.fd, pkg_header.worker, pkg_header.index, pkg_header.serid);
-#endif
-                swReactorThread_send(&_send);
-                worker->lock.unlock(&worker->lock);
-            }
+            swReactorThread_onResponse(&resp);
         }
         else if (errno == EAGAIN)
         {
@@ -467,6 +619,130 @@ static int swReactorThread_onPipeReceive(swReactor *reactor, swEvent *ev)
     return SW_OK;
 }
 
+static sw_inline uint32_t swReactorThread_pipe_buffer_length(swServer *serv, swReactorThread *thread, int worker_id)
+{
+    if (serv->ipc_mode == SW_IPC_CHANNEL)
+    {
+        return thread->channel_buffer[worker_id] ? thread->channel_buffer[worker_id]->length : 0;
+    }
+    return serv->connection_list[serv->workers[worker_id].pipe_master].in_buffer->length;
+}
+
+/**
+ * the worker pipe is congested, stop reading from the connection instead of blocking the reactor thread
+ */
+static void swReactorThread_pause(swReactorThread *thread, uint16_t worker_id, swEventData *data)
+{
+    swServer *serv = SwooleG.serv;
+    swConnection *conn;
+
+    if (!swEventData_is_stream(data->info.type))
+    {
+        return;
+    }
+    conn = swServer_connection_verify(serv, data->info.fd);
+    if (conn == NULL || conn->paused || conn->removed)
+    {
+        return;
+    }
+    if (thread->pause_list[worker_id] == NULL)
+    {
+        thread->pause_list[worker_id] = swLinkedList_new();
+        if (thread->pause_list[worker_id] == NULL)
+        {
+            return;
+        }
+    }
+    if (swLinkedList_append(thread->pause_list[worker_id], (void *) (long) data->info.fd) < 0)
+    {
+        return;
+    }
+    conn->paused = 1;
+    swReactor_del_event(&thread->reactor, conn->fd, SW_EVENT_READ);
+    thread->pause_num++;
+    //the idle reactor must wake up to check the pipes
+    thread->reactor.timeout_msec = SW_PIPE_RESUME_INTERVAL;
+    sw_atomic_fetch_add(&SwooleStats->pause_count, 1);
+}
+
+/**
+ * resume reading once the worker pipe drains below the low watermark (half of pipe_buffer_size)
+ */
+static void swReactorThread_resume(swReactor *reactor)
+{
+    swServer *serv = reactor->ptr;
+    swReactorThread *thread = swServer_get_thread(serv, reactor->id);
+    swConnection *conn;
+    swLinkedList *list;
+    uint32_t session_id;
+    int i;
+
+    if (thread->pause_num == 0)
+    {
+        return;
+    }
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        list = thread->pause_list[i];
+        if (list == NULL || list->num == 0
+                || swReactorThread_pipe_buffer_length(serv, thread, i) > serv->pipe_buffer_size / 2)
+        {
+            continue;
+        }
+        while (list->num > 0)
+        {
+            session_id = (uint32_t) (long) swLinkedList_shift(list);
+            thread->pause_num--;
+            //closed
+            conn = swServer_connection_verify(serv, session_id);
+            if (conn == NULL || !conn->paused)
+            {
+                continue;
+            }
+            conn->paused = 0;
+            swReactor_add_event(reactor, conn->fd, SW_EVENT_READ);
+            sw_atomic_fetch_add(&SwooleStats->resume_count, 1);
+        }
+    }
+    if (thread->pause_num == 0)
+    {
+        reactor->timeout_msec = -1;
+    }
+}
+
+/**
+ * SW_IPC_CHANNEL: flush the buffered requests and receive one response from each worker
+ */
+static int swReactorThread_onChannelDrain(swReactor *reactor)
+{
+    swServer *serv = reactor->ptr;
+    swReactorThread *thread = swServer_get_thread(serv, reactor->id);
+    swEventData resp;
+    int i, n = 0;
+
+    for (i = 0; i < serv->worker_num; i++)
+    {
+        if (!swBuffer_empty(thread->channel_buffer[i]))
+        {
+            swIPCChannel_flush(swServer_channel_to_worker(serv, reactor->id, i), &serv->worker_notify[i],
+                    thread->channel_buffer[i]);
+        }
+        if (swIPCChannel_pop(swServer_channel_to_reactor(serv, i, reactor->id), &serv->worker_notify[i], &resp,
+                sizeof(resp)) > 0)
+        {
+            swReactorThread_onResponse(&resp);
+            n++;
+        }
+    }
+    return n;
+}
+
+static int swReactorThread_onChannelNotify(swReactor *reactor, swEvent *ev)
+{
+    swServer *serv = reactor->ptr;
+    return swIPCChannel_consume(reactor, &serv->reactor_notify[reactor->id], swReactorThread_onChannelDrain);
+}
+
 int swReactorThread_send2worker(void *data, int len, uint16_t target_worker_id)
 {
     swServer *serv = SwooleG.serv;
@@ -474,8 +750,20 @@ int swReactorThread_send2worker(void *data, int len, uint16_t target_worker_id)
     int ret = -1;
     swWorker *worker = &(serv->workers[target_worker_id]);
 
+    //shared memory ring of this reactor thread and the worker
+    if (SwooleTG.type == SW_THREAD_REACTOR && serv->ipc_mode == SW_IPC_CHANNEL)
+    {
+        swReactorThread *thread = swServer_get_thread(serv, SwooleTG.id);
+        ret = swIPCChannel_push(swServer_channel_to_worker(serv, SwooleTG.id, target_worker_id),
+                &serv->worker_notify[target_worker_id], &thread->channel_buffer[target_worker_id], data, len);
+        if (ret == SW_OK && swReactorThread_pipe_buffer_length(serv, thread, target_worker_id) > serv->pipe_buffer_size)
+        {
+            swReactorThread_pause(thread, target_worker_id, data);
+        }
+        return ret;
+    }
     //reactor thread
-    if (SwooleTG.type == SW_THREAD_REACTOR)
+    else if (SwooleTG.type == SW_THREAD_REACTOR)
     {
         int pipe_fd = worker->pipe_master;
         int thread_id = serv->connection_list[pipe_fd].from_id;
@@ -505,11 +793,6 @@ int swReactorThread_send2worker(void *data, int len, uint16_t target_worker_id)
         else
         {
             append_pipe_buffer:
-            if (buffer->length > serv->pipe_buffer_size)
-            {
-                swYield();
-                swSocket_wait(pipe_fd, SW_SOCKET_OVERFLOW_WAIT, SW_EVENT_WRITE);
-            }
             if (swBuffer_append(buffer, data, len) < 0)
             {
                 swWarn("append to pipe_buffer failed.");
@@ -520,8 +803,14 @@ int swReactorThread_send2worker(void *data, int len, uint16_t target_worker_id)
                 ret = SW_OK;
             }
         }
+        uint32_t buffer_length = buffer->length;
         //release thread lock
         lock->unlock(lock);
+
+        if (buffer_length > serv->pipe_buffer_size)
+        {
+            swReactorThread_pause(swServer_get_thread(serv, SwooleTG.id), target_worker_id, data);
+        }
     }
     //master/udp thread
     else
@@ -639,7 +928,8 @@ int swReactorThread_send(swSendData *_send)
     //sendfile to client
     else if (_send->info.type == SW_EVENT_SENDFILE)
     {
-        swConnection_sendfile(conn, _send_data);
+        swSendFile_request *req = (swSendFile_request *) _send_data;
+        swConnection_sendfile(conn, req->filename, req->offset, req->length);
     }
     //send data
     else
@@ -672,7 +962,7 @@ int swReactorThread_send(swSendData *_send)
     }
 
     //listen EPOLLOUT event
-    if (reactor->set(reactor, fd, SW_EVENT_TCP | SW_EVENT_WRITE | SW_EVENT_READ) < 0
+    if (reactor->set(reactor, fd, SW_EVENT_TCP | SW_EVENT_WRITE | (conn->paused ? 0 : SW_EVENT_READ)) < 0
             && (errno == EBADF || errno == ENOENT))
     {
         goto close_fd;
@@ -842,7 +1132,7 @@ static int swReactorThread_onWrite(swReactor *reactor, swEvent *ev)
     //remove EPOLLOUT event
     if (swBuffer_empty(conn->out_buffer))
     {
-        reactor->set(reactor, fd, SW_FD_TCP | SW_EVENT_READ);
+        reactor->set(reactor, fd, SW_FD_TCP | (conn->paused ? SW_EVENT_DEAULT : SW_EVENT_READ));
     }
     return SW_OK;
 }
@@ -961,10 +1251,26 @@ static int swReactorThread_onReceive_no_buffer(swReactor *reactor, swEvent *even
     return SW_OK;
 }
 
-void swReactorThread_set_protocol(swServer *serv, swReactor *reactor)
+/**
+ * the packages of one connection are sent to the worker in one message,
+ * only when all of them go to the same worker as they are sent one by one
+ */
+static void swReactorThread_set_package_batch(swServer *serv)
 {
-    //udp receive
-    reactor->setHandle(reactor, SW_FD_UDP, swReactorThread_onPackage);
+#ifndef SW_USE_RINGBUFFER
+    if (serv->factory_mode == SW_MODE_PROCESS
+            && (serv->dispatch_mode == SW_DISPATCH_FDMOD || serv->dispatch_mode == SW_DISPATCH_IPMOD
+                    || serv->dispatch_mode == SW_DISPATCH_UIDMOD))
+    {
+        serv->protocol.onPackageBatch = swReactorThread_dispatch_string_batch;
+    }
+#endif
+}
+
+void swReactorThread_set_protocol(swServer *serv, swReactor *reactor)
+{
+    //udp receive
+    reactor->setHandle(reactor, SW_FD_UDP, swReactorThread_onPackage);
     //write
     reactor->setHandle(reactor, SW_FD_TCP | SW_EVENT_WRITE, swReactorThread_onWrite);
 
@@ -979,6 +1285,7 @@ void swReactorThread_set_protocol(swServer *serv, swReactor *reactor)
     {
         serv->protocol.get_package_length = swProtocol_get_package_length;
         serv->protocol.onPackage = swReactorThread_dispatch_string_buffer;
+        swReactorThread_set_package_batch(serv);
         reactor->setHandle(reactor, SW_FD_TCP, swReactorThread_onReceive_buffer_check_length);
     }
     else if (serv->open_http_protocol)
@@ -994,6 +1301,7 @@ void swReactorThread_set_protocol(swServer *serv, swReactor *reactor)
     {
         serv->protocol.get_package_length = swMqtt_get_package_length;
         serv->protocol.onPackage = swReactorThread_dispatch_string_buffer;
+        swReactorThread_set_package_batch(serv);
         reactor->setHandle(reactor, SW_FD_TCP, swReactorThread_onReceive_buffer_check_length);
     }
     else
@@ -1002,59 +1310,282 @@ void swReactorThread_set_protocol(swServer *serv, swReactor *reactor)
     }
 }
 
+/**
+ * control frames are answered in the reactor thread, the reply is ordered with the output of the workers
+ */
+static int swReactorThread_websocket_reply(swConnection *conn, char opcode, char *payload, size_t length)
+{
+    char buf[SW_WEBSOCKET_HEADER_LEN + 0x7d];
+    swString frame;
+    swSendData _send;
+
+    bzero(&frame, sizeof(frame));
+    frame.str = buf;
+    frame.size = sizeof(buf);
+    swWebSocket_encode(&frame, payload, length, opcode, 1, 0);
+
+    bzero(&_send, sizeof(_send));
+    _send.info.fd = conn->session_id;
+    _send.info.type = SW_EVENT_TCP;
+    _send.data = frame.str;
+    _send.length = frame.length;
+    return swReactorThread_send(&_send);
+}
+
+/**
+ * send the close frame and close the connection, the rest of the frames in the buffer are discarded
+ */
+static int swReactorThread_websocket_close(swConnection *conn, int code)
+{
+    swServer *serv = SwooleG.serv;
+    uint16_t status = htons(code);
+    swEvent event;
+
+    swReactorThread_websocket_reply(conn, WEBSOCKET_OPCODE_CONNECTION_CLOSE, (char *) &status, sizeof(status));
+
+    bzero(&event, sizeof(event));
+    event.fd = conn->fd;
+    event.from_id = conn->from_id;
+    event.socket = conn;
+    swReactorThread_onClose(&serv->reactor_threads[serv->factory_mode == SW_MODE_SINGLE ? 0 : conn->from_id].reactor, &event);
+    return SW_ERR;
+}
+
+static void swReactorThread_websocket_free(swConnection *conn)
+{
+    if (conn->websocket_message)
+    {
+        swString_free(conn->websocket_message);
+        conn->websocket_message = NULL;
+    }
+    conn->websocket_compression &= ~SW_WEBSOCKET_INFLATING;
+}
+
+/**
+ * the complete data message, [FIN][OPCODE] is written in the 2 bytes before the payload
+ */
+static int swReactorThread_websocket_dispatch(swConnection *conn, char opcode, int compressed, char *payload, size_t length)
+{
+#ifdef SW_HAVE_ZLIB
+    if (compressed)
+    {
+        swString *buffer = swReactorThread_websocket_inflate(conn, payload, length);
+        if (buffer == NULL)
+        {
+            buffer = swReactorThread_inflate.buffer;
+            return swReactorThread_websocket_close(conn, (buffer && buffer->size >= SwooleG.serv->protocol.package_max_length) ?
+                    WEBSOCKET_CLOSE_MESSAGE_TOO_BIG : WEBSOCKET_CLOSE_MESSAGE_ERROR);
+        }
+        payload = buffer->str + SW_WEBSOCKET_HEADER_LEN;
+        length = buffer->length - SW_WEBSOCKET_HEADER_LEN;
+    }
+#endif
+    if (opcode == WEBSOCKET_OPCODE_TEXT_FRAME && swWebSocket_check_utf8(payload, length) < 0)
+    {
+        swWarn("invalid utf-8 text message, remote_addr=%s:%d.", swConnection_get_ip(conn), swConnection_get_port(conn));
+        return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_MESSAGE_ERROR);
+    }
+    payload -= SW_WEBSOCKET_HEADER_LEN;
+    payload[0] = 1;
+    payload[1] = opcode;
+    return swReactorThread_dispatch_string_buffer(conn, payload, length + SW_WEBSOCKET_HEADER_LEN);
+}
+
+/**
+ * the fragments are reassembled up to package_max_length and the control frames never reach the workers
+ */
 static int swReactorThread_websocket_onPackage(swConnection *conn, char *data, uint32_t length)
 {
+    swServer *serv = SwooleG.serv;
     swString frame;
     bzero(&frame, sizeof(frame));
     frame.str = data;
     frame.length = length;
 
-    swString send_frame;
-    bzero(&send_frame, sizeof(send_frame));
-    char buf[32];
-    send_frame.str = buf;
-    send_frame.size = sizeof(buf);
-
     swWebSocket_frame ws;
     swWebSocket_decode(&ws, &frame);
 
-    size_t offset;
+    swString *message = conn->websocket_message;
+    int compressed = ws.header.RSV1;
+    int ret;
+
+    //the frames of the client must be masked, RSV1 is only valid on the first frame of the compressed message
+    if (!ws.header.MASK || ws.header.RSV2 || ws.header.RSV3
+            || (ws.header.RSV1 && (!(conn->websocket_compression & SW_WEBSOCKET_DEFLATE)
+                    || (ws.header.OPCODE != WEBSOCKET_OPCODE_TEXT_FRAME && ws.header.OPCODE != WEBSOCKET_OPCODE_BINARY_FRAME))))
+    {
+        swWarn("invalid frame, opcode=%d, MASK=%d, RSV1=%d.", ws.header.OPCODE, ws.header.MASK, ws.header.RSV1);
+        return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+    }
+    //the control frames can be injected in the middle of the fragmented message
+    if (ws.header.OPCODE >= WEBSOCKET_OPCODE_CONNECTION_CLOSE && (!ws.header.FIN || ws.payload_length > 0x7d))
+    {
+        return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+    }
+
     switch (ws.header.OPCODE)
     {
-    case WEBSOCKET_OPCODE_CONTINUATION_FRAME:
     case WEBSOCKET_OPCODE_TEXT_FRAME:
     case WEBSOCKET_OPCODE_BINARY_FRAME:
-        offset = length - ws.payload_length;
-        data[offset] = ws.header.FIN;
-        data[offset + 1] = ws.header.OPCODE;
-        swReactorThread_dispatch_string_buffer(conn, data + offset, length - offset);
-        break;
+        if (message)
+        {
+            return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+        }
+        if (ws.header.FIN)
+        {
+            return swReactorThread_websocket_dispatch(conn, ws.header.OPCODE, compressed, ws.payload, ws.payload_length);
+        }
+        message = swString_new(SW_BUFFER_SIZE_BIG < ws.payload_length * 2 ? ws.payload_length * 2 : SW_BUFFER_SIZE_BIG);
+        if (message == NULL)
+        {
+            return SW_ERR;
+        }
+        //[FIN][OPCODE][payload]
+        message->str[1] = ws.header.OPCODE;
+        message->length = SW_WEBSOCKET_HEADER_LEN;
+        conn->websocket_message = message;
+        if (compressed)
+        {
+            conn->websocket_compression |= SW_WEBSOCKET_INFLATING;
+        }
+        return swString_append_ptr(message, ws.payload, ws.payload_length);
 
-    case WEBSOCKET_OPCODE_PING:
-        if (length == 2)
+    case WEBSOCKET_OPCODE_CONTINUATION_FRAME:
+        if (message == NULL)
+        {
+            return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+        }
+        if (message->length + ws.payload_length > serv->protocol.package_max_length)
+        {
+            swWarn("the message is bigger than %d, remote_addr=%s:%d.", serv->protocol.package_max_length,
+                    swConnection_get_ip(conn), swConnection_get_port(conn));
+            return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_MESSAGE_TOO_BIG);
+        }
+        if (swString_append_ptr(message, ws.payload, ws.payload_length) < 0)
         {
             return SW_ERR;
         }
-        swWebSocket_encode(&send_frame, data += 2, length - 2, WEBSOCKET_OPCODE_PONG, 1, 0);
-        swConnection_send(conn, send_frame.str, send_frame.length, 0);
-        break;
+        if (!ws.header.FIN)
+        {
+            return SW_OK;
+        }
+        compressed = (conn->websocket_compression & SW_WEBSOCKET_INFLATING) ? 1 : 0;
+        ret = swReactorThread_websocket_dispatch(conn, message->str[1], compressed,
+                message->str + SW_WEBSOCKET_HEADER_LEN, message->length - SW_WEBSOCKET_HEADER_LEN);
+        swReactorThread_websocket_free(conn);
+        return ret;
 
+    case WEBSOCKET_OPCODE_PING:
+        swReactorThread_websocket_reply(conn, WEBSOCKET_OPCODE_PONG, ws.payload, ws.payload_length);
+        return SW_OK;
+
+    //unsolicited pong is the heartbeat of the client
     case WEBSOCKET_OPCODE_PONG:
-        return SW_ERR;
+        return SW_OK;
 
     case WEBSOCKET_OPCODE_CONNECTION_CLOSE:
-        if (0x7d < (length - 2))
+        return swReactorThread_websocket_close(conn, swWebSocket_get_close_code(ws.payload, ws.payload_length));
+
+    default:
+        return swReactorThread_websocket_close(conn, WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+    }
+}
+
+#ifdef SW_HAVE_ZLIB
+static z_stream* swReactorThread_inflate_get(swConnection *conn)
+{
+    z_stream *stream = conn->websocket_inflate;
+    int window_bits = conn->websocket_client_window_bits ? conn->websocket_client_window_bits : 15;
+
+    if (stream)
+    {
+        return stream;
+    }
+    if (swReactorThread_inflate.pool_num > 0)
+    {
+        stream = swReactorThread_inflate.pool[--swReactorThread_inflate.pool_num];
+        if (inflateReset2(stream, -window_bits) != Z_OK)
         {
-            return SW_ERR;
+            inflateEnd(stream);
+            sw_free(stream);
+            return NULL;
         }
-        send_frame.str[0] = 0x88;
-        send_frame.str[1] = 0x00;
-        send_frame.length = 2;
-        swConnection_send(conn, send_frame.str, 2, 0);
-        return SW_ERR;
     }
-    return SW_OK;
+    else
+    {
+        stream = sw_malloc(sizeof(z_stream));
+        if (stream == NULL)
+        {
+            swWarn("malloc(%ld) failed.", sizeof(z_stream));
+            return NULL;
+        }
+        bzero(stream, sizeof(z_stream));
+        //raw deflate
+        if (inflateInit2(stream, -window_bits) != Z_OK)
+        {
+            swWarn("inflateInit2() failed.");
+            sw_free(stream);
+            return NULL;
+        }
+    }
+    conn->websocket_inflate = stream;
+    return stream;
+}
+
+static void swReactorThread_inflate_release(swConnection *conn)
+{
+    z_stream *stream = conn->websocket_inflate;
+    if (stream == NULL)
+    {
+        return;
+    }
+    conn->websocket_inflate = NULL;
+
+    if (swReactorThread_inflate.pool_num < SW_WEBSOCKET_INFLATE_POOL_SIZE)
+    {
+        swReactorThread_inflate.pool[swReactorThread_inflate.pool_num++] = stream;
+    }
+    else
+    {
+        inflateEnd(stream);
+        sw_free(stream);
+    }
+}
+
+/**
+ * inflate the reassembled message, [FIN][OPCODE] is reserved at the head of the buffer
+ */
+static swString* swReactorThread_websocket_inflate(swConnection *conn, char *data, size_t length)
+{
+    swServer *serv = SwooleG.serv;
+    z_stream *stream = swReactorThread_inflate_get(conn);
+    if (stream == NULL)
+    {
+        return NULL;
+    }
+    swString *buffer = swReactorThread_inflate.buffer;
+    if (buffer == NULL)
+    {
+        buffer = swString_new(SW_BUFFER_SIZE_BIG);
+        if (buffer == NULL)
+        {
+            return NULL;
+        }
+        swReactorThread_inflate.buffer = buffer;
+    }
+
+    buffer->length = SW_WEBSOCKET_HEADER_LEN;
+    if (swWebSocket_inflate(stream, data, length, 1, buffer, serv->protocol.package_max_length) < 0)
+    {
+        return NULL;
+    }
+    if (conn->websocket_compression & SW_WEBSOCKET_CLIENT_NO_CONTEXT_TAKEOVER)
+    {
+        swReactorThread_inflate_release(conn);
+    }
+    return buffer;
 }
+#endif
 
 static int swReactorThread_onReceive_buffer_check_length(swReactor *reactor, swEvent *event)
 {
@@ -1088,6 +1619,85 @@ static int swReactorThread_onReceive_buffer_check_length(swReactor *reactor, swE
     return SW_OK;
 }
 
+/**
+ * send the data to the worker in SW_BUFFER_SIZE chunks, the last one is last_type
+ */
+static int swReactorThread_dispatch_stream(swConnection *conn, uint16_t worker_id, uint8_t type, uint8_t last_type,
+        char *data, uint32_t length)
+{
+    swFactory *factory = SwooleG.factory;
+    swDispatchData task;
+    uint32_t offset = 0;
+
+    task.data.info.from_id = conn->from_id;
+    task.target_worker_id = worker_id;
+
+    do
+    {
+        task.data.info.len = length - offset > SW_BUFFER_SIZE ? SW_BUFFER_SIZE : length - offset;
+        task.data.info.type = offset + task.data.info.len == length ? last_type : type;
+        task.data.info.fd = conn->fd;
+        memcpy(task.data.data, data + offset, task.data.info.len);
+        if (factory->dispatch(factory, &task) < 0)
+        {
+            return SW_ERR;
+        }
+        offset += task.data.info.len;
+    } while (offset < length);
+
+    return SW_OK;
+}
+
+/**
+ * the body of the streaming request, the request is finished when content_length bytes are sent
+ */
+static int swReactorThread_dispatch_http_body(swConnection *conn, swHttpRequest *request, char *data, uint32_t length)
+{
+    request->stream_length += length;
+    if (request->stream_length == request->content_length)
+    {
+        return swReactorThread_dispatch_stream(conn, request->stream_worker_id, SW_EVENT_HTTP_BODY,
+                SW_EVENT_HTTP_BODY_END, data, length);
+    }
+    else if (length > 0)
+    {
+        return swReactorThread_dispatch_stream(conn, request->stream_worker_id, SW_EVENT_HTTP_BODY,
+                SW_EVENT_HTTP_BODY, data, length);
+    }
+    return SW_OK;
+}
+
+/**
+ * the head is sent first, then the body in chunks as it comes.
+ * The worker pipe pauses the connection when the worker falls behind, the reactor only holds the head buffer.
+ */
+static int swReactorThread_http_stream_start(swServer *serv, swConnection *conn, swHttpRequest *request)
+{
+    swString *buffer = request->buffer;
+    char body[SW_HTTP_HEADER_MAX_SIZE];
+    uint32_t body_length = buffer->length - request->header_length;
+
+    if (body_length > request->content_length)
+    {
+        body_length = request->content_length;
+    }
+    memcpy(body, buffer->str + request->header_length, body_length);
+
+    request->stream = 1;
+    request->stream_worker_id = swServer_worker_schedule(serv, conn->fd);
+    request->index.flags |= SW_HTTP_INDEX_STREAM;
+
+    buffer->length = request->header_length;
+    if (swHttpRequest_append_index(request) < 0
+            || swReactorThread_dispatch_stream(conn, request->stream_worker_id, SW_EVENT_PACKAGE_START,
+                    SW_EVENT_PACKAGE_END, buffer->str, buffer->length) < 0)
+    {
+        return SW_ERR;
+    }
+    swString_clear(buffer);
+    return swReactorThread_dispatch_http_body(conn, request, body, body_length);
+}
+
 /**
  * For Http Protocol
  */
@@ -1152,6 +1762,12 @@ static int swReactorThread_onReceive_http_request(swReactor *reactor, swEvent *e
     buf = buffer->str + buffer->length;
     buf_len = buffer->size - buffer->length;
 
+    //the next request is left in the socket
+    if (request->stream && buf_len > request->content_length - request->stream_length)
+    {
+        buf_len = request->content_length - request->stream_length;
+    }
+
     n = swConnection_recv(conn, buf, buf_len, 0);
     if (n < 0)
     {
@@ -1178,160 +1794,130 @@ static int swReactorThread_onReceive_http_request(swReactor *reactor, swEvent *e
         conn->last_time = SwooleGS->now;
         buffer->length += n;
 
-        if (request->method == 0 && swHttpRequest_get_protocol(request) < 0)
+        if (request->stream)
         {
-            if (request->buffer->length < SW_HTTP_HEADER_MAX_SIZE)
+            if (swReactorThread_dispatch_http_body(conn, request, buffer->str, buffer->length) < 0)
             {
-                return SW_OK;
+                goto close_fd;
             }
+            swString_clear(buffer);
+            if (request->stream_length == request->content_length)
+            {
+                swHttpRequest_free(conn);
+            }
+            //read again in the next event, the connection may be paused
+            return SW_OK;
+        }
 
-            swWarn("get protocol failed.");
-#ifdef SW_HTTP_BAD_REQUEST
-            if (swConnection_send(conn, SW_STRL(SW_HTTP_BAD_REQUEST) - 1, 0) < 0)
+        //the head is parsed once, the index is sent to the worker with the request
+        if (request->header_length == 0)
+        {
+            int ret = swHttpRequest_parse(request);
+            if (ret == SW_WAIT)
             {
-                swSysError("send() failed.");
+                if (buffer->size == buffer->length)
+                {
+                    swWarn("http header is too long.");
+                    goto close_fd;
+                }
+                goto recv_data;
             }
+            else if (ret < 0)
+            {
+                swWarn("bad request.");
+#ifdef SW_HTTP_BAD_REQUEST
+                if (swConnection_send(conn, SW_STRL(SW_HTTP_BAD_REQUEST) - 1, 0) < 0)
+                {
+                    swSysError("send() failed.");
+                }
 #endif
-            goto close_fd;
-        }
+                goto close_fd;
+            }
 
-        swTrace("request->method=%d", request->method);
+            swTrace("request->method=%d", request->method);
 
-        //DELETE
-        if (request->method == HTTP_DELETE)
-        {
-            if (request->content_length == 0 && swHttpRequest_have_content_length(request) == SW_FALSE)
+            if (request->index.flags & SW_HTTP_INDEX_CHUNKED)
             {
-                goto http_no_entity;
+                swWarn("chunked request body is not supported.");
+                goto close_fd;
             }
-            else
+            else if (request->content_length > protocol->package_max_length)
             {
-                goto http_entity;
+                swWarn("content-length more than the package_max_length[%d].", protocol->package_max_length);
+                goto close_fd;
             }
         }
-        //GET HEAD OPTIONS
-        else if (request->method == HTTP_GET || request->method == HTTP_HEAD || request->method == HTTP_OPTIONS)
+
+        uint32_t request_size = request->content_length + request->header_length;
+        //the index is appended behind the request
+        uint32_t index_size = sizeof(swHttpIndex) + sizeof(swHttpIndex_trailer);
+
+        if (serv->http_body_stream && request->content_length > 0 && request_size + index_size > buffer->size)
         {
-            http_no_entity:
-            if (memcmp(buffer->str + buffer->length - 4, "\r\n\r\n", 4) == 0)
+            if (swReactorThread_http_stream_start(serv, conn, request) < 0)
             {
-                swReactorThread_dispatch_string_buffer(conn, buffer->str, buffer->length);
-                swHttpRequest_free(conn);
-            }
-            else if (buffer->size == buffer->length)
-            {
-                swWarn("http header is too long.");
                 goto close_fd;
             }
-            //wait more data
-            else
+            if (request->stream_length == request->content_length)
             {
-                goto recv_data;
+                swHttpRequest_free(conn);
             }
+            return SW_OK;
         }
-        //POST PUT HTTP_PATCH
-        else if (request->method == HTTP_POST || request->method == HTTP_PUT || request->method == HTTP_PATCH)
+
+        if (request_size + index_size > buffer->size && swString_extend(buffer, request_size + index_size) < 0)
         {
-            http_entity:
-            if (request->content_length == 0)
+            goto close_fd;
+        }
+
+        //discard the redundant data
+        if (buffer->length > request_size)
+        {
+            buffer->length = request_size;
+        }
+
+        if (buffer->length == request_size)
+        {
+            swHttpRequest_append_index(request);
+            swReactorThread_dispatch_string_buffer(conn, buffer->str, buffer->length);
+            swHttpRequest_free(conn);
+        }
+        else
+        {
+#ifdef SW_HTTP_100_CONTINUE
+            //Expect: 100-continue
+            if ((request->index.flags & SW_HTTP_INDEX_EXPECT) && !request->expect_sent)
             {
-                if (swHttpRequest_get_content_length(request) < 0)
+                swSendData _send;
+                _send.data = "HTTP/1.1 100 Continue\r\n\r\n";
+                _send.length = strlen(_send.data);
+                request->expect_sent = 1;
+
+                int send_times = 0;
+                direct_send:
+                n = swConnection_send(conn, _send.data, _send.length, 0);
+                if (n < _send.length)
                 {
-                    if (buffer->size == buffer->length)
+                    _send.data += n;
+                    _send.length -= n;
+                    send_times++;
+                    if (send_times < 10)
                     {
-                        swWarn("http header is too long.");
-                        goto close_fd;
+                        goto direct_send;
                     }
                     else
                     {
-                        goto recv_data;
+                        swWarn("send http header failed");
                     }
                 }
-                else if (request->content_length > protocol->package_max_length)
-                {
-                    swWarn("content-length more than the package_max_length[%d].", protocol->package_max_length);
-                    goto close_fd;
-                }
-            }
-
-            uint32_t request_size = 0;
-
-            //http header is not the end
-            if (request->header_length == 0)
-            {
-                if (buffer->size == buffer->length)
-                {
-                    swWarn("http header is too long.");
-                    goto close_fd;
-                }
-                if (swHttpRequest_get_header_length(request) < 0)
-                {
-                    goto recv_data;
-                }
-                request_size = request->content_length + request->header_length;
             }
             else
             {
-                request_size = request->content_length + request->header_length;
+                swTrace("PostWait: request->content_length=%d, buffer->length=%zd, request->header_length=%d\n",
+                        request->content_length, buffer->length, request->header_length);
             }
-
-            if (request_size > buffer->size && swString_extend(buffer, request_size) < 0)
-            {
-                goto close_fd;
-            }
-
-            //discard the redundant data
-            if (buffer->length > request_size)
-            {
-                buffer->length = request_size;
-            }
-
-            if (buffer->length == request_size)
-            {
-                swReactorThread_dispatch_string_buffer(conn, buffer->str, buffer->length);
-                swHttpRequest_free(conn);
-            }
-            else
-            {
-#ifdef SW_HTTP_100_CONTINUE
-                //Expect: 100-continue
-                if (swHttpRequest_has_expect_header(request))
-                {
-                    swSendData _send;
-                    _send.data = "HTTP/1.1 100 Continue\r\n\r\n";
-                    _send.length = strlen(_send.data);
-
-                    int send_times = 0;
-                    direct_send:
-                    n = swConnection_send(conn, _send.data, _send.length, 0);
-                    if (n < _send.length)
-                    {
-                        _send.data += n;
-                        _send.length -= n;
-                        send_times++;
-                        if (send_times < 10)
-                        {
-                            goto direct_send;
-                        }
-                        else
-                        {
-                            swWarn("send http header failed");
-                        }
-                    }
-                }
-                else
-                {
-                    swTrace("PostWait: request->content_length=%d, buffer->length=%zd, request->header_length=%d\n",
-                            request->content_length, buffer->length, request->header_length);
-                }
 #endif
-                goto recv_data;
-            }
-        }
-        else
-        {
-            swWarn("method no support");
-            goto close_fd;
+            goto recv_data;
         }
     }
     return SW_OK;
@@ -1531,8 +2117,8 @@ static int swReactorThread_loop_stream(swThreadParam *param)
     reactor->socket_list = serv->connection_list;
     reactor->max_socket = serv->max_connection;
 
-    reactor->onFinish = NULL;
-    reactor->onTimeout = NULL;
+    reactor->onFinish = swReactorThread_resume;
+    reactor->onTimeout = swReactorThread_resume;
     reactor->close = swReactorThread_close;
 
     reactor->setHandle(reactor, SW_FD_CLOSE, swReactorThread_onClose);
@@ -1599,6 +2185,25 @@ static int swReactorThread_loop_stream(swThreadParam *param)
 #endif
             }
         }
+
+        thread->pause_list = sw_calloc(serv->worker_num, sizeof(swLinkedList *));
+        if (thread->pause_list == NULL)
+        {
+            swSysError("thread->pause_list create failed");
+            return SW_ERR;
+        }
+
+        if (serv->ipc_mode == SW_IPC_CHANNEL)
+        {
+            thread->channel_buffer = sw_calloc(serv->worker_num, sizeof(swBuffer *));
+            if (thread->channel_buffer == NULL)
+            {
+                swSysError("thread->channel_buffer create failed");
+                return SW_ERR;
+            }
+            reactor->add(reactor, serv->reactor_notify[reactor_id].pipe.getFd(&serv->reactor_notify[reactor_id].pipe, 0), SW_FD_CHANNEL);
+            reactor->setHandle(reactor, SW_FD_CHANNEL, swReactorThread_onChannelNotify);
+        }
     }
 
     //wait other thread
@@ -1621,35 +2226,40 @@ static int swUDPThread_start(swServer *serv)
     pthread_t thread_id;
     swListenPort *ls;
     int index = serv->reactor_num;
+    int i, sock;
 
     LL_FOREACH(serv->listen_list, ls)
     {
-        param = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swThreadParam));
-
         if (ls->type == SW_SOCK_UDP || ls->type == SW_SOCK_UDP6 || ls->type == SW_SOCK_UNIX_DGRAM)
         {
-            if (ls->type == SW_SOCK_UDP)
+            for (i = 0; i < serv->dgram_thread_num; i++)
             {
-                serv->connection_list[ls->sock].info.addr.inet_v4.sin_port = htons(ls->port);
-            }
-            else
-            {
-                serv->connection_list[ls->sock].info.addr.inet_v6.sin6_port = htons(ls->port);
-            }
+                param = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(swThreadParam));
+                sock = ls->socks[i];
+
+                if (ls->type == SW_SOCK_UDP)
+                {
+                    serv->connection_list[sock].info.addr.inet_v4.sin_port = htons(ls->port);
+                }
+                else
+                {
+                    serv->connection_list[sock].info.addr.inet_v6.sin6_port = htons(ls->port);
+                }
 
-            serv->connection_list[ls->sock].fd = ls->sock;
-            serv->connection_list[ls->sock].socket_type = ls->type;
-            serv->connection_list[ls->sock].object = ls;
+                serv->connection_list[sock].fd = sock;
+                serv->connection_list[sock].socket_type = ls->type;
+                serv->connection_list[sock].object = ls;
 
-            param->object = ls;
-            param->pti = index++;
+                param->object = &ls->socks[i];
+                param->pti = index++;
 
-            if (pthread_create(&thread_id, NULL, (void * (*)(void *)) swReactorThread_loop_dgram, (void *) param) < 0)
-            {
-                swWarn("pthread_create[udp_listener] fail");
-                return SW_ERR;
+                if (pthread_create(&thread_id, NULL, (void * (*)(void *)) swReactorThread_loop_dgram, (void *) param) < 0)
+                {
+                    swWarn("pthread_create[udp_listener] fail");
+                    return SW_ERR;
+                }
+                ls->threads[i] = thread_id;
             }
-            ls->thread_id = thread_id;
         }
     }
     return SW_OK;
@@ -1661,9 +2271,7 @@ static int swUDPThread_start(swServer *serv)
 static int swReactorThread_loop_dgram(swThreadParam *param)
 {
     swEvent event;
-    swListenPort *ls = param->object;
-
-    int fd = ls->sock;
+    int fd = *(int *) param->object;
 
     SwooleTG.factory_lock_target = 0;
     SwooleTG.factory_target_worker = -1;
@@ -1676,6 +2284,17 @@ static int swReactorThread_loop_dgram(swThreadParam *param)
     swSetBlock(fd);
     event.fd = fd;
 
+#ifdef HAVE_MMSG
+    swServer *serv = SwooleG.serv;
+    if (serv->dgram_batch > 1 && serv->factory_mode == SW_MODE_PROCESS
+            && serv->connection_list[fd].socket_type != SW_SOCK_UNIX_DGRAM)
+    {
+        swReactorThread_loop_dgram_batch(serv, fd);
+        pthread_exit(0);
+        return 0;
+    }
+#endif
+
     while (SwooleG.running == 1)
     {
         swReactorThread_onPackage(NULL, &event);
@@ -1769,6 +2388,56 @@ static int swReactorThread_dispatch_string_buffer(swConnection *conn, char *data
     return SW_OK;
 }
 
+#ifndef SW_USE_RINGBUFFER
+/**
+ * [uint32_t length][data] entries aligned to 4 bytes, the big package is sent in chunks
+ */
+static int swReactorThread_dispatch_string_batch(swConnection *conn, char *data, uint32_t *lengths, int n)
+{
+    swFactory *factory = SwooleG.factory;
+    swDispatchData task;
+    uint32_t size;
+    int i;
+
+    task.data.info.type = SW_EVENT_PACKAGE_BATCH;
+    task.data.info.from_id = conn->from_id;
+    task.data.info.len = 0;
+    task.target_worker_id = -1;
+
+    for (i = 0; i < n; i++)
+    {
+        size = swPackage_batch_size(lengths[i]);
+        //the batched packages must be sent before the next one, the worker is the same
+        if (task.data.info.len > 0 && (size > SW_BUFFER_SIZE || task.data.info.len + size > SW_BUFFER_SIZE))
+        {
+            task.data.info.fd = conn->fd;
+            if (factory->dispatch(factory, &task) < 0)
+            {
+                return SW_ERR;
+            }
+            task.data.info.len = 0;
+        }
+        if (size > SW_BUFFER_SIZE)
+        {
+            swReactorThread_dispatch_string_buffer(conn, data, lengths[i]);
+        }
+        else
+        {
+            memcpy(task.data.data + task.data.info.len, &lengths[i], sizeof(uint32_t));
+            memcpy(task.data.data + task.data.info.len + sizeof(uint32_t), data, lengths[i]);
+            task.data.info.len += size;
+        }
+        data += lengths[i];
+    }
+    if (task.data.info.len > 0)
+    {
+        task.data.info.fd = conn->fd;
+        return factory->dispatch(factory, &task);
+    }
+    return SW_OK;
+}
+#endif
+
 #if 0
 int swReactorThread_dispatch_array_buffer(swReactorThread *thread, swConnection *conn)
 {
@@ -1882,6 +2551,38 @@ void swReactorThread_free(swServer *serv)
 #ifdef SW_USE_RINGBUFFER
             thread->buffer_input->destroy(thread->buffer_input);
 #endif
+            if (thread->channel_buffer)
+            {
+                int j;
+                for (j = 0; j < serv->worker_num; j++)
+                {
+                    if (thread->channel_buffer[j])
+                    {
+                        swBuffer_free(thread->channel_buffer[j]);
+                    }
+                }
+                sw_free(thread->channel_buffer);
+            }
+            if (thread->pause_list)
+            {
+                int j;
+                for (j = 0; j < serv->worker_num; j++)
+                {
+                    if (thread->pause_list[j] == NULL)
+                    {
+                        continue;
+                    }
+                    else if (thread->pause_list[j]->num > 0)
+                    {
+                        swLinkedList_free(thread->pause_list[j], NULL);
+                    }
+                    else
+                    {
+                        sw_free(thread->pause_list[j]);
+                    }
+                }
+                sw_free(thread->pause_list);
+            }
         }
     }
 
@@ -1892,10 +2593,13 @@ void swReactorThread_free(swServer *serv)
         {
             if (ls->type == SW_SOCK_UDP || ls->type == SW_SOCK_UDP6 || ls->type == SW_SOCK_UNIX_DGRAM)
             {
-                pthread_cancel(ls->thread_id);
-                if (pthread_join(ls->thread_id, NULL))
+                for (i = 0; i < serv->dgram_thread_num; i++)
                 {
-                    swWarn("pthread_join() failed. Error: %s[%d]", strerror(errno), errno);
+                    pthread_cancel(ls->threads[i]);
+                    if (pthread_join(ls->threads[i], NULL))
+                    {
+                        swWarn("pthread_join() failed. Error: %s[%d]", strerror(errno), errno);
+                    }
                 }
             }
         }
@@ -423,7 +423,7 @@ int swServer_worker_init(swServer *serv, swWorker *worker)
     }
     else
     {
-        buffer_num = serv->reactor_num + serv->dgram_port_num;
+        buffer_num = serv->reactor_num + serv->dgram_port_num * serv->dgram_thread_num;
     }
 
     SwooleWG.buffer_input = sw_malloc(sizeof(swString*) * buffer_num);
@@ -597,6 +597,12 @@ int swServer_start(swServer *serv)
         }
     }
 
+    //the workers reply from the dgram sockets, create them before fork
+    if (serv->have_udp_sock == 1 && serv->factory_mode != SW_MODE_SINGLE && swServer_dgram_listen(serv) < 0)
+    {
+        return SW_ERR;
+    }
+
     //factory start
     if (factory->start(factory) < 0)
     {
@@ -644,12 +650,18 @@ void swServer_init(swServer *serv)
 
     serv->worker_num = SW_CPU_NUM;
     serv->max_connection = SwooleG.max_sockets;
+    serv->dgram_thread_num = 1;
 
     serv->max_request = 0;
 
     serv->open_tcp_nopush = 1;
     serv->http_parse_post = 1;
 
+    serv->websocket_compression_level = SW_WEBSOCKET_COMPRESSION_LEVEL;
+    serv->websocket_compression_threshold = SW_WEBSOCKET_COMPRESSION_THRESHOLD;
+    serv->websocket_client_max_window_bits = 15;
+    serv->websocket_server_max_window_bits = 15;
+
     //tcp keepalive
     serv->tcp_keepcount = SW_TCP_KEEPCOUNT;
     serv->tcp_keepinterval = SW_TCP_KEEPINTERVAL;
@@ -671,6 +683,7 @@ void swServer_init(swServer *serv)
     serv->buffer_output_size = SW_BUFFER_OUTPUT_SIZE;
 
     serv->pipe_buffer_size = SW_PIPE_BUFFER_SIZE;
+    serv->ipc_mode = SW_IPC_UNSOCK;
 
     memcpy(serv->protocol.package_eof, eof, serv->protocol.package_eof_len);
 }
@@ -763,6 +776,7 @@ int swServer_free(swServer *serv)
          * Wait until all the end of the thread
          */
         swReactorThread_free(serv);
+        swIPCChannel_free(serv);
     }
 
     //reactor free
@@ -889,7 +903,7 @@ int swServer_tcp_send(swServer *serv, int fd, void *data, uint32_t length)
     return SW_OK;
 }
 
-int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len)
+int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len, off_t offset, size_t length)
 {
 #ifdef SW_USE_OPENSSL
     swConnection *conn = swServer_connection_verify(serv, fd);
@@ -901,13 +915,13 @@ int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len)
 #endif
 
     swSendData send_data;
-    send_data.info.len = len;
     char buffer[SW_BUFFER_SIZE];
+    swSendFile_request *req = (swSendFile_request *) buffer;
 
     //file name size
-    if (send_data.info.len > SW_BUFFER_SIZE - 1)
+    if (len > SW_BUFFER_SIZE - sizeof(swSendFile_request) - 1)
     {
-        swWarn("sendfile name too long. [MAX_LENGTH=%d]", (int) SW_BUFFER_SIZE - 1);
+        swWarn("sendfile name too long. [MAX_LENGTH=%d]", (int) (SW_BUFFER_SIZE - sizeof(swSendFile_request) - 1));
         return SW_ERR;
     }
 
@@ -920,9 +934,11 @@ int swServer_tcp_sendfile(swServer *serv, int fd, char *filename, uint32_t len)
 
     send_data.info.fd = fd;
     send_data.info.type = SW_EVENT_SENDFILE;
-    memcpy(buffer, filename, send_data.info.len);
-    buffer[send_data.info.len] = 0;
-    send_data.info.len++;
+    req->offset = offset;
+    req->length = length;
+    memcpy(req->filename, filename, len);
+    req->filename[len] = 0;
+    send_data.info.len = sizeof(swSendFile_request) + len + 1;
     send_data.length = 0;
     send_data.data = buffer;
 
@@ -1053,6 +1069,57 @@ int swServer_add_listener(swServer *serv, int type, char *host, int port)
     return SW_OK;
 }
 
+/**
+ * create the sockets of the dgram threads, the udp threads bind the port again with SO_REUSEPORT
+ * and the kernel spreads the packets by the source address. Without SO_REUSEPORT they share the socket.
+ */
+int swServer_dgram_listen(swServer *serv)
+{
+    swListenPort *ls;
+    int i;
+#ifdef HAVE_REUSEPORT
+    int sock;
+    int bufsize = SwooleG.socket_buffer_size;
+#endif
+
+    LL_FOREACH(serv->listen_list, ls)
+    {
+        if (!swSocket_is_dgram(ls->type))
+        {
+            continue;
+        }
+        ls->socks = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(int) * serv->dgram_thread_num);
+        ls->threads = SwooleG.memory_pool->alloc(SwooleG.memory_pool, sizeof(pthread_t) * serv->dgram_thread_num);
+        if (ls->socks == NULL || ls->threads == NULL)
+        {
+            swWarn("malloc for the dgram threads failed.");
+            return SW_ERR;
+        }
+        ls->socks[0] = ls->sock;
+
+        for (i = 1; i < serv->dgram_thread_num; i++)
+        {
+            ls->socks[i] = ls->sock;
+#ifdef HAVE_REUSEPORT
+            if (ls->type == SW_SOCK_UNIX_DGRAM || !SwooleG.reuse_port)
+            {
+                continue;
+            }
+            sock = swSocket_listen(ls->type, ls->host, ls->port, serv->backlog);
+            if (sock < 0)
+            {
+                swWarn("bind %s:%d with SO_REUSEPORT failed, the dgram threads share the socket.", ls->host, ls->port);
+                continue;
+            }
+            setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+            setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+            ls->socks[i] = sock;
+#endif
+        }
+    }
+    return SW_OK;
+}
+
 /**
  * listen the TCP server socket
  */
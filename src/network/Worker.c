@@ -21,13 +21,47 @@
 #include <grp.h>
 
 static int swWorker_onPipeReceive(swReactor *reactor, swEvent *event);
+static int swWorker_onChannelNotify(swReactor *reactor, swEvent *event);
+
+/**
+ * SW_IPC_CHANNEL: the responses which can not be put into the full rings, one for each reactor thread
+ */
+static swBuffer **swWorker_channel_buffer = NULL;
+
+#ifdef HAVE_MMSG
+/**
+ * the replies sent while handling a dgram batch, flushed with sendmmsg
+ */
+typedef struct
+{
+    int sock;
+    uint16_t num;
+    uint32_t length;
+    struct mmsghdr msgs[SW_DGRAM_BATCH_MAX];
+    struct iovec iov[SW_DGRAM_BATCH_MAX];
+    swSocketAddress addrs[SW_DGRAM_BATCH_MAX];
+    char buffer[SW_DGRAM_QUEUE_SIZE];
+} swWorker_sendto_queue;
+
+static swWorker_sendto_queue *swWorker_dgram_queue = NULL;
+static uint8_t swWorker_dgram_batching = 0;
+#endif
 
 int swWorker_create(swWorker *worker)
 {
     /**
      * Create shared memory storage
      */
-    worker->send_shm = sw_shm_malloc(SwooleG.serv->buffer_output_size);
+    worker->send_shm = NULL;
+    if (SwooleG.slab_pool)
+    {
+        worker->send_shm = SwooleG.slab_pool->alloc(SwooleG.slab_pool, SwooleG.serv->buffer_output_size);
+    }
+    //the slab pool is full
+    if (worker->send_shm == NULL)
+    {
+        worker->send_shm = sw_shm_malloc(SwooleG.serv->buffer_output_size);
+    }
     if (worker->send_shm == NULL)
     {
         swWarn("malloc for worker->store failed.");
@@ -40,10 +74,19 @@ int swWorker_create(swWorker *worker)
 
 void swWorker_free(swWorker *worker)
 {
-    if (worker->send_shm)
+    if (worker->send_shm == NULL)
+    {
+        return;
+    }
+    if (SwooleG.slab_pool && swSlabPool_contains(SwooleG.slab_pool, worker->send_shm))
+    {
+        SwooleG.slab_pool->free(SwooleG.slab_pool, worker->send_shm);
+    }
+    else
     {
         sw_shm_free(worker->send_shm);
     }
+    worker->send_shm = NULL;
 }
 
 void swWorker_signal_init(void)
@@ -132,6 +175,152 @@ static sw_inline int swWorker_discard_data(swServer *serv, swEventData *task)
     return SW_TRUE;
 }
 
+/**
+ * the packets are handled one by one as the single packet events
+ */
+static void swWorker_onDgramBatch(swServer *serv, swEventData *task)
+{
+    swString *package = swWorker_get_buffer(serv, task->info.from_id);
+    swDgramPacket *packet;
+    uint32_t offset = 0;
+
+    task->info.type = task->info.fd;
+#ifdef HAVE_MMSG
+    swWorker_dgram_batching = 1;
+#endif
+    while (offset < task->info.len)
+    {
+        packet = (swDgramPacket *) (task->data + offset);
+        swString_clear(package);
+        swString_append_ptr(package, (char *) packet, sizeof(swDgramPacket) + packet->length);
+
+        SwooleWG.request_count++;
+        sw_atomic_fetch_add(&SwooleStats->request_count, 1);
+        serv->onPacket(serv, task);
+        offset += swDgramPacket_size(packet->length);
+    }
+    swString_clear(package);
+#ifdef HAVE_MMSG
+    swWorker_dgram_batching = 0;
+#endif
+    swWorker_sendto_flush();
+    task->info.type = SW_EVENT_DGRAM_BATCH;
+}
+
+/**
+ * the complete packages of one connection, received by the reactor thread in one read
+ */
+static void swWorker_onPackageBatch(swServer *serv, swEventData *task)
+{
+    swString *package = swWorker_get_buffer(serv, task->info.from_id);
+    uint32_t offset = 0;
+    uint32_t length;
+
+    task->info.type = SW_EVENT_PACKAGE_END;
+    while (offset < task->info.len)
+    {
+        //the connection may be closed in onReceive
+        if (swWorker_discard_data(serv, task) == SW_TRUE)
+        {
+            break;
+        }
+        memcpy(&length, task->data + offset, sizeof(length));
+        swString_clear(package);
+        swString_append_ptr(package, task->data + offset + sizeof(length), length);
+
+        serv->onReceive(serv, task);
+        SwooleWG.request_count++;
+        sw_atomic_fetch_add(&SwooleStats->request_count, 1);
+        offset += swPackage_batch_size(length);
+    }
+    swString_clear(package);
+    task->info.type = SW_EVENT_PACKAGE_BATCH;
+}
+
+/**
+ * send to the udp client, queued in the dgram batch
+ */
+int swWorker_sendto(int sock, struct sockaddr *addr, socklen_t addr_len, char *data, uint32_t length)
+{
+#ifdef HAVE_MMSG
+    swWorker_sendto_queue *queue = swWorker_dgram_queue;
+    int i;
+
+    if (!swWorker_dgram_batching || length > SW_DGRAM_QUEUE_SIZE || addr_len > sizeof(queue->addrs[0].addr))
+    {
+        goto send_now;
+    }
+    if (queue == NULL)
+    {
+        queue = sw_malloc(sizeof(swWorker_sendto_queue));
+        if (queue == NULL)
+        {
+            goto send_now;
+        }
+        bzero(queue, sizeof(swWorker_sendto_queue));
+        swWorker_dgram_queue = queue;
+    }
+    if (queue->num > 0 && (queue->sock != sock || queue->num == SW_DGRAM_BATCH_MAX
+            || queue->length + length > SW_DGRAM_QUEUE_SIZE))
+    {
+        swWorker_sendto_flush();
+    }
+
+    i = queue->num++;
+    queue->sock = sock;
+    memcpy(queue->buffer + queue->length, data, length);
+    memcpy(&queue->addrs[i].addr, addr, addr_len);
+    queue->iov[i].iov_base = queue->buffer + queue->length;
+    queue->iov[i].iov_len = length;
+    queue->msgs[i].msg_hdr.msg_name = &queue->addrs[i].addr;
+    queue->msgs[i].msg_hdr.msg_namelen = addr_len;
+    queue->msgs[i].msg_hdr.msg_iov = &queue->iov[i];
+    queue->msgs[i].msg_hdr.msg_iovlen = 1;
+    queue->length += length;
+    return length;
+
+    send_now:
+#endif
+    return swSocket_sendto_blocking(sock, data, length, 0, addr, addr_len);
+}
+
+void swWorker_sendto_flush(void)
+{
+#ifdef HAVE_MMSG
+    swWorker_sendto_queue *queue = swWorker_dgram_queue;
+    int n, offset = 0;
+
+    if (queue == NULL || queue->num == 0)
+    {
+        return;
+    }
+    while (offset < queue->num)
+    {
+        n = sendmmsg(queue->sock, queue->msgs + offset, queue->num - offset, 0);
+        if (n >= 0)
+        {
+            offset += n;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN)
+        {
+            swSocket_wait(queue->sock, 1000, SW_EVENT_WRITE);
+        }
+        //skip the failed one, as sendto does
+        else
+        {
+            swSysError("sendmmsg(%d) failed.", queue->sock);
+            offset++;
+        }
+    }
+    queue->num = 0;
+    queue->length = 0;
+#endif
+}
+
 int swWorker_onTask(swFactory *factory, swEventData *task)
 {
     swServer *serv = factory->ptr;
@@ -211,6 +400,29 @@ int swWorker_onTask(swFactory *factory, swEventData *task)
         }
         break;
 
+    case SW_EVENT_DGRAM_BATCH:
+        swWorker_onDgramBatch(serv, task);
+        break;
+
+    case SW_EVENT_PACKAGE_BATCH:
+        swWorker_onPackageBatch(serv, task);
+        break;
+
+    //the chunks of the http request body
+    case SW_EVENT_HTTP_BODY:
+    case SW_EVENT_HTTP_BODY_END:
+        if (swWorker_discard_data(serv, task) == SW_TRUE)
+        {
+            break;
+        }
+        serv->onReceive(serv, task);
+        if (task->info.type == SW_EVENT_HTTP_BODY_END)
+        {
+            SwooleWG.request_count++;
+            sw_atomic_fetch_add(&SwooleStats->request_count, 1);
+        }
+        break;
+
     case SW_EVENT_CLOSE:
 #ifdef SW_USE_OPENSSL
         conn = swServer_connection_verify(serv, task->info.fd);
@@ -364,14 +576,35 @@ void swWorker_onStop(swServer *serv)
         serv->onWorkerStop(serv, SwooleWG.id);
     }
     swWorker_free(worker);
+    //the objects cached by this process are given back to the other processes
+    if (SwooleG.slab_pool)
+    {
+        swSlabPool_flush(SwooleG.slab_pool);
+    }
 }
 
 void swWorker_clean(void)
 {
-    int i;
+    int i, j;
     swServer *serv = SwooleG.serv;
     swWorker *worker;
 
+    if (swWorker_channel_buffer)
+    {
+        for (i = 0; i < serv->reactor_num; i++)
+        {
+            for (j = 0; j < SW_SOCKET_OVERFLOW_WAIT && !swBuffer_empty(swWorker_channel_buffer[i]); j++)
+            {
+                if (swIPCChannel_flush(swServer_channel_to_reactor(serv, SwooleWG.id, i), &serv->reactor_notify[i],
+                        swWorker_channel_buffer[i]) == 0)
+                {
+                    break;
+                }
+                usleep(1000);
+            }
+        }
+    }
+
     for (i = 0; i < serv->worker_num + SwooleG.task_worker_num; i++)
     {
         worker = swServer_get_worker(serv, i);
@@ -433,6 +666,25 @@ int swWorker_loop(swFactory *factory, int worker_id)
     SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_PIPE, swWorker_onPipeReceive);
     SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_PIPE | SW_FD_WRITE, swReactor_onWrite);
 
+    if (serv->ipc_mode == SW_IPC_CHANNEL)
+    {
+        swWorker_channel_buffer = sw_calloc(serv->reactor_num, sizeof(swBuffer *));
+        if (swWorker_channel_buffer == NULL)
+        {
+            swError("[Worker] malloc for channel_buffer failed.");
+            return SW_ERR;
+        }
+        swIPCNotify *notify = &serv->worker_notify[worker_id];
+        SwooleG.main_reactor->add(SwooleG.main_reactor, notify->pipe.getFd(&notify->pipe, 0), SW_FD_CHANNEL);
+        SwooleG.main_reactor->setHandle(SwooleG.main_reactor, SW_FD_CHANNEL, swWorker_onChannelNotify);
+        /**
+         * the previous worker may exit with the requests in the rings
+         */
+        uint64_t flag = 1;
+        notify->parked = 0;
+        notify->pipe.write(&notify->pipe, &flag, sizeof(flag));
+    }
+
     swWorker_onStart(serv);
 
 #ifdef HAVE_SIGNALFD
@@ -470,7 +722,13 @@ int swWorker_send2reactor(swEventData *ev_data, size_t sendn, int fd)
     int pipe_worker_id = reactor_id + (pipe_index * serv->reactor_num);
     swWorker *worker = swServer_get_worker(serv, pipe_worker_id);
 
-    if (SwooleG.main_reactor)
+    //shared memory ring of this worker and the reactor thread
+    if (swWorker_channel_buffer && reactor_id < serv->reactor_num)
+    {
+        return swIPCChannel_push(swServer_channel_to_reactor(serv, SwooleWG.id, reactor_id),
+                &serv->reactor_notify[reactor_id], &swWorker_channel_buffer[reactor_id], ev_data, sendn);
+    }
+    else if (SwooleG.main_reactor)
     {
         ret = SwooleG.main_reactor->write(SwooleG.main_reactor, worker->pipe_worker, ev_data, sendn);
     }
@@ -518,6 +776,38 @@ static int swWorker_onPipeReceive(swReactor *reactor, swEvent *event)
     return SW_ERR;
 }
 
+/**
+ * SW_IPC_CHANNEL: flush the buffered responses and receive one request from each reactor thread
+ */
+static int swWorker_onChannelDrain(swReactor *reactor)
+{
+    swServer *serv = reactor->ptr;
+    swEventData task;
+    int i, n = 0;
+
+    for (i = 0; i < serv->reactor_num; i++)
+    {
+        if (!swBuffer_empty(swWorker_channel_buffer[i]))
+        {
+            swIPCChannel_flush(swServer_channel_to_reactor(serv, SwooleWG.id, i), &serv->reactor_notify[i],
+                    swWorker_channel_buffer[i]);
+        }
+        if (swIPCChannel_pop(swServer_channel_to_worker(serv, i, SwooleWG.id), &serv->reactor_notify[i], &task,
+                sizeof(task)) > 0)
+        {
+            swWorker_onTask(&serv->factory, &task);
+            n++;
+        }
+    }
+    return n;
+}
+
+static int swWorker_onChannelNotify(swReactor *reactor, swEvent *event)
+{
+    swServer *serv = reactor->ptr;
+    return swIPCChannel_consume(reactor, &serv->worker_notify[SwooleWG.id], swWorker_onChannelDrain);
+}
+
 int swWorker_send2worker(swWorker *dst_worker, void *buf, int n, int flag)
 {
     int pipefd, ret;
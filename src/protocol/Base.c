@@ -68,7 +68,8 @@ static sw_inline int swProtocol_split_package_by_eof(swProtocol *protocol, void
     //waiting for more data
     if (eof_pos < 0)
     {
-        buffer->offset = buffer->length - protocol->package_eof_len;
+        //the scanned positions are skipped in the next read
+        buffer->offset = buffer->length < protocol->package_eof_len ? 0 : buffer->length - protocol->package_eof_len + 1;
         return buffer->length;
     }
 
@@ -116,18 +117,43 @@ static sw_inline int swProtocol_split_package_by_eof(swProtocol *protocol, void
 }
 
 /**
+ * @return SW_ERR: the connection is closed in the callback, the buffer must not be touched
+ */
+static sw_inline int swProtocol_dispatch_length(swProtocol *protocol, swConnection *conn, char *data, uint32_t *lengths, int n)
+{
+    int fd = conn->fd;
+    int i;
+
+    if (n > 1 && protocol->onPackageBatch)
+    {
+        protocol->onPackageBatch(conn, data, lengths, n);
+        return SW_OK;
+    }
+    for (i = 0; i < n; i++)
+    {
+        protocol->onPackage(conn, data, lengths[i]);
+        if (conn->fd != fd || conn->closed || conn->removed)
+        {
+            return SW_ERR;
+        }
+        data += lengths[i];
+    }
+    return SW_OK;
+}
+
+/**
+ * all the complete packages in the buffer are extracted after one read, the partial package is moved to the head
  * @return SW_ERR: close the connection
  * @return SW_OK: continue
  */
 int swProtocol_recv_check_length(swProtocol *protocol, swConnection *conn, swString *buffer)
 {
-    char *recvbuf;
-    uint32_t recvbuf_size;
-
-    do_recv: recvbuf = buffer->str + buffer->length;
-    recvbuf_size = buffer->offset > 0 ? buffer->offset - buffer->length : protocol->package_length_offset + protocol->package_length_size;
+    uint32_t lengths[SW_PACKAGE_BATCH_MAX];
+    uint32_t offset = 0, start = 0, wait_length = 0;
+    int package_length;
+    int count = 0;
 
-    int n = swConnection_recv(conn, recvbuf, recvbuf_size, 0);
+    int n = swConnection_recv(conn, buffer->str + buffer->length, buffer->size - buffer->length, 0);
     if (n < 0)
     {
         switch (swConnection_error(errno))
@@ -145,58 +171,58 @@ int swProtocol_recv_check_length(swProtocol *protocol, swConnection *conn, swStr
     {
         return SW_ERR;
     }
-    else
-    {
-        conn->last_time = SwooleGS->now;
-        buffer->length += n;
 
-        if (conn->recv_wait)
+    conn->last_time = SwooleGS->now;
+    buffer->length += n;
+
+    while (offset < buffer->length)
+    {
+        package_length = protocol->get_package_length(protocol, conn, buffer->str + offset, buffer->length - offset);
+        //invalid package, close connection.
+        if (package_length < 0)
         {
-            if (buffer->length == buffer->offset)
-            {
-                do_package:
-                protocol->onPackage(conn, buffer->str, buffer->length);
-                conn->recv_wait = 0;
-                swString_clear(buffer);
-            }
-            return SW_OK;
+            return SW_ERR;
         }
-        else
+        //no length
+        else if (package_length == 0)
         {
-            int package_length = protocol->get_package_length(protocol, conn, buffer->str, buffer->length);
-            //invalid package, close connection.
-            if (package_length < 0)
-            {
-                return SW_ERR;
-            }
-            //no length
-            else if (package_length == 0)
+            break;
+        }
+        //wait for the rest of the package
+        else if (package_length > buffer->length - offset)
+        {
+            wait_length = package_length;
+            break;
+        }
+        lengths[count++] = package_length;
+        offset += package_length;
+        if (count == SW_PACKAGE_BATCH_MAX)
+        {
+            if (swProtocol_dispatch_length(protocol, conn, buffer->str + start, lengths, count) < 0)
             {
                 return SW_OK;
             }
-            //get length success
-            else
-            {
-                if (buffer->size < package_length)
-                {
-                    if (swString_extend(buffer, package_length) < 0)
-                    {
-                        return SW_ERR;
-                    }
-                }
-                conn->recv_wait = 1;
-                buffer->offset = package_length;
-                if (buffer->length == package_length)
-                {
-                    goto do_package;
-                }
-                else
-                {
-                    goto do_recv;
-                }
-            }
+            start = offset;
+            count = 0;
+        }
+    }
+    if (count > 0 && swProtocol_dispatch_length(protocol, conn, buffer->str + start, lengths, count) < 0)
+    {
+        return SW_OK;
+    }
+
+    if (offset > 0)
+    {
+        buffer->length -= offset;
+        if (buffer->length > 0)
+        {
+            memmove(buffer->str, buffer->str + offset, buffer->length);
         }
     }
+    if (wait_length > buffer->size && swString_extend(buffer, wait_length) < 0)
+    {
+        return SW_ERR;
+    }
     return SW_OK;
 }
 
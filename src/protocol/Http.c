@@ -19,95 +19,205 @@
 #include <assert.h>
 #include <stddef.h>
 
+static const struct
+{
+    char *name;
+    uint8_t length;
+    uint8_t method;
+} swHttpRequest_methods[] =
+{
+    { "GET", 3, HTTP_GET },
+    { "POST", 4, HTTP_POST },
+    { "PUT", 3, HTTP_PUT },
+    { "PATCH", 5, HTTP_PATCH },
+    { "DELETE", 6, HTTP_DELETE },
+    { "HEAD", 4, HTTP_HEAD },
+    { "OPTIONS", 7, HTTP_OPTIONS },
+};
+
 /**
- * only GET/POST
+ * only GET/POST/PUT/PATCH/DELETE/HEAD/OPTIONS
  */
-int swHttpRequest_get_protocol(swHttpRequest *request)
+static int swHttpRequest_parse_request_line(swHttpRequest *request, char *buf, char *pe)
 {
-    char *buf = request->buffer->str;
-    char *pe = buf + request->buffer->length;
+    swHttpIndex *index = &request->index;
+    char *p, *uri;
+    int i;
 
-    //http method
-    if (memcmp(buf, "GET", 3) == 0)
+    for (i = 0; i < sizeof(swHttpRequest_methods) / sizeof(swHttpRequest_methods[0]); i++)
+    {
+        if (pe - buf > swHttpRequest_methods[i].length && buf[swHttpRequest_methods[i].length] == SW_SPACE
+                && memcmp(buf, swHttpRequest_methods[i].name, swHttpRequest_methods[i].length) == 0)
+        {
+            request->method = swHttpRequest_methods[i].method;
+            request->offset = swHttpRequest_methods[i].length + 1;
+            break;
+        }
+    }
+    if (request->method == 0)
     {
-        request->method = HTTP_GET;
-        request->offset = 4;
-        buf += 4;
+        return SW_ERR;
     }
-    else if (memcmp(buf, "POST", 4) == 0)
+
+    uri = buf + request->offset;
+    p = memchr(uri, SW_SPACE, pe - uri);
+    if (p == NULL || p == uri || pe - p != sizeof("HTTP/1.1"))
     {
-        request->method = HTTP_POST;
-        request->offset = 5;
-        buf += 5;
+        return SW_ERR;
     }
-    else if (memcmp(buf, "PUT", 3) == 0)
+    if (memcmp(p + 1, "HTTP/1.1", 8) == 0)
     {
-        request->method = HTTP_PUT;
-        request->offset = 4;
-        buf += 4;
+        request->version = HTTP_VERSION_11;
     }
-    else if (memcmp(buf, "PATCH", 5) == 0)
+    else if (memcmp(p + 1, "HTTP/1.0", 8) == 0)
     {
-        request->method = HTTP_PATCH;
-        request->offset = 6;
-        buf += 6;
+        request->version = HTTP_VERSION_10;
     }
-    else if (memcmp(buf, "DELETE", 6) == 0)
+    else
     {
-        request->method = HTTP_DELETE;
-        request->offset = 7;
-        buf += 7;
+        return SW_ERR;
     }
-    else if (memcmp(buf, "HEAD", 4) == 0)
+
+    index->method = request->method;
+    index->version = request->version == HTTP_VERSION_11 ? 11 : 10;
+    index->uri = uri - request->buffer->str;
+    index->uri_length = p - uri;
+    char *query = memchr(uri, '?', p - uri);
+    index->path_length = query ? query - uri : index->uri_length;
+    return SW_OK;
+}
+
+static int swHttpRequest_parse_header(swHttpRequest *request, char *buf, char *pe)
+{
+    swHttpIndex *index = &request->index;
+    char *name_end, *value = memchr(buf, ':', pe - buf);
+
+    if (value == NULL || value == buf)
     {
-        request->method = HTTP_HEAD;
-        request->offset = 5;
-        buf += 5;
+        return SW_ERR;
     }
-    else if (memcmp(buf, "OPTIONS", 7) == 0)
+    name_end = value++;
+    while (value < pe && (*value == SW_SPACE || *value == '\t'))
     {
-        request->method = HTTP_OPTIONS;
-        request->offset = 8;
-        buf += 8;
+        value++;
     }
-    else
+    while (pe > value && (pe[-1] == SW_SPACE || pe[-1] == '\t'))
     {
-        return SW_ERR;
+        pe--;
     }
 
-    //http version
-    char *p;
-    char cmp = 0;
-    for (p = buf; p < pe; p++)
+    int name_length = name_end - buf;
+    if (name_length == sizeof("Content-Length") - 1 && strncasecmp(buf, SW_STRL("Content-Length") - 1) == 0)
     {
-        if (cmp == 0 && *p == SW_SPACE)
+        request->content_length = atoi(value);
+        index->content_length = request->content_length;
+        index->flags |= SW_HTTP_INDEX_CONTENT_LENGTH;
+    }
+    else if (name_length == sizeof("Transfer-Encoding") - 1 && strncasecmp(buf, SW_STRL("Transfer-Encoding") - 1) == 0
+            && swoole_strnpos(value, pe - value, SW_STRL("chunked") - 1) >= 0)
+    {
+        index->flags |= SW_HTTP_INDEX_CHUNKED;
+    }
+    else if (name_length == sizeof("Expect") - 1 && strncasecmp(buf, SW_STRL("Expect") - 1) == 0
+            && strncasecmp(value, SW_STRL("100-continue") - 1) == 0)
+    {
+        index->flags |= SW_HTTP_INDEX_EXPECT;
+    }
+
+    if (index->header_num == SW_HTTP_INDEX_HEADER_MAX)
+    {
+        index->flags |= SW_HTTP_INDEX_OVERFLOW;
+        return SW_OK;
+    }
+    swHttpIndex_header *header = &index->headers[index->header_num++];
+    header->name = buf - request->buffer->str;
+    header->name_length = name_length;
+    header->value = value - request->buffer->str;
+    header->value_length = pe - value;
+    return SW_OK;
+}
+
+/**
+ * the head is parsed in one pass while it is received, the bytes before request->scan are not read again.
+ * SW_WAIT: more data is needed, SW_OK: header_length is set.
+ */
+int swHttpRequest_parse(swHttpRequest *request)
+{
+    swString *buffer = request->buffer;
+    char *line, *pe, *eol;
+
+    while (1)
+    {
+        eol = memchr(buffer->str + request->scan, '\n', buffer->length - request->scan);
+        if (eol == NULL)
         {
-            cmp = 1;
+            request->scan = buffer->length;
+            return SW_WAIT;
         }
-        else if (cmp == 1)
+        line = buffer->str + request->line;
+        pe = (eol > line && eol[-1] == '\r') ? eol - 1 : eol;
+        request->line = request->scan = eol + 1 - buffer->str;
+
+        if (request->state == 0)
         {
-            if (p + 8 > pe)
-            {
-                return SW_ERR;
-            }
-            if (memcmp(p, "HTTP/1.1", 8) == 0)
-            {
-                request->version = HTTP_VERSION_11;
-                break;
-            }
-            else if (memcmp(p, "HTTP/1.0", 8) == 0)
-            {
-                request->version = HTTP_VERSION_10;
-                break;
-            }
-            else
+            if (swHttpRequest_parse_request_line(request, line, pe) < 0)
             {
                 return SW_ERR;
             }
+            request->state = 1;
+        }
+        //the empty line
+        else if (pe == line)
+        {
+            request->header_length = request->line;
+            request->index.body = request->header_length;
+            buffer->offset = request->header_length;
+            return SW_OK;
         }
+        else if (swHttpRequest_parse_header(request, line, pe) < 0)
+        {
+            return SW_ERR;
+        }
+    }
+    return SW_ERR;
+}
+
+/**
+ * [request][index][trailer], the index is cut to the parsed headers
+ */
+int swHttpRequest_append_index(swHttpRequest *request)
+{
+    swHttpIndex_trailer trailer;
+    trailer.length = offsetof(swHttpIndex, headers) + sizeof(swHttpIndex_header) * request->index.header_num;
+    trailer.magic = SW_HTTP_INDEX_MAGIC;
+
+    if (swString_append_ptr(request->buffer, (char *) &request->index, trailer.length) < 0
+            || swString_append_ptr(request->buffer, (char *) &trailer, sizeof(trailer)) < 0)
+    {
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+/**
+ * the index is copied out, it is not aligned behind the request. length is set to the size of the request.
+ */
+int swHttpIndex_get(char *data, uint32_t *length, swHttpIndex *index)
+{
+    swHttpIndex_trailer trailer;
+
+    if (*length < sizeof(trailer) + offsetof(swHttpIndex, headers))
+    {
+        return SW_ERR;
+    }
+    memcpy(&trailer, data + *length - sizeof(trailer), sizeof(trailer));
+    if (trailer.magic != SW_HTTP_INDEX_MAGIC || trailer.length > *length - sizeof(trailer)
+            || trailer.length > sizeof(swHttpIndex))
+    {
+        return SW_ERR;
     }
-    p += 8;
-    request->buffer->offset = p - request->buffer->str;
+    *length -= sizeof(trailer) + trailer.length;
+    memcpy(index, data + *length, trailer.length);
     return SW_OK;
 }
 
@@ -126,133 +236,369 @@ void swHttpRequest_free(swConnection *conn)
     }
 }
 
-/**
- * POST content-length
- */
-int swHttpRequest_get_content_length(swHttpRequest *request)
+char* swHttp_get_status_message(int code)
 {
-    swString *buffer = request->buffer;
-    char *buf = buffer->str + buffer->offset;
-    int len = buffer->length - buffer->offset;
+    switch (code)
+    {
+    case 100:
+        return "100 Continue";
+    case 101:
+        return "101 Switching Protocols";
+    case 201:
+        return "201 Created";
+    case 202:
+        return "202 Accepted";
+    case 203:
+        return "203 Non-Authoritative Information";
+    case 204:
+        return "204 No Content";
+    case 205:
+        return "205 Reset Content";
+    case 206:
+        return "206 Partial Content";
+    case 207:
+        return "207 Multi-Status";
+    case 208:
+        return "208 Already Reported";
+    case 226:
+        return "226 IM Used";
+    case 300:
+        return "300 Multiple Choices";
+    case 301:
+        return "301 Moved Permanently";
+    case 302:
+        return "302 Found";
+    case 303:
+        return "303 See Other";
+    case 304:
+        return "304 Not Modified";
+    case 305:
+        return "305 Use Proxy";
+    case 307:
+        return "307 Temporary Redirect";
+    case 400:
+        return "400 Bad Request";
+    case 401:
+        return "401 Unauthorized";
+    case 402:
+        return "402 Payment Required";
+    case 403:
+        return "403 Forbidden";
+    case 404:
+        return "404 Not Found";
+    case 405:
+        return "405 Method Not Allowed";
+    case 406:
+        return "406 Not Acceptable";
+    case 407:
+        return "407 Proxy Authentication Required";
+    case 408:
+        return "408 Request Timeout";
+    case 409:
+        return "409 Conflict";
+    case 410:
+        return "410 Gone";
+    case 411:
+        return "411 Length Required";
+    case 412:
+        return "412 Precondition Failed";
+    case 413:
+        return "413 Request Entity Too Large";
+    case 414:
+        return "414 Request URI Too Long";
+    case 415:
+        return "415 Unsupported Media Type";
+    case 416:
+        return "416 Requested Range Not Satisfiable";
+    case 417:
+        return "417 Expectation Failed";
+    case 418:
+        return "418 I'm a teapot";
+    case 421:
+        return "421 Misdirected Request";
+    case 422:
+        return "422 Unprocessable Entity";
+    case 423:
+        return "423 Locked";
+    case 424:
+        return "424 Failed Dependency";
+    case 426:
+        return "426 Upgrade Required";
+    case 428:
+        return "428 Precondition Required";
+    case 429:
+        return "429 Too Many Requests";
+    case 431:
+        return "431 Request Header Fields Too Large";
+    case 500:
+        return "500 Internal Server Error";
+    case 501:
+        return "501 Method Not Implemented";
+    case 503:
+        return "503 Service Unavailable";
+    case 505:
+        return "505 HTTP Version Not Supported";
+    case 506:
+        return "506 Variant Also Negotiates";
+    case 507:
+        return "507 Insufficient Storage";
+    case 508:
+        return "508 Loop Detected";
+    case 510:
+        return "510 Not Extended";
+    case 511:
+        return "511 Network Authentication Required";
+    case 200:
+    default:
+        return "200 OK";
+    }
+}
 
-    char *pe = buf + len;
-    char *p;
-    char state = 0;
+static struct
+{
+    uint32_t length;
+    char str[64];
+} swHttp_status_lines[SW_HTTP_STATUS_MAX - SW_HTTP_STATUS_MIN];
 
-    for (p = buf; p < pe; p++)
+static struct
+{
+    time_t now;
+    uint32_t length;
+    char str[64];
+} swHttp_date;
+
+/**
+ * the line of a code is formatted into the static table on its first use, it never fails.
+ * the unknown codes get the line of 200
+ */
+char* swHttp_get_status_line(int code, uint32_t *length)
+{
+    if (code < SW_HTTP_STATUS_MIN || code >= SW_HTTP_STATUS_MAX)
     {
-        if (*p == '\r' && *(p + 1) == '\n')
-        {
-            if (state == 0)
-            {
-                if (strncasecmp(p + 2, SW_STRL("Content-Length") - 1) == 0)
-                {
-                    p += sizeof("Content-Length: ");
-                    request->content_length = atoi(p);
-                    state = 1;
-                }
-                else
-                {
-                    p++;
-                }
-            }
-            else
-            {
-                if (memcmp(p + 2, SW_STRL("\r\n") - 1) == 0)
-                {
-                    //strlen(header) + sizeof("\r\n\r\n")
-                    request->header_length = p - buffer->str + sizeof("\r\n\r\n") - 1;
-                    buffer->offset = request->header_length;
-                    return SW_OK;
-                }
-            }
-        }
+        code = 200;
+    }
+    code -= SW_HTTP_STATUS_MIN;
+    if (swHttp_status_lines[code].length == 0)
+    {
+        swHttp_status_lines[code].length = snprintf(swHttp_status_lines[code].str, sizeof(swHttp_status_lines[code].str),
+                "HTTP/1.1 %s\r\n", swHttp_get_status_message(code + SW_HTTP_STATUS_MIN));
     }
+    *length = swHttp_status_lines[code].length;
+    return swHttp_status_lines[code].str;
+}
 
-    return SW_ERR;
+/**
+ * "Sun, 06 Nov 1994 08:49:37 GMT"
+ */
+int swHttp_format_date(char *buf, size_t size, time_t time)
+{
+    static char *weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    struct tm tm;
+
+    gmtime_r(&time, &tm);
+    return snprintf(buf, size, "%s, %02d %s %04d %02d:%02d:%02d GMT", weekdays[tm.tm_wday], tm.tm_mday,
+            months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
 }
 
-int swHttpRequest_have_content_length(swHttpRequest *request)
+/**
+ * "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n", formatted once per second
+ */
+char* swHttp_get_date(time_t now, uint32_t *length)
 {
-    swString *buffer = request->buffer;
-    char *buf = buffer->str + buffer->offset;
-    int len = buffer->length - buffer->offset;
+    uint32_t n;
 
-    char *pe = buf + len;
-    char *p;
+    if (swHttp_date.now != now || swHttp_date.length == 0)
+    {
+        memcpy(swHttp_date.str, "Date: ", 6);
+        n = 6 + swHttp_format_date(swHttp_date.str + 6, sizeof(swHttp_date.str) - 6, now);
+        memcpy(swHttp_date.str + n, "\r\n", 3);
+        swHttp_date.length = n + 2;
+        swHttp_date.now = now;
+    }
+    *length = swHttp_date.length;
+    return swHttp_date.str;
+}
 
-    for (p = buf; p < pe; p++)
+static int swHttp_parse_offset(char **p, char *pe, off_t *value)
+{
+    char *s = *p;
+    off_t n = 0;
+
+    while (*p < pe && **p >= '0' && **p <= '9')
     {
-        if (*p == '\r' && *(p + 1) == '\n')
+        //overflow
+        if (n > (SW_HTTP_OFFSET_MAX - 9) / 10)
         {
-            if (strncasecmp(p + 2, SW_STRL("Content-Length") - 1) == 0)
-            {
-                return SW_TRUE;
-            }
-            else
-            {
-                p++;
-            }
+            return SW_ERR;
         }
+        n = n * 10 + (**p - '0');
+        (*p)++;
     }
-    return SW_FALSE;
+    *value = n;
+    return *p == s ? SW_ERR : SW_OK;
 }
 
-#ifdef SW_HTTP_100_CONTINUE
-int swHttpRequest_has_expect_header(swHttpRequest *request)
+/**
+ * "bytes=0-499,500-,-500", the ranges are clamped to the file size
+ * return the number of ranges, 0 if the header is ignored, SW_ERR if no range is satisfiable
+ */
+int swHttp_parse_range(char *value, uint32_t length, off_t filesize, swHttpRange *ranges, int max)
 {
-    swString *buffer = request->buffer;
-    //char *buf = buffer->str + buffer->offset;
-    char *buf = buffer->str;
-    //int len = buffer->length - buffer->offset;
-    int len = buffer->length;
-
-    char *pe = buf + len;
-    char *p;
+    char *p = value;
+    char *pe = value + length;
+    off_t first, last, total = 0;
+    int n = 0, unsatisfiable = 0;
 
-    for (p = buf; p < pe; p++)
+    if (length < sizeof("bytes=") - 1 || strncasecmp(p, "bytes=", sizeof("bytes=") - 1) != 0)
     {
+        return 0;
+    }
+    p += sizeof("bytes=") - 1;
 
-        if (*p == '\r' && *(p + 1) == '\n')
+    while (1)
+    {
+        while (p < pe && (*p == ' ' || *p == '\t'))
         {
-            if (strncasecmp(p + 2, SW_STRL("Expect") - 1) == 0)
+            p++;
+        }
+        if (p < pe && *p == '-')
+        {
+            //suffix range, the last bytes of the file
+            p++;
+            if (swHttp_parse_offset(&p, pe, &last) < 0)
+            {
+                return 0;
+            }
+            if (last == 0)
             {
-                p += sizeof("Expect: ") + 1;
-                if (strncasecmp(p, SW_STRL("100-continue") - 1) == 0)
+                unsatisfiable++;
+                goto next;
+            }
+            first = last > filesize ? 0 : filesize - last;
+            last = filesize - 1;
+        }
+        else
+        {
+            if (swHttp_parse_offset(&p, pe, &first) < 0 || p == pe || *p != '-')
+            {
+                return 0;
+            }
+            p++;
+            if (p < pe && *p >= '0' && *p <= '9')
+            {
+                if (swHttp_parse_offset(&p, pe, &last) < 0 || last < first)
                 {
-                    return 1;
+                    return 0;
                 }
-                else
+                if (last >= filesize)
                 {
-                    return 0;
+                    last = filesize - 1;
                 }
             }
             else
             {
-                p++;
+                last = filesize - 1;
+            }
+            if (first >= filesize)
+            {
+                unsatisfiable++;
+                goto next;
             }
         }
+        if (n == max)
+        {
+            return 0;
+        }
+        ranges[n].offset = first;
+        ranges[n].length = last - first + 1;
+        total += ranges[n].length;
+        n++;
+
+        next:
+        while (p < pe && (*p == ' ' || *p == '\t'))
+        {
+            p++;
+        }
+        if (p == pe)
+        {
+            break;
+        }
+        if (*p != ',')
+        {
+            return 0;
+        }
+        p++;
     }
-    return 0;
+
+    if (n == 0)
+    {
+        return unsatisfiable > 0 ? SW_ERR : 0;
+    }
+    //overlapping ranges asking for more than the file, send the whole file
+    if (total > filesize)
+    {
+        return 0;
+    }
+    return n;
 }
-#endif
 
 /**
- * POST get header-length
+ * If-None-Match: "*", or the list of the entity tags, compared weakly
  */
-int swHttpRequest_get_header_length(swHttpRequest *request)
+int swHttp_match_etag(char *value, uint32_t length, char *etag, uint32_t etag_length)
 {
-    swString *buffer = request->buffer;
+    char *p = value;
+    char *pe = value + length;
+    char *tag;
 
-    int n = swoole_strnpos(buffer->str, buffer->length, "\r\n\r\n", 4);
-    if (n < 0)
+    if (etag_length > 2 && memcmp(etag, "W/", 2) == 0)
     {
-        return SW_ERR;
+        etag += 2;
+        etag_length -= 2;
     }
-    else
+    while (p < pe)
     {
-        //strlen(header) + sizeof("\r\n\r\n")
-        request->header_length = n + 4;
-        return SW_OK;
+        while (p < pe && (*p == ' ' || *p == '\t' || *p == ','))
+        {
+            p++;
+        }
+        if (p == pe)
+        {
+            break;
+        }
+        if (*p == '*')
+        {
+            return 1;
+        }
+        if (pe - p > 2 && memcmp(p, "W/", 2) == 0)
+        {
+            p += 2;
+        }
+        tag = p;
+        if (p < pe && *p == '"')
+        {
+            p++;
+            while (p < pe && *p != '"')
+            {
+                p++;
+            }
+            if (p < pe)
+            {
+                p++;
+            }
+        }
+        else
+        {
+            while (p < pe && *p != ',' && *p != ' ' && *p != '\t')
+            {
+                p++;
+            }
+        }
+        if (p - tag == etag_length && memcmp(tag, etag, etag_length) == 0)
+        {
+            return 1;
+        }
     }
+    return 0;
 }
@@ -16,6 +16,7 @@
 
 #include "swoole.h"
 #include "websocket.h"
+#include "Connection.h"
 #include <sys/time.h>
 
 /*  The following is websocket data frame:
@@ -52,24 +53,39 @@ int swWebSocket_get_package_length(swProtocol *protocol, swConnection *conn, cha
     //0-125
     uint64_t payload_length = buf[1] & 0x7f;
     int header_length = SW_WEBSOCKET_HEADER_LEN;
-    buf += SW_WEBSOCKET_HEADER_LEN;
 
     //uint16_t, 2byte
-    if (length == 0x7e)
+    if (payload_length == 0x7e)
     {
-        payload_length = ntohs(*((uint16_t *) buf));
         header_length += 2;
     }
     //uint64_t, 8byte
-    else if (length > 0x7e)
+    else if (payload_length > 0x7e)
     {
-        payload_length = swoole_ntoh64(*((uint64_t *) buf));
         header_length += 8;
     }
+    //need the extended payload length
+    if (length < header_length)
+    {
+        return 0;
+    }
+    if (payload_length == 0x7e)
+    {
+        payload_length = ntohs(*((uint16_t *) (buf + SW_WEBSOCKET_HEADER_LEN)));
+    }
+    else if (payload_length > 0x7e)
+    {
+        payload_length = swoole_ntoh64(*((uint64_t *) (buf + SW_WEBSOCKET_HEADER_LEN)));
+    }
     if (mask)
     {
         header_length += SW_WEBSOCKET_MASK_LEN;
     }
+    if (payload_length > protocol->package_max_length - header_length)
+    {
+        swWarn("invalid frame, remote_addr=%s:%d, payload_length=%ld.", swConnection_get_ip(conn), swConnection_get_port(conn), (long) payload_length);
+        return SW_ERR;
+    }
     return header_length + payload_length;
 }
 
@@ -163,6 +179,104 @@ void swWebSocket_decode(swWebSocket_frame *frame, swString *data)
     frame->payload = data->str + header_length;
 }
 
+/**
+ * the text message must be valid utf-8, the ascii bytes are checked 8 bytes at a time
+ */
+int swWebSocket_check_utf8(char *data, size_t length)
+{
+    uchar *p = (uchar *) data;
+    uchar *pe = p + length;
+    uint64_t chunk;
+    static const uint32_t min[4] = { 0, 0x80, 0x800, 0x10000 };
+    uint32_t c;
+    int i, n;
+
+    while (p < pe)
+    {
+        if (pe - p >= sizeof(chunk))
+        {
+            memcpy(&chunk, p, sizeof(chunk));
+            if ((chunk & 0x8080808080808080ULL) == 0)
+            {
+                p += sizeof(chunk);
+                continue;
+            }
+        }
+        if (*p < 0x80)
+        {
+            p++;
+            continue;
+        }
+        if (*p >= 0xc2 && *p <= 0xdf)
+        {
+            n = 1;
+            c = *p & 0x1f;
+        }
+        else if (*p >= 0xe0 && *p <= 0xef)
+        {
+            n = 2;
+            c = *p & 0x0f;
+        }
+        else if (*p >= 0xf0 && *p <= 0xf4)
+        {
+            n = 3;
+            c = *p & 0x07;
+        }
+        else
+        {
+            return SW_ERR;
+        }
+        if (pe - p <= n)
+        {
+            return SW_ERR;
+        }
+        for (i = 1; i <= n; i++)
+        {
+            if ((p[i] & 0xc0) != 0x80)
+            {
+                return SW_ERR;
+            }
+            c = (c << 6) | (p[i] & 0x3f);
+        }
+        //the overlong forms and the surrogates are invalid
+        if (c < min[n] || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff)
+        {
+            return SW_ERR;
+        }
+        p += n + 1;
+    }
+    return SW_OK;
+}
+
+/**
+ * the status code echoed in the close reply, or the code of the error in the close frame
+ */
+int swWebSocket_get_close_code(char *payload, size_t length)
+{
+    if (length == 0)
+    {
+        return WEBSOCKET_CLOSE_NORMAL;
+    }
+    else if (length == 1)
+    {
+        return WEBSOCKET_CLOSE_PROTOCOL_ERROR;
+    }
+
+    int code = ntohs(*(uint16_t *) payload);
+    //1004-1006 and 1015 must not be sent by the peer
+    if (code < WEBSOCKET_CLOSE_NORMAL || (code > WEBSOCKET_CLOSE_DATA_ERROR && code < WEBSOCKET_CLOSE_MESSAGE_ERROR)
+            || (code > WEBSOCKET_CLOSE_SERVER_ERROR && code < 3000) || code > 4999)
+    {
+        return WEBSOCKET_CLOSE_PROTOCOL_ERROR;
+    }
+    //the reason
+    if (swWebSocket_check_utf8(payload + 2, length - 2) < 0)
+    {
+        return WEBSOCKET_CLOSE_MESSAGE_ERROR;
+    }
+    return code;
+}
+
 void swWebSocket_print_frame(swWebSocket_frame *frm)
 {
     printf("FIN: %x, RSV1: %d, RSV2: %d, RSV3: %d, opcode: %d, MASK: %d, length: %ld\n", frm->header.FIN,
@@ -174,3 +288,293 @@ void swWebSocket_print_frame(swWebSocket_frame *frm)
         printf("payload: %s\n", frm->payload);
     }
 }
+
+static void swWebSocket_trim(char **start, char **end)
+{
+    while (*start < *end && (**start == ' ' || **start == '\t'))
+    {
+        (*start)++;
+    }
+    while (*end > *start && (*(*end - 1) == ' ' || *(*end - 1) == '\t'))
+    {
+        (*end)--;
+    }
+}
+
+static int swWebSocket_parse_window_bits(char *value, char *end)
+{
+    int bits = 0;
+
+    //the value can be quoted
+    if (end - value >= 2 && *value == '"' && *(end - 1) == '"')
+    {
+        value++;
+        end--;
+    }
+    if (end - value < 1 || end - value > 2)
+    {
+        return SW_ERR;
+    }
+    for (; value < end; value++)
+    {
+        if (*value < '0' || *value > '9')
+        {
+            return SW_ERR;
+        }
+        bits = bits * 10 + (*value - '0');
+    }
+    return (bits < 8 || bits > 15) ? SW_ERR : bits;
+}
+
+static int swWebSocket_parse_deflate_param(char *name, char *name_end, char *value, char *value_end, swWebSocket_deflate_param *offer)
+{
+    size_t length = name_end - name;
+    int bits;
+
+    if (length == sizeof("server_no_context_takeover") - 1 && strncasecmp(name, "server_no_context_takeover", length) == 0)
+    {
+        if (value || offer->server_no_context_takeover)
+        {
+            return SW_ERR;
+        }
+        offer->server_no_context_takeover = 1;
+    }
+    else if (length == sizeof("client_no_context_takeover") - 1 && strncasecmp(name, "client_no_context_takeover", length) == 0)
+    {
+        if (value || offer->client_no_context_takeover)
+        {
+            return SW_ERR;
+        }
+        offer->client_no_context_takeover = 1;
+    }
+    else if (length == sizeof("server_max_window_bits") - 1 && strncasecmp(name, "server_max_window_bits", length) == 0)
+    {
+        if (!value || offer->server_max_window_bits || (bits = swWebSocket_parse_window_bits(value, value_end)) < 0)
+        {
+            return SW_ERR;
+        }
+        offer->server_max_window_bits = bits;
+    }
+    else if (length == sizeof("client_max_window_bits") - 1 && strncasecmp(name, "client_max_window_bits", length) == 0)
+    {
+        if (offer->client_max_window_bits)
+        {
+            return SW_ERR;
+        }
+        //without value, the client supports the parameter
+        bits = value ? swWebSocket_parse_window_bits(value, value_end) : 15;
+        if (bits < 0)
+        {
+            return SW_ERR;
+        }
+        offer->client_max_window_bits = bits;
+    }
+    else
+    {
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+/**
+ * Sec-WebSocket-Extensions: "permessage-deflate; client_max_window_bits, x-webkit-deflate-frame",
+ * the first permessage-deflate offer with the valid parameters is used
+ */
+int swWebSocket_parse_deflate_offer(char *value, size_t length, swWebSocket_deflate_param *offer)
+{
+    char *p = value;
+    char *pe = value + length;
+    char *offer_end, *name, *name_end, *param_end, *eq;
+    int valid;
+
+    for (; p < pe; p = offer_end + 1)
+    {
+        offer_end = memchr(p, ',', pe - p);
+        if (offer_end == NULL)
+        {
+            offer_end = pe;
+        }
+        name = p;
+        name_end = memchr(p, ';', offer_end - p);
+        if (name_end == NULL)
+        {
+            name_end = offer_end;
+        }
+        p = name_end;
+        swWebSocket_trim(&name, &name_end);
+        if (name_end - name != sizeof("permessage-deflate") - 1 || strncasecmp(name, "permessage-deflate", name_end - name) != 0)
+        {
+            continue;
+        }
+
+        bzero(offer, sizeof(swWebSocket_deflate_param));
+        valid = 1;
+        while (valid && p < offer_end)
+        {
+            //skip ';'
+            name = p + 1;
+            param_end = memchr(name, ';', offer_end - name);
+            if (param_end == NULL)
+            {
+                param_end = offer_end;
+            }
+            p = param_end;
+
+            eq = memchr(name, '=', param_end - name);
+            name_end = eq ? eq : param_end;
+            swWebSocket_trim(&name, &name_end);
+            if (eq)
+            {
+                eq++;
+                swWebSocket_trim(&eq, &param_end);
+            }
+            if (swWebSocket_parse_deflate_param(name, name_end, eq, param_end, offer) < 0)
+            {
+                valid = 0;
+            }
+        }
+        if (valid)
+        {
+            return SW_OK;
+        }
+    }
+    return SW_ERR;
+}
+
+/**
+ * the server stream never takes over the context, so any worker can compress the message,
+ * the offer is updated to the negotiated parameters, return the length of the response header
+ */
+int swWebSocket_accept_deflate_offer(swWebSocket_deflate_param *offer, swWebSocket_deflate_param *setting, char *buf, size_t size)
+{
+    uint8_t server_bits = setting->server_max_window_bits;
+    uint8_t client_bits = 15;
+    int n;
+
+    if (offer->server_max_window_bits && offer->server_max_window_bits < server_bits)
+    {
+        server_bits = offer->server_max_window_bits;
+    }
+    //zlib cannot deflate with the 256 bytes window
+    if (server_bits < 9)
+    {
+        return SW_ERR;
+    }
+
+    n = snprintf(buf, size, "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover");
+    if (offer->client_no_context_takeover || setting->client_no_context_takeover)
+    {
+        offer->client_no_context_takeover = 1;
+        n += snprintf(buf + n, size - n, "; client_no_context_takeover");
+    }
+    if (server_bits < 15 || offer->server_max_window_bits)
+    {
+        n += snprintf(buf + n, size - n, "; server_max_window_bits=%d", server_bits);
+    }
+    //the client window can be limited only if the client offers the parameter
+    if (offer->client_max_window_bits)
+    {
+        client_bits = offer->client_max_window_bits;
+        if (setting->client_max_window_bits < client_bits)
+        {
+            client_bits = setting->client_max_window_bits;
+            n += snprintf(buf + n, size - n, "; client_max_window_bits=%d", client_bits);
+        }
+    }
+    n += snprintf(buf + n, size - n, "\r\n");
+
+    offer->server_no_context_takeover = 1;
+    offer->server_max_window_bits = server_bits;
+    offer->client_max_window_bits = client_bits;
+    return n;
+}
+
+#ifdef SW_HAVE_ZLIB
+/**
+ * inflate the payload of one frame into out, the last frame of the message gets the tail removed by the client
+ */
+int swWebSocket_inflate(z_stream *stream, char *data, size_t length, int fin, swString *out, size_t max_length)
+{
+    char *input[2] = { data, SW_WEBSOCKET_DEFLATE_TAIL };
+    size_t input_length[2] = { length, fin ? sizeof(SW_WEBSOCKET_DEFLATE_TAIL) - 1 : 0 };
+    int i, status;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (input_length[i] == 0)
+        {
+            continue;
+        }
+        stream->next_in = (Bytef *) input[i];
+        stream->avail_in = input_length[i];
+        do
+        {
+            if (out->length == out->size)
+            {
+                if (out->size >= max_length)
+                {
+                    swWarn("the inflated message is bigger than %ld.", (long) max_length);
+                    return SW_ERR;
+                }
+                if (swString_extend(out, out->size * 2 > max_length ? max_length : out->size * 2) < 0)
+                {
+                    return SW_ERR;
+                }
+            }
+            stream->next_out = (Bytef *) (out->str + out->length);
+            stream->avail_out = out->size - out->length;
+            status = inflate(stream, Z_SYNC_FLUSH);
+            out->length = (char *) stream->next_out - out->str;
+
+            //the final block, the context is not kept
+            if (status == Z_STREAM_END)
+            {
+                inflateReset(stream);
+                break;
+            }
+            //no progress, the input is consumed
+            else if (status == Z_BUF_ERROR)
+            {
+                break;
+            }
+            else if (status != Z_OK)
+            {
+                swWarn("inflate() failed, Error: %s[%d].", stream->msg ? stream->msg : "", status);
+                return SW_ERR;
+            }
+        } while (stream->avail_in > 0 || stream->avail_out == 0);
+    }
+    return SW_OK;
+}
+
+/**
+ * deflate the message with the sync flush, the tail is removed
+ */
+int swWebSocket_deflate(z_stream *stream, char *data, size_t length, swString *out)
+{
+    //the sync flush adds the empty stored block
+    size_t size = out->length + deflateBound(stream, length) + 16;
+    if (size > out->size && swString_extend(out, size) < 0)
+    {
+        return SW_ERR;
+    }
+
+    stream->next_in = (Bytef *) data;
+    stream->avail_in = length;
+    stream->next_out = (Bytef *) (out->str + out->length);
+    stream->avail_out = out->size - out->length;
+
+    int status = deflate(stream, Z_SYNC_FLUSH);
+    if (status != Z_OK || stream->avail_in > 0 || stream->avail_out == 0)
+    {
+        swWarn("deflate() failed, Error: %s[%d].", stream->msg ? stream->msg : "", status);
+        return SW_ERR;
+    }
+    out->length = (char *) stream->next_out - out->str;
+    if (out->length >= 4 && memcmp(out->str + out->length - 4, SW_WEBSOCKET_DEFLATE_TAIL, 4) == 0)
+    {
+        out->length -= 4;
+    }
+    return SW_OK;
+}
+#endif
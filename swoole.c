@@ -94,12 +94,16 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_sendfile, 0, 0, 3)
     ZEND_ARG_OBJ_INFO(0, zobject, swoole_server, 0)
     ZEND_ARG_INFO(0, conn_fd)
     ZEND_ARG_INFO(0, filename)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, length)
 ZEND_END_ARG_INFO()
 
 //for object style
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_sendfile_oo, 0, 0, 2)
     ZEND_ARG_INFO(0, conn_fd)
     ZEND_ARG_INFO(0, filename)
+    ZEND_ARG_INFO(0, offset)
+    ZEND_ARG_INFO(0, length)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_server_close, 0, 0, 2)
@@ -325,6 +329,7 @@ const zend_function_entry swoole_functions[] =
     PHP_FE(swoole_async_dns_lookup, NULL)
     /*------other-----*/
     PHP_FE(swoole_client_select, NULL)
+    PHP_FE(swoole_client_pool_stats, NULL)
     PHP_FE(swoole_set_process_name, NULL)
     PHP_FE(swoole_get_local_ip, NULL)
     PHP_FE(swoole_strerror, NULL)
@@ -439,6 +444,15 @@ STD_PHP_INI_ENTRY("swoole.message_queue_key", "0", PHP_INI_ALL, OnUpdateString,
  * Unix socket buffer size
  */
 STD_PHP_INI_ENTRY("swoole.unixsock_buffer_size", "8388608", PHP_INI_ALL, OnUpdateLong, socket_buffer_size, zend_swoole_globals, swoole_globals)
+/**
+ * shared memory of connection_list, session_list, swoole_table: transparent, explicit
+ */
+STD_PHP_INI_ENTRY("swoole.shm_hugepage", "", PHP_INI_SYSTEM, OnUpdateString, shm_hugepage, zend_swoole_globals, swoole_globals)
+/**
+ * interleave, bind. The nodes are "0-1,3", all the online nodes by default
+ */
+STD_PHP_INI_ENTRY("swoole.shm_numa", "", PHP_INI_SYSTEM, OnUpdateString, shm_numa, zend_swoole_globals, swoole_globals)
+STD_PHP_INI_ENTRY("swoole.shm_numa_nodes", "", PHP_INI_SYSTEM, OnUpdateString, shm_numa_nodes, zend_swoole_globals, swoole_globals)
 PHP_INI_END()
 
 static void php_swoole_init_globals(zend_swoole_globals *swoole_globals)
@@ -633,9 +647,7 @@ PHP_MINIT_FUNCTION(swoole)
 #ifdef SW_ASYNC_HTTPCLIENT
     swoole_http_client_init(module_number TSRMLS_CC);
 #endif
-#ifdef SW_USE_REDIS
     swoole_redis_init(module_number TSRMLS_CC);
-#endif
     swoole_async_init(module_number TSRMLS_CC);
     swoole_process_init(module_number TSRMLS_CC);
     swoole_table_init(module_number TSRMLS_CC);
@@ -644,10 +656,7 @@ PHP_MINIT_FUNCTION(swoole)
     swoole_http_init(module_number TSRMLS_CC);
     swoole_buffer_init(module_number TSRMLS_CC);
     swoole_websocket_init(module_number TSRMLS_CC);
-
-#ifdef SW_ASYNC_MYSQL
     swoole_mysql_init(module_number TSRMLS_CC);
-#endif
 
     if (SWOOLE_G(socket_buffer_size) > 0)
     {
@@ -658,6 +667,28 @@ PHP_MINIT_FUNCTION(swoole)
     SwooleG.socket_buffer_size = 256 * 1024;
 #endif
 
+    if (SWOOLE_G(shm_hugepage) && strcasecmp(SWOOLE_G(shm_hugepage), "transparent") == 0)
+    {
+        SwooleG.shm_hugepage = SW_HUGEPAGE_TRANSPARENT;
+    }
+    else if (SWOOLE_G(shm_hugepage) && strcasecmp(SWOOLE_G(shm_hugepage), "explicit") == 0)
+    {
+        SwooleG.shm_hugepage = SW_HUGEPAGE_EXPLICIT;
+    }
+    if (SWOOLE_G(shm_numa) && strcasecmp(SWOOLE_G(shm_numa), "interleave") == 0)
+    {
+        SwooleG.shm_numa = SW_NUMA_INTERLEAVE;
+    }
+    else if (SWOOLE_G(shm_numa) && strcasecmp(SWOOLE_G(shm_numa), "bind") == 0)
+    {
+        SwooleG.shm_numa = SW_NUMA_BIND;
+    }
+    if (SWOOLE_G(shm_numa_nodes) && SWOOLE_G(shm_numa_nodes)[0]
+            && swShareMemory_parse_nodes(SWOOLE_G(shm_numa_nodes), &SwooleG.shm_numa_nodes) < 0)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "swoole.shm_numa_nodes=%s is invalid.", SWOOLE_G(shm_numa_nodes));
+    }
+
     if (SWOOLE_G(aio_thread_num) > 0)
     {
         if (SWOOLE_G(aio_thread_num) > SW_AIO_THREAD_NUM_MAX)
@@ -63,6 +63,12 @@ static int client_onPackage(swConnection *conn, char *data, uint32_t length);
 static void client_onClose(swClient *cli);
 static void client_onError(swClient *cli);
 
+static swClientPool* client_pool_get(zval *object, char *key, int key_len TSRMLS_DC);
+static void client_pool_release(zval *object, swClient *cli, int release_object TSRMLS_DC);
+static void client_pool_free_client(swClient *cli);
+static void client_pool_onProbe(void *object);
+static void client_pool_set_probe(long interval);
+
 static sw_inline void client_execute_callback(swClient *cli, enum client_callback_type type)
 {
 #if PHP_MAJOR_VERSION < 7
@@ -143,7 +149,12 @@ static const zend_function_entry swoole_client_methods[] =
     PHP_FE_END
 };
 
+/**
+ * per-worker connection pools, key is host:port or the connection id
+ */
 static swHashMap *php_sw_long_connections;
+static long php_sw_pool_probe_timer = -1;
+static long php_sw_pool_probe_interval = SW_CLIENT_POOL_PROBE_INTERVAL;
 
 zend_class_entry swoole_client_ce;
 zend_class_entry *swoole_client_class_entry_ptr;
@@ -229,6 +240,176 @@ static void client_onError(swClient *cli)
     client_execute_callback(cli, SW_CLIENT_CALLBACK_onError);
 }
 
+static swClientPool* client_pool_get(zval *object, char *key, int key_len TSRMLS_DC)
+{
+    swClientPool *pool = swHashMap_find(php_sw_long_connections, key, key_len);
+    if (pool == NULL)
+    {
+        pool = swClientPool_new(key, key_len, 0, SW_CLIENT_POOL_MAX_SIZE);
+        if (pool == NULL)
+        {
+            return NULL;
+        }
+        pool->onFree = client_pool_free_client;
+        if (swHashMap_add(php_sw_long_connections, key, key_len, pool, NULL) == FAILURE)
+        {
+            swoole_php_fatal_error(E_WARNING, "swoole_client_create_socket add to hashtable failed.");
+            swClientPool_free(pool);
+            return NULL;
+        }
+    }
+
+    zval *zset = sw_zend_read_property(Z_OBJCE_P(object), object, ZEND_STRL("setting"), 1 TSRMLS_CC);
+    if (zset == NULL || ZVAL_IS_NULL(zset) || Z_TYPE_P(zset) != IS_ARRAY)
+    {
+        return pool;
+    }
+
+    HashTable *vht = Z_ARRVAL_P(zset);
+    zval *v;
+
+    if (sw_zend_hash_find(vht, ZEND_STRS("pool_max_size"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        pool->max_size = (uint32_t) Z_LVAL_P(v);
+    }
+    if (sw_zend_hash_find(vht, ZEND_STRS("pool_min_size"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        pool->min_size = (uint32_t) Z_LVAL_P(v);
+    }
+    if (sw_zend_hash_find(vht, ZEND_STRS("pool_idle_timeout"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        pool->idle_timeout = (uint32_t) Z_LVAL_P(v);
+    }
+    if (sw_zend_hash_find(vht, ZEND_STRS("pool_max_lifetime"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        pool->max_lifetime = (uint32_t) Z_LVAL_P(v);
+    }
+    /**
+     * liveness probe for the idle connections, 0 to disable it.
+     */
+    if (sw_zend_hash_find(vht, ZEND_STRS("pool_probe_interval"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        client_pool_set_probe(Z_LVAL_P(v));
+    }
+    else
+    {
+        client_pool_set_probe(php_sw_pool_probe_interval);
+    }
+    return pool;
+}
+
+/**
+ * the probe timer only work with event loop, it is removed when the interval is 0 or there is no pool.
+ */
+static void client_pool_set_probe(long interval)
+{
+    if (php_sw_pool_probe_timer >= 0 && (interval != php_sw_pool_probe_interval || interval <= 0))
+    {
+        php_swoole_del_timer_internal(php_sw_pool_probe_timer);
+        php_sw_pool_probe_timer = -1;
+    }
+    php_sw_pool_probe_interval = interval;
+    if (interval > 0 && php_sw_pool_probe_timer < 0 && SwooleG.main_reactor)
+    {
+        php_sw_pool_probe_timer = php_swoole_add_timer_internal((int) interval, client_pool_onProbe, NULL, 1);
+    }
+}
+
+/**
+ * give back the connection to the pool, the php object will not receive any event.
+ */
+static void client_pool_release(zval *object, swClient *cli, int release_object TSRMLS_DC)
+{
+    if (cli->async)
+    {
+        if (!cli->socket->removed)
+        {
+            SwooleG.main_reactor->del(SwooleG.main_reactor, cli->socket->fd);
+        }
+        cli->onConnect = NULL;
+        cli->onReceive = NULL;
+        cli->onError = NULL;
+        cli->onClose = NULL;
+        if (cli->object && release_object)
+        {
+            zval *zobject = cli->object;
+            sw_zval_ptr_dtor(&zobject);
+#if PHP_MAJOR_VERSION >= 7
+            efree(zobject);
+#endif
+        }
+        cli->object = NULL;
+    }
+    swoole_set_object(object, NULL);
+    swClientPool_release(cli->pool, cli);
+}
+
+static void client_pool_free_client(swClient *cli)
+{
+    if (!cli->async)
+    {
+        sw_free(cli->socket);
+    }
+    sw_free(cli->server_str);
+    pefree(cli, 1);
+}
+
+/**
+ * for swoole_http_client, give back the connection or free it if closed.
+ */
+void php_swoole_client_pool_free(zval *object, swClient *cli TSRMLS_DC)
+{
+    if (!cli->closed && cli->pool)
+    {
+        client_pool_release(object, cli, 0 TSRMLS_CC);
+        return;
+    }
+    if (cli->pool)
+    {
+        swClientPool_remove(cli->pool, cli);
+    }
+    client_pool_free_client(cli);
+}
+
+static void client_pool_onProbe(void *object)
+{
+    swClientPool *pool;
+    char *key;
+
+    int pool_num;
+
+    swHashMap_each_reset(php_sw_long_connections);
+    while ((pool = swHashMap_each(php_sw_long_connections, &key)))
+    {
+        swClientPool_check(pool);
+    }
+
+    //free the pools without connections, the iterator can not go on after a delete
+    free_pool:
+    pool_num = 0;
+    swHashMap_each_reset(php_sw_long_connections);
+    while ((pool = swHashMap_each(php_sw_long_connections, &key)))
+    {
+        if (pool->num == 0)
+        {
+            swHashMap_del(php_sw_long_connections, pool->key, pool->key_len);
+            swClientPool_free(pool);
+            goto free_pool;
+        }
+        pool_num++;
+    }
+    if (pool_num == 0 && php_sw_pool_probe_timer >= 0)
+    {
+        php_swoole_del_timer_internal(php_sw_pool_probe_timer);
+        php_sw_pool_probe_timer = -1;
+    }
+}
+
 static void client_check_setting(swClient *cli, zval *zset TSRMLS_DC)
 {
     HashTable *vht;
@@ -492,8 +673,7 @@ swClient* php_swoole_client_create_socket(zval *object, char *host, int host_len
     int packet_mode = 0;
     char conn_key[SW_LONG_CONNECTION_KEY_LEN];
     int conn_key_len = 0;
-    uint64_t tmp_buf;
-    int ret;
+    swClientPool *pool;
 
 #if PHP_MAJOR_VERSION < 7
     TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
@@ -538,40 +718,40 @@ swClient* php_swoole_client_create_socket(zval *object, char *host, int host_len
     //keep the tcp connection
     if (type & SW_FLAG_KEEP)
     {
-        swClient *find = swHashMap_find(php_sw_long_connections, conn_key, conn_key_len);
-        if (find == NULL)
+        pool = client_pool_get(object, conn_key, conn_key_len TSRMLS_CC);
+        if (pool == NULL)
         {
-            cli = (swClient*) pemalloc(sizeof(swClient), 1);
-            if (swHashMap_add(php_sw_long_connections, conn_key, conn_key_len, cli, NULL) == FAILURE)
-            {
-                swoole_php_fatal_error(E_WARNING, "swoole_client_create_socket add to hashtable failed.");
-            }
-            goto create_socket;
+            return NULL;
         }
-        else
+        cli = swClientPool_get(pool);
+        if (cli)
         {
-            cli = find;
-            //try recv, check connection status
-            ret = recv(cli->socket->fd, &tmp_buf, sizeof(tmp_buf), MSG_DONTWAIT | MSG_PEEK);
-            if (ret == 0 || (ret < 0 && swConnection_error(errno) == SW_CLOSE))
-            {
-                cli->close(cli);
-                goto create_socket;
-            }
-            //clear history data
-            if (ret > 0)
-            {
-                swSocket_clean(cli->socket->fd);
-            }
+            goto set_object;
         }
+        if (swClientPool_full(pool))
+        {
+            pool->full_count++;
+            swoole_php_error(E_WARNING, "the connection pool of [%s] is full, max_size=%d.", conn_key, pool->max_size);
+            zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("errCode"), SW_ERROR_CLIENT_POOL_FULL TSRMLS_CC);
+            return NULL;
+        }
+        cli = (swClient*) pemalloc(sizeof(swClient), 1);
+        if (swClient_create(cli, php_swoole_socktype(type), async) < 0)
+        {
+            pefree(cli, 1);
+            goto create_error;
+        }
+        swClientPool_add(pool, cli);
+        cli->server_str = strdup(conn_key);
+        cli->server_strlen = conn_key_len;
     }
     else
     {
         cli = (swClient*) emalloc(sizeof(swClient));
-
-        create_socket:
         if (swClient_create(cli, php_swoole_socktype(type), async) < 0)
         {
+            efree(cli);
+            create_error:
             swoole_php_fatal_error(E_WARNING, "swClient_create() failed. Error: %s [%d]", strerror(errno), errno);
             zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("errCode"), errno TSRMLS_CC);
             return NULL;
@@ -582,6 +762,7 @@ swClient* php_swoole_client_create_socket(zval *object, char *host, int host_len
         cli->server_strlen = conn_key_len;
     }
 
+    set_object:
     zend_update_property_long(swoole_client_class_entry_ptr, object, ZEND_STRL("sock"), cli->socket->fd TSRMLS_CC);
 
     if (type & SW_FLAG_KEEP)
@@ -652,15 +833,14 @@ static PHP_METHOD(swoole_client, __destruct)
         //connection is closed, release swClient memoty
         if (cli->closed)
         {
-            //long tcp connection, delete from php_sw_long_connections
+            //long tcp connection, remove from the connection pool
             if (cli->keep)
             {
-                if (swHashMap_del(php_sw_long_connections, cli->server_str, cli->server_strlen))
+                if (cli->pool)
                 {
-                    swoole_php_fatal_error(E_WARNING, "delete from hashtable failed.");
+                    swClientPool_remove(cli->pool, cli);
                 }
-                sw_free(cli->server_str);
-                pefree(cli, 1);
+                client_pool_free_client(cli);
             }
             else
             {
@@ -673,6 +853,11 @@ static PHP_METHOD(swoole_client, __destruct)
         {
             cli->close(cli);
         }
+        //give back to the connection pool
+        else if (cli->pool)
+        {
+            client_pool_release(getThis(), cli, 0 TSRMLS_CC);
+        }
     }
 
     //unset object
@@ -763,10 +948,10 @@ static PHP_METHOD(swoole_client, connect)
         }
     }
 
+    int reuse = 0;
     if (cli->keep == 1 && cli->socket->active == 1)
     {
-        zend_update_property_bool(swoole_client_class_entry_ptr, getThis(), SW_STRL("reuse")-1, 1 TSRMLS_CC);
-        RETURN_TRUE;
+        reuse = 1;
     }
     else if (cli->socket->active == 1)
     {
@@ -774,20 +959,23 @@ static PHP_METHOD(swoole_client, connect)
         RETURN_FALSE;
     }
 
-    zval *zset = sw_zend_read_property(swoole_client_class_entry_ptr, getThis(), ZEND_STRL("setting"), 1 TSRMLS_CC);
-    if (zset && !ZVAL_IS_NULL(zset))
+    if (!reuse)
     {
-        client_check_setting(cli, zset TSRMLS_CC);
-    }
+        zval *zset = sw_zend_read_property(swoole_client_class_entry_ptr, getThis(), ZEND_STRL("setting"), 1 TSRMLS_CC);
+        if (zset && !ZVAL_IS_NULL(zset))
+        {
+            client_check_setting(cli, zset TSRMLS_CC);
+        }
 
 #ifdef SW_USE_OPENSSL
-    //ssl/tls
-    if (cli->open_ssl && swClient_enable_ssl_encrypt(cli) < 0)
-    {
-        swoole_php_fatal_error(E_ERROR, "no receive callback.");
-        RETURN_FALSE;
-    }
+        //ssl/tls
+        if (cli->open_ssl && swClient_enable_ssl_encrypt(cli) < 0)
+        {
+            swoole_php_fatal_error(E_ERROR, "no receive callback.");
+            RETURN_FALSE;
+        }
 #endif
+    }
 
     //nonblock async
     if (cli->async)
@@ -845,6 +1033,25 @@ static PHP_METHOD(swoole_client, connect)
         cli->reactor_fdtype = PHP_SWOOLE_FD_CLIENT;
     }
 
+    //borrowed from the connection pool
+    if (reuse)
+    {
+        zend_update_property_bool(swoole_client_class_entry_ptr, getThis(), SW_STRL("reuse")-1, 1 TSRMLS_CC);
+        /**
+         * the socket is writable at once, onConnect will be called in the event loop,
+         * same as a new connection.
+         */
+        if (cli->async && swSocket_is_stream(cli->type))
+        {
+            cli->socket->active = 0;
+            if (SwooleG.main_reactor->add(SwooleG.main_reactor, cli->socket->fd, cli->reactor_fdtype | SW_EVENT_WRITE) < 0)
+            {
+                RETURN_FALSE;
+            }
+        }
+        RETURN_TRUE;
+    }
+
     //nonblock async
     if (cli->connect(cli, host, port, timeout, sock_flag) < 0)
     {
@@ -1060,6 +1267,7 @@ static PHP_METHOD(swoole_client, recv)
 
         swString *buffer = cli->buffer;
         int eof = -1;
+        uint32_t scan = 0;
 
         while (1)
         {
@@ -1091,10 +1299,10 @@ static PHP_METHOD(swoole_client, recv)
                 continue;
             }
 
-            eof = swoole_strnpos(buffer->str, buffer->length, protocol->package_eof, protocol->package_eof_len);
+            eof = swoole_strnpos(buffer->str + scan, buffer->length - scan, protocol->package_eof, protocol->package_eof_len);
             if (eof >= 0)
             {
-                eof += protocol->package_eof_len;
+                eof += scan + protocol->package_eof_len;
                 SW_RETVAL_STRINGL(buffer->str, eof, 1);
 
                 if (buffer->length > eof)
@@ -1111,6 +1319,8 @@ static PHP_METHOD(swoole_client, recv)
             }
             else
             {
+                //the bytes received before are already scanned
+                scan = buffer->length - protocol->package_eof_len + 1;
                 if (buffer->length == protocol->package_max_length)
                 {
                     swoole_php_error(E_WARNING, "no package eof");
@@ -1376,6 +1586,11 @@ static PHP_METHOD(swoole_client, close)
     {
         ret = cli->close(cli);
     }
+    //give back to the connection pool
+    else if (cli->pool)
+    {
+        client_pool_release(getThis(), cli, 1 TSRMLS_CC);
+    }
     SW_CHECK_RETURN(ret);
 }
 
@@ -1656,3 +1871,31 @@ static int client_select_add(zval *sock_array, fd_set *fds, int *max_fd TSRMLS_D
     SW_HASHTABLE_FOREACH_END();
     return num ? 1 : 0;
 }
+
+PHP_FUNCTION(swoole_client_pool_stats)
+{
+    swClientPool *pool;
+    char *key;
+    zval *item;
+
+    array_init(return_value);
+
+    swHashMap_each_reset(php_sw_long_connections);
+    while ((pool = swHashMap_each(php_sw_long_connections, &key)))
+    {
+        SW_MAKE_STD_ZVAL(item);
+        array_init(item);
+        add_assoc_long(item, "num", pool->num);
+        add_assoc_long(item, "idle_num", pool->idle_list->num);
+        add_assoc_long(item, "min_size", pool->min_size);
+        add_assoc_long(item, "max_size", pool->max_size);
+        add_assoc_long(item, "idle_timeout", pool->idle_timeout);
+        add_assoc_long(item, "max_lifetime", pool->max_lifetime);
+        add_assoc_long(item, "create_count", pool->create_count);
+        add_assoc_long(item, "reuse_count", pool->reuse_count);
+        add_assoc_long(item, "close_count", pool->close_count);
+        add_assoc_long(item, "probe_fail_count", pool->probe_fail_count);
+        add_assoc_long(item, "full_count", pool->full_count);
+        add_assoc_zval(return_value, pool->key, item);
+    }
+}
@@ -41,6 +41,11 @@
 #define SW_SOCKET_BUFFER_SIZE      (8*1024*1024)
 
 #define SW_GLOBAL_MEMORY_PAGESIZE  (1024*1024*2) //全局内存的分页
+#define SW_SLAB_POOL_SIZE          (1024*1024*64) //reserved for the slab pool, the pages are mapped when they are used
+#define SW_SLAB_PAGE_SIZE          (1024*64)
+#define SW_SLAB_MAGAZINE_SIZE      32            //free objects cached by each process for a size class
+#define SW_HUGEPAGE_SIZE           (1024*1024*2)
+#define SW_HUGEPAGE_MIN            (1024*1024*2) //the smaller regions are not backed by the huge pages
 
 #define SW_MAX_THREAD_NCPU         4 // n * cpu_num
 #define SW_MAX_WORKER_NCPU         1000 // n * cpu_num
@@ -57,6 +62,9 @@
 #define SW_CLIENT_DEFAULT_TIMEOUT  0.5
 #define SW_CLIENT_MAX_PORT         65535
 //#define SW_CLIENT_SOCKET_WAIT
+#define SW_CLIENT_POOL_MAX_SIZE          64
+#define SW_CLIENT_POOL_IDLE_TIMEOUT      60    //seconds
+#define SW_CLIENT_POOL_PROBE_INTERVAL    5000  //ms
 
 //!!!Don't modify.----------------------------------------------------------
 #if __MACH__
@@ -74,6 +82,8 @@
 
 #define SW_BUFFER_SIZE_BIG         65536
 #define SW_BUFFER_SIZE_UDP         65536
+#define SW_DGRAM_BATCH_MAX         64            //vector size of recvmmsg and sendmmsg
+#define SW_DGRAM_QUEUE_SIZE        (1024*64)     //replies queued by the worker while handling a dgram batch
 #define SW_SENDFILE_TRUNK          65536
 
 #define SW_SENDFILE_MAXLEN         4194304
@@ -83,6 +93,9 @@
 
 #define SW_DATA_EOF                "\r\n\r\n"
 #define SW_DATA_EOF_MAXLEN         8
+#define SW_PACKAGE_BATCH_MAX       128           //length check packages dispatched as a batch
+#define SW_STRNPOS_MEMCHR_MISS     8             //false candidates before the simd kernels take over from memchr
+#define SW_STRNPOS_SIMD_MIN        512           //shorter haystacks are searched by memchr, the simd kernels are not faster
 
 #define SW_HEARTBEAT_PING_LEN      8
 #define SW_HEARTBEAT_PONG_LEN      8
@@ -130,6 +143,10 @@
 
 #define SW_MSGMAX                        8192
 
+#define SW_PROCESS_CHANNEL_SIZE          (8 * 1024 * 1024)
+#define SW_PROCESS_CHANNEL_MAXLEN        (1024 * 1024)
+#define SW_PROCESS_CHANNEL_MIN_SIZE      (1024 * 64)
+
 /**
  * 最大Reactor线程数量，默认会启动CPU核数的线程数
  * 如果超过8核，默认启动8个线程
@@ -167,6 +184,15 @@
 #define SW_BUFFER_OUTPUT_SIZE            (1024*1024*2)
 #define SW_BUFFER_INPUT_SIZE             (1024*1024*2)
 #define SW_PIPE_BUFFER_SIZE              (1024*1024*32)
+#define SW_PIPE_RESUME_INTERVAL          10     //ms, check the paused connections
+
+/**
+ * SW_IPC_CHANNEL, the ring size of each reactor thread and worker pair
+ */
+#define SW_IPC_CHANNEL_SIZE              (1024*256)
+#define SW_IPC_CHANNEL_SPIN_MIN          16
+#define SW_IPC_CHANNEL_SPIN_MAX          4096
+#define SW_IPC_CHANNEL_BATCH             256
 
 #define SW_MEMORY_POOL_SLAB_PAGE         10     //内存池的页数
 
@@ -197,7 +223,10 @@
 
 #define SW_TABLE_CONFLICT_PROPORTION     0.2 //20%
 #define SW_TABLE_COMPRESS_PROPORTION     0.5 //50% skip, will compress the row list
-//#define SW_TABLE_USE_PHP_HASH
+#define SW_TABLE_FIND_BLOCK              64  //rows compared in one batch by swTable_find
+#define SW_TABLE_RESIZE_LOAD             0.6 //split the buckets when the rows exceed 60% of them
+#define SW_TABLE_RESIZE_STEP             2   //buckets split by one swTableRow_set
+#define SW_TABLE_SWEEP_STEP              2   //buckets swept for the expired rows by one swTableRow_set
 //#define SW_TABLE_DEBUG
 
 #define SW_SSL_BUFSIZE  16384
@@ -212,14 +241,25 @@
 #define SW_DNS_LOOKUP_USE_THREAD
 
 //#define SW_HTTP_CLIENT_ENABLE
+#define SW_HTTP_CLIENT_RECONNECT         1
+
+#define SW_MYSQL_CONNECT_TIMEOUT         1.0
+
+#define SW_REDIS_CONNECT_TIMEOUT         1.0
+#define SW_REDIS_MAX_DEPTH               8
+#define SW_REDIS_MAX_REDIRECTS           5
 
 #define SW_HTTP_SERVER_SOFTWARE          "swoole-http-server"
 #define SW_HTTP_BAD_REQUEST              "<h1>400 Bad Request</h1>\r\n"
 #define SW_HTTP_PARAM_MAX_NUM            128
 #define SW_HTTP_COOKIE_KEYLEN            128
+#define SW_HTTP_HEADER_KEY_SIZE          128
+#define SW_HTTP_HEAD_RESERVE_SIZE        512   //status line and the default headers of the response
+#define SW_HTTP_RANGE_MAX                32    //more ranges in the Range header, the whole file is sent
 #define SW_HTTP_COOKIE_VALLEN            2048
 #define SW_HTTP_RESPONSE_INIT_SIZE       65536
 #define SW_HTTP_HEADER_MAX_SIZE          8192
+#define SW_HTTP_INDEX_HEADER_MAX         64    //headers indexed by the reactor thread
 #define SW_HTTP_COMPRESS_GZIP
 #define SW_HTTP_UPLOAD_TMP_FILE          "/tmp/swoole.upfile.XXXXXX"
 #define SW_HTTP_DATE_FORMAT              "D, d M Y H:i:s T"
@@ -227,5 +267,8 @@
 
 #define SW_WEBSOCKET_SERVER_SOFTWARE     "swoole-websocket-server"
 #define SW_WEBSOCKET_VERSION             "13"
+#define SW_WEBSOCKET_COMPRESSION_LEVEL      1
+#define SW_WEBSOCKET_COMPRESSION_THRESHOLD  256   //smaller messages are not compressed
+#define SW_WEBSOCKET_INFLATE_POOL_SIZE      16    //the idle inflate streams kept by each reactor thread
 
 #endif /* SWOOLE_CONFIG_H_ */
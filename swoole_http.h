@@ -22,6 +22,8 @@
 #include "thirdparty/php_http_parser.h"
 #include "thirdparty/multipart_parser.h"
 
+#include "Http.h"
+
 typedef struct
 {
     enum php_http_method method;
@@ -35,6 +37,19 @@ typedef struct
     char *post_content;
     uint32_t post_length;
 
+    /**
+     * the arrays are built on the first access of the property, from the offsets in zdata
+     */
+    uint8_t lazy;
+    const char *query_string;
+    uint32_t query_string_len;
+    const char *body;
+
+    long request_time;
+    int server_port;
+    int remote_port;
+    char remote_addr[INET6_ADDRSTRLEN];
+
     zval *zdata;
 
     zval *zrequest_object;
@@ -74,6 +89,20 @@ typedef struct
     uint32_t request_read :1;
     uint32_t current_header_name_allocated :1;
     uint32_t content_sender_initialized :1;
+    /**
+     * the head is received, the body comes in the SW_EVENT_HTTP_BODY events
+     */
+    uint32_t stream :1;
+    /**
+     * the arguments of onRequest reference the request object, the arrays are checked after the callback
+     */
+    uint32_t request_callback :1;
+    uint32_t request_free_later :1;
+    uint32_t stream_length;
+    /**
+     * the head parsed by the reactor thread
+     */
+    swHttpIndex index;
 
     http_request request;
     http_response response;
@@ -27,6 +27,21 @@ typedef struct
     uint gc_idx;
 } http_client_callback;
 
+typedef struct
+{
+    swString *buffer;
+    zval *callback;
+#if PHP_MAJOR_VERSION >= 7
+    zval _callback;
+#endif
+    int download_fd;
+    uint8_t sent;
+    /**
+     * GET request, can be sent again after the connection was reset
+     */
+    uint8_t idempotent;
+} http_client_request;
+
 typedef struct
 {
     swClient *cli;
@@ -34,21 +49,37 @@ typedef struct
     zend_size_t host_len;
     long port;
     double timeout;
-    char* uri;
-    zend_size_t uri_len;
-    
+
+    zval *object;
+#if PHP_MAJOR_VERSION >= 7
+    zval _object;
+#endif
+
     char *tmp_header_field_name;
     zend_size_t tmp_header_field_name_len;
-    
+
     char *body;
 
     php_http_parser parser;
-    
+
+    /**
+     * queued and in flight requests, the head is waiting for the response
+     */
+    swLinkedList *requests;
+    uint32_t sent_num;
+    uint32_t conn_request_num;
+
+    uint8_t pipeline;
+    uint8_t reconnect;  //max retry times when the connection was reset with requests in flight
+    uint8_t retry;
+    long reconnect_timer;
+
     int phase;  //0 wait 1 ready 2 busy
     int keep_alive;  //0 no 1 keep
 
 } http_client;
 
+static int http_client_parser_on_message_begin(php_http_parser *parser);
 static int http_client_parser_on_header_field(php_http_parser *parser, const char *at, size_t length);
 static int http_client_parser_on_header_value(php_http_parser *parser, const char *at, size_t length);
 static int http_client_parser_on_body(php_http_parser *parser, const char *at, size_t length);
@@ -64,7 +95,7 @@ static sw_inline void http_client_swString_append_headers(swString* swStr, char*
 
 static const php_http_parser_settings http_parser_settings =
 {
-    NULL,
+    http_client_parser_on_message_begin,
     NULL,
     NULL,
     NULL,
@@ -83,19 +114,29 @@ static PHP_METHOD(swoole_http_client, set);
 static PHP_METHOD(swoole_http_client, setHeaders);
 static PHP_METHOD(swoole_http_client, setData);
 static PHP_METHOD(swoole_http_client, execute);
+static PHP_METHOD(swoole_http_client, download);
 static PHP_METHOD(swoole_http_client, isConnected);
 static PHP_METHOD(swoole_http_client, close);
 static PHP_METHOD(swoole_http_client, on);
 
 static void http_client_free(zval *object, http_client *http);
+static void http_client_free_cli(zval *object, http_client *http TSRMLS_DC);
 static int http_client_error_callback(zval *zobject, swEvent *event, int error TSRMLS_DC);
 static int http_client_send_http_request(zval *zobject TSRMLS_DC);
 static http_client* http_client_create(zval *object TSRMLS_DC);
+static int http_client_connect(zval *zobject, http_client *http TSRMLS_DC);
+static int http_client_execute(zval *zobject, char *uri, zend_size_t uri_len, char *download_file, zval *callback TSRMLS_DC);
+static int http_client_retry(http_client *http);
+static void http_client_onReconnect(void *object);
+
+static http_client_request* http_client_request_new(zval *zobject, http_client *http, char *uri, zend_size_t uri_len, zval *callback TSRMLS_DC);
+static void http_client_request_free(http_client_request *req TSRMLS_DC);
+static void http_client_request_clear(http_client *http TSRMLS_DC);
+static void http_client_request_abort(zval *zobject, int error TSRMLS_DC);
 
 static zval* http_client_get_cb(zval *zobject, char *cb_name, int cb_name_len TSRMLS_DC);
 static void http_client_set_cb(zval *zobject, char *cb_name, int cb_name_len, zval *zcb TSRMLS_DC);
 
-
 static zval* http_client_get_cb(zval *zobject, char *cb_name, int cb_name_len TSRMLS_DC)
 {
     return sw_zend_read_property(
@@ -131,6 +172,7 @@ static const zend_function_entry swoole_http_client_methods[] =
     PHP_ME(swoole_http_client, setHeaders, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_http_client, setData, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_http_client, execute, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_http_client, download, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_http_client, isConnected, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_http_client, close, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_http_client, on, NULL, ZEND_ACC_PUBLIC)
@@ -148,6 +190,7 @@ void swoole_http_client_init(int module_number TSRMLS_DC)
 
     zend_declare_property_long(swoole_http_client_class_entry_ptr, SW_STRL("errCode")-1, 0, ZEND_ACC_PUBLIC TSRMLS_CC);
     zend_declare_property_long(swoole_http_client_class_entry_ptr, SW_STRL("sock")-1, 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_http_client_class_entry_ptr, SW_STRL("statusCode")-1, 0, ZEND_ACC_PUBLIC TSRMLS_CC);
 }
 
 /**
@@ -175,7 +218,24 @@ static void http_client_onClose(swClient *cli)
     {
         return;
     }
- 
+
+    //there are requests waiting for the connection, reconnect in the next loop
+    if (http->requests->num > 0)
+    {
+        if (http_client_retry(http) == SW_OK)
+        {
+            return;
+        }
+        swoole_php_error(E_WARNING, "connection is reset by the server, %d requests are discarded.", http->requests->num);
+        http_client_request_abort(zobject, ECONNRESET TSRMLS_CC);
+        //destroyed in the finish callback
+        if (!swoole_get_object(zobject))
+        {
+            sw_zval_ptr_dtor(&zobject);
+            return;
+        }
+    }
+
     zcallback = http_client_get_cb(zobject, ZEND_STRL("close") TSRMLS_CC);
     if (zcallback == NULL || ZVAL_IS_NULL(zcallback))
     {
@@ -228,6 +288,14 @@ static void http_client_onError(swClient *cli)
         return;
     }
 
+    //connect failed, the queued requests cannot be sent
+    http_client_request_abort(zobject, SwooleG.error TSRMLS_CC);
+    if (!swoole_get_object(zobject))
+    {
+        sw_zval_ptr_dtor(&zobject);
+        return;
+    }
+
     zcallback = http_client_get_cb(zobject, ZEND_STRL("error") TSRMLS_CC);
     if (zcallback == NULL || ZVAL_IS_NULL(zcallback))
     {
@@ -256,6 +324,10 @@ static void http_client_onError(swClient *cli)
 
 static void http_client_free(zval *object, http_client *http)
 {
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
     //printf("http_client_free()\n");
     if (!http)
     {
@@ -263,32 +335,52 @@ static void http_client_free(zval *object, http_client *http)
     }
     swoole_set_object(object, NULL);
 
+    if (http->reconnect_timer >= 0)
+    {
+        php_swoole_del_timer_internal(http->reconnect_timer);
+        http->reconnect_timer = -1;
+    }
+
     if (http->cli)
     {
+        http_client_free_cli(object, http TSRMLS_CC);
+    }
 
-#if PHP_MAJOR_VERSION >= 7
-        //for php7 object was allocated sizeof(zval) when execute
-        if (http->cli->socket->object)
+    http_client_request_clear(http TSRMLS_CC);
+    sw_free(http->requests);
+
+    //printf("free http\n");
+    efree(http);
+}
+
+static void http_client_free_cli(zval *object, http_client *http TSRMLS_DC)
+{
+    swClient *cli = http->cli;
+    http->cli = NULL;
+
+    //keep-alive connection, give back to the connection pool
+    if (cli->keep)
+    {
+        //the response is not complete, cannot reuse this connection
+        if (http->phase != 1 && !cli->closed)
         {
-            //printf("free http->cli->socket->object\n");
-            efree(http->cli->socket->object);
+            cli->onClose = NULL;
+            cli->close(cli);
         }
-#endif
-        http->cli->socket->object = NULL;
-
+        php_swoole_client_pool_free(object, cli TSRMLS_CC);
+    }
+    else
+    {
         //close connect when __destruct
-        if (http->cli->socket->fd != 0)
+        if (!cli->closed)
         {
             //printf("http->cli->close()\n");
-            http->cli->close(http->cli);
+            cli->onClose = NULL;
+            cli->close(cli);
         }
-
         //printf("free http->cli\n");
-        efree(http->cli);
-        efree(http->uri);
+        efree(cli);
     }
-    //printf("free http\n");
-    efree(http);
 }
 
 static void http_client_onReceive(swClient *cli, char *data, uint32_t length)
@@ -299,18 +391,26 @@ static void http_client_onReceive(swClient *cli, char *data, uint32_t length)
 
     zval *zobject = cli->object;
     http_client *http = swoole_get_object(zobject);
-    if (!http->cli)
+    if (!http || !http->cli)
     {
         swoole_php_fatal_error(E_WARNING, "object is not instanceof swoole_http_client.");
         return;
     }
+#if PHP_MAJOR_VERSION >= 7
+    zval _zobject = *zobject;
+    zobject = &_zobject;
+#endif
+    //the object may be released in the callbacks
+    sw_zval_add_ref(&zobject);
 
-    long parsed_n = php_http_parser_execute(&http->parser, &http_parser_settings, data, length);
-    if (parsed_n < 0)
+    size_t parsed_n = php_http_parser_execute(&http->parser, &http_parser_settings, data, length);
+    //the parser is stopped when the client is closed or reconnected in the callbacks, it is not an error
+    if (parsed_n < length && swoole_get_object(zobject) == http && http->cli == cli && !cli->closed)
     {
-        swSysError("Parsing http over socket[%d] failed.", cli->socket->fd);
+        swWarn("Parsing http over socket[%d] failed.", cli->socket->fd);
         cli->close(cli);
     }
+    sw_zval_ptr_dtor(&zobject);
 }
 
 static void http_client_onConnect(swClient *cli)
@@ -330,30 +430,13 @@ static void http_client_onConnect(swClient *cli)
     http_client_send_http_request(zobject TSRMLS_CC);
 }
 
-static int http_client_send_http_request(zval *zobject TSRMLS_DC)
+/**
+ * pack the request with set_data and set_headers, the request will be sent when the connection is ready.
+ */
+static http_client_request* http_client_request_new(zval *zobject, http_client *http, char *uri, zend_size_t uri_len, zval *callback TSRMLS_DC)
 {
-    http_client *http = swoole_get_object(zobject);
-    if (!http->cli)
-    {
-        swoole_php_fatal_error(E_WARNING, "object is not instanceof swoole_http_client.");
-        return SW_ERR;
-    }
-    
-    if (!http->cli->socket && http->cli->socket->active == 0)
-    {
-        swoole_php_error(E_WARNING, "server is not connected.");
-        return SW_ERR;
-    }
-    
-    if (http->phase != 1)
-    {
-        swoole_php_error(E_WARNING, "http client is not ready.");
-        return SW_ERR;
-    }
-    
-    http->phase = 2;
-     //clear errno
-    SwooleG.error = 0;
+    http_client_request *req = emalloc(sizeof(http_client_request));
+    bzero(req, sizeof(http_client_request));
 
     swString* req_buff = swString_new(512);
     swString* header_buff = swString_new(512);
@@ -378,10 +461,11 @@ static int http_client_send_http_request(zval *zobject TSRMLS_DC)
     else
     {
         swString_append_ptr(req_buff, ZEND_STRL("GET "));
+        req->idempotent = 1;
     }
     zend_update_property_null(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("set_data") TSRMLS_CC);
 
-    swString_append_ptr(req_buff, http->uri, http->uri_len);
+    swString_append_ptr(req_buff, uri, uri_len);
     swString_append_ptr(req_buff, ZEND_STRL(" HTTP/1.1\r\n"));
 
     zval* zheaders = sw_zend_read_property(
@@ -417,24 +501,164 @@ static int http_client_send_http_request(zval *zobject TSRMLS_DC)
     swString_append_ptr(req_buff, ZEND_STRL("\r\n"));
     swString_append(req_buff, post_buff);
 
-    int ret;
+    swString_free(header_buff);
+    swString_free(post_buff);
+
+    req->buffer = req_buff;
+    if (callback && !ZVAL_IS_NULL(callback))
+    {
+#if PHP_MAJOR_VERSION >= 7
+        req->callback = &req->_callback;
+        memcpy(req->callback, callback, sizeof(zval));
+#else
+        req->callback = callback;
+#endif
+        sw_zval_add_ref(&req->callback);
+    }
+    return req;
+}
+
+static void http_client_request_free(http_client_request *req TSRMLS_DC)
+{
+    if (req->callback)
+    {
+        sw_zval_ptr_dtor(&req->callback);
+    }
+    if (req->download_fd > 0)
+    {
+        close(req->download_fd);
+    }
+    swString_free(req->buffer);
+    efree(req);
+}
+
+static void http_client_request_clear(http_client *http TSRMLS_DC)
+{
+    http_client_request *req;
+    while ((req = swLinkedList_shift(http->requests)))
+    {
+        http_client_request_free(req TSRMLS_CC);
+    }
+    http->sent_num = 0;
+}
+
+/**
+ * the queued requests cannot be sent, the finish callback of each one is called with statusCode -1 and errCode.
+ */
+static void http_client_request_abort(zval *zobject, int error TSRMLS_DC)
+{
+    http_client *http = swoole_get_object(zobject);
+    http_client_request *req;
+    zval *retval;
+    zval **args[1];
+    int n;
+
+    if (!http)
+    {
+        return;
+    }
+#if PHP_MAJOR_VERSION >= 7
+    zval _zobject = *zobject;
+    zobject = &_zobject;
+#endif
+    //the object may be released in the callback
+    sw_zval_add_ref(&zobject);
+
+    //the requests added in the callbacks are not aborted
+    n = http->requests->num;
+    http->sent_num = 0;
+    http->phase = 1;
+    while (n-- > 0 && (req = swLinkedList_shift(http->requests)))
+    {
+        zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("statusCode"), -1 TSRMLS_CC);
+        zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("errCode"), error TSRMLS_CC);
+        zend_update_property_string(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("body"), "" TSRMLS_CC);
+
+        if (req->callback && !ZVAL_IS_NULL(req->callback))
+        {
+            retval = NULL;
+            args[0] = &zobject;
+            if (sw_call_user_function_ex(EG(function_table), NULL, req->callback, &retval, 1, args, 0, NULL TSRMLS_CC) == FAILURE)
+            {
+                swoole_php_fatal_error(E_WARNING, "onReactorCallback handler error");
+            }
+            if (EG(exception))
+            {
+                zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+            }
+            if (retval != NULL)
+            {
+                sw_zval_ptr_dtor(&retval);
+            }
+        }
+        http_client_request_free(req TSRMLS_CC);
+        //destroyed in the callback, the rest are freed with it
+        if (!swoole_get_object(zobject))
+        {
+            break;
+        }
+    }
+    sw_zval_ptr_dtor(&zobject);
+}
+
+/**
+ * send the queued requests, only one request in flight without pipeline.
+ */
+static int http_client_send_http_request(zval *zobject TSRMLS_DC)
+{
+    http_client *http = swoole_get_object(zobject);
+    if (!http->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "object is not instanceof swoole_http_client.");
+        return SW_ERR;
+    }
+
+    //wait for onConnect
+    if (http->cli->closed || !http->cli->socket || http->cli->socket->active == 0)
+    {
+        return SW_OK;
+    }
+
+    swLinkedList_node *node;
+    http_client_request *req;
+    int ret = SW_OK;
     int flags = MSG_DONTWAIT;  //http://www.cnblogs.com/blankqdb/archive/2012/08/30/2663859.html
-    
 
-    ret = http->cli->send(http->cli, req_buff->str, req_buff->length, flags);
-    if (ret < 0)
+    for (node = http->requests->head; node; node = node->next)
     {
-        SwooleG.error = errno;
-        swoole_php_sys_error(E_WARNING, "send(%d) %d bytes failed.", http->cli->socket->fd, (int)req_buff->length);
-        zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, SW_STRL("errCode")-1, SwooleG.error TSRMLS_CC);
+        req = node->data;
+        if (req->sent)
+        {
+            continue;
+        }
+        if (http->sent_num > 0 && !http->pipeline)
+        {
+            break;
+        }
+        //Connection: closed, one request per connection
+        if (!http->keep_alive && http->conn_request_num > 0)
+        {
+            break;
+        }
+
+        http->phase = 2;
+        //clear errno
+        SwooleG.error = 0;
+
+        ret = http->cli->send(http->cli, req->buffer->str, req->buffer->length, flags);
+        if (ret < 0)
+        {
+            SwooleG.error = errno;
+            swoole_php_sys_error(E_WARNING, "send(%d) %d bytes failed.", http->cli->socket->fd, (int) req->buffer->length);
+            zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, SW_STRL("errCode")-1, SwooleG.error TSRMLS_CC);
+            return SW_ERR;
+        }
+        //printf("\n%s\n", req->buffer->str);
+        req->sent = 1;
+        http->sent_num++;
+        http->conn_request_num++;
     }
-    
-    //printf("\n%s\n", req_buff->str);
 
-    swString_free(req_buff);
-    swString_free(header_buff);
-    swString_free(post_buff);
-    
     return ret;
 }
 
@@ -477,7 +701,7 @@ static int http_client_error_callback(zval *zobject, swEvent *event, int error T
     {
         sw_zval_ptr_dtor(&retval);
     }
-    
+
     //printf("sw_zval_ptr_dtor(&zobject) on error;\n");
     sw_zval_ptr_dtor(&zobject);
     return SW_OK;
@@ -492,6 +716,21 @@ static http_client* http_client_create(zval *object TSRMLS_DC)
     http = (http_client*) emalloc(sizeof(http_client));
     bzero(http, sizeof(http_client));
 
+    http->requests = swLinkedList_new();
+    if (http->requests == NULL)
+    {
+        efree(http);
+        return NULL;
+    }
+    http->reconnect_timer = -1;
+
+#if PHP_MAJOR_VERSION >= 7
+    http->object = &http->_object;
+    memcpy(http->object, object, sizeof(zval));
+#else
+    http->object = object;
+#endif
+
     swoole_set_object(object, http);
 
     php_http_parser_init(&http->parser, PHP_HTTP_RESPONSE);
@@ -506,6 +745,7 @@ static http_client* http_client_create(zval *object TSRMLS_DC)
 
     http->timeout = SW_CLIENT_DEFAULT_TIMEOUT;
     http->keep_alive = 0;
+    http->reconnect = SW_HTTP_CLIENT_RECONNECT;
 
     zval *zset = sw_zend_read_property(swoole_http_client_class_entry_ptr, object, ZEND_STRL("setting"), 1 TSRMLS_CC);
     if (zset && !ZVAL_IS_NULL(zset))
@@ -525,6 +765,33 @@ static http_client* http_client_create(zval *object TSRMLS_DC)
         {
             http->keep_alive = (int) Z_LVAL_P(ztmp);
         }
+        /**
+         * send the requests without waiting for the response, only for keep_alive
+         */
+        if (sw_zend_hash_find(vht, ZEND_STRS("pipeline"), (void **) &ztmp) == SUCCESS)
+        {
+            convert_to_boolean(ztmp);
+            http->pipeline = Z_BVAL_P(ztmp);
+        }
+        /**
+         * resend the GET requests in flight after the connection was reset
+         */
+        if (sw_zend_hash_find(vht, ZEND_STRS("reconnect"), (void **) &ztmp) == SUCCESS)
+        {
+            convert_to_long(ztmp);
+            http->reconnect = (uint8_t) Z_LVAL_P(ztmp);
+        }
+    }
+
+    if (!http->keep_alive)
+    {
+        http->pipeline = 0;
+    }
+    //keep-alive connection will be borrowed from the connection pool
+    else
+    {
+        ztmp = sw_zend_read_property(swoole_client_class_entry_ptr, object, ZEND_STRL("type"), 0 TSRMLS_CC);
+        Z_LVAL_P(ztmp) = Z_LVAL_P(ztmp) | SW_FLAG_KEEP;
     }
 
     http->phase = 1;
@@ -532,6 +799,178 @@ static http_client* http_client_create(zval *object TSRMLS_DC)
     return http;
 }
 
+static int http_client_connect(zval *zobject, http_client *http TSRMLS_DC)
+{
+    swLinkedList_node *node;
+    http_client_request *req;
+
+    swClient *cli = php_swoole_client_create_socket(zobject, http->host, http->host_len, http->port);
+    if (cli == NULL)
+    {
+        return SW_ERR;
+    }
+    http->cli = cli;
+
+    cli->object = http->object;
+    cli->reactor_fdtype = PHP_SWOOLE_FD_CLIENT;
+    cli->onReceive = http_client_onReceive;
+    cli->onConnect = http_client_onConnect;
+
+    cli->onClose = http_client_onClose;
+    cli->onError = http_client_onError;
+
+    //new connection, all of the requests need to be sent
+    php_http_parser_init(&http->parser, PHP_HTTP_RESPONSE);
+    http->parser.data = http;
+    for (node = http->requests->head; node; node = node->next)
+    {
+        req = node->data;
+        req->sent = 0;
+    }
+    http->sent_num = 0;
+    http->conn_request_num = 0;
+    http->phase = 1;
+
+    if (cli->socket->active == 1)
+    {
+        if (!cli->keep)
+        {
+            swoole_php_fatal_error(E_WARNING, "swoole_http_client is already connected.");
+            return SW_ERR;
+        }
+        //borrowed from the connection pool, send the request at once
+        if (SwooleG.main_reactor->add(SwooleG.main_reactor, cli->socket->fd, cli->reactor_fdtype | SW_EVENT_READ) < 0)
+        {
+            return SW_ERR;
+        }
+        return http_client_send_http_request(zobject TSRMLS_CC);
+    }
+
+    return cli->connect(cli, http->host, http->port, http->timeout, 0);
+}
+
+/**
+ * the connection was reset, reconnect in the next event loop, cannot free the swClient in the onClose callback.
+ */
+static int http_client_retry(http_client *http)
+{
+    swLinkedList_node *node;
+    http_client_request *req;
+    int in_flight = 0;
+
+    if (http->reconnect_timer >= 0)
+    {
+        return SW_OK;
+    }
+
+    for (node = http->requests->head; node; node = node->next)
+    {
+        req = node->data;
+        if (!req->sent)
+        {
+            continue;
+        }
+        //POST request may have been executed by the server
+        if (!req->idempotent)
+        {
+            return SW_ERR;
+        }
+        in_flight = 1;
+    }
+
+    if (in_flight)
+    {
+        if (http->retry >= http->reconnect)
+        {
+            return SW_ERR;
+        }
+        http->retry++;
+    }
+
+    http->reconnect_timer = php_swoole_add_timer_internal(1, http_client_onReconnect, http, 0);
+    return http->reconnect_timer < 0 ? SW_ERR : SW_OK;
+}
+
+static void http_client_onReconnect(void *object)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    http_client *http = object;
+    zval *zobject = http->object;
+
+    http->reconnect_timer = -1;
+    if (http->cli)
+    {
+        http_client_free_cli(zobject, http TSRMLS_CC);
+    }
+    if (http->requests->num == 0)
+    {
+        return;
+    }
+    if (http_client_connect(zobject, http TSRMLS_CC) < 0)
+    {
+        http_client_request_abort(zobject, SwooleG.error ? SwooleG.error : ECONNREFUSED TSRMLS_CC);
+    }
+}
+
+static int http_client_execute(zval *zobject, char *uri, zend_size_t uri_len, char *download_file, zval *callback TSRMLS_DC)
+{
+    http_client_request *req;
+
+    if (uri_len <= 0)
+    {
+        return SW_ERR;
+    }
+
+    http_client *http = swoole_get_object(zobject);
+    //http is not null when keeping alive
+    if (!http)
+    {
+        http = http_client_create(zobject TSRMLS_CC);
+        if (http == NULL)
+        {
+            return SW_ERR;
+        }
+    }
+
+    if (callback == NULL || ZVAL_IS_NULL(callback))
+    {
+        swoole_php_fatal_error(E_WARNING, "finish callback is not set.");
+    }
+
+    req = http_client_request_new(zobject, http, uri, uri_len, callback TSRMLS_CC);
+    if (download_file)
+    {
+        req->download_fd = open(download_file, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (req->download_fd < 0)
+        {
+            swoole_php_sys_error(E_WARNING, "open(%s) failed.", download_file);
+            req->download_fd = 0;
+            http_client_request_free(req TSRMLS_CC);
+            return SW_ERR;
+        }
+    }
+    swLinkedList_append(http->requests, req);
+
+    //waiting for reconnect
+    if (http->reconnect_timer >= 0)
+    {
+        return SW_OK;
+    }
+    //the connection was closed by the server, reconnect at once
+    if (http->cli && http->cli->closed)
+    {
+        http_client_free_cli(zobject, http TSRMLS_CC);
+    }
+    if (!http->cli)
+    {
+        return http_client_connect(zobject, http TSRMLS_CC);
+    }
+    return http_client_send_http_request(zobject TSRMLS_CC);
+}
+
 static PHP_METHOD(swoole_http_client, __construct)
 {
     char *host;
@@ -542,7 +981,7 @@ static PHP_METHOD(swoole_http_client, __construct)
     {
         return;
     }
-    
+
     if (host_len <= 0)
     {
         swoole_php_fatal_error(E_ERROR, "host is empty.");
@@ -550,7 +989,7 @@ static PHP_METHOD(swoole_http_client, __construct)
     }
 
     zend_update_property_stringl(swoole_http_client_class_entry_ptr, getThis(), ZEND_STRL("host"), host, host_len TSRMLS_CC);
-    
+
     zend_update_property_long(swoole_http_client_class_entry_ptr,
     getThis(), ZEND_STRL("port"), port TSRMLS_CC);
 
@@ -580,7 +1019,7 @@ static PHP_METHOD(swoole_http_client, __construct)
     SW_MAKE_STD_ZVAL(ztype);
     Z_LVAL_P(ztype) = SW_SOCK_TCP | SW_FLAG_ASYNC;
     zend_update_property(swoole_client_class_entry_ptr, getThis(), ZEND_STRL("type"), ztype TSRMLS_CC);
-    
+
     RETURN_TRUE;
 }
 
@@ -588,14 +1027,15 @@ static PHP_METHOD(swoole_http_client, __destruct)
 {
     zval *headers = sw_zend_read_property(swoole_http_client_class_entry_ptr, getThis(), ZEND_STRL("headers"), 0 TSRMLS_CC);
     zval *body = sw_zend_read_property(swoole_http_client_class_entry_ptr, getThis(), ZEND_STRL("body"), 0 TSRMLS_CC);
-    
+
     sw_zval_ptr_dtor(&headers);
     sw_zval_ptr_dtor(&body);
-    
+
     http_client_set_cb(getThis(), ZEND_STRL("finish"), NULL TSRMLS_CC);
     http_client_set_cb(getThis(), ZEND_STRL("close"), NULL TSRMLS_CC);
     http_client_set_cb(getThis(), ZEND_STRL("error"), NULL TSRMLS_CC);
-    
+    http_client_set_cb(getThis(), ZEND_STRL("data"), NULL TSRMLS_CC);
+
     http_client_callback *hcc = swoole_get_property(getThis(), 0);
     int i;
     for (i = 0; i < hcc->gc_idx; i++)
@@ -605,7 +1045,7 @@ static PHP_METHOD(swoole_http_client, __destruct)
     }
     efree(hcc);
     swoole_set_property(getThis(), 0, NULL);
-    
+
     //printf("zim_swoole_http_client___destruct()\n");
     http_client *http = swoole_get_object(getThis());
     if (http)
@@ -651,90 +1091,48 @@ static PHP_METHOD(swoole_http_client, setData)
 static PHP_METHOD(swoole_http_client, execute)
 {
     int ret;
-    http_client *http = NULL;
     char *uri = NULL;
     zend_size_t uri_len = 0;
     zval *finish_cb;
-    
+
     if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &uri, &uri_len, &finish_cb) == FAILURE)
     {
         return;
     }
 
-    http = swoole_get_object(getThis());
-    if (http)   //http is not null when keeping alive
-    {
-        if (http->phase != 1 || http->cli->socket->active != 1 || http->keep_alive != 1) //http not ready
-        {
-            swoole_php_fatal_error(E_ERROR, "Operation now in progress phase %d.", http->phase);
-            
-            swEvent e;
-            e.fd = http->cli->socket->fd;
-            e.socket = http->cli->socket;
-            http_client_error_callback(getThis(), &e, errno TSRMLS_CC);
-
-            RETURN_FALSE;
-        }
-    }
-    else
-    {
-        http = http_client_create(getThis() TSRMLS_CC);
-    }
+    ret = http_client_execute(getThis(), uri, uri_len, NULL, finish_cb TSRMLS_CC);
+    SW_CHECK_RETURN(ret);
+}
 
-    if (http == NULL)
-    {
-        RETURN_FALSE;
-    }
-    
-    if (uri_len <= 0)
-    {
-        RETURN_FALSE;
-    }
+//$http_client->download($uri, $file, $callback);
+static PHP_METHOD(swoole_http_client, download)
+{
+    int ret;
+    char *uri = NULL;
+    zend_size_t uri_len = 0;
+    char *download_file = NULL;
+    zend_size_t download_file_len = 0;
+    zval *finish_cb;
 
-    http->uri = estrdup(uri);
-    http->uri_len = uri_len;
-    
-    if (finish_cb == NULL || ZVAL_IS_NULL(finish_cb))
-    {
-        swoole_php_fatal_error(E_WARNING, "finish callback is not set.");
-    }
-    http_client_set_cb(getThis(), ZEND_STRL("finish"), finish_cb TSRMLS_CC);
-    
-    if (http->cli)   //if connection exists
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ssz", &uri, &uri_len, &download_file, &download_file_len, &finish_cb) == FAILURE)
     {
-        http_client_send_http_request(getThis() TSRMLS_CC);
-        RETURN_TRUE;
-    }
-    
-    swClient *cli = php_swoole_client_create_socket(getThis(), http->host, http->host_len, http->port);
-    if (cli == NULL)
-    {
-        RETURN_FALSE;
+        return;
     }
-    http->cli = cli;
 
-    if (cli->socket->active == 1)
+    if (download_file_len <= 0)
     {
-        swoole_php_fatal_error(E_WARNING, "swoole_http_client is already connected.");
+        swoole_php_error(E_WARNING, "download file is empty.");
         RETURN_FALSE;
     }
 
-    cli->object = getThis();
-    cli->reactor_fdtype = PHP_SWOOLE_FD_CLIENT;
-    cli->onReceive = http_client_onReceive;
-    cli->onConnect = http_client_onConnect;
-
-    cli->onClose = http_client_onClose;
-    cli->onError = http_client_onError;
-
-    ret = cli->connect(cli, http->host, http->port, http->timeout, 0);
+    ret = http_client_execute(getThis(), uri, uri_len, download_file, finish_cb TSRMLS_CC);
     SW_CHECK_RETURN(ret);
 }
 
 static PHP_METHOD(swoole_http_client, isConnected)
 {
     http_client *http = swoole_get_object(getThis());
-    if (!http->cli)
+    if (!http || !http->cli)
     {
         RETURN_FALSE;
     }
@@ -750,7 +1148,7 @@ static PHP_METHOD(swoole_http_client, close)
     int ret = 1;
 
     http_client *http = swoole_get_object(getThis());
-    if (!http->cli)
+    if (!http || !http->cli)
     {
         swoole_php_fatal_error(E_WARNING, "object is not instanceof swoole_http_client.");
         RETURN_FALSE;
@@ -770,6 +1168,8 @@ static PHP_METHOD(swoole_http_client, close)
 
     if (http->cli->async == 1 && SwooleG.main_reactor != NULL)
     {
+        //closed by the user, don't reconnect
+        http_client_request_clear(http TSRMLS_CC);
         ret = http->cli->close(http->cli);
     }
     SW_CHECK_RETURN(ret);
@@ -787,7 +1187,7 @@ static PHP_METHOD(swoole_http_client, on)
     }
 
     if (strncasecmp("finish", cb_name, cb_name_len) == 0 || strncasecmp("error", cb_name, cb_name_len) == 0
-            || strncasecmp("close", cb_name, cb_name_len) == 0)
+            || strncasecmp("close", cb_name, cb_name_len) == 0 || strncasecmp("data", cb_name, cb_name_len) == 0)
     {
         http_client_set_cb(getThis(), cb_name, cb_name_len, zcallback TSRMLS_CC);
     }
@@ -796,12 +1196,45 @@ static PHP_METHOD(swoole_http_client, on)
         swoole_php_fatal_error(E_WARNING, "swoole_http_client: event callback[%s] is unknow", cb_name);
         RETURN_FALSE;
     }
-    
+
     zend_update_property(swoole_http_client_class_entry_ptr, getThis(), cb_name, cb_name_len, zcallback TSRMLS_CC);
 
     RETURN_TRUE;
 }
 
+/**
+ * new response, clear the headers and body of the last one.
+ */
+static int http_client_parser_on_message_begin(php_http_parser *parser)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    http_client* http = (http_client*) parser->data;
+    zval* zobject = http->object;
+
+    zval *headers = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("headers"), 0 TSRMLS_CC);
+    if (Z_TYPE_P(headers) == IS_ARRAY)
+    {
+        zend_hash_clean(Z_ARRVAL_P(headers));
+    }
+    zval *body = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("body"), 0 TSRMLS_CC);
+    zval_dtor(body);
+    SW_ZVAL_STRING(body, "", 1);
+
+    //the response of a reset connection, write the file from the beginning
+    http_client_request *req = http->requests->head ? http->requests->head->data : NULL;
+    if (req && req->download_fd > 0 && lseek(req->download_fd, 0, SEEK_SET) == 0)
+    {
+        if (ftruncate(req->download_fd, 0) < 0)
+        {
+            swSysError("ftruncate(%d) failed.", req->download_fd);
+        }
+    }
+    return 0;
+}
+
 static int http_client_parser_on_header_field(php_http_parser *parser, const char *at, size_t length)
 {
 // #if PHP_MAJOR_VERSION < 7
@@ -824,7 +1257,7 @@ static int http_client_parser_on_header_value(php_http_parser *parser, const cha
 
     http_client* http = (http_client*) parser->data;
     zval* zobject = (zval*) http->cli->object;
-    
+
     zval *headers = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("headers"), 0 TSRMLS_CC);
 
     char *header_name = zend_str_tolower_dup(http->tmp_header_field_name, http->tmp_header_field_name_len);
@@ -833,6 +1266,9 @@ static int http_client_parser_on_header_value(php_http_parser *parser, const cha
     return 0;
 }
 
+/**
+ * write to the download file, or stream to the data callback, or append to $client->body
+ */
 static int http_client_parser_on_body(php_http_parser *parser, const char *at, size_t length)
 {
 #if PHP_MAJOR_VERSION < 7
@@ -841,7 +1277,46 @@ static int http_client_parser_on_body(php_http_parser *parser, const char *at, s
 
     http_client* http = (http_client*) parser->data;
     zval* zobject = (zval*) http->cli->object;
-    
+
+    http_client_request *req = http->requests->head ? http->requests->head->data : NULL;
+    if (req && req->download_fd > 0)
+    {
+        if (swoole_sync_writefile(req->download_fd, (void *) at, length) < length)
+        {
+            swoole_php_sys_error(E_WARNING, "write to the download file failed.");
+            return -1;
+        }
+        return 0;
+    }
+
+    zval *zcallback = http_client_get_cb(zobject, ZEND_STRL("data") TSRMLS_CC);
+    if (zcallback && !ZVAL_IS_NULL(zcallback))
+    {
+        zval **args[2];
+        zval *zdata;
+        zval *retval = NULL;
+
+        SW_MAKE_STD_ZVAL(zdata);
+        SW_ZVAL_STRINGL(zdata, at, length, 1);
+
+        args[0] = &zobject;
+        args[1] = &zdata;
+        if (sw_call_user_function_ex(EG(function_table), NULL, zcallback, &retval, 2, args, 0, NULL TSRMLS_CC) == FAILURE)
+        {
+            swoole_php_fatal_error(E_WARNING, "swoole_http_client: onData handler error");
+        }
+        if (EG(exception))
+        {
+            zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+        }
+        if (retval != NULL)
+        {
+            sw_zval_ptr_dtor(&retval);
+        }
+        sw_zval_ptr_dtor(&zdata);
+        return 0;
+    }
+
     zval *body = sw_zend_read_property(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("body"), 0 TSRMLS_CC);
     zval *tmp;
     SW_MAKE_STD_ZVAL(tmp);
@@ -863,27 +1338,42 @@ static int http_client_parser_on_message_complete(php_http_parser *parser)
 #endif
 
     http_client* http = (http_client*) parser->data;
-    zval* zobject = (zval*) http->cli->object;
+    swClient *cli = http->cli;
+    zval* zobject = (zval*) cli->object;
 
-    if(http->keep_alive == 1)
+    http_client_request *req = swLinkedList_shift(http->requests);
+    if (req == NULL)
+    {
+        swoole_php_error(E_WARNING, "no request for the response.");
+        return 0;
+    }
+    if (req->download_fd > 0)
+    {
+        close(req->download_fd);
+        req->download_fd = 0;
+    }
+
+    http->sent_num--;
+    http->retry = 0;
+    zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("statusCode"), parser->status_code TSRMLS_CC);
+    zend_update_property_long(swoole_http_client_class_entry_ptr, zobject, ZEND_STRL("errCode"), 0 TSRMLS_CC);
+    if (http->sent_num == 0)
     {
         //reset http phase for reuse
         http->phase = 1;
     }
 
-    zval *retval;
-    zval *zcallback;
-
-    zcallback = http_client_get_cb(zobject, ZEND_STRL("finish") TSRMLS_CC);
+    zval *retval = NULL;
+    zval *zcallback = req->callback;
 
     zval **args[1];
     args[0] = &zobject;
-    
+
     if (zcallback == NULL || ZVAL_IS_NULL(zcallback))
     {
         swoole_php_fatal_error(E_WARNING, "swoole_http_client object have not receive callback.");
     }
-    if (sw_call_user_function_ex(EG(function_table), NULL, zcallback, &retval, 1, args, 0, NULL TSRMLS_CC) == FAILURE)
+    else if (sw_call_user_function_ex(EG(function_table), NULL, zcallback, &retval, 1, args, 0, NULL TSRMLS_CC) == FAILURE)
     {
         swoole_php_fatal_error(E_WARNING, "onReactorCallback handler error");
     }
@@ -895,10 +1385,22 @@ static int http_client_parser_on_message_complete(php_http_parser *parser)
     {
         sw_zval_ptr_dtor(&retval);
     }
+    http_client_request_free(req TSRMLS_CC);
 
+    //closed, destroyed or reconnected in the callback, stop parsing the rest of the data
+    if (swoole_get_object(zobject) != http || http->cli != cli || cli->closed)
+    {
+        return -1;
+    }
     if (http->keep_alive == 0)
     {
+        //the queued requests will be sent on a new connection
         http->cli->close(http->cli);
+        return -1;
+    }
+    else if (!http->pipeline)
+    {
+        http_client_send_http_request(zobject TSRMLS_CC);
     }
 
     return 0;
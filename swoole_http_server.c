@@ -43,6 +43,9 @@ static uint8_t http_merge_request_flag = 0;
 swString *swoole_http_buffer;
 swString *swoole_http_form_data_buffer;
 
+static swString *http_response_header;
+static int http_response_header_flag = 0;
+
 #ifdef SW_HAVE_ZLIB
 swString *swoole_zlib_buffer;
 #endif
@@ -66,6 +69,37 @@ enum http_global_flag
     HTTP_GLOBAL_FILES     = 1u << 6,
 };
 
+/**
+ * the arrays of swoole_http_request not built yet
+ */
+enum http_lazy_flag
+{
+    HTTP_LAZY_ON          = 1u << 0,
+    HTTP_LAZY_HEADER      = 1u << 1,
+    HTTP_LAZY_SERVER      = 1u << 2,
+    HTTP_LAZY_GET         = 1u << 3,
+    HTTP_LAZY_POST        = 1u << 4,
+    HTTP_LAZY_COOKIE      = 1u << 5,
+};
+
+#define HTTP_LAZY_ALL  (HTTP_LAZY_HEADER | HTTP_LAZY_SERVER | HTTP_LAZY_GET | HTTP_LAZY_POST | HTTP_LAZY_COOKIE)
+
+/**
+ * the arrays are built on first access with --enable-http-lazy-request, otherwise before onRequest.
+ * php 5.3 has no zend_literal and get_property_ptr_ptr has no type argument before 5.5.
+ */
+#if defined(SW_HTTP_LAZY_REQUEST) && (PHP_MAJOR_VERSION >= 7 || (PHP_MAJOR_VERSION == 5 && PHP_MINOR_VERSION >= 5))
+#define HTTP_LAZY_PROPERTY   1
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+#define HTTP_LAZY_KEY_DC     , void **cache_slot
+#define HTTP_LAZY_KEY_CC     , NULL
+#else
+#define HTTP_LAZY_KEY_DC     , const zend_literal *key TSRMLS_DC
+#define HTTP_LAZY_KEY_CC     , NULL TSRMLS_CC
+#endif
+
 enum http_upload_errno
 {
     HTTP_UPLOAD_ERR_OK = 0,
@@ -94,6 +128,10 @@ zend_class_entry *swoole_http_request_class_entry_ptr;
 
 static zval* php_sw_http_server_callbacks[2];
 
+#ifdef HTTP_LAZY_PROPERTY
+static zend_object_handlers swoole_http_request_handlers;
+#endif
+
 static int http_onReceive(swServer *serv, swEventData *req);
 static void http_onClose(swServer *serv, int fd, int from_id);
 
@@ -112,12 +150,21 @@ static int multipart_body_on_header_complete(multipart_parser* p);
 static int multipart_body_on_data_end(multipart_parser* p);
 static int multipart_body_end(multipart_parser* p);
 
-static int http_request_new(swoole_http_client* c TSRMLS_DC);
+static int http_request_new(swoole_http_client* c, int lazy TSRMLS_DC);
+static void http_request_stream_abort(swoole_http_client *client);
+
+static void http_request_build_header(swoole_http_client *client TSRMLS_DC);
+static void http_request_build_server(swoole_http_client *client TSRMLS_DC);
+static void http_request_build_get(swoole_http_client *client TSRMLS_DC);
+static void http_request_build_post(swoole_http_client *client TSRMLS_DC);
+static void http_request_build_cookie(swoole_http_client *client TSRMLS_DC);
+static void http_request_materialize(swoole_http_client *client, int flags TSRMLS_DC);
 
 static void http_global_merge(zval *val, zval *zrequest, int type);
 static void http_global_clear(TSRMLS_D);
 static swoole_http_client* http_get_client(zval *object, int check_end TSRMLS_DC);
 static void http_build_header(swoole_http_client *client, zval *object, swString *response, int body_length TSRMLS_DC);
+static int http_response_header_prepare(zval *zheader TSRMLS_DC);
 static void http_parse_cookie(zval *array, const char *at, size_t length);
 static int http_trim_double_quote(zval **value, char **ptr);
 
@@ -132,6 +179,8 @@ static int http_response_compress(swString *body, int level);
 #endif
 
 #define http_merge_php_global(v,r,t)  if (http_merge_global_flag > 0) http_global_merge(v,r,t)
+#define http_head_append(p,s,l)       do { memcpy(p, s, l); p += l; } while (0)
+#define http_head_append_str(p,s)     http_head_append(p, s, sizeof(s) - 1)
 
 static PHP_METHOD(swoole_http_server, on);
 static PHP_METHOD(swoole_http_server, start);
@@ -397,21 +446,16 @@ static int http_request_on_query_string(php_http_parser *parser, const char *at,
 #endif
     swoole_http_client *client = parser->data;
 
-    //no need free, will free by treat_data
-    char *query = estrndup(at, length);
-    sw_add_assoc_stringl_ex(client->request.zserver, ZEND_STRS("query_string"), query, length, 1);
-
-    zval *zget;
-    http_alloc_zval(client, request, zget);
-    array_init(zget);
-    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("get"), zget TSRMLS_CC);
-
-    //parse url params
-    sapi_module.treat_data(PARSE_STRING, query, zget TSRMLS_CC);
-
-    //merge php global variable
-    http_merge_php_global(zget, client->request.zrequest_object, HTTP_GLOBAL_GET);
-
+    client->request.query_string = at;
+    client->request.query_string_len = length;
+    if (client->request.lazy)
+    {
+        client->request.lazy |= HTTP_LAZY_GET;
+    }
+    else
+    {
+        http_request_build_get(client TSRMLS_CC);
+    }
     return 0;
 }
 
@@ -491,26 +535,19 @@ static int http_trim_double_quote(zval **value, char **ptr)
     return len;
 }
 
-static int http_request_on_header_value(php_http_parser *parser, const char *at, size_t length)
+/**
+ * the headers changing the state of the request, return 1 for the cookie
+ */
+static int http_request_on_header_state(swoole_http_client *client, const char *name, size_t name_len, const char *at, size_t length)
 {
-#if PHP_MAJOR_VERSION < 7
-    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
-#endif
-
-    swoole_http_client *client = parser->data;
-    char *header_name = zend_str_tolower_dup(client->current_header_name, client->current_header_name_len);
+    php_http_parser *parser = &client->parser;
 
-    if (strncasecmp(header_name, "cookie", client->current_header_name_len) == 0)
+    if (name_len == sizeof("cookie") - 1 && strncasecmp(name, ZEND_STRL("cookie")) == 0)
     {
-        zval *zcookie;
-        http_alloc_zval(client, request, zcookie);
-        array_init(zcookie);
-        zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("cookie"), zcookie TSRMLS_CC);
-
-        http_parse_cookie(zcookie, at, length);
-        http_merge_php_global(zcookie, client->request.zrequest_object, HTTP_GLOBAL_COOKIE);
+        return 1;
     }
-    else if (strncasecmp(header_name, ZEND_STRL("upgrade")) == 0 && strncasecmp(at, ZEND_STRL("websocket")) == 0)
+    else if (name_len == sizeof("upgrade") - 1 && strncasecmp(name, ZEND_STRL("upgrade")) == 0
+            && strncasecmp(at, ZEND_STRL("websocket")) == 0)
     {
         swConnection *conn = swWorker_get_connection(SwooleG.serv, client->fd);
         if (!conn)
@@ -519,31 +556,55 @@ static int http_request_on_header_value(php_http_parser *parser, const char *at,
             return SW_ERR;
         }
         conn->websocket_status = WEBSOCKET_STATUS_CONNECTION;
-        zval *header = client->request.zheader;
-        sw_add_assoc_stringl_ex(header, header_name, client->current_header_name_len + 1, (char *) at, length, 1);
+    }
+    else if (name_len != sizeof("content-type") - 1 || strncasecmp(name, ZEND_STRL("content-type")) != 0)
+    {
+        return 0;
     }
     else if ((parser->method == PHP_HTTP_POST || parser->method == PHP_HTTP_PUT || parser->method == PHP_HTTP_DELETE || parser->method == PHP_HTTP_PATCH)
-            && memcmp(header_name, ZEND_STRL("content-type")) == 0
             && strncasecmp(at, ZEND_STRL("application/x-www-form-urlencoded")) == 0)
     {
         client->request.post_form_urlencoded = 1;
-        zval *header = client->request.zheader;
-        sw_add_assoc_stringl_ex(header, header_name, client->current_header_name_len + 1, (char *) at, length, 1);
     }
-    else if (parser->method == PHP_HTTP_POST && memcmp(header_name, ZEND_STRL("content-type")) == 0
-            && strncasecmp(at, ZEND_STRL("multipart/form-data")) == 0)
+    else if (parser->method == PHP_HTTP_POST && strncasecmp(at, ZEND_STRL("multipart/form-data")) == 0)
     {
         int boundary_len = length - strlen("multipart/form-data; boundary=");
         multipart_parser *p = multipart_parser_init(at + length - boundary_len, boundary_len, &mt_parser_settings);
         client->mt_parser = p;
         p->data = client;
-        zval *header = client->request.zheader;
-        sw_add_assoc_stringl_ex(header, header_name, client->current_header_name_len + 1, (char *) at, length, 1);
+    }
+    return 0;
+}
+
+static int http_request_on_header_value(php_http_parser *parser, const char *at, size_t length)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    swoole_http_client *client = parser->data;
+    int ret = http_request_on_header_state(client, client->current_header_name, client->current_header_name_len, at, length);
+
+    if (ret < 0)
+    {
+        return SW_ERR;
+    }
+    else if (ret == 1)
+    {
+        zval *zcookie;
+        http_alloc_zval(client, request, zcookie);
+        array_init(zcookie);
+        zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("cookie"), zcookie TSRMLS_CC);
+
+        http_parse_cookie(zcookie, at, length);
+        http_merge_php_global(zcookie, client->request.zrequest_object, HTTP_GLOBAL_COOKIE);
     }
     else
     {
+        char *header_name = zend_str_tolower_dup(client->current_header_name, client->current_header_name_len);
         zval *header = client->request.zheader;
         sw_add_assoc_stringl_ex(header, header_name, client->current_header_name_len + 1, (char *) at, length, 1);
+        efree(header_name);
     }
 
     if (client->current_header_name_allocated)
@@ -551,7 +612,6 @@ static int http_request_on_header_value(php_http_parser *parser, const char *at,
         efree(client->current_header_name);
         client->current_header_name_allocated = 0;
     }
-    efree(header_name);
 
     return 0;
 }
@@ -839,20 +899,20 @@ static int http_request_on_body(php_http_parser *parser, const char *at, size_t
 #endif
 
     swoole_http_client *client = parser->data;
-    char *body;
 
     client->request.post_length = length;
 
     if (SwooleG.serv->http_parse_post && client->request.post_form_urlencoded)
     {
-        zval *zpost;
-        http_alloc_zval(client, request, zpost);
-        array_init(zpost);
-
-        body = estrndup(at, length);
-        zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("post"), zpost TSRMLS_CC);
-        sapi_module.treat_data(PARSE_STRING, body, zpost TSRMLS_CC);
-        http_merge_php_global(zpost, client->request.zrequest_object, HTTP_GLOBAL_POST);
+        client->request.body = at;
+        if (client->request.lazy)
+        {
+            client->request.lazy |= HTTP_LAZY_POST;
+        }
+        else
+        {
+            http_request_build_post(client TSRMLS_CC);
+        }
     }
     else if (client->mt_parser != NULL)
     {
@@ -897,187 +957,699 @@ static int http_request_message_complete(php_http_parser *parser)
     return 0;
 }
 
-static void http_onClose(swServer *serv, int fd, int from_id)
+static void http_request_build_header(swoole_http_client *client TSRMLS_DC)
 {
-    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
-    if (!conn)
+    zval *zheader;
+    http_alloc_zval(client, request, zheader);
+    array_init(zheader);
+    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("header"), zheader TSRMLS_CC);
+
+    //the parser fills the array in http_request_on_header_value
+    if (!(client->request.lazy & HTTP_LAZY_ON))
     {
-        swWarn("connection[%d] is closed.", fd);
         return;
     }
 
-    swoole_http_client *client = swArray_fetch(http_client_array, conn->fd);
-    if (client)
+    char *data = Z_STRVAL_P(client->request.zdata);
+    char key[SW_HTTP_HEADER_KEY_SIZE];
+    char *name;
+    swHttpIndex_header *header;
+    int i;
+
+    for (i = 0; i < client->index.header_num; i++)
     {
-        if (client->request.zrequest_object && !client->end)
+        header = &client->index.headers[i];
+        name = data + header->name;
+        if (header->name_length == sizeof("cookie") - 1 && strncasecmp(name, ZEND_STRL("cookie")) == 0)
         {
-#if PHP_MAJOR_VERSION < 7
-            TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
-#endif
-            swoole_http_request_free(client TSRMLS_CC);
+            continue;
+        }
+        if (header->name_length < sizeof(key))
+        {
+            zend_str_tolower_copy(key, name, header->name_length);
+            sw_add_assoc_stringl_ex(zheader, key, header->name_length + 1, data + header->value, header->value_length, 1);
+        }
+        else
+        {
+            name = zend_str_tolower_dup(name, header->name_length);
+            sw_add_assoc_stringl_ex(zheader, name, header->name_length + 1, data + header->value, header->value_length, 1);
+            efree(name);
         }
-    }
-
-    if (php_sw_callback[SW_SERVER_CB_onClose] != NULL)
-    {
-        php_swoole_onClose(serv, fd, from_id);
     }
 }
 
-static int http_onReceive(swServer *serv, swEventData *req)
+static void http_request_build_server(swoole_http_client *client TSRMLS_DC)
 {
-#if PHP_MAJOR_VERSION < 7
-    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
-#endif
-
-    int fd = req->info.fd;
+    zval *zserver;
+    http_alloc_zval(client, request, zserver);
+    array_init(zserver);
+    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("server"), zserver TSRMLS_CC);
 
-    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
-    if (!conn)
+    if (client->request.query_string)
     {
-        swWarn("connection[%d] is closed.", fd);
-        return SW_ERR;
+        sw_add_assoc_stringl_ex(zserver, ZEND_STRS("query_string"), (char *) client->request.query_string, client->request.query_string_len, 1);
     }
+    sw_add_assoc_string(zserver, "request_method", http_get_method_name(client->parser.method), 1);
+    sw_add_assoc_stringl(zserver, "request_uri", client->request.path, client->request.path_len, 1);
+    sw_add_assoc_stringl(zserver, "path_info", client->request.path, client->request.path_len, 1);
+    sw_add_assoc_long_ex(zserver, ZEND_STRS("request_time"), client->request.request_time);
+    add_assoc_long(zserver, "server_port", client->request.server_port);
+    add_assoc_long(zserver, "remote_port", client->request.remote_port);
+    sw_add_assoc_string(zserver, "remote_addr", client->request.remote_addr, 1);
 
-    if (conn->websocket_status == WEBSOCKET_STATUS_ACTIVE)  //websocket callback
+    if (client->request.version == 101)
     {
-        return swoole_websocket_onMessage(req);
+        sw_add_assoc_string(zserver, "server_protocol", "HTTP/1.1", 1);
     }
-
-    swoole_http_client *client = swArray_alloc(http_client_array, conn->fd);
-    if (!client)
+    else
     {
-        return SW_OK;
+        sw_add_assoc_string(zserver, "server_protocol", "HTTP/1.0", 1);
     }
-    client->fd = fd;
 
-    php_http_parser *parser = &client->parser;
+    sw_add_assoc_string(zserver, "server_software", SW_HTTP_SERVER_SOFTWARE, 1);
+}
 
-    /**
-     * create request and response object
-     */
-    http_request_new(client TSRMLS_CC);
+static void http_request_build_get(swoole_http_client *client TSRMLS_DC)
+{
+    //no need free, will free by treat_data
+    char *query = estrndup(client->request.query_string, client->request.query_string_len);
 
-    zval *zserver = client->request.zserver;
+    zval *zget;
+    http_alloc_zval(client, request, zget);
+    array_init(zget);
+    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("get"), zget TSRMLS_CC);
 
-    parser->data = client;
+    //parse url params
+    sapi_module.treat_data(PARSE_STRING, query, zget TSRMLS_CC);
 
-    php_http_parser_init(parser, PHP_HTTP_REQUEST);
+    //merge php global variable
+    http_merge_php_global(zget, client->request.zrequest_object, HTTP_GLOBAL_GET);
+}
 
-    zval *zdata;
-    SW_MAKE_STD_ZVAL(zdata);
-    zdata = php_swoole_get_recv_data(zdata, req TSRMLS_CC);
+static void http_request_build_post(swoole_http_client *client TSRMLS_DC)
+{
+    char *body = estrndup(client->request.body, client->request.post_length);
 
-    swTrace("httpRequest %d bytes:\n---------------------------------------\n%s\n", Z_STRLEN_P(zdata), Z_STRVAL_P(zdata));
+    zval *zpost;
+    http_alloc_zval(client, request, zpost);
+    array_init(zpost);
+    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("post"), zpost TSRMLS_CC);
 
-    long n = php_http_parser_execute(parser, &http_parser_settings, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
-    if (n < 0)
-    {
-        sw_zval_ptr_dtor(&zdata);
-        swWarn("php_http_parser_execute failed.");
+    sapi_module.treat_data(PARSE_STRING, body, zpost TSRMLS_CC);
+    http_merge_php_global(zpost, client->request.zrequest_object, HTTP_GLOBAL_POST);
+}
 
-        if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION)
+/**
+ * only for the index path, the parser builds the cookie in http_request_on_header_value
+ */
+static void http_request_build_cookie(swoole_http_client *client TSRMLS_DC)
+{
+    zval *zcookie;
+    http_alloc_zval(client, request, zcookie);
+    array_init(zcookie);
+    zend_update_property(swoole_http_request_class_entry_ptr, client->request.zrequest_object, ZEND_STRL("cookie"), zcookie TSRMLS_CC);
+
+    char *data = Z_STRVAL_P(client->request.zdata);
+    swHttpIndex_header *header;
+    int i;
+
+    for (i = 0; i < client->index.header_num; i++)
+    {
+        header = &client->index.headers[i];
+        if (header->name_length == sizeof("cookie") - 1 && strncasecmp(data + header->name, ZEND_STRL("cookie")) == 0)
         {
-            return SwooleG.serv->factory.end(&SwooleG.serv->factory, fd);
+            http_parse_cookie(zcookie, data + header->value, header->value_length);
         }
     }
-    else
+}
+
+/**
+ * build the arrays of the flags not built yet
+ */
+static void http_request_materialize(swoole_http_client *client, int flags TSRMLS_DC)
+{
+    int lazy = client->request.lazy & flags & HTTP_LAZY_ALL;
+    if (lazy == 0)
     {
-        zval *retval;
-        zval **args[2];
-        zval *zreques_object = client->request.zrequest_object;
-        client->request.zdata = zdata;
+        return;
+    }
+    client->request.lazy &= ~lazy;
 
-        char *method_name = http_get_method_name(parser->method);
+    if (lazy & HTTP_LAZY_HEADER)
+    {
+        http_request_build_header(client TSRMLS_CC);
+    }
+    if (lazy & HTTP_LAZY_SERVER)
+    {
+        http_request_build_server(client TSRMLS_CC);
+    }
+    if (lazy & HTTP_LAZY_GET)
+    {
+        http_request_build_get(client TSRMLS_CC);
+    }
+    if (lazy & HTTP_LAZY_POST)
+    {
+        http_request_build_post(client TSRMLS_CC);
+    }
+    if (lazy & HTTP_LAZY_COOKIE)
+    {
+        http_request_build_cookie(client TSRMLS_CC);
+    }
+}
 
-        sw_add_assoc_string(zserver, "request_method", method_name, 1);
-        sw_add_assoc_stringl(zserver, "request_uri", client->request.path, client->request.path_len, 1);
-        sw_add_assoc_stringl(zserver, "path_info", client->request.path, client->request.path_len, 1);
-        sw_add_assoc_long_ex(zserver, ZEND_STRS("request_time"), SwooleGS->now);
+#ifdef HTTP_LAZY_PROPERTY
+static int http_request_lazy_member(zval *member)
+{
+    if (Z_TYPE_P(member) != IS_STRING)
+    {
+        return 0;
+    }
 
-        swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
-        if (!conn)
+    char *name = Z_STRVAL_P(member);
+    switch (Z_STRLEN_P(member))
+    {
+    case 3:
+        return memcmp(name, "get", 3) == 0 ? HTTP_LAZY_GET : 0;
+    case 4:
+        return memcmp(name, "post", 4) == 0 ? HTTP_LAZY_POST : 0;
+    case 6:
+        if (memcmp(name, "header", 6) == 0)
         {
-            sw_zval_ptr_dtor(&zdata);
-            swWarn("connection[%d] is closed.", fd);
-            return SW_ERR;
+            return HTTP_LAZY_HEADER;
         }
-
-        add_assoc_long(client->request.zserver, "server_port", swConnection_get_port(&SwooleG.serv->connection_list[conn->from_fd]));
-        add_assoc_long(client->request.zserver, "remote_port", swConnection_get_port(conn));
-        sw_add_assoc_string(zserver, "remote_addr", swConnection_get_ip(conn), 1);
-
-        if (client->request.version == 101)
+        else if (memcmp(name, "server", 6) == 0)
         {
-            sw_add_assoc_string(zserver, "server_protocol", "HTTP/1.1", 1);
+            return HTTP_LAZY_SERVER;
         }
-        else
+        else if (memcmp(name, "cookie", 6) == 0)
         {
-            sw_add_assoc_string(zserver, "server_protocol", "HTTP/1.0", 1);
+            return HTTP_LAZY_COOKIE;
         }
+        return 0;
+    default:
+        return 0;
+    }
+}
 
-        sw_add_assoc_string(zserver, "server_software", SW_HTTP_SERVER_SOFTWARE, 1);
+/**
+ * the request of the object is still in progress
+ */
+static swoole_http_client* http_request_lazy_client(zval *object TSRMLS_DC)
+{
+    zval *zfd = sw_zend_read_property(swoole_http_request_class_entry_ptr, object, ZEND_STRL("fd"), 1 TSRMLS_CC);
+    if (!zfd || Z_TYPE_P(zfd) != IS_LONG)
+    {
+        return NULL;
+    }
+    swConnection *conn = swWorker_get_connection(SwooleG.serv, Z_LVAL_P(zfd));
+    if (!conn)
+    {
+        return NULL;
+    }
+    swoole_http_client *client = swArray_fetch(http_client_array, conn->fd);
+    if (!client || !client->request.zrequest_object
+            || Z_OBJ_HANDLE_P(client->request.zrequest_object) != Z_OBJ_HANDLE_P(object))
+    {
+        return NULL;
+    }
+    return client;
+}
 
-        http_merge_php_global(zserver, zreques_object, HTTP_GLOBAL_SERVER);
-        http_merge_php_global(NULL, zreques_object, HTTP_GLOBAL_REQUEST);
+/**
+ * member is NULL for all the arrays, drop is set when the property is overwritten by the application
+ */
+static void http_request_lazy_hook(zval *object, zval *member, int drop TSRMLS_DC)
+{
+    int flags = member ? http_request_lazy_member(member) : HTTP_LAZY_ALL;
+    if (flags == 0)
+    {
+        return;
+    }
+    swoole_http_client *client = http_request_lazy_client(object TSRMLS_CC);
+    if (!client)
+    {
+        return;
+    }
+    if (drop)
+    {
+        client->request.lazy &= ~flags;
+    }
+    else
+    {
+        http_request_materialize(client, flags TSRMLS_CC);
+    }
+}
 
-        //websocket handshake
-        if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION && php_sw_http_server_callbacks[HTTP_CALLBACK_onHandShake] == NULL)
-        {
-            return swoole_websocket_onHandshake(client);
-        }
+/**
+ * the handlers are called without the runtime cache, the property may not exist yet
+ */
+#if PHP_MAJOR_VERSION >= 7
+static zval* http_request_read_property(zval *object, zval *member, int type, void **cache_slot, zval *rv)
+{
+    http_request_lazy_hook(object, member, 0);
+    return std_object_handlers.read_property(object, member, type, NULL, rv);
+}
 
-        zval *zresponse_object;
-        http_alloc_zval(client, response, zresponse_object);
-        object_init_ex(zresponse_object, swoole_http_response_class_entry_ptr);
+static zval* http_request_get_property_ptr_ptr(zval *object, zval *member, int type, void **cache_slot)
+{
+    http_request_lazy_hook(object, member, 0);
+    return std_object_handlers.get_property_ptr_ptr(object, member, type, NULL);
+}
 
-#if PHP_MEMORY_DEBUG
-        php_vmstat.new_http_response++;
-#endif
+static HashTable* http_request_get_gc(zval *object, zval **table, int *n)
+{
+    *table = NULL;
+    *n = 0;
+    return std_object_handlers.get_properties(object);
+}
+
+static zend_object* http_request_clone_obj(zval *object)
+{
+    http_request_lazy_hook(object, NULL, 0);
+    return std_object_handlers.clone_obj(object);
+}
+#else
+static zval* http_request_read_property(zval *object, zval *member, int type HTTP_LAZY_KEY_DC)
+{
+    http_request_lazy_hook(object, member, 0 TSRMLS_CC);
+    return std_object_handlers.read_property(object, member, type HTTP_LAZY_KEY_CC);
+}
 
-        //socket fd
-        zend_update_property_long(swoole_http_response_class_entry_ptr, zresponse_object, ZEND_STRL("fd"), client->fd TSRMLS_CC);
+static zval** http_request_get_property_ptr_ptr(zval *object, zval *member, int type HTTP_LAZY_KEY_DC)
+{
+    http_request_lazy_hook(object, member, 0 TSRMLS_CC);
+    return std_object_handlers.get_property_ptr_ptr(object, member, type HTTP_LAZY_KEY_CC);
+}
 
-#ifdef __CYGWIN__
-        //TODO: memory error on cygwin.
-        zval_add_ref(&zreques_object);
-        zval_add_ref(&zresponse_object);
+static HashTable* http_request_get_gc(zval *object, zval ***table, int *n TSRMLS_DC)
+{
+    *table = NULL;
+    *n = 0;
+    return std_object_handlers.get_properties(object TSRMLS_CC);
+}
+
+static zend_object_value http_request_clone_obj(zval *object TSRMLS_DC)
+{
+    http_request_lazy_hook(object, NULL, 0 TSRMLS_CC);
+    return std_object_handlers.clone_obj(object TSRMLS_CC);
+}
 #endif
-        
-        args[0] = &zreques_object;
-        args[1] = &zresponse_object;
 
-        int callback = 0;
+static void http_request_write_property(zval *object, zval *member, zval *value HTTP_LAZY_KEY_DC)
+{
+    http_request_lazy_hook(object, member, 1 TSRMLS_CC);
+    std_object_handlers.write_property(object, member, value HTTP_LAZY_KEY_CC);
+}
 
-        if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION)
+static int http_request_has_property(zval *object, zval *member, int has_set_exists HTTP_LAZY_KEY_DC)
+{
+    http_request_lazy_hook(object, member, 0 TSRMLS_CC);
+    return std_object_handlers.has_property(object, member, has_set_exists HTTP_LAZY_KEY_CC);
+}
+
+static void http_request_unset_property(zval *object, zval *member HTTP_LAZY_KEY_DC)
+{
+    http_request_lazy_hook(object, member, 1 TSRMLS_CC);
+    std_object_handlers.unset_property(object, member HTTP_LAZY_KEY_CC);
+}
+
+/**
+ * var_dump(), foreach and the array cast
+ */
+static HashTable* http_request_get_properties(zval *object TSRMLS_DC)
+{
+    http_request_lazy_hook(object, NULL, 0 TSRMLS_CC);
+    return std_object_handlers.get_properties(object TSRMLS_CC);
+}
+#endif
+
+static void http_onClose(swServer *serv, int fd, int from_id)
+{
+    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
+    if (!conn)
+    {
+        swWarn("connection[%d] is closed.", fd);
+        return;
+    }
+
+    swoole_http_client *client = swArray_fetch(http_client_array, conn->fd);
+    if (client)
+    {
+        if (client->stream)
         {
-            callback = HTTP_CALLBACK_onHandShake;
-            conn->websocket_status = WEBSOCKET_STATUS_HANDSHAKE;
+            http_request_stream_abort(client);
         }
-        else
+        if (client->request.zrequest_object && !client->end)
+        {
+#if PHP_MAJOR_VERSION < 7
+            TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+            swoole_http_request_free(client TSRMLS_CC);
+        }
+    }
+
+    if (php_sw_callback[SW_SERVER_CB_onClose] != NULL)
+    {
+        php_swoole_onClose(serv, fd, from_id);
+    }
+}
+
+/**
+ * the head has been parsed by the reactor thread, the callbacks of the parser are called with the offsets
+ */
+static int http_request_parse_index(swoole_http_client *client, char *data, swHttpIndex *index)
+{
+    php_http_parser *parser = &client->parser;
+    swHttpIndex_header *header;
+    int i;
+
+    //swHttpMethod is php_http_method + 1
+    parser->method = index->method - 1;
+    parser->http_major = index->version / 10;
+    parser->http_minor = index->version % 10;
+
+    http_request_on_path(parser, data + index->uri, index->path_length);
+    if (index->path_length + 1 < index->uri_length)
+    {
+        http_request_on_query_string(parser, data + index->uri + index->path_length + 1,
+                index->uri_length - index->path_length - 1);
+    }
+    for (i = 0; i < index->header_num; i++)
+    {
+        header = &index->headers[i];
+        //the arrays are built from the index on the first access
+        if (client->request.lazy)
         {
-            callback = HTTP_CALLBACK_onRequest;
-            //no have onRequest callback
-            if (php_sw_http_server_callbacks[callback] == NULL)
+            int ret = http_request_on_header_state(client, data + header->name, header->name_length,
+                    data + header->value, header->value_length);
+            if (ret < 0)
+            {
+                return SW_ERR;
+            }
+            else if (ret == 1)
             {
-                swoole_websocket_onReuqest(client);
-                return SW_OK;
+                client->request.lazy |= HTTP_LAZY_COOKIE;
             }
+            continue;
+        }
+        http_request_on_header_field(parser, data + header->name, header->name_length);
+        if (http_request_on_header_value(parser, data + header->value, header->value_length) < 0)
+        {
+            return SW_ERR;
+        }
+    }
+    http_request_on_headers_complete(parser);
+    //the body comes later
+    if (index->flags & SW_HTTP_INDEX_STREAM)
+    {
+        return SW_OK;
+    }
+    if (index->content_length > 0)
+    {
+        http_request_on_body(parser, data + index->body, index->content_length);
+    }
+    http_request_message_complete(parser);
+    return SW_OK;
+}
+
+/**
+ * the request is complete, call onRequest or onHandShake
+ */
+static int http_onRequest(swoole_http_client *client TSRMLS_DC)
+{
+    int fd = client->fd;
+    zval *retval;
+    zval **args[2];
+    zval *zdata = client->request.zdata;
+    zval *zreques_object = client->request.zrequest_object;
+
+    //the arrival time, $request->server is built later with the lazy arrays
+    client->request.request_time = SwooleGS->now;
+
+    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
+    if (!conn)
+    {
+        sw_zval_ptr_dtor(&zdata);
+        swWarn("connection[%d] is closed.", fd);
+        return SW_ERR;
+    }
+
+    client->request.server_port = swConnection_get_port(&SwooleG.serv->connection_list[conn->from_fd]);
+    client->request.remote_port = swConnection_get_port(conn);
+    char *remote_addr = swConnection_get_ip(conn);
+    if (remote_addr)
+    {
+        strncpy(client->request.remote_addr, remote_addr, sizeof(client->request.remote_addr) - 1);
+    }
+
+    if (!client->request.lazy)
+    {
+        http_request_build_server(client TSRMLS_CC);
+        http_merge_php_global(client->request.zserver, zreques_object, HTTP_GLOBAL_SERVER);
+        http_merge_php_global(NULL, zreques_object, HTTP_GLOBAL_REQUEST);
+    }
+
+    //websocket handshake
+    if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION && php_sw_http_server_callbacks[HTTP_CALLBACK_onHandShake] == NULL)
+    {
+        http_request_materialize(client, HTTP_LAZY_HEADER TSRMLS_CC);
+        return swoole_websocket_onHandshake(client);
+    }
+
+    zval *zresponse_object;
+    http_alloc_zval(client, response, zresponse_object);
+    object_init_ex(zresponse_object, swoole_http_response_class_entry_ptr);
+
+#if PHP_MEMORY_DEBUG
+    php_vmstat.new_http_response++;
+#endif
+
+    //socket fd
+    zend_update_property_long(swoole_http_response_class_entry_ptr, zresponse_object, ZEND_STRL("fd"), client->fd TSRMLS_CC);
+
+#ifdef __CYGWIN__
+    //TODO: memory error on cygwin.
+    zval_add_ref(&zreques_object);
+    zval_add_ref(&zresponse_object);
+#endif
+    
+    args[0] = &zreques_object;
+    args[1] = &zresponse_object;
+
+    int callback = 0;
+
+    if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION)
+    {
+        callback = HTTP_CALLBACK_onHandShake;
+        conn->websocket_status = WEBSOCKET_STATUS_HANDSHAKE;
+    }
+    else
+    {
+        callback = HTTP_CALLBACK_onRequest;
+        //no have onRequest callback
+        if (php_sw_http_server_callbacks[callback] == NULL)
+        {
+            swoole_websocket_onReuqest(client);
+            return SW_OK;
+        }
+    }
+
+    client->request_callback = 1;
+    if (sw_call_user_function_ex(EG(function_table), NULL, php_sw_http_server_callbacks[callback], &retval, 2, args, 0, NULL TSRMLS_CC) == FAILURE)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "onRequest handler error");
+    }
+    client->request_callback = 0;
+    if (EG(exception))
+    {
+        zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+    }
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+    //end() is called in the callback
+    if (client->request_free_later)
+    {
+        client->request_free_later = 0;
+        swoole_http_request_free(client TSRMLS_CC);
+    }
+    return SW_OK;
+}
+
+/**
+ * the chunk of the streaming request body
+ */
+static void http_request_on_stream(swoole_http_client *client, char *data, uint32_t length)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    if (client->mt_parser)
+    {
+        if (multipart_parser_execute(client->mt_parser, data, length) != length)
+        {
+            swoole_php_fatal_error(E_WARNING, "parse multipart body failed.");
         }
+    }
+    else if (client->request.post_length + length <= client->stream_length)
+    {
+        memcpy(client->request.post_content + client->request.post_length, data, length);
+        client->request.post_length += length;
+    }
+}
 
-        if (sw_call_user_function_ex(EG(function_table), NULL, php_sw_http_server_callbacks[callback], &retval, 2, args, 0, NULL TSRMLS_CC) == FAILURE)
+/**
+ * the connection is closed before the body is received
+ */
+static void http_request_stream_abort(swoole_http_client *client)
+{
+    multipart_parser *p = client->mt_parser;
+
+    client->stream = 0;
+    if (p)
+    {
+        if (p->fp)
         {
-            php_error_docref(NULL TSRMLS_CC, E_WARNING, "onRequest handler error");
+            fclose((FILE *) p->fp);
+            p->fp = NULL;
         }
-        if (EG(exception))
+        multipart_parser_free(p);
+        client->mt_parser = NULL;
+    }
+}
+
+static int http_onReceive_body(swConnection *conn, swEventData *req TSRMLS_DC)
+{
+    swoole_http_client *client = swArray_fetch(http_client_array, conn->fd);
+    //the head is not accepted
+    if (!client || !client->stream)
+    {
+        return SW_OK;
+    }
+
+    http_request_on_stream(client, req->data, req->info.len);
+    if (req->info.type == SW_EVENT_HTTP_BODY)
+    {
+        return SW_OK;
+    }
+
+    client->stream = 0;
+    if (client->request.post_content)
+    {
+        client->request.post_content[client->request.post_length] = 0;
+        http_request_on_body(&client->parser, client->request.post_content, client->request.post_length);
+    }
+    http_request_message_complete(&client->parser);
+    return http_onRequest(client TSRMLS_CC);
+}
+
+static int http_onReceive(swServer *serv, swEventData *req)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    int fd = req->info.fd;
+
+    swConnection *conn = swWorker_get_connection(SwooleG.serv, fd);
+    if (!conn)
+    {
+        swWarn("connection[%d] is closed.", fd);
+        return SW_ERR;
+    }
+
+    if (conn->websocket_status == WEBSOCKET_STATUS_ACTIVE)  //websocket callback
+    {
+        return swoole_websocket_onMessage(req);
+    }
+
+    if (req->info.type == SW_EVENT_HTTP_BODY || req->info.type == SW_EVENT_HTTP_BODY_END)
+    {
+        return http_onReceive_body(conn, req TSRMLS_CC);
+    }
+
+    swoole_http_client *client = swArray_alloc(http_client_array, conn->fd);
+    if (!client)
+    {
+        return SW_OK;
+    }
+    client->fd = fd;
+
+    php_http_parser *parser = &client->parser;
+
+    zval *zdata;
+    SW_MAKE_STD_ZVAL(zdata);
+    zdata = php_swoole_get_recv_data(zdata, req TSRMLS_CC);
+
+    long n;
+    swHttpIndex *index = &client->index;
+    uint32_t length = Z_STRLEN_P(zdata);
+    int lazy = 0;
+
+    if (swHttpIndex_get(Z_STRVAL_P(zdata), &length, index) == SW_OK)
+    {
+        //$request->rawContent() and the handshake only see the request
+        Z_STRLEN_P(zdata) = length;
+        Z_STRVAL_P(zdata)[length] = 0;
+    }
+    else
+    {
+        index->flags = SW_HTTP_INDEX_OVERFLOW;
+    }
+
+#ifdef HTTP_LAZY_PROPERTY
+    //the superglobals are set before onRequest
+    lazy = !(index->flags & (SW_HTTP_INDEX_OVERFLOW | SW_HTTP_INDEX_CHUNKED)) && http_merge_global_flag == 0;
+#endif
+
+    /**
+     * create request and response object
+     */
+    http_request_new(client, lazy TSRMLS_CC);
+
+    parser->data = client;
+
+    php_http_parser_init(parser, PHP_HTTP_REQUEST);
+
+    swTrace("httpRequest %d bytes:\n---------------------------------------\n%s\n", Z_STRLEN_P(zdata), Z_STRVAL_P(zdata));
+
+    if (index->flags & (SW_HTTP_INDEX_OVERFLOW | SW_HTTP_INDEX_CHUNKED))
+    {
+        n = php_http_parser_execute(parser, &http_parser_settings, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
+    }
+    else
+    {
+        n = http_request_parse_index(client, Z_STRVAL_P(zdata), index);
+    }
+    if (n < 0)
+    {
+        sw_zval_ptr_dtor(&zdata);
+        swWarn("php_http_parser_execute failed.");
+
+        if (conn->websocket_status == WEBSOCKET_STATUS_CONNECTION)
         {
-            zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+            return SwooleG.serv->factory.end(&SwooleG.serv->factory, fd);
         }
-        if (retval)
+    }
+    //the body comes in the SW_EVENT_HTTP_BODY events
+    else if (index->flags & SW_HTTP_INDEX_STREAM)
+    {
+        client->request.zdata = zdata;
+        client->stream = 1;
+        client->stream_length = index->content_length;
+        //the multipart body is parsed as it comes, the files are written to the tmp files
+        if (!client->mt_parser)
         {
-            sw_zval_ptr_dtor(&retval);
+            client->request.post_content = emalloc(index->content_length + 1);
         }
     }
+    else
+    {
+        client->request.zdata = zdata;
+        return http_onRequest(client TSRMLS_CC);
+    }
     return SW_OK;
 }
 
@@ -1093,6 +1665,18 @@ void swoole_http_init(int module_number TSRMLS_DC)
     INIT_CLASS_ENTRY(swoole_http_request_ce, "swoole_http_request", swoole_http_request_methods);
     swoole_http_request_class_entry_ptr = zend_register_internal_class(&swoole_http_request_ce TSRMLS_CC);
 
+#ifdef HTTP_LAZY_PROPERTY
+    memcpy(&swoole_http_request_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    swoole_http_request_handlers.read_property = http_request_read_property;
+    swoole_http_request_handlers.write_property = http_request_write_property;
+    swoole_http_request_handlers.has_property = http_request_has_property;
+    swoole_http_request_handlers.unset_property = http_request_unset_property;
+    swoole_http_request_handlers.get_property_ptr_ptr = http_request_get_property_ptr_ptr;
+    swoole_http_request_handlers.get_properties = http_request_get_properties;
+    swoole_http_request_handlers.get_gc = http_request_get_gc;
+    swoole_http_request_handlers.clone_obj = http_request_clone_obj;
+#endif
+
     REGISTER_LONG_CONSTANT("HTTP_GLOBAL_GET", HTTP_GLOBAL_GET, CONST_CS | CONST_PERSISTENT);
     REGISTER_LONG_CONSTANT("HTTP_GLOBAL_POST", HTTP_GLOBAL_POST, CONST_CS | CONST_PERSISTENT);
     REGISTER_LONG_CONSTANT("HTTP_GLOBAL_COOKIE", HTTP_GLOBAL_COOKIE, CONST_CS | CONST_PERSISTENT);
@@ -1146,7 +1730,7 @@ static PHP_METHOD(swoole_http_server, on)
     }
 }
 
-static int http_request_new(swoole_http_client* client TSRMLS_DC)
+static int http_request_new(swoole_http_client* client, int lazy TSRMLS_DC)
 {
     bzero(&client->request, sizeof(client->request));
     bzero(&client->response, sizeof(client->response));
@@ -1159,18 +1743,20 @@ static int http_request_new(swoole_http_client* client TSRMLS_DC)
     php_vmstat.new_http_request ++;
 #endif
 
-    zval *zheader;
-    http_alloc_zval(client, request, zheader);
-    array_init(zheader);
-    zend_update_property(swoole_http_request_class_entry_ptr, zrequest_object, ZEND_STRL("header"), zheader TSRMLS_CC);
-
-    zval *zserver;
-    http_alloc_zval(client, request, zserver);
-    array_init(zserver);
-    zend_update_property(swoole_http_request_class_entry_ptr, zrequest_object, ZEND_STRL("server"), zserver TSRMLS_CC);
-
     zend_update_property_long(swoole_http_request_class_entry_ptr, zrequest_object, ZEND_STRL("fd"), client->fd TSRMLS_CC);
 
+#ifdef HTTP_LAZY_PROPERTY
+    if (lazy)
+    {
+        Z_OBJ_HT_P(zrequest_object) = &swoole_http_request_handlers;
+        client->request.lazy = HTTP_LAZY_ON | HTTP_LAZY_HEADER | HTTP_LAZY_SERVER;
+    }
+    else
+#endif
+    {
+        http_request_build_header(client TSRMLS_CC);
+    }
+
     client->end = 0;
 
     return SW_OK;
@@ -1179,6 +1765,27 @@ static int http_request_new(swoole_http_client* client TSRMLS_DC)
 void swoole_http_request_free(swoole_http_client *client TSRMLS_DC)
 {
     http_request *req = &client->request;
+#ifdef HTTP_LAZY_PROPERTY
+    if ((req->lazy & HTTP_LAZY_ALL) && client->request_callback)
+    {
+        client->request_free_later = 1;
+        client->end = 1;
+        return;
+    }
+    //the object is kept by the application, the arrays can not be built after the request is freed
+    if (req->lazy & HTTP_LAZY_ALL)
+    {
+        zval *zobject = req->zrequest_object;
+#if PHP_MAJOR_VERSION >= 7
+        if (GC_REFCOUNT(Z_OBJ_P(zobject)) > 1)
+#else
+        if (Z_REFCOUNT_P(zobject) > 1 || EG(objects_store).object_buckets[Z_OBJ_HANDLE_P(zobject)].bucket.obj.refcount > 1)
+#endif
+        {
+            http_request_materialize(client, HTTP_LAZY_ALL TSRMLS_CC);
+        }
+    }
+#endif
     if (req->path)
     {
         efree(req->path);
@@ -1283,124 +1890,6 @@ void swoole_http_request_free(swoole_http_client *client TSRMLS_DC)
     client->gzip_enable = 0;
 }
 
-static char *http_status_message(int code)
-{
-    switch (code)
-    {
-    case 100:
-        return "100 Continue";
-    case 101:
-        return "101 Switching Protocols";
-    case 201:
-        return "201 Created";
-    case 202:
-        return "202 Accepted";
-    case 203:
-        return "203 Non-Authoritative Information";
-    case 204:
-        return "204 No Content";
-    case 205:
-        return "205 Reset Content";
-    case 206:
-        return "206 Partial Content";
-    case 207:
-        return "207 Multi-Status";
-    case 208:
-        return "208 Already Reported";
-    case 226:
-        return "226 IM Used";
-    case 300:
-        return "300 Multiple Choices";
-    case 301:
-        return "301 Moved Permanently";
-    case 302:
-        return "302 Found";
-    case 303:
-        return "303 See Other";
-    case 304:
-        return "304 Not Modified";
-    case 305:
-        return "305 Use Proxy";
-    case 307:
-        return "307 Temporary Redirect";
-    case 400:
-        return "400 Bad Request";
-    case 401:
-        return "401 Unauthorized";
-    case 402:
-        return "402 Payment Required";
-    case 403:
-        return "403 Forbidden";
-    case 404:
-        return "404 Not Found";
-    case 405:
-        return "405 Method Not Allowed";
-    case 406:
-        return "406 Not Acceptable";
-    case 407:
-        return "407 Proxy Authentication Required";
-    case 408:
-        return "408 Request Timeout";
-    case 409:
-        return "409 Conflict";
-    case 410:
-        return "410 Gone";
-    case 411:
-        return "411 Length Required";
-    case 412:
-        return "412 Precondition Failed";
-    case 413:
-        return "413 Request Entity Too Large";
-    case 414:
-        return "414 Request URI Too Long";
-    case 415:
-        return "415 Unsupported Media Type";
-    case 416:
-        return "416 Requested Range Not Satisfiable";
-    case 417:
-        return "417 Expectation Failed";
-    case 418:
-        return "418 I'm a teapot";
-    case 421:
-        return "421 Misdirected Request";
-    case 422:
-        return "422 Unprocessable Entity";
-    case 423:
-        return "423 Locked";
-    case 424:
-        return "424 Failed Dependency";
-    case 426:
-        return "426 Upgrade Required";
-    case 428:
-        return "428 Precondition Required";
-    case 429:
-        return "429 Too Many Requests";
-    case 431:
-        return "431 Request Header Fields Too Large";
-    case 500:
-        return "500 Internal Server Error";
-    case 501:
-        return "501 Method Not Implemented";
-    case 503:
-        return "503 Service Unavailable";
-    case 505:
-        return "505 HTTP Version Not Supported";
-    case 506:
-        return "506 Variant Also Negotiates";
-    case 507:
-        return "507 Insufficient Storage";
-    case 508:
-        return "508 Loop Detected";
-    case 510:
-        return "510 Not Extended";
-    case 511:
-        return "511 Network Authentication Required";
-    case 200:
-    default:
-        return "200 OK";
-    }
-}
-
 static PHP_METHOD(swoole_http_server, setglobal)
 {
     long global_flag = 0;
@@ -1475,10 +1964,22 @@ static PHP_METHOD(swoole_http_server, start)
     }
 #endif
 
-    serv->onReceive = http_onReceive;
-    serv->onClose = http_onClose;
-    serv->open_http_protocol = 1;
-    serv->open_mqtt_protocol = 0;
+    //the headers added to every response
+    zval *zsetting = sw_zend_read_property(swoole_server_class_entry_ptr, getThis(), ZEND_STRL("setting"), 1 TSRMLS_CC);
+    zval *zheader;
+    if (zsetting && Z_TYPE_P(zsetting) == IS_ARRAY
+            && sw_zend_hash_find(Z_ARRVAL_P(zsetting), ZEND_STRS("http_response_header"), (void **) &zheader) == SUCCESS)
+    {
+        if (http_response_header_prepare(zheader TSRMLS_CC) < 0)
+        {
+            RETURN_FALSE;
+        }
+    }
+
+    serv->onReceive = http_onReceive;
+    serv->onClose = http_onClose;
+    serv->open_http_protocol = 1;
+    serv->open_mqtt_protocol = 0;
     serv->open_eof_check = 0;
     serv->open_length_check = 0;
 
@@ -1647,171 +2148,222 @@ static swoole_http_client *http_get_client(zval *object, int check_end TSRMLS_DC
     return client;
 }
 
+static int http_header_flag(char *key, uint32_t keylen)
+{
+    switch (keylen)
+    {
+    case 4:
+        return strncasecmp(key, ZEND_STRL("Date")) == 0 ? HTTP_RESPONSE_DATE : 0;
+    case 6:
+        return strncasecmp(key, ZEND_STRL("Server")) == 0 ? HTTP_RESPONSE_SERVER : 0;
+    case 10:
+        return strncasecmp(key, ZEND_STRL("Connection")) == 0 ? HTTP_RESPONSE_CONNECTION : 0;
+    case 12:
+        return strncasecmp(key, ZEND_STRL("Content-Type")) == 0 ? HTTP_RESPONSE_CONTENT_TYPE : 0;
+    case 14:
+        return strncasecmp(key, ZEND_STRL("Content-Length")) == 0 ? HTTP_RESPONSE_CONTENT_LENGTH : 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * the bytes of "key: value\r\n" lines, the headers set by the application are flagged
+ */
+static size_t http_header_size(HashTable *ht, int *flag)
+{
+    zval *value = NULL;
+    char *key = NULL;
+    uint32_t keylen = 0;
+    int type;
+    size_t size = 0;
+
+    SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
+    {
+        if (!key)
+        {
+            break;
+        }
+        *flag |= http_header_flag(key, keylen);
+        size += keylen + Z_STRLEN_P(value) + 4;
+    }
+    SW_HASHTABLE_FOREACH_END();
+    return size;
+}
+
+static char* http_header_copy(HashTable *ht, char *p)
+{
+    zval *value = NULL;
+    char *key = NULL;
+    uint32_t keylen = 0;
+    int type;
+
+    SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
+    {
+        if (!key)
+        {
+            break;
+        }
+        http_head_append(p, key, keylen);
+        http_head_append(p, ": ", 2);
+        http_head_append(p, Z_STRVAL_P(value), Z_STRLEN_P(value));
+        http_head_append(p, "\r\n", 2);
+    }
+    SW_HASHTABLE_FOREACH_END();
+    return p;
+}
+
+/**
+ * the http_response_header setting is serialized once in the worker
+ */
+static int http_response_header_prepare(zval *zheader TSRMLS_DC)
+{
+    if (Z_TYPE_P(zheader) != IS_ARRAY)
+    {
+        swoole_php_fatal_error(E_WARNING, "http_response_header must be array.");
+        return SW_ERR;
+    }
+
+    zval *value;
+    char *key;
+    uint32_t keylen;
+    int type;
+
+    HashTable *ht = Z_ARRVAL_P(zheader);
+    SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
+    {
+        if (!key)
+        {
+            break;
+        }
+        convert_to_string(value);
+    }
+    SW_HASHTABLE_FOREACH_END();
+
+    http_response_header_flag = 0;
+    size_t size = http_header_size(ht, &http_response_header_flag);
+    http_response_header = swString_new(size + 1);
+    if (!http_response_header)
+    {
+        return SW_ERR;
+    }
+    http_response_header->length = http_header_copy(ht, http_response_header->str) - http_response_header->str;
+    return SW_OK;
+}
+
 static void http_build_header(swoole_http_client *client, zval *object, swString *response, int body_length TSRMLS_DC)
 {
     assert(client->send_header == 0);
 
-    char buf[SW_HTTP_HEADER_MAX_SIZE];
-    int n;
-    char *date_str;
+    uint32_t n;
+    char *line;
+    char *p;
+    int flag = http_response_header_flag;
+    zval *header = client->response.zheader;
 
     client->keepalive = php_http_should_keep_alive(&client->parser);
 
+#ifdef SW_HAVE_ZLIB
+    if (client->gzip_enable)
+    {
+        body_length = swoole_zlib_buffer->length;
+    }
+#endif
+
+    /**
+     * the head is copied into the buffer extended once
+     */
+    size_t size = response->length + SW_HTTP_HEAD_RESERVE_SIZE;
+    if (header)
+    {
+        size += http_header_size(Z_ARRVAL_P(header), &flag);
+    }
+    if (http_response_header)
+    {
+        size += http_response_header->length;
+    }
+    if (client->response.cookie)
+    {
+        size += client->response.cookie->length;
+    }
+    if (size > response->size && swString_extend(response, size) < 0)
+    {
+        return;
+    }
+    p = response->str + response->length;
+
     /**
      * http status line
      */
-    n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\n", http_status_message(client->response.status));
-    swString_append_ptr(response, buf, n);
+    line = swHttp_get_status_line(client->response.status, &n);
+    http_head_append(p, line, n);
 
     /**
      * http header
      */
-    zval *header = client->response.zheader;
     if (header)
     {
-        int flag = 0x0;
-        char *key_server = "Server";
-        char *key_connection = "Connection";
-        char *key_content_length = "Content-Length";
-        char *key_content_type = "Content-Type";
-        char *key_date = "Date";
-
-        HashTable *ht = Z_ARRVAL_P(header);
-        zval *value = NULL;
-        char *key = NULL;
-        uint32_t keylen = 0;
-        int type;
-
-        SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
-        {
-            if (!key)
-            {
-                break;
-            }
-            if (strcmp(key, key_server) == 0)
-            {
-                flag |= HTTP_RESPONSE_SERVER;
-            }
-            else if (strcmp(key, key_connection) == 0)
-            {
-                flag |= HTTP_RESPONSE_CONNECTION;
-            }
-            else if (strcmp(key, key_content_length) == 0)
-            {
-                flag |= HTTP_RESPONSE_CONTENT_LENGTH;
-            }
-            else if (strcmp(key, key_date) == 0)
-            {
-                flag |= HTTP_RESPONSE_DATE;
-            }
-            else if (strcmp(key, key_content_type) == 0)
-            {
-                flag |= HTTP_RESPONSE_CONTENT_TYPE;
-            }
-            n = snprintf(buf, sizeof(buf), "%*s: %*s\r\n", keylen - 1, key, Z_STRLEN_P(value), Z_STRVAL_P(value));
-            swString_append_ptr(response, buf, n);
-        }
-        SW_HASHTABLE_FOREACH_END();
-
-        if (!(flag & HTTP_RESPONSE_SERVER))
-        {
-            swString_append_ptr(response, ZEND_STRL("Server: "SW_HTTP_SERVER_SOFTWARE"\r\n"));
-        }
-        if (!(flag & HTTP_RESPONSE_CONNECTION))
-        {
-            if (client->keepalive)
-            {
-                swString_append_ptr(response, ZEND_STRL("Connection: keep-alive\r\n"));
-            }
-            else
-            {
-                swString_append_ptr(response, ZEND_STRL("Connection: close\r\n"));
-            }
-        }
-        if (client->request.method == PHP_HTTP_OPTIONS)
-        {
-            swString_append_ptr(response, ZEND_STRL("Allow: GET, POST, PUT, PATCH, DELETE, HEAD, OPTIONS\r\nContent-Length: 0\r\n"));
-        }
-        else
-        {
-            if (!(flag & HTTP_RESPONSE_CONTENT_LENGTH) && body_length >= 0)
-            {
-#ifdef SW_HAVE_ZLIB
-                if (client->gzip_enable)
-                {
-                    body_length = swoole_zlib_buffer->length;
-                }
-#endif
-                n = snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", body_length);
-                swString_append_ptr(response, buf, n);
-            }
-        }
-        if (!(flag & HTTP_RESPONSE_DATE))
-        {
-            date_str = sw_php_format_date(ZEND_STRL(SW_HTTP_DATE_FORMAT), SwooleGS->now, 0 TSRMLS_CC);
-            n = snprintf(buf, sizeof(buf), "Date: %s\r\n", date_str);
-            swString_append_ptr(response, buf, n);
-            efree(date_str);
-        }
-        if (!(flag & HTTP_RESPONSE_CONTENT_TYPE))
-        {
-            swString_append_ptr(response, ZEND_STRL("Content-Type: text/html\r\n"));
-        }
+        p = http_header_copy(Z_ARRVAL_P(header), p);
     }
-    else
+    if (http_response_header)
+    {
+        http_head_append(p, http_response_header->str, http_response_header->length);
+    }
+    if (!(flag & HTTP_RESPONSE_SERVER))
+    {
+        http_head_append_str(p, "Server: "SW_HTTP_SERVER_SOFTWARE"\r\n");
+    }
+    if (!(flag & HTTP_RESPONSE_CONTENT_TYPE))
+    {
+        http_head_append_str(p, "Content-Type: text/html\r\n");
+    }
+    if (!(flag & HTTP_RESPONSE_CONNECTION))
     {
-        swString_append_ptr(response, ZEND_STRL("Server: "SW_HTTP_SERVER_SOFTWARE"\r\nContent-Type: text/html\r\n"));
         if (client->keepalive)
         {
-            swString_append_ptr(response, ZEND_STRL("Connection: keep-alive\r\n"));
+            http_head_append_str(p, "Connection: keep-alive\r\n");
         }
         else
         {
-            swString_append_ptr(response, ZEND_STRL("Connection: close\r\n"));
-        }
-
-        date_str = sw_php_format_date(ZEND_STRL(SW_HTTP_DATE_FORMAT), SwooleGS->now, 0 TSRMLS_CC);
-        n = snprintf(buf, sizeof(buf), "Date: %s\r\n", date_str);
-        efree(date_str);
-        swString_append_ptr(response, buf, n);
-
-        if (client->request.method == PHP_HTTP_OPTIONS)
-        {
-            n = snprintf(buf, sizeof(buf), "Allow: GET, POST, PUT, DELETE, HEAD, OPTIONS\r\nContent-Length: %d\r\n", 0);
-            swString_append_ptr(response, buf, n);
-        }
-        else if (body_length >= 0)
-        {
-#ifdef SW_HAVE_ZLIB
-            if (client->gzip_enable)
-            {
-                body_length = swoole_zlib_buffer->length;
-            }
-#endif
-            n = snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", body_length);
-            swString_append_ptr(response, buf, n);
+            http_head_append_str(p, "Connection: close\r\n");
         }
     }
+    if (client->request.method == PHP_HTTP_OPTIONS)
+    {
+        http_head_append_str(p, "Allow: GET, POST, PUT, PATCH, DELETE, HEAD, OPTIONS\r\nContent-Length: 0\r\n");
+    }
+    else if (!(flag & HTTP_RESPONSE_CONTENT_LENGTH) && body_length >= 0)
+    {
+        http_head_append_str(p, "Content-Length: ");
+        p += swoole_itoa(p, body_length);
+        http_head_append(p, "\r\n", 2);
+    }
+    if (!(flag & HTTP_RESPONSE_DATE))
+    {
+        line = swHttp_get_date(SwooleGS->now, &n);
+        http_head_append(p, line, n);
+    }
 
     if (client->chunk)
     {
-        swString_append_ptr(response, SW_STRL("Transfer-Encoding: chunked\r\n") - 1);
+        http_head_append_str(p, "Transfer-Encoding: chunked\r\n");
     }
     //http cookies
     if (client->response.cookie)
     {
-        swString_append(response, client->response.cookie);
+        http_head_append(p, client->response.cookie->str, client->response.cookie->length);
     }
     //http compress
     if (client->gzip_enable)
     {
 #ifdef SW_HTTP_COMPRESS_GZIP
-        swString_append_ptr(response, SW_STRL("Content-Encoding: gzip\r\n") - 1);
+        http_head_append_str(p, "Content-Encoding: gzip\r\n");
 #else
-        swString_append_ptr(response, SW_STRL("Content-Encoding: deflate\r\n") - 1);
+        http_head_append_str(p, "Content-Encoding: deflate\r\n");
 #endif
     }
-    swString_append_ptr(response, ZEND_STRL("\r\n"));
+    http_head_append(p, "\r\n", 2);
+    response->length = p - response->str;
     client->send_header = 1;
 }
 
@@ -1962,6 +2514,190 @@ static PHP_METHOD(swoole_http_response, end)
     RETURN_TRUE;
 }
 
+/**
+ * the request header by the lowercase name, from the index if the array is not built
+ */
+static char* http_request_header_find(swoole_http_client *client, char *name, uint32_t length, uint32_t *value_length)
+{
+    if (client->request.lazy & HTTP_LAZY_HEADER)
+    {
+        char *data = Z_STRVAL_P(client->request.zdata);
+        swHttpIndex_header *header;
+        int i;
+
+        for (i = 0; i < client->index.header_num; i++)
+        {
+            header = &client->index.headers[i];
+            if (header->name_length == length && strncasecmp(data + header->name, name, length) == 0)
+            {
+                *value_length = header->value_length;
+                return data + header->value;
+            }
+        }
+    }
+    else if (client->request.zheader)
+    {
+        zval *value;
+        if (sw_zend_hash_find(Z_ARRVAL_P(client->request.zheader), name, length + 1, (void **) &value) == SUCCESS
+                && Z_TYPE_P(value) == IS_STRING)
+        {
+            *value_length = Z_STRLEN_P(value);
+            return Z_STRVAL_P(value);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * the response header set by the application, the name is matched case-insensitively
+ */
+static zval* http_response_header_find(swoole_http_client *client, char *name, uint32_t length)
+{
+    zval *value = NULL;
+    char *key = NULL;
+    uint32_t keylen = 0;
+    int type;
+
+    if (!client->response.zheader)
+    {
+        return NULL;
+    }
+
+    HashTable *ht = Z_ARRVAL_P(client->response.zheader);
+    SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, value)
+    {
+        if (!key)
+        {
+            break;
+        }
+        if (keylen == length && strncasecmp(key, name, length) == 0)
+        {
+            return value;
+        }
+    }
+    SW_HASHTABLE_FOREACH_END();
+    return NULL;
+}
+
+/**
+ * replace the response header of any case
+ */
+static void http_response_header_set(swoole_http_client *client, zval *object, char *name, uint32_t length, char *value, uint32_t value_length TSRMLS_DC)
+{
+    zval *zheader = client->response.zheader;
+    zval *zvalue = NULL;
+    char *key = NULL;
+    uint32_t keylen = 0;
+    int type;
+    char buf[SW_HTTP_HEADER_KEY_SIZE];
+
+    if (!zheader)
+    {
+        http_alloc_zval(client, response, zheader);
+        array_init(zheader);
+        zend_update_property(swoole_http_response_class_entry_ptr, object, ZEND_STRL("header"), zheader TSRMLS_CC);
+    }
+
+    HashTable *ht = Z_ARRVAL_P(zheader);
+    buf[0] = 0;
+    SW_HASHTABLE_FOREACH_START2(ht, key, keylen, type, zvalue)
+    {
+        if (!key)
+        {
+            break;
+        }
+        if (keylen == length && strncasecmp(key, name, length) == 0)
+        {
+            memcpy(buf, key, keylen + 1);
+            break;
+        }
+    }
+    SW_HASHTABLE_FOREACH_END();
+
+    if (buf[0])
+    {
+        sw_zend_hash_del(ht, buf, length + 1);
+    }
+    sw_add_assoc_stringl_ex(zheader, name, length + 1, value, value_length, 1);
+}
+
+/**
+ * the head of one part of multipart/byteranges
+ */
+static int http_range_part_head(char *buf, size_t size, char *boundary, char *type, uint32_t type_length, swHttpRange *range, off_t filesize)
+{
+    if (type)
+    {
+        return snprintf(buf, size, "\r\n--%s\r\nContent-Type: %.*s\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n", boundary,
+                (int) type_length, type, (long) range->offset, (long) (range->offset + range->length - 1), (long) filesize);
+    }
+    else
+    {
+        return snprintf(buf, size, "\r\n--%s\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n", boundary, (long) range->offset,
+                (long) (range->offset + range->length - 1), (long) filesize);
+    }
+}
+
+/**
+ * multipart/byteranges, the head of each part is sent before the sendfile of the range
+ */
+static int http_response_send_ranges(swoole_http_client *client, zval *object, char *filename, int filename_length,
+        swHttpRange *ranges, int range_n, off_t filesize TSRMLS_DC)
+{
+    static uint32_t boundary_seq = 0;
+    char boundary[24];
+    char part[SW_HTTP_HEADER_KEY_SIZE * 4];
+    char type[SW_HTTP_HEADER_KEY_SIZE * 2];
+    uint32_t type_length = 0;
+    off_t body_length;
+    int i, n, ret;
+
+    snprintf(boundary, sizeof(boundary), "%08x%08x", (uint32_t) getpid(), ++boundary_seq);
+
+    //the parts have the content type of the file
+    zval *zvalue = http_response_header_find(client, ZEND_STRL("Content-Type"));
+    if (zvalue)
+    {
+        type_length = Z_STRLEN_P(zvalue) < sizeof(type) ? Z_STRLEN_P(zvalue) : sizeof(type) - 1;
+        memcpy(type, Z_STRVAL_P(zvalue), type_length);
+    }
+    n = snprintf(part, sizeof(part), "multipart/byteranges; boundary=%s", boundary);
+    http_response_header_set(client, object, ZEND_STRL("Content-Type"), part, n TSRMLS_CC);
+
+    body_length = snprintf(part, sizeof(part), "\r\n--%s--\r\n", boundary);
+    for (i = 0; i < range_n; i++)
+    {
+        body_length += http_range_part_head(part, sizeof(part), boundary, zvalue ? type : NULL, type_length, &ranges[i], filesize);
+        body_length += ranges[i].length;
+    }
+
+    swString_clear(swoole_http_buffer);
+    http_build_header(client, object, swoole_http_buffer, (int) body_length TSRMLS_CC);
+
+    for (i = 0; i < range_n; i++)
+    {
+        n = http_range_part_head(part, sizeof(part), boundary, zvalue ? type : NULL, type_length, &ranges[i], filesize);
+        swString_append_ptr(swoole_http_buffer, part, n);
+        ret = swServer_tcp_send(SwooleG.serv, client->fd, swoole_http_buffer->str, swoole_http_buffer->length);
+        swString_clear(swoole_http_buffer);
+        if (ret < 0)
+        {
+            return SW_ERR;
+        }
+        ret = swServer_tcp_sendfile(SwooleG.serv, client->fd, filename, filename_length, ranges[i].offset, ranges[i].length);
+        if (ret < 0)
+        {
+            return SW_ERR;
+        }
+    }
+    n = snprintf(part, sizeof(part), "\r\n--%s--\r\n", boundary);
+    return swServer_tcp_send(SwooleG.serv, client->fd, part, n);
+}
+
+/**
+ * 304 if the validators match, 206 for the Range header, 416 if no range is satisfiable,
+ * the ranges are sent by sendfile from their offsets
+ */
 static PHP_METHOD(swoole_http_response, sendfile)
 {
     char *filename;
@@ -1991,17 +2727,10 @@ static PHP_METHOD(swoole_http_response, sendfile)
         RETURN_FALSE;
     }
 
-    int file_fd = open(filename, O_RDONLY);
-    if (file_fd < 0)
-    {
-        swoole_php_sys_error(E_WARNING, "open(%s) failed.", filename);
-        RETURN_FALSE;
-    }
-
     struct stat file_stat;
-    if (fstat(file_fd, &file_stat) < 0)
+    if (stat(filename, &file_stat) < 0)
     {
-        swoole_php_sys_error(E_WARNING, "fstat(%s) failed.", filename);
+        swoole_php_sys_error(E_WARNING, "stat(%s) failed.", filename);
         RETURN_FALSE;
     }
 
@@ -2011,8 +2740,117 @@ static PHP_METHOD(swoole_http_response, sendfile)
         RETURN_FALSE;
     }
 
+#ifdef SW_HAVE_ZLIB
+    //the file is not compressed
+    client->gzip_enable = 0;
+#endif
+
+    char etag[64];
+    char last_modified[64];
+    char buf[SW_HTTP_HEADER_KEY_SIZE * 2];
+    uint32_t etag_length, last_modified_length, n;
+    char *value;
+    zval *zvalue;
+    off_t filesize = file_stat.st_size;
+    off_t body_length = filesize;
+    swHttpRange ranges[SW_HTTP_RANGE_MAX];
+    int range_n = 0;
+
+    //the validators set by the application are used
+    zvalue = http_response_header_find(client, ZEND_STRL("ETag"));
+    if (zvalue && Z_STRLEN_P(zvalue) < sizeof(etag))
+    {
+        etag_length = Z_STRLEN_P(zvalue);
+        memcpy(etag, Z_STRVAL_P(zvalue), etag_length);
+    }
+    else
+    {
+        etag_length = snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long) file_stat.st_mtime, (unsigned long) filesize);
+        http_response_header_set(client, getThis(), ZEND_STRL("ETag"), etag, etag_length TSRMLS_CC);
+    }
+    zvalue = http_response_header_find(client, ZEND_STRL("Last-Modified"));
+    if (zvalue && Z_STRLEN_P(zvalue) < sizeof(last_modified))
+    {
+        last_modified_length = Z_STRLEN_P(zvalue);
+        memcpy(last_modified, Z_STRVAL_P(zvalue), last_modified_length);
+    }
+    else
+    {
+        last_modified_length = swHttp_format_date(last_modified, sizeof(last_modified), file_stat.st_mtime);
+        http_response_header_set(client, getThis(), ZEND_STRL("Last-Modified"), last_modified, last_modified_length TSRMLS_CC);
+    }
+    http_response_header_set(client, getThis(), ZEND_STRL("Accept-Ranges"), ZEND_STRL("bytes") TSRMLS_CC);
+
+    //the conditions only apply to the default status
+    int status_ok = client->response.status == 0 || client->response.status == 200;
+
+    if (status_ok && (client->parser.method == PHP_HTTP_GET || client->parser.method == PHP_HTTP_HEAD))
+    {
+        //If-None-Match takes precedence, If-Modified-Since is compared with Last-Modified exactly
+        value = http_request_header_find(client, ZEND_STRL("if-none-match"), &n);
+        if (value)
+        {
+            ret = swHttp_match_etag(value, n, etag, etag_length);
+        }
+        else
+        {
+            value = http_request_header_find(client, ZEND_STRL("if-modified-since"), &n);
+            ret = value && n == last_modified_length && memcmp(value, last_modified, n) == 0;
+        }
+        if (ret)
+        {
+            client->response.status = 304;
+            body_length = -1;
+            goto send_head;
+        }
+    }
+
+    if (status_ok && client->parser.method == PHP_HTTP_GET)
+    {
+        uint32_t if_range_length;
+        char *if_range = http_request_header_find(client, ZEND_STRL("if-range"), &if_range_length);
+        value = http_request_header_find(client, ZEND_STRL("range"), &n);
+        //If-Range is the exact validator of the file, or the whole file is sent
+        if (value && if_range && !((if_range_length == etag_length && memcmp(if_range, etag, etag_length) == 0)
+                || (if_range_length == last_modified_length && memcmp(if_range, last_modified, last_modified_length) == 0)))
+        {
+            value = NULL;
+        }
+        if (value)
+        {
+            range_n = swHttp_parse_range(value, n, filesize, ranges, SW_HTTP_RANGE_MAX);
+        }
+    }
+
+    if (range_n > 1)
+    {
+        client->response.status = 206;
+        if (http_response_send_ranges(client, getThis(), filename, filename_length, ranges, range_n, filesize TSRMLS_CC) < 0)
+        {
+            client->send_header = 0;
+            RETURN_FALSE;
+        }
+        goto end;
+    }
+    else if (range_n == 1)
+    {
+        client->response.status = 206;
+        n = snprintf(buf, sizeof(buf), "bytes %ld-%ld/%ld", (long) ranges[0].offset,
+                (long) (ranges[0].offset + ranges[0].length - 1), (long) filesize);
+        http_response_header_set(client, getThis(), ZEND_STRL("Content-Range"), buf, n TSRMLS_CC);
+        body_length = ranges[0].length;
+    }
+    else if (range_n < 0)
+    {
+        client->response.status = 416;
+        n = snprintf(buf, sizeof(buf), "bytes */%ld", (long) filesize);
+        http_response_header_set(client, getThis(), ZEND_STRL("Content-Range"), buf, n TSRMLS_CC);
+        body_length = 0;
+    }
+
+    send_head:
     swString_clear(swoole_http_buffer);
-    http_build_header(client, getThis(), swoole_http_buffer, file_stat.st_size TSRMLS_CC);
+    http_build_header(client, getThis(), swoole_http_buffer, (int) body_length TSRMLS_CC);
 
     ret = swServer_tcp_send(SwooleG.serv, client->fd, swoole_http_buffer->str, swoole_http_buffer->length);
     if (ret < 0)
@@ -2021,13 +2859,19 @@ static PHP_METHOD(swoole_http_response, sendfile)
         RETURN_FALSE;
     }
 
-    ret = swServer_tcp_sendfile(SwooleG.serv, client->fd, filename, filename_length);
-    if (ret < 0)
+    //HEAD, 304 and 416 have no body
+    if (body_length > 0 && client->parser.method != PHP_HTTP_HEAD)
     {
-        client->send_header = 0;
-        RETURN_FALSE;
+        ret = swServer_tcp_sendfile(SwooleG.serv, client->fd, filename, filename_length, range_n == 1 ? ranges[0].offset : 0,
+                range_n == 1 ? ranges[0].length : 0);
+        if (ret < 0)
+        {
+            client->send_header = 0;
+            RETURN_FALSE;
+        }
     }
 
+    end:
     swoole_http_request_free(client TSRMLS_CC);
     if (!client->keepalive)
     {
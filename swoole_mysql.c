@@ -17,144 +17,2096 @@
  */
 
 #include "php_swoole.h"
+#include "swoole_mysql.h"
+#include "ext/standard/sha1.h"
 
 #ifdef SW_ASYNC_MYSQL
+#include "ext/mysqlnd/mysqlnd.h"
+#include "ext/mysqli/mysqli_mysqlnd.h"
+#include "ext/mysqli/php_mysqli_structs.h"
+
+static void swoole_mysql_legacy_init(int module_number TSRMLS_DC);
+#endif
+
+typedef struct
+{
+    swString *packet;
+    zval *callback;
+#if PHP_MAJOR_VERSION >= 7
+    zval _callback;
+#endif
+    uint8_t command;
+} mysql_request;
+
+typedef struct
+{
+    swClient *cli;
+    zval *object;
+#if PHP_MAJOR_VERSION >= 7
+    zval _object;
+#endif
+
+    zval *onConnect;
+    zval *onClose;
+#if PHP_MAJOR_VERSION >= 7
+    zval _onConnect;
+    zval _onClose;
+#endif
+
+    char *host;
+    long port;
+    char *user;
+    char *password;
+    char *database;
+    uint8_t charset;
+    double timeout;
+
+    /**
+     * incomplete packet
+     */
+    swString *buffer;
+
+    uint8_t state;
+    uint8_t connected;
+    uint8_t pipeline;
+    uint32_t pool_size;
+    long connect_timer;
+
+    /**
+     * queued and in flight requests, the head is waiting for the response
+     */
+    swLinkedList *requests;
+    uint32_t sent_num;
+
+    struct
+    {
+        uint16_t num_column;
+        uint16_t num_param;
+        uint16_t index;
+        uint32_t stmt_id;
+        mysql_field *columns;
+        zval *result_array;
+    } response;
+
+} mysql_connection;
+
+static PHP_METHOD(swoole_mysql, __construct);
+static PHP_METHOD(swoole_mysql, __destruct);
+static PHP_METHOD(swoole_mysql, connect);
+static PHP_METHOD(swoole_mysql, query);
+static PHP_METHOD(swoole_mysql, prepare);
+static PHP_METHOD(swoole_mysql, execute);
+static PHP_METHOD(swoole_mysql, close);
+static PHP_METHOD(swoole_mysql, on);
+
+static void mysql_onConnect(swClient *cli);
+static void mysql_onReceive(swClient *cli, char *data, uint32_t length);
+static void mysql_onError(swClient *cli);
+static void mysql_onClose(swClient *cli);
+static void mysql_onConnectFromPool(void *object);
+static void mysql_onConnectTimeout(void *object);
+
+static int mysql_onPacket(mysql_connection *mysql, char *data, uint32_t length TSRMLS_DC);
+static int mysql_handshake(mysql_connection *mysql, char *buf, int len, uint8_t sequence);
+static int mysql_auth_switch(mysql_connection *mysql, char *buf, int len, uint8_t sequence);
+static void mysql_scramble(char *to, char *scramble, char *password);
+static int mysql_response(mysql_connection *mysql, char *buf, int len TSRMLS_DC);
+static int mysql_decode_field(char *buf, int len, mysql_field *col);
+static int mysql_decode_text_row(mysql_connection *mysql, char *buf, int len, zval *row_array);
+static int mysql_decode_binary_row(mysql_connection *mysql, char *buf, int len, zval *row_array);
+static void mysql_connect_callback(mysql_connection *mysql, int result TSRMLS_DC);
+static void mysql_request_callback(mysql_connection *mysql, zval *result TSRMLS_DC);
+static void mysql_request_free(mysql_request *req TSRMLS_DC);
+static int mysql_request_add(mysql_connection *mysql, swString *packet, uint8_t command, zval *callback TSRMLS_DC);
+static int mysql_send(mysql_connection *mysql TSRMLS_DC);
+static void mysql_clear(mysql_connection *mysql, int error, char *error_msg TSRMLS_DC);
+static void mysql_free_cli(mysql_connection *mysql);
+static void mysql_pool_free_client(swClient *cli);
+
+static zend_class_entry swoole_mysql_ce;
+zend_class_entry *swoole_mysql_class_entry_ptr;
+
+/**
+ * per-worker connection pools, the key is user@host:port/database
+ */
+static swHashMap *mysql_pools = NULL;
+
+static const zend_function_entry swoole_mysql_methods[] =
+{
+    PHP_ME(swoole_mysql, __construct, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    PHP_ME(swoole_mysql, __destruct, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_DTOR)
+    PHP_ME(swoole_mysql, connect, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, query, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, prepare, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, execute, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, close, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_mysql, on, NULL, ZEND_ACC_PUBLIC)
+    PHP_FE_END
+};
+
+static const struct
+{
+    char *name;
+    uint8_t nr;
+} mysql_charsets[] =
+{
+    { "big5", 1 },
+    { "latin1", 8 },
+    { "gb2312", 24 },
+    { "gbk", 28 },
+    { "utf8", 33 },
+    { "utf8mb4", 45 },
+    { "binary", 63 },
+    { NULL, 0 },
+};
+
+static uint8_t mysql_get_charset(char *name)
+{
+    int i;
+    for (i = 0; mysql_charsets[i].name; i++)
+    {
+        if (strcasecmp(mysql_charsets[i].name, name) == 0)
+        {
+            return mysql_charsets[i].nr;
+        }
+    }
+    return 0;
+}
+
+static sw_inline void mysql_packet_init(swString *packet, uint8_t command)
+{
+    bzero(packet->str, 5);
+    packet->str[4] = command;
+    packet->length = 5;
+}
+
+static sw_inline void mysql_packet_end(swString *packet, uint8_t sequence)
+{
+    mysql_pack_length(packet->length - SW_MYSQL_PACKET_HEADER_SIZE, packet->str);
+    packet->str[3] = sequence;
+}
+
+static void mysql_scramble(char *to, char *scramble, char *password)
+{
+    PHP_SHA1_CTX context;
+    unsigned char hash_stage1[SW_MYSQL_SCRAMBLE_LENGTH];
+    unsigned char hash_stage2[SW_MYSQL_SCRAMBLE_LENGTH];
+    int i;
+
+    //SHA1(password)
+    PHP_SHA1Init(&context);
+    PHP_SHA1Update(&context, (unsigned char *) password, strlen(password));
+    PHP_SHA1Final(hash_stage1, &context);
+
+    //SHA1(SHA1(password))
+    PHP_SHA1Init(&context);
+    PHP_SHA1Update(&context, hash_stage1, SW_MYSQL_SCRAMBLE_LENGTH);
+    PHP_SHA1Final(hash_stage2, &context);
+
+    //SHA1(scramble + SHA1(SHA1(password)))
+    PHP_SHA1Init(&context);
+    PHP_SHA1Update(&context, (unsigned char *) scramble, SW_MYSQL_SCRAMBLE_LENGTH);
+    PHP_SHA1Update(&context, hash_stage2, SW_MYSQL_SCRAMBLE_LENGTH);
+    PHP_SHA1Final((unsigned char *) to, &context);
+
+    for (i = 0; i < SW_MYSQL_SCRAMBLE_LENGTH; i++)
+    {
+        to[i] = to[i] ^ hash_stage1[i];
+    }
+}
+
+/**
+ * initial handshake packet (protocol version 10), reply the handshake response
+ */
+static int mysql_handshake(mysql_connection *mysql, char *buf, int len, uint8_t sequence)
+{
+    char *p = buf;
+    char *end = buf + len;
+    char scramble[SW_MYSQL_SCRAMBLE_LENGTH];
+    char token[SW_MYSQL_SCRAMBLE_LENGTH];
+    char *plugin = NULL;
+    uint32_t capability;
+    int n;
+
+    if (len < 1 || (uint8_t) p[0] != 10)
+    {
+        return -SW_MYSQL_ERR_PROTOCOL_ERROR;
+    }
+    p++;
+    //server version
+    p += strnlen(p, end - p) + 1;
+    //connection id(4) + auth-plugin-data-part-1(8) + filler(1) + capability flags(2)
+    if (p + 15 > end)
+    {
+        return -SW_MYSQL_ERR_PACKET_CORRUPT;
+    }
+    p += 4;
+    memcpy(scramble, p, 8);
+    p += 9;
+    capability = mysql_uint2korr(p);
+    p += 2;
+    //character set(1) + status flags(2) + capability flags upper(2) + auth-plugin-data length(1) + reserved(10)
+    if (p + 16 <= end)
+    {
+        p += 3;
+        capability |= ((uint32_t) mysql_uint2korr(p)) << 16;
+        p += 13;
+        //auth-plugin-data-part-2
+        if ((capability & SW_MYSQL_CLIENT_SECURE_CONNECTION) && p + 12 <= end)
+        {
+            memcpy(scramble + 8, p, 12);
+            p += 13;
+        }
+        if ((capability & SW_MYSQL_CLIENT_PLUGIN_AUTH) && p < end)
+        {
+            plugin = p;
+        }
+    }
+    if (!(capability & SW_MYSQL_CLIENT_PROTOCOL_41))
+    {
+        return -SW_MYSQL_ERR_PROTOCOL_ERROR;
+    }
+    if (plugin && strncmp(plugin, SW_MYSQL_NATIVE_PASSWORD, end - plugin) != 0)
+    {
+        swTrace("auth plugin %s, switch to %s.", plugin, SW_MYSQL_NATIVE_PASSWORD);
+    }
+
+    uint32_t client_flag = SW_MYSQL_CLIENT_LONG_PASSWORD | SW_MYSQL_CLIENT_LONG_FLAG | SW_MYSQL_CLIENT_PROTOCOL_41
+            | SW_MYSQL_CLIENT_TRANSACTIONS | SW_MYSQL_CLIENT_SECURE_CONNECTION | SW_MYSQL_CLIENT_PLUGIN_AUTH;
+    if (mysql->database)
+    {
+        client_flag |= SW_MYSQL_CLIENT_CONNECT_WITH_DB;
+    }
+
+    swString *packet = swString_new(256);
+    char *w = packet->str + SW_MYSQL_PACKET_HEADER_SIZE;
+
+    //capability flags, max-packet size, character set, reserved(23)
+    bzero(w, 32);
+    mysql_int4store(w, client_flag);
+    mysql_int4store(w + 4, SW_MYSQL_PACKET_MAX_SIZE);
+    w[8] = mysql->charset;
+    packet->length = SW_MYSQL_PACKET_HEADER_SIZE + 32;
+
+    //username
+    swString_append_ptr(packet, mysql->user, strlen(mysql->user) + 1);
+
+    //auth-response
+    if (mysql->password && mysql->password[0])
+    {
+        mysql_scramble(token, scramble, mysql->password);
+        n = SW_MYSQL_SCRAMBLE_LENGTH;
+        swString_append_ptr(packet, (char *) &n, 1);
+        swString_append_ptr(packet, token, SW_MYSQL_SCRAMBLE_LENGTH);
+    }
+    else
+    {
+        swString_append_ptr(packet, "\0", 1);
+    }
+
+    if (mysql->database)
+    {
+        swString_append_ptr(packet, mysql->database, strlen(mysql->database) + 1);
+    }
+    swString_append_ptr(packet, ZEND_STRS(SW_MYSQL_NATIVE_PASSWORD));
+    mysql_packet_end(packet, sequence + 1);
+
+    n = mysql->cli->send(mysql->cli, packet->str, packet->length, 0);
+    swString_free(packet);
+    return n < 0 ? SW_ERR : SW_OK;
+}
+
+/**
+ * auth switch request, only mysql_native_password is supported
+ */
+static int mysql_auth_switch(mysql_connection *mysql, char *buf, int len, uint8_t sequence)
+{
+    char *plugin = buf + 1;
+    int plugin_len = strnlen(plugin, len - 1);
+    char *scramble = plugin + plugin_len + 1;
+    char packet[SW_MYSQL_PACKET_HEADER_SIZE + SW_MYSQL_SCRAMBLE_LENGTH];
+    int length = 0;
+
+    if (plugin_len != sizeof(SW_MYSQL_NATIVE_PASSWORD) - 1 || memcmp(plugin, SW_MYSQL_NATIVE_PASSWORD, plugin_len) != 0)
+    {
+        swWarn("auth plugin %.*s is not supported.", plugin_len, plugin);
+        return SW_ERR;
+    }
+    if (scramble + SW_MYSQL_SCRAMBLE_LENGTH > buf + len)
+    {
+        return SW_ERR;
+    }
+    if (mysql->password && mysql->password[0])
+    {
+        mysql_scramble(packet + SW_MYSQL_PACKET_HEADER_SIZE, scramble, mysql->password);
+        length = SW_MYSQL_SCRAMBLE_LENGTH;
+    }
+    mysql_pack_length(length, packet);
+    packet[3] = sequence + 1;
+    return mysql->cli->send(mysql->cli, packet, SW_MYSQL_PACKET_HEADER_SIZE + length, 0) < 0 ? SW_ERR : SW_OK;
+}
+
+static int mysql_decode_field(char *buf, int len, mysql_field *col)
+{
+    int i;
+    unsigned long size;
+    char nul;
+    char *wh;
+    int tmp_len;
+
+    wh = buf;
+
+    i = 0;
+
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->catalog_length = size;
+    memmove(wh, &buf[i], size);
+    col->catalog = wh;
+    col->catalog[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* n (Length Coded String)    db */
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->db_length = size;
+    memmove(wh, &buf[i], size);
+    col->db = wh;
+    col->db[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* n (Length Coded String)    table */
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->table_length = size;
+    memmove(wh, &buf[i], size);
+    col->table = wh;
+    col->table[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* n (Length Coded String)    org_table */
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->org_table_length = size;
+    memmove(wh, &buf[i], size);
+    col->org_table = wh;
+    col->org_table[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* n (Length Coded String)    name */
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->name_length = size;
+    memmove(wh, &buf[i], size);
+    col->name = wh;
+    col->name[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* n (Length Coded String)    org_name */
+    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+    if (tmp_len == -1)
+    {
+        return -SW_MYSQL_ERR_BAD_LCB;
+    }
+    i += tmp_len;
+    if (i + size > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+    col->org_name_length = size;
+    memmove(wh, &buf[i], size);
+    col->org_name = wh;
+    col->org_name[size] = '\0';
+    wh += size + 1;
+    i += size;
+
+    /* check len */
+    if (i + 13 > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+
+    /* (filler) */
+    i += 1;
+
+    /* charset */
+    col->charsetnr = mysql_uint2korr(&buf[i]);
+    i += 2;
+
+    /* length */
+    col->length = mysql_uint4korr(&buf[i]);
+    i += 4;
+
+    /* type */
+    col->type = (unsigned char) buf[i];
+    i += 1;
+
+    /* flags */
+    col->flags = mysql_uint2korr(&buf[i]);
+    i += 2;
+
+    /* decimals */
+    col->decimals = buf[i];
+    i += 1;
+
+    /* filler */
+    i += 2;
+
+    /* default - a priori facultatif */
+    if (len - i > 0)
+    {
+        tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
+        if (tmp_len == -1)
+        {
+            return -SW_MYSQL_ERR_BAD_LCB;
+        }
+        i += tmp_len;
+        if (i + size > len)
+        {
+            return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+        }
+        col->def_length = size;
+        memmove(wh, &buf[i], size);
+        col->def = wh;
+        col->def[size] = '\0';
+        wh += size + 1;
+        i += size;
+    }
+    else
+    {
+        col->def = NULL;
+        col->def_length = 0;
+    }
+
+    /* set write pointer */
+    return wh - buf;
+}
+
+static int mysql_decode_text_row(mysql_connection *mysql, char *buf, int len, zval *row_array)
+{
+    int read_n = 0, i;
+    int tmp_len;
+    ulong_t size;
+    char nul;
+    char value_buffer[32];
+    char *error;
+    mysql_field *col;
+
+    for (i = 0; i < mysql->response.num_column; i++)
+    {
+        col = &mysql->response.columns[i];
+        tmp_len = mysql_length_coded_binary(&buf[read_n], &size, &nul, len - read_n);
+        if (tmp_len == -1)
+        {
+            return -SW_MYSQL_ERR_BAD_LCB;
+        }
+        read_n += tmp_len;
+        if (read_n + size > len)
+        {
+            return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+        }
+        if (nul == 1)
+        {
+            add_assoc_null(row_array, col->name);
+            continue;
+        }
+
+        switch (col->type)
+        {
+        /* Integer */
+        case SW_MYSQL_TYPE_TINY:
+        case SW_MYSQL_TYPE_SHORT:
+        case SW_MYSQL_TYPE_INT24:
+        case SW_MYSQL_TYPE_LONG:
+        case SW_MYSQL_TYPE_LONGLONG:
+        case SW_MYSQL_TYPE_YEAR:
+            if (size < sizeof(value_buffer))
+            {
+                memcpy(value_buffer, buf + read_n, size);
+                value_buffer[size] = 0;
+                errno = 0;
+                long long value = strtoll(value_buffer, &error, 10);
+                if (*error == '\0' && errno == 0 && value <= LONG_MAX && value >= LONG_MIN)
+                {
+                    add_assoc_long(row_array, col->name, (long) value);
+                    break;
+                }
+            }
+            //unsigned bigint overflow
+            sw_add_assoc_stringl(row_array, col->name, buf + read_n, size, 1);
+            break;
+
+        case SW_MYSQL_TYPE_FLOAT:
+        case SW_MYSQL_TYPE_DOUBLE:
+            if (size < sizeof(value_buffer))
+            {
+                memcpy(value_buffer, buf + read_n, size);
+                value_buffer[size] = 0;
+                double value = strtod(value_buffer, &error);
+                if (*error == '\0')
+                {
+                    add_assoc_double(row_array, col->name, value);
+                    break;
+                }
+            }
+            sw_add_assoc_stringl(row_array, col->name, buf + read_n, size, 1);
+            break;
+
+        /* String, Decimal, Date Time */
+        default:
+            sw_add_assoc_stringl(row_array, col->name, buf + read_n, size, 1);
+            break;
+        }
+        read_n += size;
+    }
+    return read_n;
+}
+
+/**
+ * binary protocol resultset row, for COM_STMT_EXECUTE
+ */
+static int mysql_decode_binary_row(mysql_connection *mysql, char *buf, int len, zval *row_array)
+{
+    int i;
+    int tmp_len;
+    ulong_t size;
+    char nul;
+    char value_buffer[64];
+    mysql_field *col;
+
+    int null_count = (mysql->response.num_column + 7 + 2) / 8;
+    char *null_bitmap = buf + 1;
+    int read_n = 1 + null_count;
+
+    if (read_n > len)
+    {
+        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+    }
+
+    for (i = 0; i < mysql->response.num_column; i++)
+    {
+        col = &mysql->response.columns[i];
+        if ((null_bitmap[(i + 2) / 8] >> ((i + 2) % 8)) & 1)
+        {
+            add_assoc_null(row_array, col->name);
+            continue;
+        }
+
+        switch (col->type)
+        {
+        case SW_MYSQL_TYPE_TINY:
+            if (read_n + 1 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            if (col->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, col->name, (uint8_t) buf[read_n]);
+            }
+            else
+            {
+                add_assoc_long(row_array, col->name, (int8_t) buf[read_n]);
+            }
+            read_n += 1;
+            break;
+
+        case SW_MYSQL_TYPE_SHORT:
+        case SW_MYSQL_TYPE_YEAR:
+            if (read_n + 2 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            if (col->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, col->name, (uint16_t) mysql_uint2korr(buf + read_n));
+            }
+            else
+            {
+                add_assoc_long(row_array, col->name, (int16_t) mysql_uint2korr(buf + read_n));
+            }
+            read_n += 2;
+            break;
+
+        case SW_MYSQL_TYPE_INT24:
+        case SW_MYSQL_TYPE_LONG:
+            if (read_n + 4 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            if (col->flags & SW_MYSQL_UNSIGNED_FLAG)
+            {
+                add_assoc_long(row_array, col->name, (long) (uint32_t) mysql_uint4korr(buf + read_n));
+            }
+            else
+            {
+                add_assoc_long(row_array, col->name, (int32_t) mysql_uint4korr(buf + read_n));
+            }
+            read_n += 4;
+            break;
+
+        case SW_MYSQL_TYPE_LONGLONG:
+            if (read_n + 8 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            else
+            {
+                uint64_t value = mysql_uint8korr(buf + read_n);
+                if ((col->flags & SW_MYSQL_UNSIGNED_FLAG) && value > LONG_MAX)
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%llu", (unsigned long long) value);
+                    sw_add_assoc_stringl(row_array, col->name, value_buffer, tmp_len, 1);
+                }
+                else
+                {
+                    add_assoc_long(row_array, col->name, (long) (int64_t) value);
+                }
+            }
+            read_n += 8;
+            break;
+
+        case SW_MYSQL_TYPE_FLOAT:
+            if (read_n + 4 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            else
+            {
+                float value;
+                memcpy(&value, buf + read_n, sizeof(value));
+                add_assoc_double(row_array, col->name, value);
+            }
+            read_n += 4;
+            break;
+
+        case SW_MYSQL_TYPE_DOUBLE:
+            if (read_n + 8 > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            else
+            {
+                double value;
+                memcpy(&value, buf + read_n, sizeof(value));
+                add_assoc_double(row_array, col->name, value);
+            }
+            read_n += 8;
+            break;
+
+        case SW_MYSQL_TYPE_DATE:
+        case SW_MYSQL_TYPE_DATETIME:
+        case SW_MYSQL_TYPE_TIMESTAMP:
+            size = (uint8_t) buf[read_n];
+            if (read_n + 1 + size > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            else
+            {
+                char *t = buf + read_n + 1;
+                int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, usec = 0;
+                if (size >= 4)
+                {
+                    year = mysql_uint2korr(t);
+                    month = (uint8_t) t[2];
+                    day = (uint8_t) t[3];
+                }
+                if (size >= 7)
+                {
+                    hour = (uint8_t) t[4];
+                    minute = (uint8_t) t[5];
+                    second = (uint8_t) t[6];
+                }
+                if (size >= 11)
+                {
+                    usec = mysql_uint4korr(t + 7);
+                }
+                if (col->type == SW_MYSQL_TYPE_DATE)
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%04d-%02d-%02d", year, month, day);
+                }
+                else if (usec)
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%04d-%02d-%02d %02d:%02d:%02d.%06d", year, month, day, hour, minute, second, usec);
+                }
+                else
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%04d-%02d-%02d %02d:%02d:%02d", year, month, day, hour, minute, second);
+                }
+                sw_add_assoc_stringl(row_array, col->name, value_buffer, tmp_len, 1);
+            }
+            read_n += 1 + size;
+            break;
+
+        case SW_MYSQL_TYPE_TIME:
+            size = (uint8_t) buf[read_n];
+            if (read_n + 1 + size > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            else
+            {
+                char *t = buf + read_n + 1;
+                int negative = 0, hour = 0, minute = 0, second = 0, usec = 0;
+                if (size >= 8)
+                {
+                    negative = t[0];
+                    hour = mysql_uint4korr(t + 1) * 24 + (uint8_t) t[5];
+                    minute = (uint8_t) t[6];
+                    second = (uint8_t) t[7];
+                }
+                if (size >= 12)
+                {
+                    usec = mysql_uint4korr(t + 8);
+                }
+                if (usec)
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%s%02d:%02d:%02d.%06d", negative ? "-" : "", hour, minute, second, usec);
+                }
+                else
+                {
+                    tmp_len = snprintf(value_buffer, sizeof(value_buffer), "%s%02d:%02d:%02d", negative ? "-" : "", hour, minute, second);
+                }
+                sw_add_assoc_stringl(row_array, col->name, value_buffer, tmp_len, 1);
+            }
+            read_n += 1 + size;
+            break;
+
+        case SW_MYSQL_TYPE_NULL:
+            add_assoc_null(row_array, col->name);
+            break;
+
+        /* String, Decimal, Blob */
+        default:
+            tmp_len = mysql_length_coded_binary(&buf[read_n], &size, &nul, len - read_n);
+            if (tmp_len == -1)
+            {
+                return -SW_MYSQL_ERR_BAD_LCB;
+            }
+            read_n += tmp_len;
+            if (read_n + size > len)
+            {
+                return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
+            }
+            sw_add_assoc_stringl(row_array, col->name, buf + read_n, size, 1);
+            read_n += size;
+            break;
+        }
+    }
+    return read_n;
+}
+
+static void mysql_response_free(mysql_connection *mysql TSRMLS_DC)
+{
+    int i;
+    if (mysql->response.columns)
+    {
+        for (i = 0; i < mysql->response.num_column; i++)
+        {
+            swoole_efree(mysql->response.columns[i].name);
+        }
+        efree(mysql->response.columns);
+    }
+    if (mysql->response.result_array)
+    {
+        sw_zval_ptr_dtor(&mysql->response.result_array);
+#if PHP_MAJOR_VERSION >= 7
+        efree(mysql->response.result_array);
+#endif
+    }
+    bzero(&mysql->response, sizeof(mysql->response));
+}
+
+static void mysql_set_error(mysql_connection *mysql, char *buf, int len, int connect TSRMLS_DC)
+{
+    //0xff + error code(2) + '#' + sql state(5) + error message
+    int error_code = len >= 3 ? mysql_uint2korr(buf + 1) : 0;
+    char *msg = buf + 3;
+    int msg_len = len - 3;
+    if (msg_len > 0 && msg[0] == '#')
+    {
+        msg += 6;
+        msg_len -= 6;
+    }
+    if (msg_len < 0)
+    {
+        msg_len = 0;
+    }
+    zend_update_property_long(swoole_mysql_class_entry_ptr, mysql->object, connect ? ZEND_STRL("connect_errno") : ZEND_STRL("errno"), error_code TSRMLS_CC);
+    zend_update_property_stringl(swoole_mysql_class_entry_ptr, mysql->object, connect ? ZEND_STRL("connect_error") : ZEND_STRL("error"), msg, msg_len TSRMLS_CC);
+}
+
+/**
+ * parse the response of the head request packet by packet
+ */
+static int mysql_response(mysql_connection *mysql, char *buf, int len TSRMLS_DC)
+{
+    mysql_request *req = mysql->requests->head ? mysql->requests->head->data : NULL;
+    uint8_t type = (uint8_t) buf[0];
+    ulong_t value;
+    char nul;
+    int n;
+    zval *result;
+
+    if (req == NULL || len < 1)
+    {
+        return -SW_MYSQL_ERR_UNEXPECT_R_STATE;
+    }
+
+    switch (mysql->state)
+    {
+    case SW_MYSQL_STATE_READ_START:
+        if (type == SW_MYSQL_PACKET_ERR)
+        {
+            mysql_set_error(mysql, buf, len, 0 TSRMLS_CC);
+            SW_MAKE_STD_ZVAL(result);
+            ZVAL_BOOL(result, 0);
+            mysql_request_callback(mysql, result TSRMLS_CC);
+            sw_zval_ptr_dtor(&result);
+            return SW_OK;
+        }
+        else if (type == SW_MYSQL_PACKET_OK && req->command == SW_MYSQL_COM_STMT_PREPARE)
+        {
+            //stmt id(4), num columns(2), num params(2)
+            if (len < 9)
+            {
+                return -SW_MYSQL_ERR_PACKET_CORRUPT;
+            }
+            mysql->response.stmt_id = mysql_uint4korr(buf + 1);
+            mysql->response.num_column = mysql_uint2korr(buf + 5);
+            mysql->response.num_param = mysql_uint2korr(buf + 7);
+            mysql->response.index = 0;
+            if (mysql->response.num_param > 0)
+            {
+                mysql->state = SW_MYSQL_STATE_READ_PARAM;
+                return SW_OK;
+            }
+            else if (mysql->response.num_column > 0)
+            {
+                mysql->state = SW_MYSQL_STATE_READ_FIELD;
+                return SW_OK;
+            }
+            goto prepare_end;
+        }
+        else if (type == SW_MYSQL_PACKET_OK)
+        {
+            char *p = buf + 1;
+            n = mysql_length_coded_binary(p, &value, &nul, len - 1);
+            if (n < 0)
+            {
+                return -SW_MYSQL_ERR_BAD_LCB;
+            }
+            zend_update_property_long(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("affected_rows"), value TSRMLS_CC);
+            p += n;
+            n = mysql_length_coded_binary(p, &value, &nul, len - (p - buf));
+            if (n < 0)
+            {
+                return -SW_MYSQL_ERR_BAD_LCB;
+            }
+            zend_update_property_long(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("insert_id"), value TSRMLS_CC);
+
+            SW_MAKE_STD_ZVAL(result);
+            ZVAL_BOOL(result, 1);
+            mysql_request_callback(mysql, result TSRMLS_CC);
+            sw_zval_ptr_dtor(&result);
+            return SW_OK;
+        }
+        //result set, column count
+        n = mysql_length_coded_binary(buf, &value, &nul, len);
+        if (n < 0 || value == 0)
+        {
+            return -SW_MYSQL_ERR_BAD_LCB;
+        }
+        mysql->response.num_column = value;
+        mysql->response.index = 0;
+        mysql->response.columns = ecalloc(value, sizeof(mysql_field));
+        SW_ALLOC_INIT_ZVAL(mysql->response.result_array);
+        array_init(mysql->response.result_array);
+        mysql->state = SW_MYSQL_STATE_READ_FIELD;
+        return SW_OK;
+
+    case SW_MYSQL_STATE_READ_PARAM:
+        if (++mysql->response.index == mysql->response.num_param)
+        {
+            mysql->state = SW_MYSQL_STATE_READ_PARAM_EOF;
+        }
+        return SW_OK;
+
+    case SW_MYSQL_STATE_READ_PARAM_EOF:
+        if (mysql->response.num_column > 0)
+        {
+            mysql->response.index = 0;
+            mysql->state = SW_MYSQL_STATE_READ_FIELD;
+            return SW_OK;
+        }
+        goto prepare_end;
+
+    case SW_MYSQL_STATE_READ_FIELD:
+        //the column definitions of prepare are not used
+        if (mysql->response.columns)
+        {
+            mysql_field *col = &mysql->response.columns[mysql->response.index];
+            n = mysql_decode_field(buf, len, col);
+            if (n < 0)
+            {
+                return n;
+            }
+            col->name = estrndup(col->name, col->name_length);
+            col->org_name = col->table = col->org_table = col->db = col->catalog = col->def = NULL;
+        }
+        if (++mysql->response.index == mysql->response.num_column)
+        {
+            mysql->state = SW_MYSQL_STATE_READ_FIELD_EOF;
+        }
+        return SW_OK;
+
+    case SW_MYSQL_STATE_READ_FIELD_EOF:
+        if (req->command == SW_MYSQL_COM_STMT_PREPARE)
+        {
+            goto prepare_end;
+        }
+        mysql->state = SW_MYSQL_STATE_READ_ROW;
+        return SW_OK;
+
+    case SW_MYSQL_STATE_READ_ROW:
+        if (type == SW_MYSQL_PACKET_EOF && len < 9)
+        {
+            result = mysql->response.result_array;
+            mysql->response.result_array = NULL;
+            mysql_request_callback(mysql, result TSRMLS_CC);
+            sw_zval_ptr_dtor(&result);
+#if PHP_MAJOR_VERSION >= 7
+            efree(result);
+#endif
+            return SW_OK;
+        }
+        else if (type == SW_MYSQL_PACKET_ERR)
+        {
+            mysql_set_error(mysql, buf, len, 0 TSRMLS_CC);
+            SW_MAKE_STD_ZVAL(result);
+            ZVAL_BOOL(result, 0);
+            mysql_request_callback(mysql, result TSRMLS_CC);
+            sw_zval_ptr_dtor(&result);
+            return SW_OK;
+        }
+        else
+        {
+            zval *row_array;
+            SW_MAKE_STD_ZVAL(row_array);
+            array_init(row_array);
+            if (req->command == SW_MYSQL_COM_STMT_EXECUTE)
+            {
+                n = mysql_decode_binary_row(mysql, buf, len, row_array);
+            }
+            else
+            {
+                n = mysql_decode_text_row(mysql, buf, len, row_array);
+            }
+            if (n < 0)
+            {
+                sw_zval_ptr_dtor(&row_array);
+                return n;
+            }
+            add_next_index_zval(mysql->response.result_array, row_array);
+            return SW_OK;
+        }
+
+    default:
+        return -SW_MYSQL_ERR_UNEXPECT_R_STATE;
+    }
+
+    //SW_MAKE_STD_ZVAL is a declaration in PHP 7, it can not follow the label
+    prepare_end:
+    {
+        SW_MAKE_STD_ZVAL(result);
+        ZVAL_LONG(result, mysql->response.stmt_id);
+        mysql_request_callback(mysql, result TSRMLS_CC);
+        sw_zval_ptr_dtor(&result);
+    }
+    return SW_OK;
+}
+
+static void mysql_onConnect(swClient *cli)
+{
+    mysql_connection *mysql = cli->object;
+    mysql->state = SW_MYSQL_STATE_HANDSHAKE;
+}
+
+/**
+ * split the stream into packets: payload length (3 bytes) + sequence id (1 byte) + payload
+ */
+static void mysql_onReceive(swClient *cli, char *data, uint32_t length)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    mysql_connection *mysql = cli->object;
+    swString *buffer = mysql->buffer;
+    zval *zobject = mysql->object;
+    uint32_t packet_length;
+    char *packet;
+
+    if (swString_append_ptr(buffer, data, length) < 0)
+    {
+        cli->close(cli);
+        return;
+    }
+
+    //the callbacks may destroy the object
+    sw_zval_add_ref(&zobject);
+
+    while (buffer->length - buffer->offset >= SW_MYSQL_PACKET_HEADER_SIZE)
+    {
+        packet = buffer->str + buffer->offset;
+        packet_length = mysql_uint3korr(packet);
+        //multi-packets is not supported
+        if (packet_length >= SW_MYSQL_PACKET_MAX_SIZE)
+        {
+            swWarn("mysql packet is too big, length=%d.", packet_length);
+            cli->close(cli);
+            break;
+        }
+        packet_length += SW_MYSQL_PACKET_HEADER_SIZE;
+        if (buffer->length - buffer->offset < packet_length)
+        {
+            break;
+        }
+        buffer->offset += packet_length;
+        if (mysql_onPacket(mysql, packet, packet_length TSRMLS_CC) < 0)
+        {
+            if (mysql->cli == cli && !cli->closed)
+            {
+                cli->close(cli);
+            }
+            break;
+        }
+        //closed in the callback
+        if (mysql->cli != cli || cli->closed)
+        {
+            break;
+        }
+    }
+
+    if (buffer->offset >= buffer->length || mysql->cli != cli || cli->closed)
+    {
+        swString_clear(buffer);
+    }
+    else if (buffer->offset > 0)
+    {
+        memmove(buffer->str, buffer->str + buffer->offset, buffer->length - buffer->offset);
+        buffer->length -= buffer->offset;
+        buffer->offset = 0;
+    }
+
+    sw_zval_ptr_dtor(&zobject);
+}
+
+static int mysql_onPacket(mysql_connection *mysql, char *data, uint32_t length TSRMLS_DC)
+{
+    uint8_t sequence = data[3];
+    char *buf = data + SW_MYSQL_PACKET_HEADER_SIZE;
+    int len = length - SW_MYSQL_PACKET_HEADER_SIZE;
+    int ret;
+
+    switch (mysql->state)
+    {
+    case SW_MYSQL_STATE_HANDSHAKE:
+        if (len > 0 && (uint8_t) buf[0] == SW_MYSQL_PACKET_ERR)
+        {
+            mysql_set_error(mysql, buf, len, 1 TSRMLS_CC);
+            return SW_ERR;
+        }
+        if (mysql_handshake(mysql, buf, len, sequence) < 0)
+        {
+            zend_update_property_string(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("connect_error"), "bad handshake packet." TSRMLS_CC);
+            return SW_ERR;
+        }
+        mysql->state = SW_MYSQL_STATE_AUTH;
+        return SW_OK;
+
+    case SW_MYSQL_STATE_AUTH:
+        if (len > 0 && (uint8_t) buf[0] == SW_MYSQL_PACKET_OK)
+        {
+            mysql->connected = 1;
+            mysql->state = SW_MYSQL_STATE_QUERY;
+            zend_update_property_bool(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("connected"), 1 TSRMLS_CC);
+            mysql_connect_callback(mysql, 1 TSRMLS_CC);
+            return SW_OK;
+        }
+        else if (len > 0 && (uint8_t) buf[0] == SW_MYSQL_PACKET_EOF)
+        {
+            if (mysql_auth_switch(mysql, buf, len, sequence) < 0)
+            {
+                zend_update_property_string(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("connect_error"), "auth plugin is not supported." TSRMLS_CC);
+                return SW_ERR;
+            }
+            return SW_OK;
+        }
+        mysql_set_error(mysql, buf, len, 1 TSRMLS_CC);
+        return SW_ERR;
+
+    default:
+        ret = mysql_response(mysql, buf, len TSRMLS_CC);
+        if (ret < 0)
+        {
+            swWarn("mysql response parse error, code=%d.", -ret);
+            return SW_ERR;
+        }
+        return SW_OK;
+    }
+}
+
+static void mysql_onError(swClient *cli)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    mysql_connection *mysql = cli->object;
+    zend_update_property_long(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("connect_errno"), SwooleG.error TSRMLS_CC);
+    zend_update_property_string(swoole_mysql_class_entry_ptr, mysql->object, ZEND_STRL("connect_error"), strerror(SwooleG.error) TSRMLS_CC);
+    //swClient will close the socket after onError
+    cli->onClose = NULL;
+    mysql_connect_callback(mysql, 0 TSRMLS_CC);
+}
+
+static void mysql_onClose(swClient *cli)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    mysql_connection *mysql = cli->object;
+    zval *zobject = mysql->object;
+    zval **args[1];
+    zval *retval = NULL;
+
+    mysql->connected = 0;
+    zend_update_property_bool(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("connected"), 0 TSRMLS_CC);
+
+    //closed before the authentication is done
+    if (mysql->onConnect)
+    {
+        mysql_connect_callback(mysql, 0 TSRMLS_CC);
+        return;
+    }
+
+    mysql_clear(mysql, 2006, "MySQL server has gone away" TSRMLS_CC);
+
+    if (mysql->onClose)
+    {
+        args[0] = &zobject;
+        if (sw_call_user_function_ex(EG(function_table), NULL, mysql->onClose, &retval, 1, args, 0, NULL TSRMLS_CC) != SUCCESS)
+        {
+            swoole_php_fatal_error(E_WARNING, "swoole_mysql onClose handler error.");
+        }
+        if (EG(exception))
+        {
+            zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+        }
+        if (retval)
+        {
+            sw_zval_ptr_dtor(&retval);
+        }
+    }
+}
+
+static void mysql_connect_callback(mysql_connection *mysql, int result TSRMLS_DC)
+{
+    zval *zobject = mysql->object;
+    zval *zcallback = mysql->onConnect;
+    zval **args[2];
+    zval *retval = NULL;
+    zval *zresult;
+
+    if (!zcallback)
+    {
+        return;
+    }
+    if (mysql->connect_timer >= 0)
+    {
+        php_swoole_del_timer_internal(mysql->connect_timer);
+        mysql->connect_timer = -1;
+    }
+#if PHP_MAJOR_VERSION >= 7
+    //connect() may be called again in the callback
+    zval _zcallback;
+    memcpy(&_zcallback, zcallback, sizeof(zval));
+    zcallback = &_zcallback;
+#endif
+    mysql->onConnect = NULL;
+
+    if (!result)
+    {
+        mysql_clear(mysql, 2002, "Can't connect to MySQL server" TSRMLS_CC);
+    }
+
+    SW_MAKE_STD_ZVAL(zresult);
+    ZVAL_BOOL(zresult, result);
+    args[0] = &zobject;
+    args[1] = &zresult;
+    if (sw_call_user_function_ex(EG(function_table), NULL, zcallback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_mysql onConnect handler error.");
+    }
+    if (EG(exception))
+    {
+        zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+    }
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+    sw_zval_ptr_dtor(&zresult);
+    sw_zval_ptr_dtor(&zcallback);
+
+    //send the queued requests
+    if (result && mysql->cli && !mysql->cli->closed)
+    {
+        mysql_send(mysql TSRMLS_CC);
+    }
+}
+
+/**
+ * the head request is done, call the callback and send the next one
+ */
+static void mysql_request_callback(mysql_connection *mysql, zval *result TSRMLS_DC)
+{
+    zval *zobject = mysql->object;
+    zval **args[2];
+    zval *retval = NULL;
+
+    mysql_request *req = swLinkedList_shift(mysql->requests);
+    mysql->sent_num--;
+    mysql->state = mysql->sent_num > 0 ? SW_MYSQL_STATE_READ_START : SW_MYSQL_STATE_QUERY;
+    mysql_response_free(mysql TSRMLS_CC);
+
+    if (req->callback)
+    {
+        args[0] = &zobject;
+        args[1] = &result;
+        if (sw_call_user_function_ex(EG(function_table), NULL, req->callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+        {
+            swoole_php_fatal_error(E_WARNING, "swoole_mysql callback handler error.");
+        }
+        if (EG(exception))
+        {
+            zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+        }
+        if (retval)
+        {
+            sw_zval_ptr_dtor(&retval);
+        }
+    }
+    mysql_request_free(req TSRMLS_CC);
+
+    if (mysql->cli && !mysql->cli->closed)
+    {
+        mysql_send(mysql TSRMLS_CC);
+    }
+}
+
+static void mysql_request_free(mysql_request *req TSRMLS_DC)
+{
+    if (req->callback)
+    {
+        sw_zval_ptr_dtor(&req->callback);
+    }
+    swString_free(req->packet);
+    efree(req);
+}
+
+/**
+ * fail all of the requests
+ */
+static void mysql_clear(mysql_connection *mysql, int error, char *error_msg TSRMLS_DC)
+{
+    mysql_request *req;
+    zval *result;
+    zval *zobject = mysql->object;
+    zval **args[2];
+    zval *retval = NULL;
+
+    mysql_response_free(mysql TSRMLS_CC);
+    mysql->state = SW_MYSQL_STATE_QUERY;
+    mysql->sent_num = 0;
+
+    while ((req = swLinkedList_shift(mysql->requests)))
+    {
+        zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("errno"), error TSRMLS_CC);
+        zend_update_property_string(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("error"), error_msg TSRMLS_CC);
+        if (req->callback)
+        {
+            SW_MAKE_STD_ZVAL(result);
+            ZVAL_BOOL(result, 0);
+            args[0] = &zobject;
+            args[1] = &result;
+            if (sw_call_user_function_ex(EG(function_table), NULL, req->callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+            {
+                swoole_php_fatal_error(E_WARNING, "swoole_mysql callback handler error.");
+            }
+            if (EG(exception))
+            {
+                zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+            }
+            if (retval)
+            {
+                sw_zval_ptr_dtor(&retval);
+            }
+            sw_zval_ptr_dtor(&result);
+        }
+        mysql_request_free(req TSRMLS_CC);
+    }
+}
+
+static int mysql_request_add(mysql_connection *mysql, swString *packet, uint8_t command, zval *callback TSRMLS_DC)
+{
+    mysql_request *req = emalloc(sizeof(mysql_request));
+    bzero(req, sizeof(mysql_request));
+
+    req->packet = packet;
+    req->command = command;
+#if PHP_MAJOR_VERSION >= 7
+    req->callback = &req->_callback;
+    memcpy(req->callback, callback, sizeof(zval));
+#else
+    req->callback = callback;
+#endif
+    sw_zval_add_ref(&req->callback);
+
+    if (swLinkedList_append(mysql->requests, req) < 0)
+    {
+        mysql_request_free(req TSRMLS_CC);
+        return SW_ERR;
+    }
+    return mysql_send(mysql TSRMLS_CC);
+}
+
+/**
+ * send the queued requests, all of them are written at once in pipeline mode
+ */
+static int mysql_send(mysql_connection *mysql TSRMLS_DC)
+{
+    swLinkedList_node *node;
+    mysql_request *req;
+    uint32_t i = 0;
+
+    //not ready
+    if (!mysql->connected || !mysql->cli || mysql->onConnect)
+    {
+        return SW_OK;
+    }
+
+    for (node = mysql->requests->head; node; node = node->next, i++)
+    {
+        //already sent
+        if (i < mysql->sent_num)
+        {
+            continue;
+        }
+        if (mysql->sent_num > 0 && !mysql->pipeline)
+        {
+            break;
+        }
+        req = node->data;
+        if (mysql->cli->send(mysql->cli, req->packet->str, req->packet->length, 0) < 0)
+        {
+            swoole_php_sys_error(E_WARNING, "send(%d) %d bytes failed.", mysql->cli->socket->fd, (int) req->packet->length);
+            return SW_ERR;
+        }
+        mysql->sent_num++;
+        mysql->state = SW_MYSQL_STATE_READ_START;
+    }
+    return SW_OK;
+}
+
+static void mysql_pool_free_client(swClient *cli)
+{
+    //swClient only frees the input buffer of the eof/length check mode
+    if (cli->buffer)
+    {
+        swString_free(cli->buffer);
+    }
+    pefree(cli, 1);
+}
+
+static sw_inline int mysql_is_idle(mysql_connection *mysql)
+{
+    //the buffer is only cleared after the packets are handled, close() may be called in the callback
+    return mysql->connected && mysql->state == SW_MYSQL_STATE_QUERY && mysql->requests->num == 0
+            && mysql->buffer->offset == mysql->buffer->length && !mysql->onConnect;
+}
+
+static void mysql_free_cli(mysql_connection *mysql)
+{
+    swClient *cli = mysql->cli;
+    int idle = mysql_is_idle(mysql);
+    mysql->cli = NULL;
+    mysql->connected = 0;
+
+    //idle connection, give back to the pool
+    if (cli->pool && !cli->closed && idle)
+    {
+        SwooleG.main_reactor->del(SwooleG.main_reactor, cli->socket->fd);
+        cli->object = NULL;
+        cli->onConnect = NULL;
+        cli->onReceive = NULL;
+        cli->onError = NULL;
+        cli->onClose = NULL;
+        swClientPool_release(cli->pool, cli);
+        return;
+    }
+
+    if (!cli->closed)
+    {
+        cli->onClose = NULL;
+        cli->close(cli);
+    }
+    if (cli->pool)
+    {
+        swClientPool_remove(cli->pool, cli);
+        mysql_pool_free_client(cli);
+    }
+    else
+    {
+        if (cli->buffer)
+        {
+            swString_free(cli->buffer);
+        }
+        efree(cli);
+    }
+}
+
+static void mysql_onConnectFromPool(void *object)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+    mysql_connection *mysql = object;
+    zval *zobject = mysql->object;
+
+    mysql->connect_timer = -1;
+    sw_zval_add_ref(&zobject);
+    mysql_connect_callback(mysql, 1 TSRMLS_CC);
+    sw_zval_ptr_dtor(&zobject);
+}
+
+/**
+ * the tcp connect, handshake and authentication did not finish in time
+ */
+static void mysql_onConnectTimeout(void *object)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+    mysql_connection *mysql = object;
+    zval *zobject = mysql->object;
+    swClient *cli = mysql->cli;
+
+    mysql->connect_timer = -1;
+    if (!mysql->onConnect)
+    {
+        return;
+    }
+    zend_update_property_long(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("connect_errno"), ETIMEDOUT TSRMLS_CC);
+    zend_update_property_string(swoole_mysql_class_entry_ptr, zobject, ZEND_STRL("connect_error"), "connect timeout" TSRMLS_CC);
+    //the socket is released by the next connect() or the destructor
+    if (cli && !cli->closed)
+    {
+        cli->onClose = NULL;
+        cli->close(cli);
+    }
+    mysql->connected = 0;
+
+    sw_zval_add_ref(&zobject);
+    mysql_connect_callback(mysql, 0 TSRMLS_CC);
+    sw_zval_ptr_dtor(&zobject);
+}
+
+void swoole_mysql_init(int module_number TSRMLS_DC)
+{
+    INIT_CLASS_ENTRY(swoole_mysql_ce, "swoole_mysql", swoole_mysql_methods);
+    swoole_mysql_class_entry_ptr = zend_register_internal_class(&swoole_mysql_ce TSRMLS_CC);
+
+    zend_declare_property_bool(swoole_mysql_class_entry_ptr, ZEND_STRL("connected"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_mysql_class_entry_ptr, ZEND_STRL("connect_errno"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_string(swoole_mysql_class_entry_ptr, ZEND_STRL("connect_error"), "", ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_mysql_class_entry_ptr, ZEND_STRL("errno"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_string(swoole_mysql_class_entry_ptr, ZEND_STRL("error"), "", ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_mysql_class_entry_ptr, ZEND_STRL("affected_rows"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_mysql_class_entry_ptr, ZEND_STRL("insert_id"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+
+#ifdef SW_ASYNC_MYSQL
+    swoole_mysql_legacy_init(module_number TSRMLS_CC);
+#endif
+}
+
+static PHP_METHOD(swoole_mysql, __construct)
+{
+    mysql_connection *mysql = emalloc(sizeof(mysql_connection));
+    bzero(mysql, sizeof(mysql_connection));
+
+    mysql->requests = swLinkedList_new();
+    mysql->buffer = swString_new(SW_BUFFER_SIZE_BIG);
+    mysql->connect_timer = -1;
+#if PHP_MAJOR_VERSION >= 7
+    mysql->object = &mysql->_object;
+    memcpy(mysql->object, getThis(), sizeof(zval));
+#else
+    mysql->object = getThis();
+#endif
+    swoole_set_object(getThis(), mysql);
+}
+
+static PHP_METHOD(swoole_mysql, __destruct)
+{
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql)
+    {
+        return;
+    }
+    swoole_set_object(getThis(), NULL);
+
+    if (mysql->connect_timer >= 0)
+    {
+        php_swoole_del_timer_internal(mysql->connect_timer);
+    }
+    if (mysql->onConnect)
+    {
+        sw_zval_ptr_dtor(&mysql->onConnect);
+        mysql->onConnect = NULL;
+    }
+    if (mysql->cli)
+    {
+        mysql_free_cli(mysql);
+    }
+    mysql_response_free(mysql TSRMLS_CC);
+
+    mysql_request *req;
+    while ((req = swLinkedList_shift(mysql->requests)))
+    {
+        mysql_request_free(req TSRMLS_CC);
+    }
+    sw_free(mysql->requests);
+    swString_free(mysql->buffer);
+
+    if (mysql->onClose)
+    {
+        sw_zval_ptr_dtor(&mysql->onClose);
+    }
+    swoole_efree(mysql->host);
+    swoole_efree(mysql->user);
+    swoole_efree(mysql->password);
+    swoole_efree(mysql->database);
+    efree(mysql);
+}
+
+//$db->connect(array $server, callable $callback);
+static PHP_METHOD(swoole_mysql, connect)
+{
+    zval *server_info;
+    zval *callback;
+    zval *value;
+    char key[SW_LONG_CONNECTION_KEY_LEN];
+    int key_len;
+    swClientPool *pool = NULL;
+    swClient *cli = NULL;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "az", &server_info, &callback) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql)
+    {
+        RETURN_FALSE;
+    }
+    //the last connection was closed by the server
+    if (mysql->cli && mysql->cli->closed && !mysql->onConnect)
+    {
+        mysql_free_cli(mysql);
+    }
+    if (mysql->cli || mysql->onConnect)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql client is already connected.");
+        RETURN_FALSE;
+    }
+
+    HashTable *_ht = Z_ARRVAL_P(server_info);
+
+    if (sw_zend_hash_find(_ht, ZEND_STRS("host"), (void **) &value) == FAILURE)
+    {
+        swoole_php_fatal_error(E_WARNING, "host is empty.");
+        RETURN_FALSE;
+    }
+    convert_to_string(value);
+    swoole_efree(mysql->host);
+    mysql->host = estrndup(Z_STRVAL_P(value), Z_STRLEN_P(value));
+
+    mysql->port = 3306;
+    if (sw_zend_hash_find(_ht, ZEND_STRS("port"), (void **) &value) == SUCCESS)
+    {
+        convert_to_long(value);
+        mysql->port = Z_LVAL_P(value);
+    }
+
+    if (sw_zend_hash_find(_ht, ZEND_STRS("user"), (void **) &value) == FAILURE)
+    {
+        swoole_php_fatal_error(E_WARNING, "user is empty.");
+        RETURN_FALSE;
+    }
+    convert_to_string(value);
+    swoole_efree(mysql->user);
+    mysql->user = estrndup(Z_STRVAL_P(value), Z_STRLEN_P(value));
+
+    swoole_efree(mysql->password);
+    mysql->password = NULL;
+    if (sw_zend_hash_find(_ht, ZEND_STRS("password"), (void **) &value) == SUCCESS)
+    {
+        convert_to_string(value);
+        mysql->password = estrndup(Z_STRVAL_P(value), Z_STRLEN_P(value));
+    }
+
+    swoole_efree(mysql->database);
+    mysql->database = NULL;
+    if (sw_zend_hash_find(_ht, ZEND_STRS("database"), (void **) &value) == SUCCESS)
+    {
+        convert_to_string(value);
+        mysql->database = estrndup(Z_STRVAL_P(value), Z_STRLEN_P(value));
+    }
+
+    mysql->charset = mysql_get_charset("utf8");
+    if (sw_zend_hash_find(_ht, ZEND_STRS("charset"), (void **) &value) == SUCCESS)
+    {
+        convert_to_string(value);
+        mysql->charset = mysql_get_charset(Z_STRVAL_P(value));
+        if (mysql->charset == 0)
+        {
+            swoole_php_fatal_error(E_WARNING, "unknown charset [%s].", Z_STRVAL_P(value));
+            RETURN_FALSE;
+        }
+    }
+
+    mysql->timeout = SW_MYSQL_CONNECT_TIMEOUT;
+    if (sw_zend_hash_find(_ht, ZEND_STRS("timeout"), (void **) &value) == SUCCESS)
+    {
+        convert_to_double(value);
+        mysql->timeout = Z_DVAL_P(value);
+    }
+
+    if (sw_zend_hash_find(_ht, ZEND_STRS("pipeline"), (void **) &value) == SUCCESS)
+    {
+        convert_to_boolean(value);
+        mysql->pipeline = Z_BVAL_P(value);
+    }
+
+    mysql->pool_size = 0;
+    if (sw_zend_hash_find(_ht, ZEND_STRS("pool_size"), (void **) &value) == SUCCESS)
+    {
+        convert_to_long(value);
+        mysql->pool_size = Z_LVAL_P(value) > 0 ? Z_LVAL_P(value) : 0;
+    }
+
+    php_swoole_check_reactor();
+
+    //borrow an authenticated connection from the pool
+    if (mysql->pool_size > 0)
+    {
+        key_len = snprintf(key, sizeof(key), "%s@%s:%ld/%s", mysql->user, mysql->host, mysql->port, mysql->database ? mysql->database : "");
+        if (mysql_pools == NULL)
+        {
+            mysql_pools = swHashMap_new(SW_HASHMAP_INIT_BUCKET_N, NULL);
+        }
+        pool = swHashMap_find(mysql_pools, key, key_len);
+        if (pool == NULL)
+        {
+            pool = swClientPool_new(key, key_len, 0, mysql->pool_size);
+            if (pool == NULL)
+            {
+                RETURN_FALSE;
+            }
+            pool->onFree = mysql_pool_free_client;
+            swHashMap_add(mysql_pools, key, key_len, pool, NULL);
+        }
+        pool->max_size = mysql->pool_size;
+
+        cli = swClientPool_get(pool);
+        if (cli == NULL && swClientPool_full(pool))
+        {
+            pool->full_count++;
+            swoole_php_error(E_WARNING, "the connection pool of [%s] is full, max_size=%d.", key, pool->max_size);
+            zend_update_property_long(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("connect_errno"), SW_ERROR_CLIENT_POOL_FULL TSRMLS_CC);
+            RETURN_FALSE;
+        }
+    }
+
+#if PHP_MAJOR_VERSION >= 7
+    mysql->onConnect = &mysql->_onConnect;
+    memcpy(mysql->onConnect, callback, sizeof(zval));
+#else
+    mysql->onConnect = callback;
+#endif
+    sw_zval_add_ref(&mysql->onConnect);
+    swString_clear(mysql->buffer);
+
+    if (cli)
+    {
+        mysql->cli = cli;
+        mysql->connected = 1;
+        mysql->state = SW_MYSQL_STATE_QUERY;
+    }
+    else
+    {
+        cli = pool ? pemalloc(sizeof(swClient), 1) : emalloc(sizeof(swClient));
+        if (swClient_create(cli, SW_SOCK_TCP, 1) < 0)
+        {
+            pool ? pefree(cli, 1) : efree(cli);
+            swoole_php_fatal_error(E_WARNING, "swClient_create() failed. Error: %s [%d]", strerror(errno), errno);
+            zend_update_property_long(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("connect_errno"), errno TSRMLS_CC);
+            sw_zval_ptr_dtor(&mysql->onConnect);
+            mysql->onConnect = NULL;
+            RETURN_FALSE;
+        }
+        if (pool)
+        {
+            swClientPool_add(pool, cli);
+        }
+        mysql->cli = cli;
+        mysql->connected = 0;
+        mysql->state = SW_MYSQL_STATE_HANDSHAKE;
+    }
+
+    cli->object = mysql;
+    cli->reactor_fdtype = PHP_SWOOLE_FD_CLIENT;
+    cli->onConnect = mysql_onConnect;
+    cli->onReceive = mysql_onReceive;
+    cli->onError = mysql_onError;
+    cli->onClose = mysql_onClose;
+
+    if (mysql->connected)
+    {
+        if (SwooleG.main_reactor->add(SwooleG.main_reactor, cli->socket->fd, cli->reactor_fdtype | SW_EVENT_READ) < 0)
+        {
+            goto _failed;
+        }
+        //onConnect is called in the event loop, same as a new connection
+        mysql->connect_timer = php_swoole_add_timer_internal(1, mysql_onConnectFromPool, mysql, 0);
+        if (mysql->connect_timer < 0)
+        {
+            goto _failed;
+        }
+        RETURN_TRUE;
+    }
+
+    if (cli->connect(cli, mysql->host, mysql->port, mysql->timeout, 1) < 0)
+    {
+        swoole_php_fatal_error(E_WARNING, "connect to mysql server[%s:%ld] failed.", mysql->host, mysql->port);
+        goto _failed;
+    }
+    //the async connect has no timeout of its own, it covers the handshake and authentication too
+    if (mysql->timeout > 0)
+    {
+        int ms = (int) (mysql->timeout * 1000);
+        mysql->connect_timer = php_swoole_add_timer_internal(ms > 0 ? ms : 1, mysql_onConnectTimeout, mysql, 0);
+    }
+    RETURN_TRUE;
+
+    _failed:
+    sw_zval_ptr_dtor(&mysql->onConnect);
+    mysql->onConnect = NULL;
+    mysql->connected = 0;
+    mysql_free_cli(mysql);
+    RETURN_FALSE;
+}
+
+//$db->query($sql, callable $callback);
+static PHP_METHOD(swoole_mysql, query)
+{
+    char *sql;
+    zend_size_t sql_len;
+    zval *callback;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &sql, &sql_len, &callback) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (sql_len <= 0)
+    {
+        swoole_php_fatal_error(E_WARNING, "Query is empty.");
+        RETURN_FALSE;
+    }
+    if (sql_len >= SW_MYSQL_PACKET_MAX_SIZE)
+    {
+        swoole_php_fatal_error(E_WARNING, "Query is too big.");
+        RETURN_FALSE;
+    }
+
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql || !mysql->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql client is not connected to server.");
+        RETURN_FALSE;
+    }
+
+    swString *packet = swString_new(sql_len + 5);
+    mysql_packet_init(packet, SW_MYSQL_COM_QUERY);
+    swString_append_ptr(packet, sql, sql_len);
+    mysql_packet_end(packet, 0);
+
+    SW_CHECK_RETURN(mysql_request_add(mysql, packet, SW_MYSQL_COM_QUERY, callback TSRMLS_CC));
+}
+
+//$db->prepare($sql, function($db, $stmt_id) {});
+static PHP_METHOD(swoole_mysql, prepare)
+{
+    char *sql;
+    zend_size_t sql_len;
+    zval *callback;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &sql, &sql_len, &callback) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (sql_len <= 0 || sql_len >= SW_MYSQL_PACKET_MAX_SIZE)
+    {
+        swoole_php_fatal_error(E_WARNING, "Query is empty or too big.");
+        RETURN_FALSE;
+    }
+
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql || !mysql->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql client is not connected to server.");
+        RETURN_FALSE;
+    }
+
+    swString *packet = swString_new(sql_len + 5);
+    mysql_packet_init(packet, SW_MYSQL_COM_STMT_PREPARE);
+    swString_append_ptr(packet, sql, sql_len);
+    mysql_packet_end(packet, 0);
+
+    SW_CHECK_RETURN(mysql_request_add(mysql, packet, SW_MYSQL_COM_STMT_PREPARE, callback TSRMLS_CC));
+}
+
+//$db->execute($stmt_id, array $params, callable $callback);
+static PHP_METHOD(swoole_mysql, execute)
+{
+    long stmt_id;
+    zval *params;
+    zval *callback;
+    zval *value;
+    int i = 0;
+    char buf[16];
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "laz", &stmt_id, &params, &callback) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql || !mysql->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql client is not connected to server.");
+        RETURN_FALSE;
+    }
+
+    int num_params = php_swoole_array_length(params);
+    int null_count = (num_params + 7) / 8;
+
+    swString *packet = swString_new(SW_BUFFER_SIZE_BIG);
+    mysql_packet_init(packet, SW_MYSQL_COM_STMT_EXECUTE);
+
+    //stmt id(4), flags(1), iteration count(4)
+    mysql_int4store(buf, stmt_id);
+    buf[4] = 0;
+    mysql_int4store(buf + 5, 1);
+    swString_append_ptr(packet, buf, 9);
+
+    if (num_params > 0)
+    {
+        //null bitmap, new-params-bound flag, the types
+        size_t null_offset = packet->length;
+        size_t type_offset = null_offset + null_count + 1;
+        swString_extend(packet, packet->size + null_count + 1 + num_params * 2);
+        bzero(packet->str + null_offset, null_count + 1 + num_params * 2);
+        packet->str[null_offset + null_count] = 1;
+        packet->length = type_offset + num_params * 2;
+
+        SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(params), value)
+            //the buffer may be moved by swString_append_ptr, write the type first
+            char *type = packet->str + type_offset + i * 2;
+            switch (Z_TYPE_P(value))
+            {
+            case IS_NULL:
+                packet->str[null_offset + i / 8] |= (1 << (i % 8));
+                type[0] = SW_MYSQL_TYPE_NULL;
+                break;
+            case IS_LONG:
+                type[0] = SW_MYSQL_TYPE_LONGLONG;
+                mysql_int8store(buf, (int64_t) Z_LVAL_P(value));
+                swString_append_ptr(packet, buf, 8);
+                break;
+            case IS_DOUBLE:
+                type[0] = SW_MYSQL_TYPE_DOUBLE;
+                memcpy(buf, &Z_DVAL_P(value), 8);
+                swString_append_ptr(packet, buf, 8);
+                break;
+#if PHP_MAJOR_VERSION < 7
+            case IS_BOOL:
+#else
+            case IS_TRUE:
+            case IS_FALSE:
+#endif
+                type[0] = SW_MYSQL_TYPE_TINY;
+                buf[0] = Z_BVAL_P(value) ? 1 : 0;
+                swString_append_ptr(packet, buf, 1);
+                break;
+            case IS_STRING:
+                type[0] = (char) SW_MYSQL_TYPE_VAR_STRING;
+                swString_append_ptr(packet, buf, mysql_write_lcb(buf, Z_STRLEN_P(value)));
+                swString_append_ptr(packet, Z_STRVAL_P(value), Z_STRLEN_P(value));
+                break;
+            default:
+            {
+                //do not change the array of the caller, it may be shared or immutable in PHP 7
+                zval copy = *value;
+                zval_copy_ctor(&copy);
+                convert_to_string(&copy);
+                type[0] = (char) SW_MYSQL_TYPE_VAR_STRING;
+                swString_append_ptr(packet, buf, mysql_write_lcb(buf, Z_STRLEN(copy)));
+                swString_append_ptr(packet, Z_STRVAL(copy), Z_STRLEN(copy));
+                zval_dtor(&copy);
+                break;
+            }
+            }
+            i++;
+        SW_HASHTABLE_FOREACH_END();
+    }
 
-#include "ext/mysqlnd/mysqlnd.h"
-#include "ext/mysqli/mysqli_mysqlnd.h"
-#include "ext/mysqli/php_mysqli_structs.h"
+    if (packet->length - SW_MYSQL_PACKET_HEADER_SIZE >= SW_MYSQL_PACKET_MAX_SIZE)
+    {
+        swoole_php_fatal_error(E_WARNING, "the parameters are too big.");
+        swString_free(packet);
+        RETURN_FALSE;
+    }
+    mysql_packet_end(packet, 0);
 
-//#define SW_MYSQL_STRICT_TYPE
-//#define SW_MYSQL_DEBUG
+    SW_CHECK_RETURN(mysql_request_add(mysql, packet, SW_MYSQL_COM_STMT_EXECUTE, callback TSRMLS_CC));
+}
 
-enum mysql_command
+static PHP_METHOD(swoole_mysql, close)
 {
-    SW_MYSQL_COM_SLEEP = 0,
-    SW_MYSQL_COM_QUIT,
-    SW_MYSQL_SW_MYSQL_COM_INIT_DB,
-    SW_MYSQL_COM_QUERY = 3,
-    SW_MYSQL_COM_FIELD_LIST,
-    SW_MYSQL_COM_CREATE_DB,
-    SW_MYSQL_COM_DROP_DB,
-    SW_MYSQL_COM_REFRESH,
-    SW_MYSQL_COM_SHUTDOWN,
-    SW_MYSQL_COM_STATISTICS,
-    SW_MYSQL_COM_PROCESS_INFO,
-    SW_MYSQL_COM_CONNECT,
-    SW_MYSQL_COM_PROCESS_KILL,
-    SW_MYSQL_COM_DEBUG,
-    SW_MYSQL_COM_PING,
-    SW_MYSQL_COM_TIME,
-    SW_MYSQL_COM_DELAYED_INSERT,
-    SW_MYSQL_COM_CHANGE_USER,
-    SW_MYSQL_COM_BINLOG_DUMP,
-    SW_MYSQL_COM_TABLE_DUMP,
-    SW_MYSQL_COM_CONNECT_OUT,
-    SW_MYSQL_COM_REGISTER_SLAVE,
-    SW_MYSQL_COM_STMT_PREPARE,
-    SW_MYSQL_COM_STMT_EXECUTE,
-    SW_MYSQL_COM_STMT_SEND_LONG_DATA,
-    SW_MYSQL_COM_STMT_CLOSE,
-    SW_MYSQL_COM_STMT_RESET,
-    SW_MYSQL_COM_SET_OPTION,
-    SW_MYSQL_COM_STMT_FETCH,
-    SW_MYSQL_COM_DAEMON,
-    SW_MYSQL_COM_END
-};
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql || !mysql->cli)
+    {
+        swoole_php_fatal_error(E_WARNING, "mysql client is not connected to server.");
+        RETURN_FALSE;
+    }
 
-enum mysql_read_state
-{
-    SW_MYSQL_STATE_QUERY,
-    SW_MYSQL_STATE_READ_START,
-    SW_MYSQL_STATE_READ_FIELD,
-    SW_MYSQL_STATE_READ_ROW,
-    SW_MYSQL_STATE_READ_END,
-};
+    //the idle connection of the pool is kept alive
+    if (!mysql->cli->closed && !(mysql->cli->pool && mysql_is_idle(mysql)))
+    {
+        //onClose callback
+        mysql->cli->close(mysql->cli);
+    }
+    if (mysql->cli)
+    {
+        mysql_free_cli(mysql);
+    }
+    zend_update_property_bool(swoole_mysql_class_entry_ptr, getThis(), ZEND_STRL("connected"), 0 TSRMLS_CC);
+    RETURN_TRUE;
+}
 
-enum mysql_error_code
+static PHP_METHOD(swoole_mysql, on)
 {
-    SW_MYSQL_ERR_PROTOCOL_ERROR = 1,
-    SW_MYSQL_ERR_BUFFER_OVERSIZE,
-    SW_MYSQL_ERR_PACKET_CORRUPT,
-    SW_MYSQL_ERR_WANT_READ,
-    SW_MYSQL_ERR_WANT_WRITE,
-    SW_MYSQL_ERR_UNKNOWN_ERROR,
-    SW_MYSQL_ERR_MYSQL_ERROR,
-    SW_MYSQL_ERR_SERVER_LOST,
-    SW_MYSQL_ERR_BAD_PORT,
-    SW_MYSQL_ERR_RESOLV_HOST,
-    SW_MYSQL_ERR_SYSTEM,
-    SW_MYSQL_ERR_CANT_CONNECT,
-    SW_MYSQL_ERR_BUFFER_TOO_SMALL,
-    SW_MYSQL_ERR_UNEXPECT_R_STATE,
-    SW_MYSQL_ERR_STRFIELD_CORRUPT,
-    SW_MYSQL_ERR_BINFIELD_CORRUPT,
-    SW_MYSQL_ERR_BAD_LCB,
-    SW_MYSQL_ERR_LEN_OVER_BUFFER,
-    SW_MYSQL_ERR_CONVLONG,
-    SW_MYSQL_ERR_CONVLONGLONG,
-    SW_MYSQL_ERR_CONVFLOAT,
-    SW_MYSQL_ERR_CONVDOUBLE,
-    SW_MYSQL_ERR_CONVTIME,
-    SW_MYSQL_ERR_CONVTIMESTAMP,
-    SW_MYSQL_ERR_CONVDATE
-};
+    char *name;
+    zend_size_t len;
+    zval *cb;
 
-enum mysql_field_types
-{
-    SW_MYSQL_TYPE_DECIMAL,
-    SW_MYSQL_TYPE_TINY,
-    SW_MYSQL_TYPE_SHORT,
-    SW_MYSQL_TYPE_LONG,
-    SW_MYSQL_TYPE_FLOAT,
-    SW_MYSQL_TYPE_DOUBLE,
-    SW_MYSQL_TYPE_NULL,
-    SW_MYSQL_TYPE_TIMESTAMP,
-    SW_MYSQL_TYPE_LONGLONG,
-    SW_MYSQL_TYPE_INT24,
-    SW_MYSQL_TYPE_DATE,
-    SW_MYSQL_TYPE_TIME,
-    SW_MYSQL_TYPE_DATETIME,
-    SW_MYSQL_TYPE_YEAR,
-    SW_MYSQL_TYPE_NEWDATE,
-    SW_MYSQL_TYPE_VARCHAR,
-    SW_MYSQL_TYPE_BIT,
-    SW_MYSQL_TYPE_NEWDECIMAL = 246,
-    SW_MYSQL_TYPE_ENUM = 247,
-    SW_MYSQL_TYPE_SET = 248,
-    SW_MYSQL_TYPE_TINY_BLOB = 249,
-    SW_MYSQL_TYPE_MEDIUM_BLOB = 250,
-    SW_MYSQL_TYPE_LONG_BLOB = 251,
-    SW_MYSQL_TYPE_BLOB = 252,
-    SW_MYSQL_TYPE_VAR_STRING = 253,
-    SW_MYSQL_TYPE_STRING = 254,
-    SW_MYSQL_TYPE_GEOMETRY = 255
-};
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &name, &len, &cb) == FAILURE)
+    {
+        return;
+    }
 
-typedef struct
-{
-    char *name; /* Name of column */
-    char *org_name; /* Original column name, if an alias */
-    char *table; /* Table of column if column was a field */
-    char *org_table; /* Org table name, if table was an alias */
-    char *db; /* Database for table */
-    char *catalog; /* Catalog for table */
-    char *def; /* Default value (set by mysql_list_fields) */
-    unsigned long length; /* Width of column (create length) */
-    unsigned long max_length; /* Max width for selected set */
-    unsigned int name_length;
-    unsigned int org_name_length;
-    unsigned int table_length;
-    unsigned int org_table_length;
-    unsigned int db_length;
-    unsigned int catalog_length;
-    unsigned int def_length;
-    unsigned int flags; /* Div flags */
-    unsigned int decimals; /* Number of decimals in field */
-    unsigned int charsetnr; /* Character set */
-    enum mysql_field_types type; /* Type of field. See mysql_com.h for types */
-    void *extension;
-} mysql_field;
+    mysql_connection *mysql = swoole_get_object(getThis());
+    if (!mysql)
+    {
+        RETURN_FALSE;
+    }
+
+    if (strncasecmp("close", name, len) == 0)
+    {
+        if (mysql->onClose)
+        {
+            sw_zval_ptr_dtor(&mysql->onClose);
+        }
+#if PHP_MAJOR_VERSION >= 7
+        mysql->onClose = &mysql->_onClose;
+        memcpy(mysql->onClose, cb, sizeof(zval));
+#else
+        mysql->onClose = cb;
+#endif
+        sw_zval_add_ref(&mysql->onClose);
+    }
+    else
+    {
+        swoole_php_error(E_WARNING, "Unknown event type[%s]", name);
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+
+#ifdef SW_ASYNC_MYSQL
+
+//#define SW_MYSQL_STRICT_TYPE
+//#define SW_MYSQL_DEBUG
 
 typedef union
 {
@@ -200,90 +2152,14 @@ typedef struct
 
 } mysql_client;
 
-#define mysql_uint2korr(A) (uint16_t) (((uint16_t) ((zend_uchar) (A)[0]))+((uint16_t) ((zend_uchar) (A)[1]) << 8))
-#define mysql_uint8korr(A)    ((ulong)(((uint32_t) ((uchar) (A)[0])) +\
-                    (((uint32_t) ((uchar) (A)[1])) << 8) +\
-                    (((uint32_t) ((uchar) (A)[2])) << 16) +\
-                    (((uint32_t) ((uchar) (A)[3])) << 24)) +\
-                    (((ulong) (((uint32_t) ((uchar) (A)[4])) +\
-                    (((uint32_t) ((uchar) (A)[5])) << 8) +\
-                    (((uint32_t) ((uchar) (A)[6])) << 16) +\
-                    (((uint32_t) ((uchar) (A)[7])) << 24))) <<\
-                    32))
-#define mysql_uint3korr(A)    (uint32_t) (((uint32_t) ((uchar) (A)[0])) +\
-                  (((uint32_t) ((uint32_t) (A)[1])) << 8) +\
-                  (((uint32_t) ((uint32_t) (A)[2])) << 16))
-
-static int mysql_request(swString *sql, swString *buffer);
+static int mysql_pack_query(swString *sql, swString *buffer);
 #ifdef SW_MYSQL_DEBUG
 static void mysql_client_info(mysql_client *client);
 static void mysql_column_info(mysql_field *field);
 #endif
-static int mysql_decode_field(char *buf, int len, mysql_field *col);
 static int mysql_decode_row(mysql_client *client, char *buf, int packet_len);
 static int swoole_mysql_onRead(swReactor *reactor, swEvent *event);
 
-static sw_inline void mysql_pack_length(int length, char *buf)
-{
-    buf[2] = length >> 16;
-    buf[1] = length >> 8;
-    buf[0] = length;
-}
-
-static sw_inline int mysql_lcb_ll(char *m, ulong_t *r, char *nul, int len)
-{
-    if (len < 1)
-        return -1;
-    switch ((unsigned char) m[0])
-    {
-
-    case 251: /* fb : 1 octet */
-        *r = 0;
-        *nul = 1;
-        return 1;
-
-    case 252: /* fc : 2 octets */
-        if (len < 3)
-        {
-            return -1;
-        }
-        *r = mysql_uint2korr(m + 1);
-        *nul = 0;
-        return 3;
-
-    case 253: /* fd : 3 octets */
-        if (len < 4)
-        {
-            return -1;
-        }
-        *r = mysql_uint3korr(m + 1);
-        *nul = 0;
-        return 4;
-
-    case 254: /* fe */
-        if (len < 9)
-        {
-            return -1;
-        }
-        *r = mysql_uint8korr(m + 1);
-        *nul = 0;
-        return 9;
-
-    default:
-        *r = (unsigned char) m[0];
-        *nul = 0;
-        return 1;
-    }
-}
-
-static sw_inline int mysql_length_coded_binary(char *m, ulong_t *r, char *nul, int len)
-{
-    ulong_t val = 0;
-    int retcode = mysql_lcb_ll(m, &val, nul, len);
-    *r = val;
-    return retcode;
-}
-
 static sw_inline void mysql_get_socket(zval *mysql_link, zval *return_value, int *sock TSRMLS_DC)
 {
     MY_MYSQL *mysql;
@@ -306,187 +2182,6 @@ static sw_inline void mysql_get_socket(zval *mysql_link, zval *return_value, int
     }
 }
 
-static sw_inline int mysql_decode_field(char *buf, int len, mysql_field *col)
-{
-    int i;
-    unsigned long size;
-    char nul;
-    char *wh;
-    int tmp_len;
-
-    wh = buf;
-
-    i = 0;
-
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->catalog_length = size;
-    memmove(wh, &buf[i], size);
-    col->catalog = wh;
-    col->catalog[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* n (Length Coded String)    db */
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->db_length = size;
-    memmove(wh, &buf[i], size);
-    col->db = wh;
-    col->db[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* n (Length Coded String)    table */
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->table_length = size;
-    memmove(wh, &buf[i], size);
-    col->table = wh;
-    col->table[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* n (Length Coded String)    org_table */
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->org_table_length = size;
-    memmove(wh, &buf[i], size);
-    col->org_table = wh;
-    col->org_table[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* n (Length Coded String)    name */
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->name_length = size;
-    memmove(wh, &buf[i], size);
-    col->name = wh;
-    col->name[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* n (Length Coded String)    org_name */
-    tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-    if (tmp_len == -1)
-    {
-        return -SW_MYSQL_ERR_BAD_LCB;
-    }
-    i += tmp_len;
-    if (i + size > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-    col->org_name_length = size;
-    memmove(wh, &buf[i], size);
-    col->org_name = wh;
-    col->org_name[size] = '\0';
-    wh += size + 1;
-    i += size;
-
-    /* check len */
-    if (i + 13 > len)
-    {
-        return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-    }
-
-    /* (filler) */
-    i += 1;
-
-    /* charset */
-    col->charsetnr = uint2korr(&buf[i]);
-    i += 2;
-
-    /* length */
-    col->length = uint4korr(&buf[i]);
-    i += 4;
-
-    /* type */
-    col->type = (unsigned char) buf[i];
-    i += 1;
-
-    /* flags */
-    col->flags = uint3korr(&buf[i]);
-    i += 2;
-
-    /* decimals */
-    col->decimals = buf[i];
-    i += 1;
-
-    /* filler */
-    i += 2;
-
-    /* default - a priori facultatif */
-    if (len - i > 0)
-    {
-        tmp_len = mysql_length_coded_binary(&buf[i], &size, &nul, len - i);
-        if (tmp_len == -1)
-        {
-            return -SW_MYSQL_ERR_BAD_LCB;
-        }
-        i += tmp_len;
-        if (i + size > len)
-        {
-            return -SW_MYSQL_ERR_LEN_OVER_BUFFER;
-        }
-        col->def_length = size;
-        memmove(wh, &buf[i], size);
-        col->def = wh;
-        col->def[size] = '\0';
-        wh += size + 1;
-        i += size;
-    }
-    else
-    {
-        col->def = NULL;
-        col->def_length = 0;
-    }
-
-    /* set write pointer */
-    return wh - buf;
-}
-
 static sw_inline int mysql_decode_row(mysql_client *client, char *buf, int packet_len)
 {
     int read_n = 0, i;
@@ -752,12 +2447,12 @@ static sw_inline int mysql_read_rows(mysql_client *client)
 static swString *mysql_request_buffer = NULL;
 static int isset_event_callback = 0;
 
-void swoole_mysql_init(int module_number TSRMLS_DC)
+static void swoole_mysql_legacy_init(int module_number TSRMLS_DC)
 {
     mysql_request_buffer = swString_new(65536);
 }
 
-static int mysql_request(swString *sql, swString *buffer)
+static int mysql_pack_query(swString *sql, swString *buffer)
 {
     bzero(buffer->str, 5);
     //length
@@ -768,7 +2463,7 @@ static int mysql_request(swString *sql, swString *buffer)
     return swString_append(buffer, sql);
 }
 
-static int mysql_response(mysql_client *client)
+static int mysql_legacy_response(mysql_client *client)
 {
     swString *buffer = client->buffer;
 
@@ -1010,7 +2705,7 @@ PHP_FUNCTION(swoole_mysql_query)
     sw_zval_add_ref(&client->callback);
     swString_clear(mysql_request_buffer);
 
-    if (mysql_request(&sql, mysql_request_buffer) < 0)
+    if (mysql_pack_query(&sql, mysql_request_buffer) < 0)
     {
         RETURN_FALSE;
     }
@@ -1116,7 +2811,7 @@ static int swoole_mysql_onRead(swReactor *reactor, swEvent *event)
             }
 
             parse_response:
-            if (mysql_response(client) < 0)
+            if (mysql_legacy_response(client) < 0)
             {
                 return SW_OK;
             }
@@ -1186,3 +2881,4 @@ static int swoole_mysql_onRead(swReactor *reactor, swEvent *event)
 }
 
 #endif
+
@@ -0,0 +1,297 @@
+/*
+ +----------------------------------------------------------------------+
+ | Swoole                                                               |
+ +----------------------------------------------------------------------+
+ | Copyright (c) 2012-2015 The Swoole Group                             |
+ +----------------------------------------------------------------------+
+ | This source file is subject to version 2.0 of the Apache license,    |
+ | that is bundled with this package in the file LICENSE, and is        |
+ | available through the world-wide-web at the following url:           |
+ | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+ | If you did not receive a copy of the Apache2.0 license and are unable|
+ | to obtain it through the world-wide-web, please send a note to       |
+ | license@swoole.com so we can mail you a copy immediately.            |
+ +----------------------------------------------------------------------+
+ | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+ +----------------------------------------------------------------------+
+ */
+
+#ifndef SWOOLE_MYSQL_H_
+#define SWOOLE_MYSQL_H_
+
+enum mysql_command
+{
+    SW_MYSQL_COM_SLEEP = 0,
+    SW_MYSQL_COM_QUIT,
+    SW_MYSQL_SW_MYSQL_COM_INIT_DB,
+    SW_MYSQL_COM_QUERY = 3,
+    SW_MYSQL_COM_FIELD_LIST,
+    SW_MYSQL_COM_CREATE_DB,
+    SW_MYSQL_COM_DROP_DB,
+    SW_MYSQL_COM_REFRESH,
+    SW_MYSQL_COM_SHUTDOWN,
+    SW_MYSQL_COM_STATISTICS,
+    SW_MYSQL_COM_PROCESS_INFO,
+    SW_MYSQL_COM_CONNECT,
+    SW_MYSQL_COM_PROCESS_KILL,
+    SW_MYSQL_COM_DEBUG,
+    SW_MYSQL_COM_PING,
+    SW_MYSQL_COM_TIME,
+    SW_MYSQL_COM_DELAYED_INSERT,
+    SW_MYSQL_COM_CHANGE_USER,
+    SW_MYSQL_COM_BINLOG_DUMP,
+    SW_MYSQL_COM_TABLE_DUMP,
+    SW_MYSQL_COM_CONNECT_OUT,
+    SW_MYSQL_COM_REGISTER_SLAVE,
+    SW_MYSQL_COM_STMT_PREPARE,
+    SW_MYSQL_COM_STMT_EXECUTE,
+    SW_MYSQL_COM_STMT_SEND_LONG_DATA,
+    SW_MYSQL_COM_STMT_CLOSE,
+    SW_MYSQL_COM_STMT_RESET,
+    SW_MYSQL_COM_SET_OPTION,
+    SW_MYSQL_COM_STMT_FETCH,
+    SW_MYSQL_COM_DAEMON,
+    SW_MYSQL_COM_END
+};
+
+enum mysql_read_state
+{
+    SW_MYSQL_STATE_QUERY,
+    SW_MYSQL_STATE_READ_START,
+    SW_MYSQL_STATE_READ_FIELD,
+    SW_MYSQL_STATE_READ_ROW,
+    SW_MYSQL_STATE_READ_END,
+    /**
+     * native client
+     */
+    SW_MYSQL_STATE_HANDSHAKE,
+    SW_MYSQL_STATE_AUTH,
+    SW_MYSQL_STATE_READ_FIELD_EOF,
+    SW_MYSQL_STATE_READ_PARAM,
+    SW_MYSQL_STATE_READ_PARAM_EOF,
+};
+
+enum mysql_error_code
+{
+    SW_MYSQL_ERR_PROTOCOL_ERROR = 1,
+    SW_MYSQL_ERR_BUFFER_OVERSIZE,
+    SW_MYSQL_ERR_PACKET_CORRUPT,
+    SW_MYSQL_ERR_WANT_READ,
+    SW_MYSQL_ERR_WANT_WRITE,
+    SW_MYSQL_ERR_UNKNOWN_ERROR,
+    SW_MYSQL_ERR_MYSQL_ERROR,
+    SW_MYSQL_ERR_SERVER_LOST,
+    SW_MYSQL_ERR_BAD_PORT,
+    SW_MYSQL_ERR_RESOLV_HOST,
+    SW_MYSQL_ERR_SYSTEM,
+    SW_MYSQL_ERR_CANT_CONNECT,
+    SW_MYSQL_ERR_BUFFER_TOO_SMALL,
+    SW_MYSQL_ERR_UNEXPECT_R_STATE,
+    SW_MYSQL_ERR_STRFIELD_CORRUPT,
+    SW_MYSQL_ERR_BINFIELD_CORRUPT,
+    SW_MYSQL_ERR_BAD_LCB,
+    SW_MYSQL_ERR_LEN_OVER_BUFFER,
+    SW_MYSQL_ERR_CONVLONG,
+    SW_MYSQL_ERR_CONVLONGLONG,
+    SW_MYSQL_ERR_CONVFLOAT,
+    SW_MYSQL_ERR_CONVDOUBLE,
+    SW_MYSQL_ERR_CONVTIME,
+    SW_MYSQL_ERR_CONVTIMESTAMP,
+    SW_MYSQL_ERR_CONVDATE
+};
+
+enum mysql_field_types
+{
+    SW_MYSQL_TYPE_DECIMAL,
+    SW_MYSQL_TYPE_TINY,
+    SW_MYSQL_TYPE_SHORT,
+    SW_MYSQL_TYPE_LONG,
+    SW_MYSQL_TYPE_FLOAT,
+    SW_MYSQL_TYPE_DOUBLE,
+    SW_MYSQL_TYPE_NULL,
+    SW_MYSQL_TYPE_TIMESTAMP,
+    SW_MYSQL_TYPE_LONGLONG,
+    SW_MYSQL_TYPE_INT24,
+    SW_MYSQL_TYPE_DATE,
+    SW_MYSQL_TYPE_TIME,
+    SW_MYSQL_TYPE_DATETIME,
+    SW_MYSQL_TYPE_YEAR,
+    SW_MYSQL_TYPE_NEWDATE,
+    SW_MYSQL_TYPE_VARCHAR,
+    SW_MYSQL_TYPE_BIT,
+    SW_MYSQL_TYPE_NEWDECIMAL = 246,
+    SW_MYSQL_TYPE_ENUM = 247,
+    SW_MYSQL_TYPE_SET = 248,
+    SW_MYSQL_TYPE_TINY_BLOB = 249,
+    SW_MYSQL_TYPE_MEDIUM_BLOB = 250,
+    SW_MYSQL_TYPE_LONG_BLOB = 251,
+    SW_MYSQL_TYPE_BLOB = 252,
+    SW_MYSQL_TYPE_VAR_STRING = 253,
+    SW_MYSQL_TYPE_STRING = 254,
+    SW_MYSQL_TYPE_GEOMETRY = 255
+};
+
+enum mysql_client_capability
+{
+    SW_MYSQL_CLIENT_LONG_PASSWORD = 0x00000001,
+    SW_MYSQL_CLIENT_LONG_FLAG = 0x00000004,
+    SW_MYSQL_CLIENT_CONNECT_WITH_DB = 0x00000008,
+    SW_MYSQL_CLIENT_PROTOCOL_41 = 0x00000200,
+    SW_MYSQL_CLIENT_TRANSACTIONS = 0x00002000,
+    SW_MYSQL_CLIENT_SECURE_CONNECTION = 0x00008000,
+    SW_MYSQL_CLIENT_PLUGIN_AUTH = 0x00080000,
+};
+
+#define SW_MYSQL_PACKET_HEADER_SIZE      4
+#define SW_MYSQL_PACKET_MAX_SIZE         0xffffff
+#define SW_MYSQL_SCRAMBLE_LENGTH         20
+#define SW_MYSQL_NATIVE_PASSWORD         "mysql_native_password"
+
+#define SW_MYSQL_PACKET_OK               0x00
+#define SW_MYSQL_PACKET_EOF              0xfe
+#define SW_MYSQL_PACKET_ERR              0xff
+
+#define SW_MYSQL_UNSIGNED_FLAG           32
+
+typedef struct
+{
+    char *name; /* Name of column */
+    char *org_name; /* Original column name, if an alias */
+    char *table; /* Table of column if column was a field */
+    char *org_table; /* Org table name, if table was an alias */
+    char *db; /* Database for table */
+    char *catalog; /* Catalog for table */
+    char *def; /* Default value (set by mysql_list_fields) */
+    unsigned long length; /* Width of column (create length) */
+    unsigned long max_length; /* Max width for selected set */
+    unsigned int name_length;
+    unsigned int org_name_length;
+    unsigned int table_length;
+    unsigned int org_table_length;
+    unsigned int db_length;
+    unsigned int catalog_length;
+    unsigned int def_length;
+    unsigned int flags; /* Div flags */
+    unsigned int decimals; /* Number of decimals in field */
+    unsigned int charsetnr; /* Character set */
+    enum mysql_field_types type; /* Type of field. See mysql_com.h for types */
+    void *extension;
+} mysql_field;
+
+#define mysql_uint2korr(A) (uint16_t) (((uint16_t) ((uint8_t) (A)[0]))+((uint16_t) ((uint8_t) (A)[1]) << 8))
+#define mysql_uint3korr(A)    (uint32_t) (((uint32_t) ((uint8_t) (A)[0])) +\
+                  (((uint32_t) ((uint8_t) (A)[1])) << 8) +\
+                  (((uint32_t) ((uint8_t) (A)[2])) << 16))
+#define mysql_uint4korr(A)    (uint32_t) (((uint32_t) ((uint8_t) (A)[0])) +\
+                  (((uint32_t) ((uint8_t) (A)[1])) << 8) +\
+                  (((uint32_t) ((uint8_t) (A)[2])) << 16) +\
+                  (((uint32_t) ((uint8_t) (A)[3])) << 24))
+#define mysql_uint8korr(A)    ((uint64_t) mysql_uint4korr(A) + (((uint64_t) mysql_uint4korr((A) + 4)) << 32))
+
+#define mysql_int1store(T,A)  *((uint8_t*) (T)) = (uint8_t) (A)
+#define mysql_int2store(T,A)  do { uint32_t def_temp = (uint32_t) (A) ;\
+                  *((uint8_t*) (T)) = (uint8_t) (def_temp);\
+                  *((uint8_t*) (T+1)) = (uint8_t) ((def_temp >> 8)); } while (0)
+#define mysql_int3store(T,A)  do { *(T) = (char) ((A));\
+                  *(T+1) = (char) (((uint32_t) (A) >> 8));\
+                  *(T+2) = (char) (((A) >> 16)); } while (0)
+#define mysql_int4store(T,A)  do { *(T) = (char) ((A));\
+                  *((T)+1) = (char) (((A) >> 8));\
+                  *((T)+2) = (char) (((A) >> 16));\
+                  *((T)+3) = (char) (((A) >> 24)); } while (0)
+#define mysql_int8store(T,A)  do { uint32_t def_temp = (uint32_t) (A), def_temp2 = (uint32_t) ((A) >> 32);\
+                  mysql_int4store((T), def_temp);\
+                  mysql_int4store((T + 4), def_temp2); } while (0)
+
+static sw_inline void mysql_pack_length(int length, char *buf)
+{
+    buf[2] = length >> 16;
+    buf[1] = length >> 8;
+    buf[0] = length;
+}
+
+static sw_inline int mysql_lcb_ll(char *m, ulong_t *r, char *nul, int len)
+{
+    if (len < 1)
+        return -1;
+    switch ((unsigned char) m[0])
+    {
+
+    case 251: /* fb : 1 octet */
+        *r = 0;
+        *nul = 1;
+        return 1;
+
+    case 252: /* fc : 2 octets */
+        if (len < 3)
+        {
+            return -1;
+        }
+        *r = mysql_uint2korr(m + 1);
+        *nul = 0;
+        return 3;
+
+    case 253: /* fd : 3 octets */
+        if (len < 4)
+        {
+            return -1;
+        }
+        *r = mysql_uint3korr(m + 1);
+        *nul = 0;
+        return 4;
+
+    case 254: /* fe */
+        if (len < 9)
+        {
+            return -1;
+        }
+        *r = mysql_uint8korr(m + 1);
+        *nul = 0;
+        return 9;
+
+    default:
+        *r = (unsigned char) m[0];
+        *nul = 0;
+        return 1;
+    }
+}
+
+static sw_inline int mysql_length_coded_binary(char *m, ulong_t *r, char *nul, int len)
+{
+    ulong_t val = 0;
+    int retcode = mysql_lcb_ll(m, &val, nul, len);
+    *r = val;
+    return retcode;
+}
+
+/**
+ * write the length coded binary, return the bytes written
+ */
+static sw_inline int mysql_write_lcb(char *p, ulong_t n)
+{
+    if (n < 251)
+    {
+        mysql_int1store(p, n);
+        return 1;
+    }
+    else if (n < 65536)
+    {
+        mysql_int1store(p, 252);
+        mysql_int2store(p + 1, n);
+        return 3;
+    }
+    else if (n < 16777216)
+    {
+        mysql_int1store(p, 253);
+        mysql_int3store(p + 1, n);
+        return 4;
+    }
+    else
+    {
+        mysql_int1store(p, 254);
+        mysql_int8store(p + 1, (uint64_t) n);
+        return 9;
+    }
+}
+
+#endif /* SWOOLE_MYSQL_H_ */
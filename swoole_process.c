@@ -21,7 +21,9 @@
 static PHP_METHOD(swoole_process, __construct);
 static PHP_METHOD(swoole_process, __destruct);
 static PHP_METHOD(swoole_process, useQueue);
+static PHP_METHOD(swoole_process, useChannel);
 static PHP_METHOD(swoole_process, pop);
+static PHP_METHOD(swoole_process, popMulti);
 static PHP_METHOD(swoole_process, push);
 static PHP_METHOD(swoole_process, kill);
 static PHP_METHOD(swoole_process, signal);
@@ -38,6 +40,7 @@ static PHP_METHOD(swoole_process, exit);
 static PHP_METHOD(swoole_process, exec);
 
 static void php_swoole_onSignal(int signo);
+static swString* php_swoole_process_get_buffer(swChannel *chan);
 
 static uint32_t php_swoole_worker_round_id = 1;
 static zval *signal_callback[SW_SIGNO_MAX];
@@ -56,12 +59,14 @@ static const zend_function_entry swoole_process_methods[] =
     PHP_ME(swoole_process, setaffinity, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 #endif
     PHP_ME(swoole_process, useQueue, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_process, useChannel, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, start, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, write, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, close, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, read, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, push, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, pop, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_process, popMulti, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, exit, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_process, exec, NULL, ZEND_ACC_PUBLIC)
     PHP_FALIAS(name, swoole_set_process_name, NULL)
@@ -191,6 +196,10 @@ static PHP_METHOD(swoole_process, __destruct)
         swMsgQueue_free(process->queue);
         efree(process->queue);
     }
+    if (process->channel)
+    {
+        swChannel_free(process->channel);
+    }
     efree(process);
 }
 
@@ -256,6 +265,57 @@ static PHP_METHOD(swoole_process, useQueue)
     RETURN_TRUE;
 }
 
+/**
+ * shared memory ring, the data is not copied by the kernel and the size is not limited by msgmnb
+ */
+static PHP_METHOD(swoole_process, useChannel)
+{
+    long size = SW_PROCESS_CHANNEL_SIZE;
+    long maxlen = SW_PROCESS_CHANNEL_MAXLEN;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|ll", &size, &maxlen) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swWorker *process = swoole_get_object(getThis());
+    if (process->channel)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "channel has already been created.");
+        RETURN_FALSE;
+    }
+    if (maxlen <= 0 || size < SW_PROCESS_CHANNEL_MIN_SIZE + maxlen * 2)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "channel size must be bigger than %d + maxlen * 2.", SW_PROCESS_CHANNEL_MIN_SIZE);
+        RETURN_FALSE;
+    }
+
+    swChannel *chan = swChannel_new(size, maxlen, SW_CHAN_SHM | SW_CHAN_LOCK | SW_CHAN_NOTIFY);
+    if (chan == NULL)
+    {
+        RETURN_FALSE;
+    }
+    process->channel = chan;
+
+    //can be added to swoole_event_add, readable when there is new data
+    zend_update_property_long(swoole_process_class_entry_ptr, getThis(), ZEND_STRL("channel_fd"), chan->notify_fd.getFd(&chan->notify_fd, 0) TSRMLS_CC);
+    RETURN_TRUE;
+}
+
+static swString* php_swoole_process_get_buffer(swChannel *chan)
+{
+    static swString *buffer = NULL;
+    if (buffer == NULL)
+    {
+        buffer = swString_new(chan->maxlen);
+    }
+    else if (buffer->size < chan->maxlen)
+    {
+        swString_extend(buffer, chan->maxlen);
+    }
+    return buffer;
+}
+
 static PHP_METHOD(swoole_process, kill)
 {
     long pid;
@@ -605,19 +665,38 @@ static PHP_METHOD(swoole_process, push)
         php_error_docref(NULL TSRMLS_CC, E_WARNING, "data empty.");
         RETURN_FALSE;
     }
-    else if (length >= sizeof(message.data))
-    {
-        php_error_docref(NULL TSRMLS_CC, E_WARNING, "data too big.");
-        RETURN_FALSE;
-    }
 
     swWorker *process = swoole_get_object(getThis());
 
+    if (process->channel)
+    {
+        if (length > process->channel->maxlen)
+        {
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "data too big.");
+            RETURN_FALSE;
+        }
+        if (swChannel_push(process->channel, data, length) < 0)
+        {
+            if (SwooleG.error == SW_ERROR_CHANNEL_FULL)
+            {
+                php_error_docref(NULL TSRMLS_CC, E_WARNING, "channel is full.");
+            }
+            RETURN_FALSE;
+        }
+        swChannel_notify(process->channel);
+        RETURN_TRUE;
+    }
+
     if (!process->queue)
     {
         php_error_docref(NULL TSRMLS_CC, E_WARNING, "have not msgqueue, can not use push()");
         RETURN_FALSE;
     }
+    if (length >= sizeof(message.data))
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "data too big.");
+        RETURN_FALSE;
+    }
 
     message.type = process->id;
     memcpy(message.data, data, length);
@@ -643,6 +722,19 @@ static PHP_METHOD(swoole_process, pop)
         maxsize = SW_MSGMAX;
     }
     swWorker *process = swoole_get_object(getThis());
+    if (process->channel)
+    {
+        swChannel *chan = process->channel;
+        swString *buffer = php_swoole_process_get_buffer(chan);
+        int n;
+
+        //blocking, the same as msgrcv
+        while ((n = swChannel_pop(chan, buffer->str, buffer->size)) < 0)
+        {
+            swChannel_wait(chan, -1);
+        }
+        SW_RETURN_STRINGL(buffer->str, n, 1);
+    }
     if (!process->queue)
     {
         php_error_docref(NULL TSRMLS_CC, E_WARNING, "have not msgqueue, can not use push()");
@@ -673,6 +765,51 @@ static PHP_METHOD(swoole_process, pop)
     SW_RETURN_STRINGL(message.data, n, 1);
 }
 
+/**
+ * pop the data in the channel without blocking, used in the callback of swoole_event_add($process->channel_fd)
+ */
+static PHP_METHOD(swoole_process, popMulti)
+{
+    long num = 0;
+    int n, i;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &num) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swWorker *process = swoole_get_object(getThis());
+    swChannel *chan = process->channel;
+    if (!chan)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "have not channel, can not use popMulti()");
+        RETURN_FALSE;
+    }
+
+    swString *buffer = php_swoole_process_get_buffer(chan);
+    //clear the eventfd, the data pushed after this will notify again
+    swChannel_wait(chan, 0);
+
+    array_init(return_value);
+    chan->lock.lock(&chan->lock);
+    for (i = 0; num <= 0 || i < num; i++)
+    {
+        n = swChannel_out(chan, buffer->str, buffer->size);
+        if (n < 0)
+        {
+            break;
+        }
+        sw_add_next_index_stringl(return_value, buffer->str, n, 1);
+    }
+    chan->lock.unlock(&chan->lock);
+
+    //the rest of the data, the event will be triggered again
+    if (num > 0 && i == num && chan->num > 0)
+    {
+        swChannel_notify(chan);
+    }
+}
+
 static PHP_METHOD(swoole_process, exec)
 {
     char *execfile = NULL;
@@ -16,61 +16,182 @@
 
 #include "php_swoole.h"
 
-#ifdef SW_USE_REDIS
-#include <hiredis/hiredis.h>
-#include <hiredis/async.h>
-
-typedef struct
-{
-    redisAsyncContext *context;
-    uint8_t state;
-    zval *result_callback;
-    zval _result_callback;
-    zval *connect_callback;
-    zval _connect_callback;
-    zval *object;
-} swRedisClient;
+#define SW_REDIS_CLUSTER_SLOTS     16384
 
 enum swoole_redis_state
 {
     SWOOLE_REDIS_STATE_CONNECT,
     SWOOLE_REDIS_STATE_READY,
-    SWOOLE_REDIS_STATE_WAIT,
+    SWOOLE_REDIS_STATE_SUBSCRIBE,
     SWOOLE_REDIS_STATE_CLOSED,
 };
 
+enum swoole_redis_request_type
+{
+    SWOOLE_REDIS_REQUEST_USER,
+    /**
+     * CLUSTER SLOTS, sent after the seed node is connected
+     */
+    SWOOLE_REDIS_REQUEST_SLOTS,
+    /**
+     * ASKING, the reply is dropped
+     */
+    SWOOLE_REDIS_REQUEST_DISCARD,
+};
+
+typedef struct
+{
+    zval *callback;
+#if PHP_MAJOR_VERSION >= 7
+    zval _callback;
+#endif
+    /**
+     * the command is kept for MOVED/ASK redirection in cluster mode
+     */
+    swString *packet;
+    uint8_t type;
+    uint8_t redirects;
+} redis_request;
+
+typedef struct
+{
+    zval *array;
+    long remaining;
+} redis_parse_frame;
+
+typedef struct _redis_node
+{
+    /**
+     * the list of nodes which have commands to flush
+     */
+    struct _redis_node *next, *prev;
+
+    struct _swRedisClient *redis;
+    swClient *cli;
+    char *host;
+    long port;
+    uint8_t connected;
+    uint8_t dirty;
+    /**
+     * in onError/onClose of the client, it must not be closed or freed now
+     */
+    uint8_t closing;
+
+    /**
+     * the commands issued in this loop, written with one send at the end of the loop
+     */
+    swString *wbuffer;
+    /**
+     * the incomplete reply
+     */
+    swString *rbuffer;
+    swLinkedList *requests;
+
+    /**
+     * the arrays (multi-bulk replies) which are waiting for their elements
+     */
+    redis_parse_frame stack[SW_REDIS_MAX_DEPTH];
+    int depth;
+} redis_node;
+
+typedef struct _swRedisClient
+{
+    zval *object;
+#if PHP_MAJOR_VERSION >= 7
+    zval _object;
+#endif
+
+    zval *onConnect;
+    zval *onClose;
+    zval *onMessage;
+#if PHP_MAJOR_VERSION >= 7
+    zval _onConnect;
+    zval _onClose;
+    zval _onMessage;
+#endif
+
+    uint8_t state;
+    uint8_t cluster;
+    double timeout;
+
+    redis_node **nodes;
+    uint16_t node_num;
+    /**
+     * slot -> index of nodes, cluster mode only
+     */
+    uint16_t *slots;
+    /**
+     * commands without key are sent to the node of the last command
+     */
+    redis_node *last_node;
+    /**
+     * MULTI ... EXEC/DISCARD must be sent to the same node
+     */
+    redis_node *pinned_node;
+    redis_request *multi;
+} swRedisClient;
+
+static PHP_METHOD(swoole_redis, __construct);
+static PHP_METHOD(swoole_redis, __destruct);
 static PHP_METHOD(swoole_redis, connect);
-static PHP_METHOD(swoole_redis, close);
+static PHP_METHOD(swoole_redis, on);
 static PHP_METHOD(swoole_redis, execute);
-static PHP_METHOD(swoole_redis, get);
-static PHP_METHOD(swoole_redis, set);
-static PHP_METHOD(swoole_redis, __destruct);
+static PHP_METHOD(swoole_redis, __call);
+static PHP_METHOD(swoole_redis, close);
+
+static void redis_onConnect(swClient *cli);
+static void redis_onReceive(swClient *cli, char *data, uint32_t length);
+static void redis_onError(swClient *cli);
+static void redis_onClose(swClient *cli);
+static void redis_onLoopEnd(swReactor *reactor);
+
+static redis_node* redis_node_new(swRedisClient *redis, char *host, int host_len, long port);
+static redis_node* redis_node_find(swRedisClient *redis, char *host, int host_len, long port);
+static int redis_node_index(swRedisClient *redis, redis_node *node);
+static int redis_node_connect(redis_node *node TSRMLS_DC);
+static void redis_node_release_cli(redis_node *node);
+static void redis_node_retire(redis_node *node);
+static void redis_node_free(redis_node *node TSRMLS_DC);
+static void redis_node_flush(redis_node *node);
+static void redis_node_add(redis_node *node, swString *packet, redis_request *req);
+static void redis_node_clear(redis_node *node, int error, char *error_msg TSRMLS_DC);
+static void redis_node_reset_parser(redis_node *node TSRMLS_DC);
 
-static void swoole_redis_onConnect(const redisAsyncContext *c, int status);
-static void swoole_redis_onClose(const redisAsyncContext *c, int status);
-static int swoole_redis_onRead(swReactor *reactor, swEvent *event);
-static int swoole_redis_onWrite(swReactor *reactor, swEvent *event);
-static void swoole_redis_onResult(redisAsyncContext *c, void *r, void *privdata);
+static int redis_parse(redis_node *node, char *data, int length TSRMLS_DC);
+static void redis_parse_value(redis_node *node, zval *value, int is_error TSRMLS_DC);
+static void redis_onReply(redis_node *node, zval *value, int is_error TSRMLS_DC);
+static void redis_onSlots(swRedisClient *redis, zval *value TSRMLS_DC);
+static int redis_redirect(redis_node *node, redis_request *req, char *error, int error_len TSRMLS_DC);
 
-static void swoole_redis_event_AddRead(void *privdata);
-static void swoole_redis_event_AddWrite(void *privdata);
-static void swoole_redis_event_DelRead(void *privdata);
-static void swoole_redis_event_DelWrite(void *privdata);
-static void swoole_redis_event_Cleanup(void *privdata);
-static int swoole_redis_send_command(zval *object, zval *callback, char *command, ...);
+static int redis_command(swRedisClient *redis, zval **argv, int argc, zval *callback TSRMLS_DC);
+static void redis_connect_callback(swRedisClient *redis, int result TSRMLS_DC);
+static void redis_request_callback(swRedisClient *redis, zval *callback, zval *result TSRMLS_DC);
+static void redis_request_free(redis_request *req TSRMLS_DC);
 
 static zend_class_entry swoole_redis_ce;
 zend_class_entry *swoole_redis_class_entry_ptr;
-static int isset_event_callback = 0;
+
+/**
+ * the nodes which have commands to be sent at the end of this loop
+ */
+static redis_node *redis_dirty_nodes = NULL;
+static swReactor *redis_loop_reactor = NULL;
+static swString *redis_packet = NULL;
+/**
+ * the clients and nodes can not be freed in their own callbacks, they are freed at the end of the loop
+ */
+static swLinkedList *redis_garbage_clients = NULL;
+static swLinkedList *redis_garbage_nodes = NULL;
 
 static const zend_function_entry swoole_redis_methods[] =
 {
+    PHP_ME(swoole_redis, __construct, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    PHP_ME(swoole_redis, __destruct, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_DTOR)
     PHP_ME(swoole_redis, connect, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_redis, on, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_redis, execute, NULL, ZEND_ACC_PUBLIC)
-    PHP_ME(swoole_redis, get, NULL, ZEND_ACC_PUBLIC)
-    PHP_ME(swoole_redis, set, NULL, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_redis, __call, NULL, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_redis, close, NULL, ZEND_ACC_PUBLIC)
-    PHP_ME(swoole_redis, __destruct, NULL, ZEND_ACC_PUBLIC | ZEND_ACC_DTOR)
     PHP_FE_END
 };
 
@@ -78,319 +199,1584 @@ void swoole_redis_init(int module_number TSRMLS_DC)
 {
     INIT_CLASS_ENTRY(swoole_redis_ce, "swoole_redis", swoole_redis_methods);
     swoole_redis_class_entry_ptr = zend_register_internal_class(&swoole_redis_ce TSRMLS_CC);
+
+    zend_declare_property_string(swoole_redis_class_entry_ptr, ZEND_STRL("host"), "", ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_redis_class_entry_ptr, ZEND_STRL("port"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_long(swoole_redis_class_entry_ptr, ZEND_STRL("errCode"), 0, ZEND_ACC_PUBLIC TSRMLS_CC);
+    zend_declare_property_string(swoole_redis_class_entry_ptr, ZEND_STRL("errMsg"), "", ZEND_ACC_PUBLIC TSRMLS_CC);
 }
 
-static PHP_METHOD(swoole_redis, connect)
+/**
+ * CRC16-CCITT (XMODEM), the hash function of redis cluster
+ */
+static uint16_t redis_crc16(char *buf, int len)
 {
-    char *host;
-    zend_size_t host_len;
-    long port;
-    zval *callback;
+    uint16_t crc = 0;
+    int i, j;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "slz", &host, &host_len, &port, &callback) == FAILURE)
+    for (i = 0; i < len; i++)
     {
-        RETURN_FALSE;
+        crc ^= ((uint16_t) (uint8_t) buf[i]) << 8;
+        for (j = 0; j < 8; j++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
     }
+    return crc;
+}
 
-    if (host_len <= 0)
+static uint16_t redis_key_slot(char *key, int len)
+{
+    int start, end;
+
+    //hash tag, only the part between the first { and the next } is hashed
+    for (start = 0; start < len; start++)
     {
-        swoole_php_error(E_WARNING, "host is empty.");
-        RETURN_FALSE;
+        if (key[start] == '{')
+        {
+            break;
+        }
+    }
+    for (end = start + 1; end < len; end++)
+    {
+        if (key[end] == '}')
+        {
+            break;
+        }
+    }
+    if (end < len && end != start + 1)
+    {
+        key += start + 1;
+        len = end - start - 1;
     }
+    return redis_crc16(key, len) & (SW_REDIS_CLUSTER_SLOTS - 1);
+}
 
-    if (port <= 1 || port > 65535)
+static sw_inline int redis_command_is(char *command, int command_len, char *name)
+{
+    return command_len == strlen(name) && strncasecmp(command, name, command_len) == 0;
+}
+
+static sw_inline void redis_set_error(swRedisClient *redis, int code, char *msg, int msg_len TSRMLS_DC)
+{
+    zend_update_property_long(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errCode"), code TSRMLS_CC);
+    zend_update_property_stringl(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errMsg"), msg, msg_len TSRMLS_CC);
+}
+
+static sw_inline void redis_zval_free(zval *value)
+{
+    sw_zval_ptr_dtor(&value);
+#if PHP_MAJOR_VERSION >= 7
+    efree(value);
+#endif
+}
+
+static sw_inline void redis_array_add(zval *array, zval *value)
+{
+    add_next_index_zval(array, value);
+#if PHP_MAJOR_VERSION >= 7
+    efree(value);
+#endif
+}
+
+/**
+ * get the element of a list array by position
+ */
+static zval* redis_array_get(zval *array, int index)
+{
+    zval *value;
+    int i = 0;
+
+    if (array == NULL || Z_TYPE_P(array) != IS_ARRAY)
     {
-        swoole_php_error(E_WARNING, "port is invalid.");
-        RETURN_FALSE;
+        return NULL;
     }
+    SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(array), value)
+        if (i++ == index)
+        {
+            return value;
+        }
+    SW_HASHTABLE_FOREACH_END();
+    return NULL;
+}
 
-    swRedisClient *redis = emalloc(sizeof(swRedisClient));
-    bzero(redis, sizeof(swRedisClient));
-    redis->object = getThis();
-    swoole_set_object(getThis(), redis);
+static sw_inline void redis_append_bulk(swString *buffer, char *str, int len)
+{
+    char head[32];
+    int n = snprintf(head, sizeof(head), "$%d\r\n", len);
+    swString_append_ptr(buffer, head, n);
+    swString_append_ptr(buffer, str, len);
+    swString_append_ptr(buffer, "\r\n", 2);
+}
 
-    redisAsyncContext *context = redisAsyncConnect(host, (int) port);
-    if (context->err)
+static void redis_append_arg(swString *buffer, zval *value TSRMLS_DC)
+{
+    char tmp[64];
+    int n;
+
+    switch (Z_TYPE_P(value))
     {
-        swoole_php_error(E_WARNING, "connect to redis-server[%s:%d] failed, Erorr: %s[%d]", host, (int) port, context->errstr, context->err);
-        RETURN_FALSE;
+    case IS_STRING:
+        redis_append_bulk(buffer, Z_STRVAL_P(value), Z_STRLEN_P(value));
+        break;
+    case IS_LONG:
+        n = snprintf(tmp, sizeof(tmp), "%ld", (long) Z_LVAL_P(value));
+        redis_append_bulk(buffer, tmp, n);
+        break;
+    case IS_DOUBLE:
+        n = snprintf(tmp, sizeof(tmp), "%.17g", Z_DVAL_P(value));
+        redis_append_bulk(buffer, tmp, n);
+        break;
+    default:
+    {
+        //do not change the argument of the caller
+        zval copy = *value;
+        zval_copy_ctor(&copy);
+        convert_to_string(&copy);
+        redis_append_bulk(buffer, Z_STRVAL(copy), Z_STRLEN(copy));
+        zval_dtor(&copy);
+        break;
+    }
     }
+}
 
-    php_swoole_check_reactor();
-    if (!isset_event_callback)
+static void redis_check_loop_end(void)
+{
+    //register once for each reactor, the worker process has its own
+    if (redis_loop_reactor != SwooleG.main_reactor)
     {
-        SwooleG.main_reactor->setHandle(SwooleG.main_reactor, PHP_SWOOLE_FD_REDIS | SW_EVENT_READ, swoole_redis_onRead);
-        SwooleG.main_reactor->setHandle(SwooleG.main_reactor, PHP_SWOOLE_FD_REDIS | SW_EVENT_WRITE, swoole_redis_onWrite);
-        isset_event_callback = 1;
+        SwooleG.main_reactor->atLoopEnd(SwooleG.main_reactor, redis_onLoopEnd);
+        redis_loop_reactor = SwooleG.main_reactor;
     }
+}
 
-    redisAsyncSetConnectCallback(context, swoole_redis_onConnect);
-    redisAsyncSetDisconnectCallback(context, swoole_redis_onClose);
+static redis_node* redis_node_new(swRedisClient *redis, char *host, int host_len, long port)
+{
+    redis_node *node = emalloc(sizeof(redis_node));
+    bzero(node, sizeof(redis_node));
 
-#if PHP_MAJOR_VERSION < 7
-    redis->connect_callback = callback;
-#else
-    redis->connect_callback = &redis->_connect_callback;
-    memcpy(redis->connect_callback, callback, sizeof(zval));
-#endif
+    node->redis = redis;
+    node->host = estrndup(host, host_len);
+    node->port = port;
+    node->wbuffer = swString_new(SW_BUFFER_SIZE_BIG);
+    node->rbuffer = swString_new(SW_BUFFER_SIZE_BIG);
+    node->requests = swLinkedList_new();
 
-    sw_zval_add_ref(&redis->connect_callback);
+    redis->nodes = erealloc(redis->nodes, sizeof(redis_node *) * (redis->node_num + 1));
+    redis->nodes[redis->node_num++] = node;
+    return node;
+}
 
-    redis->context = context;
-    context->ev.addRead = swoole_redis_event_AddRead;
-    context->ev.delRead = swoole_redis_event_DelRead;
-    context->ev.addWrite = swoole_redis_event_AddWrite;
-    context->ev.delWrite = swoole_redis_event_DelWrite;
-    context->ev.cleanup = swoole_redis_event_Cleanup;
-    context->ev.data = redis;
+static redis_node* redis_node_find(swRedisClient *redis, char *host, int host_len, long port)
+{
+    int i;
+    for (i = 0; i < redis->node_num; i++)
+    {
+        redis_node *node = redis->nodes[i];
+        if (node->port == port && strlen(node->host) == host_len && memcmp(node->host, host, host_len) == 0)
+        {
+            return node;
+        }
+    }
+    return NULL;
+}
 
-    zend_update_property_string(swoole_redis_class_entry_ptr, getThis(), ZEND_STRL("host"), host TSRMLS_CC);
-    zend_update_property_long(swoole_redis_class_entry_ptr, getThis(), ZEND_STRL("port"), port TSRMLS_CC);
+/**
+ * the socket can be used or is connecting
+ */
+static sw_inline int redis_node_alive(redis_node *node)
+{
+    return node->cli && !node->closing && !node->cli->closed;
+}
 
-    if (SwooleG.main_reactor->add(SwooleG.main_reactor, redis->context->c.fd, PHP_SWOOLE_FD_REDIS | SW_EVENT_WRITE) < 0)
+static int redis_node_index(swRedisClient *redis, redis_node *node)
+{
+    int i;
+    for (i = 0; i < redis->node_num; i++)
     {
-        swoole_php_fatal_error(E_WARNING, "swoole_event_add failed. Erorr: %s[%d].", redis->context->errstr, redis->context->err);
-        RETURN_FALSE;
+        if (redis->nodes[i] == node)
+        {
+            return i;
+        }
     }
-
-    swConnection *conn = swReactor_get(SwooleG.main_reactor, redis->context->c.fd);
-    conn->object = redis;
+    return SW_ERR;
 }
 
-static PHP_METHOD(swoole_redis, close)
+static void redis_cli_free(swClient *cli)
 {
-    swRedisClient *redis = swoole_get_object(getThis());
-    redisAsyncDisconnect(redis->context);
+    if (!cli->closed)
+    {
+        cli->onClose = NULL;
+        cli->close(cli);
+    }
+    //swClient only frees the input buffer of the eof/length check mode
+    if (cli->buffer)
+    {
+        swString_free(cli->buffer);
+    }
+    efree(cli);
 }
 
-static PHP_METHOD(swoole_redis, __destruct)
+/**
+ * close the socket of the node, the client is freed at the end of the loop
+ */
+static void redis_node_release_cli(redis_node *node)
 {
-    swRedisClient *redis = swoole_get_object(getThis());
-    if (!redis)
+    swClient *cli = node->cli;
+    if (cli == NULL)
     {
         return;
     }
-    if (redis->state != SWOOLE_REDIS_STATE_CLOSED)
+    node->cli = NULL;
+    node->connected = 0;
+
+    //swClient will close it after the callback returns
+    if (node->closing)
     {
-        redisAsyncDisconnect(redis->context);
+        cli->onClose = NULL;
     }
-    efree(redis);
+    else if (!cli->closed)
+    {
+        cli->onClose = NULL;
+        cli->close(cli);
+    }
+    if (redis_garbage_clients == NULL)
+    {
+        redis_garbage_clients = swLinkedList_new();
+    }
+    swLinkedList_append(redis_garbage_clients, cli);
+    redis_check_loop_end();
 }
 
-static int swoole_redis_send_command(zval *object, zval *callback, char *format, ...)
+static int redis_node_connect(redis_node *node TSRMLS_DC)
 {
-#if PHP_MAJOR_VERSION < 7
-    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
-#endif
-    swRedisClient *redis = swoole_get_object(object);
-    switch (redis->state)
+    swRedisClient *redis = node->redis;
+
+    redis_node_release_cli(node);
+    node->closing = 0;
+
+    swClient *cli = emalloc(sizeof(swClient));
+    if (swClient_create(cli, SW_SOCK_TCP, 1) < 0)
     {
-    case SWOOLE_REDIS_STATE_CONNECT:
-        swoole_php_error(E_WARNING, "redis client is not connected.");
-        return SW_ERR;
-    case SWOOLE_REDIS_STATE_WAIT:
-        swoole_php_error(E_WARNING, "redis client is waiting for response.");
-        return SW_ERR;
-    case SWOOLE_REDIS_STATE_CLOSED:
-        swoole_php_error(E_WARNING, "redis client connection is closed.");
+        efree(cli);
         return SW_ERR;
-    default:
-        break;
     }
+    cli->object = node;
+    cli->reactor_fdtype = PHP_SWOOLE_FD_CLIENT;
+    cli->onConnect = redis_onConnect;
+    cli->onReceive = redis_onReceive;
+    cli->onError = redis_onError;
+    cli->onClose = redis_onClose;
 
-#if PHP_MAJOR_VERSION < 7
-    redis->result_callback = callback;
-#else
-    redis->result_callback = &redis->_result_callback;
-    memcpy(redis->result_callback, callback, sizeof(zval));
-#endif
-
-    sw_zval_add_ref(&redis->result_callback);
+    node->cli = cli;
+    swString_clear(node->rbuffer);
+    redis_node_reset_parser(node TSRMLS_CC);
 
-    va_list ap;
-    va_start(ap, format);
-    int ret = redisvAsyncCommand(redis->context, swoole_redis_onResult, NULL, format, ap);
-    va_end(ap);
-
-    if (ret < 0)
+    if (cli->connect(cli, node->host, node->port, redis->timeout, 1) < 0)
     {
-        swoole_php_error(E_WARNING, "redisAsyncCommandArgv() failed.");
+        node->cli = NULL;
+        redis_cli_free(cli);
         return SW_ERR;
     }
-    redis->state = SWOOLE_REDIS_STATE_WAIT;
     return SW_OK;
 }
 
-static PHP_METHOD(swoole_redis, execute)
+/**
+ * the node may be used by the callback which is running, it is freed at the end of the loop
+ */
+static void redis_node_retire(redis_node *node)
 {
-    zval *callback;
-    char *command;
-    zend_size_t command_len;
-
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &command, &command_len, &callback) == FAILURE)
+    if (node->dirty)
     {
-        return;
+        DL_DELETE(redis_dirty_nodes, node);
+        node->dirty = 0;
     }
-    SW_CHECK_RETURN(swoole_redis_send_command(getThis(), callback, command, command_len));
+    redis_node_release_cli(node);
+    if (redis_garbage_nodes == NULL)
+    {
+        redis_garbage_nodes = swLinkedList_new();
+    }
+    swLinkedList_append(redis_garbage_nodes, node);
+    redis_check_loop_end();
 }
 
-static PHP_METHOD(swoole_redis, get)
+static void redis_node_free(redis_node *node TSRMLS_DC)
 {
-    zval *callback;
-    char *key;
-    zend_size_t key_len;
+    redis_request *req;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &key, &key_len, &callback) == FAILURE)
+    if (node->dirty)
     {
-        return;
+        DL_DELETE(redis_dirty_nodes, node);
     }
-    SW_CHECK_RETURN(swoole_redis_send_command(getThis(), callback, "GET %s", key));
+    if (node->cli)
+    {
+        redis_cli_free(node->cli);
+    }
+    redis_node_reset_parser(node TSRMLS_CC);
+    while ((req = swLinkedList_shift(node->requests)))
+    {
+        redis_request_free(req TSRMLS_CC);
+    }
+    sw_free(node->requests);
+    swString_free(node->wbuffer);
+    swString_free(node->rbuffer);
+    efree(node->host);
+    efree(node);
 }
 
-static PHP_METHOD(swoole_redis, set)
+static void redis_node_reset_parser(redis_node *node TSRMLS_DC)
 {
-    zval *callback;
-    char *key;
-    int key_len;
-    char *value;
-    zend_size_t value_len;
+    while (node->depth > 0)
+    {
+        node->depth--;
+        redis_zval_free(node->stack[node->depth].array);
+    }
+}
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ssz", &key, &key_len, &value, &value_len, &callback) == FAILURE)
+/**
+ * send all of the commands issued in this loop with one write
+ */
+static void redis_node_flush(redis_node *node)
+{
+    if (node->dirty)
+    {
+        DL_DELETE(redis_dirty_nodes, node);
+        node->dirty = 0;
+    }
+    if (!node->connected || node->wbuffer->length == 0)
+    {
+        return;
+    }
+    if (node->cli->send(node->cli, node->wbuffer->str, node->wbuffer->length, 0) < 0)
     {
+        swSysError("send(%d) %d bytes to redis-server[%s:%ld] failed.", node->cli->socket->fd, (int) node->wbuffer->length, node->host, node->port);
+        swString_clear(node->wbuffer);
+        node->cli->close(node->cli);
         return;
     }
-    SW_CHECK_RETURN(swoole_redis_send_command(getThis(), callback, "SET %s %b", key, value, value_len));
+    swString_clear(node->wbuffer);
 }
 
-static void swoole_redis_onResult(redisAsyncContext *c, void *r, void *privdata)
+static void redis_onLoopEnd(swReactor *reactor)
 {
 #if PHP_MAJOR_VERSION < 7
     TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
 #endif
 
-    redisReply *reply = r;
-    if (reply == NULL)
+    redis_node *node, *tmp;
+    swClient *cli;
+
+    DL_FOREACH_SAFE(redis_dirty_nodes, node, tmp)
     {
-        return;
+        redis_node_flush(node);
     }
+    if (redis_garbage_nodes)
+    {
+        while ((node = swLinkedList_shift(redis_garbage_nodes)))
+        {
+            redis_node_free(node TSRMLS_CC);
+        }
+    }
+    if (redis_garbage_clients)
+    {
+        while ((cli = swLinkedList_shift(redis_garbage_clients)))
+        {
+            redis_cli_free(cli);
+        }
+    }
+}
 
-    swRedisClient *redis = c->ev.data;
-    zval *result, *retval;
-    SW_MAKE_STD_ZVAL(result);
-
-    if (reply->str == NULL)
+/**
+ * queue the command, it is sent at the end of this loop
+ */
+static void redis_node_add(redis_node *node, swString *packet, redis_request *req)
+{
+    swString_append(node->wbuffer, packet);
+    if (req)
     {
-        ZVAL_BOOL(result, 0);
-        zend_update_property_long(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errCode"), c->err TSRMLS_CC);
-        zend_update_property_string(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errMsg"), c->errstr TSRMLS_CC);
+        swLinkedList_append(node->requests, req);
     }
-    else
+    if (!node->dirty)
     {
-        SW_ZVAL_STRINGL(result, reply->str, reply->len, 1);
+        DL_APPEND(redis_dirty_nodes, node);
+        node->dirty = 1;
     }
+    redis_check_loop_end();
+}
 
-    redis->state = SWOOLE_REDIS_STATE_READY;
+/**
+ * fail all of the requests of the node
+ */
+static void redis_node_clear(redis_node *node, int error, char *error_msg TSRMLS_DC)
+{
+    swRedisClient *redis = node->redis;
+    swLinkedList *requests = node->requests;
+    redis_request *req;
+    zval *result;
 
-    zval **args[2];
-    args[0] = &redis->object;
-    args[1] = &result;
+    redis_node_reset_parser(node TSRMLS_CC);
+    swString_clear(node->wbuffer);
+    swString_clear(node->rbuffer);
+
+    //the commands issued in the callbacks are kept for the next connection
+    node->requests = swLinkedList_new();
+
+    while ((req = swLinkedList_shift(requests)))
+    {
+        if (req->type == SWOOLE_REDIS_REQUEST_USER && req->callback)
+        {
+            redis_set_error(redis, error, error_msg, strlen(error_msg) TSRMLS_CC);
+            SW_MAKE_STD_ZVAL(result);
+            ZVAL_BOOL(result, 0);
+            redis_request_callback(redis, req->callback, result TSRMLS_CC);
+            sw_zval_ptr_dtor(&result);
+        }
+        redis_request_free(req TSRMLS_CC);
+    }
+    sw_free(requests);
+}
+
+static void redis_onConnect(swClient *cli)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    redis_node *node = cli->object;
+    swRedisClient *redis = node->redis;
+
+    node->connected = 1;
 
-    if (sw_call_user_function_ex(EG(function_table), NULL, redis->result_callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    //the seed node
+    if (redis->state == SWOOLE_REDIS_STATE_CONNECT && node == redis->nodes[0])
     {
-        swoole_php_fatal_error(E_WARNING, "swoole_async_mysql callback handler error.");
+        if (redis->cluster)
+        {
+            redis_request *req = emalloc(sizeof(redis_request));
+            bzero(req, sizeof(redis_request));
+            req->type = SWOOLE_REDIS_REQUEST_SLOTS;
+
+            swString_clear(redis_packet);
+            swString_append_ptr(redis_packet, ZEND_STRL("*2\r\n$7\r\nCLUSTER\r\n$5\r\nSLOTS\r\n"));
+            //before the commands which were issued while connecting
+            swLinkedList_prepend(node->requests, req);
+            swString_extend(node->wbuffer, node->wbuffer->length + redis_packet->length);
+            memmove(node->wbuffer->str + redis_packet->length, node->wbuffer->str, node->wbuffer->length);
+            memcpy(node->wbuffer->str, redis_packet->str, redis_packet->length);
+            node->wbuffer->length += redis_packet->length;
+            redis_node_flush(node);
+            return;
+        }
+        redis->state = SWOOLE_REDIS_STATE_READY;
+        redis_node_flush(node);
+        redis_connect_callback(redis, 1 TSRMLS_CC);
+        return;
     }
-    if (retval != NULL)
+    redis_node_flush(node);
+}
+
+static void redis_onError(swClient *cli)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+
+    redis_node *node = cli->object;
+    swRedisClient *redis = node->redis;
+    zval *zobject = redis->object;
+    char *error = strerror(SwooleG.error);
+
+    //swClient will close the socket after onError, onClose is not needed
+    cli->onClose = NULL;
+    node->closing = 1;
+    node->connected = 0;
+
+    sw_zval_add_ref(&zobject);
+    swoole_php_error(E_WARNING, "connect to redis-server[%s:%ld] failed. Error: %s[%d]", node->host, node->port, error, SwooleG.error);
+    redis_set_error(redis, SwooleG.error, error, strlen(error) TSRMLS_CC);
+    redis_node_clear(node, SwooleG.error, error TSRMLS_CC);
+
+    if (redis->state == SWOOLE_REDIS_STATE_CONNECT && node == redis->nodes[0])
     {
-        sw_zval_ptr_dtor(&retval);
+        redis->state = SWOOLE_REDIS_STATE_CLOSED;
+        redis_connect_callback(redis, 0 TSRMLS_CC);
     }
-    sw_zval_ptr_dtor(&result);
+    sw_zval_ptr_dtor(&zobject);
 }
 
-void swoole_redis_onConnect(const redisAsyncContext *c, int status)
+static void redis_onClose(swClient *cli)
 {
 #if PHP_MAJOR_VERSION < 7
     TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
 #endif
-    swRedisClient *redis = c->ev.data;
 
-    zval *result, *retval;
-    SW_MAKE_STD_ZVAL(result);
-    if (status != REDIS_OK)
+    redis_node *node = cli->object;
+    swRedisClient *redis = node->redis;
+    zval *zobject = redis->object;
+    zval **args[1];
+    zval *retval = NULL;
+    uint8_t state = redis->state;
+
+    node->closing = 1;
+    node->connected = 0;
+
+    sw_zval_add_ref(&zobject);
+    redis_node_clear(node, ECONNRESET, "connection is closed." TSRMLS_CC);
+
+    if (state == SWOOLE_REDIS_STATE_CONNECT && node == redis->nodes[0])
     {
-        ZVAL_BOOL(result, 0);
-        zend_update_property_long(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errCode"), c->err TSRMLS_CC);
-        zend_update_property_string(swoole_redis_class_entry_ptr, redis->object, ZEND_STRL("errMsg"), c->errstr TSRMLS_CC);
         redis->state = SWOOLE_REDIS_STATE_CLOSED;
+        redis_connect_callback(redis, 0 TSRMLS_CC);
+        goto _free;
     }
-    else
+    //the other nodes of the cluster are connected again when they are used
+    if (redis->cluster && node != redis->nodes[0])
     {
-        ZVAL_BOOL(result, 1);
-        redis->state = SWOOLE_REDIS_STATE_READY;
+        goto _free;
     }
 
-    zval **args[2];
-    args[0] = &redis->object;
-    args[1] = &result;
-
-    if (sw_call_user_function_ex(EG(function_table), NULL, redis->connect_callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    redis->state = SWOOLE_REDIS_STATE_CLOSED;
+    if (state == SWOOLE_REDIS_STATE_CLOSED || !redis->onClose)
     {
-        swoole_php_fatal_error(E_WARNING, "swoole_async_mysql callback handler error.");
+        goto _free;
     }
-    if (retval != NULL)
+    args[0] = &zobject;
+    if (sw_call_user_function_ex(EG(function_table), NULL, redis->onClose, &retval, 1, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_redis onClose handler error.");
+    }
+    if (EG(exception))
+    {
+        zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+    }
+    if (retval)
     {
         sw_zval_ptr_dtor(&retval);
     }
-    sw_zval_ptr_dtor(&result);
-}
 
-void swoole_redis_onClose(const redisAsyncContext *c, int status)
-{
-    swRedisClient *redis = c->ev.data;
-    redis->state = SWOOLE_REDIS_STATE_CLOSED;
+    _free:
+    sw_zval_ptr_dtor(&zobject);
 }
 
-static void swoole_redis_event_AddRead(void *privdata)
+static void redis_onReceive(swClient *cli, char *data, uint32_t length)
 {
-    swRedisClient *redis = (swRedisClient*) privdata;
-    swReactor_add_event(SwooleG.main_reactor, redis->context->c.fd, SW_EVENT_READ);
-}
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
 
-static void swoole_redis_event_DelRead(void *privdata)
-{
-    swRedisClient *redis = (swRedisClient*) privdata;
-    swReactor_del_event(SwooleG.main_reactor, redis->context->c.fd, SW_EVENT_READ);
-}
+    redis_node *node = cli->object;
+    swString *buffer = node->rbuffer;
+    zval *zobject = node->redis->object;
+    int n;
 
-static void swoole_redis_event_AddWrite(void *privdata)
-{
-    swRedisClient *redis = (swRedisClient*) privdata;
-    swReactor_add_event(SwooleG.main_reactor, redis->context->c.fd, SW_EVENT_WRITE);
-}
+    //the callbacks may destroy the object
+    sw_zval_add_ref(&zobject);
 
-static void swoole_redis_event_DelWrite(void *privdata)
-{
-    swRedisClient *redis = (swRedisClient*) privdata;
-    swReactor_del_event(SwooleG.main_reactor, redis->context->c.fd, SW_EVENT_WRITE);
-}
+    //parse the socket buffer directly, only the incomplete reply is copied
+    if (buffer->length == 0)
+    {
+        n = redis_parse(node, data, length TSRMLS_CC);
+        if (n < 0)
+        {
+            goto _error;
+        }
+        if (node->cli == cli && node->connected && n < length)
+        {
+            swString_append_ptr(buffer, data + n, length - n);
+        }
+    }
+    else
+    {
+        swString_append_ptr(buffer, data, length);
+        n = redis_parse(node, buffer->str, buffer->length TSRMLS_CC);
+        if (n < 0)
+        {
+            goto _error;
+        }
+        if (node->cli == cli && node->connected)
+        {
+            if (n < buffer->length)
+            {
+                memmove(buffer->str, buffer->str + n, buffer->length - n);
+            }
+            buffer->length -= n;
+        }
+    }
+    sw_zval_ptr_dtor(&zobject);
+    return;
 
-static void swoole_redis_event_Cleanup(void *privdata)
-{
-    swRedisClient *redis = (swRedisClient*) privdata;
-    SwooleG.main_reactor->del(SwooleG.main_reactor, redis->context->c.fd);
+    _error:
+    swoole_php_error(E_WARNING, "redis-server[%s:%ld] protocol error.", node->host, node->port);
+    if (node->cli == cli && node->connected)
+    {
+        cli->close(cli);
+    }
+    sw_zval_ptr_dtor(&zobject);
 }
 
-static int swoole_redis_onRead(swReactor *reactor, swEvent *event)
+/**
+ * parse the replies, return the parsed length, the incomplete reply is left in the buffer
+ */
+static int redis_parse(redis_node *node, char *data, int length TSRMLS_DC)
 {
-    swRedisClient *redis = event->socket->object;
-    redisAsyncHandleRead(redis->context);
-    return SW_OK;
-}
+    swClient *cli = node->cli;
+    char *p = data;
+    char *end = data + length;
+    char *eol;
+    char *error;
+    long n;
+    zval *value;
+    int is_error;
 
-static int swoole_redis_onWrite(swReactor *reactor, swEvent *event)
-{
-    swRedisClient *redis = event->socket->object;
-    redisAsyncHandleWrite(redis->context);
-    return SW_OK;
-}
+    while (p < end)
+    {
+        eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+        {
+            break;
+        }
+        if (eol == p || eol[-1] != '\r')
+        {
+            return SW_ERR;
+        }
 
-#endif
+        is_error = 0;
+        switch (*p)
+        {
+        //status and error
+        case '+':
+        case '-':
+            is_error = *p == '-';
+            SW_ALLOC_INIT_ZVAL(value);
+            SW_ZVAL_STRINGL(value, p + 1, eol - 1 - (p + 1), 1);
+            p = eol + 1;
+            break;
+
+        //integer
+        case ':':
+            n = strtol(p + 1, &error, 10);
+            if (error != eol - 1)
+            {
+                return SW_ERR;
+            }
+            SW_ALLOC_INIT_ZVAL(value);
+            ZVAL_LONG(value, n);
+            p = eol + 1;
+            break;
+
+        //bulk string
+        case '$':
+            n = strtol(p + 1, &error, 10);
+            if (error != eol - 1)
+            {
+                return SW_ERR;
+            }
+            if (n >= 0 && end - (eol + 1) < n + 2)
+            {
+                goto _wait;
+            }
+            SW_ALLOC_INIT_ZVAL(value);
+            if (n < 0)
+            {
+                ZVAL_NULL(value);
+                p = eol + 1;
+            }
+            else
+            {
+                SW_ZVAL_STRINGL(value, eol + 1, n, 1);
+                p = eol + 1 + n + 2;
+            }
+            break;
+
+        //multi bulk
+        case '*':
+            n = strtol(p + 1, &error, 10);
+            if (error != eol - 1)
+            {
+                return SW_ERR;
+            }
+            p = eol + 1;
+            SW_ALLOC_INIT_ZVAL(value);
+            if (n < 0)
+            {
+                ZVAL_NULL(value);
+                break;
+            }
+            array_init(value);
+            if (n == 0)
+            {
+                break;
+            }
+            if (node->depth == SW_REDIS_MAX_DEPTH)
+            {
+                redis_zval_free(value);
+                return SW_ERR;
+            }
+            //the array is added to its parent when all of the elements are received
+            node->stack[node->depth].array = value;
+            node->stack[node->depth].remaining = n;
+            node->depth++;
+            continue;
+
+        default:
+            return SW_ERR;
+        }
+
+        redis_parse_value(node, value, is_error TSRMLS_CC);
+        //closed in the callback
+        if (node->cli != cli || !node->connected)
+        {
+            break;
+        }
+    }
+
+    _wait:
+    return p - data;
+}
+
+static void redis_parse_value(redis_node *node, zval *value, int is_error TSRMLS_DC)
+{
+    redis_parse_frame *frame;
+
+    while (node->depth > 0)
+    {
+        frame = &node->stack[node->depth - 1];
+        //the error of the command in EXEC
+        if (is_error)
+        {
+            zval_dtor(value);
+            ZVAL_BOOL(value, 0);
+            is_error = 0;
+        }
+        redis_array_add(frame->array, value);
+        if (--frame->remaining > 0)
+        {
+            return;
+        }
+        value = frame->array;
+        node->depth--;
+    }
+    redis_onReply(node, value, is_error TSRMLS_CC);
+    redis_zval_free(value);
+}
+
+static void redis_onReply(redis_node *node, zval *value, int is_error TSRMLS_DC)
+{
+    swRedisClient *redis = node->redis;
+    redis_request *req;
+    zval *result;
+
+    if (node->requests->num == 0)
+    {
+        //published messages and the replies of (un)subscribe
+        if (redis->state == SWOOLE_REDIS_STATE_SUBSCRIBE && Z_TYPE_P(value) == IS_ARRAY)
+        {
+            zval *type = redis_array_get(value, 0);
+            zval *count = redis_array_get(value, 2);
+            if (type && count && Z_TYPE_P(type) == IS_STRING && Z_TYPE_P(count) == IS_LONG && Z_LVAL_P(count) == 0
+                    && (redis_command_is(Z_STRVAL_P(type), Z_STRLEN_P(type), "unsubscribe")
+                            || redis_command_is(Z_STRVAL_P(type), Z_STRLEN_P(type), "punsubscribe")))
+            {
+                redis->state = SWOOLE_REDIS_STATE_READY;
+            }
+            if (redis->onMessage)
+            {
+                redis_request_callback(redis, redis->onMessage, value TSRMLS_CC);
+            }
+            return;
+        }
+        swWarn("unexpected reply from redis-server[%s:%ld].", node->host, node->port);
+        return;
+    }
+
+    req = swLinkedList_shift(node->requests);
+    switch (req->type)
+    {
+    case SWOOLE_REDIS_REQUEST_SLOTS:
+        if (is_error || Z_TYPE_P(value) != IS_ARRAY)
+        {
+            swoole_php_error(E_WARNING, "redis-server[%s:%ld] is not in cluster mode.", node->host, node->port);
+            redis->cluster = 0;
+        }
+        else
+        {
+            redis_onSlots(redis, value TSRMLS_CC);
+        }
+        redis->state = SWOOLE_REDIS_STATE_READY;
+        redis_connect_callback(redis, 1 TSRMLS_CC);
+        break;
+
+    case SWOOLE_REDIS_REQUEST_DISCARD:
+        break;
+
+    default:
+        if (is_error)
+        {
+            //MOVED 3999 127.0.0.1:6381 or ASK 3999 127.0.0.1:6381
+            if (redis->cluster && redis->slots && req->packet
+                    && redis_redirect(node, req, Z_STRVAL_P(value), Z_STRLEN_P(value) TSRMLS_CC) == SW_OK)
+            {
+                return;
+            }
+            redis_set_error(redis, -1, Z_STRVAL_P(value), Z_STRLEN_P(value) TSRMLS_CC);
+            if (req->callback)
+            {
+                SW_MAKE_STD_ZVAL(result);
+                ZVAL_BOOL(result, 0);
+                redis_request_callback(redis, req->callback, result TSRMLS_CC);
+                sw_zval_ptr_dtor(&result);
+            }
+        }
+        else if (req->callback)
+        {
+            redis_request_callback(redis, req->callback, value TSRMLS_CC);
+        }
+        break;
+    }
+    redis_request_free(req TSRMLS_CC);
+}
+
+/**
+ * [[start, end, [host, port, id], [replica...]], ...]
+ */
+static void redis_onSlots(swRedisClient *redis, zval *value TSRMLS_DC)
+{
+    zval *entry, *start, *end, *master, *host, *port;
+    redis_node *node;
+    long i;
+    int index;
+
+    if (!redis->slots)
+    {
+        redis->slots = ecalloc(SW_REDIS_CLUSTER_SLOTS, sizeof(uint16_t));
+    }
+
+    SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(value), entry)
+        start = redis_array_get(entry, 0);
+        end = redis_array_get(entry, 1);
+        master = redis_array_get(entry, 2);
+        host = redis_array_get(master, 0);
+        port = redis_array_get(master, 1);
+        if (!start || !end || !host || !port || Z_TYPE_P(start) != IS_LONG || Z_TYPE_P(end) != IS_LONG
+                || Z_TYPE_P(host) != IS_STRING || Z_TYPE_P(port) != IS_LONG)
+        {
+            continue;
+        }
+        node = redis_node_find(redis, Z_STRVAL_P(host), Z_STRLEN_P(host), Z_LVAL_P(port));
+        if (!node)
+        {
+            //connect when it is used
+            node = redis_node_new(redis, Z_STRVAL_P(host), Z_STRLEN_P(host), Z_LVAL_P(port));
+        }
+        index = redis_node_index(redis, node);
+        for (i = Z_LVAL_P(start); i <= Z_LVAL_P(end) && i < SW_REDIS_CLUSTER_SLOTS; i++)
+        {
+            redis->slots[i] = index;
+        }
+    SW_HASHTABLE_FOREACH_END();
+}
+
+static int redis_redirect(redis_node *node, redis_request *req, char *error, int error_len TSRMLS_DC)
+{
+    swRedisClient *redis = node->redis;
+    char *p, *addr, *colon;
+    int ask;
+    long slot;
+    long port;
+    redis_node *target;
+
+    if (error_len > 6 && memcmp(error, "MOVED ", 6) == 0)
+    {
+        ask = 0;
+        p = error + 6;
+    }
+    else if (error_len > 4 && memcmp(error, "ASK ", 4) == 0)
+    {
+        ask = 1;
+        p = error + 4;
+    }
+    else
+    {
+        return SW_ERR;
+    }
+    if (req->redirects >= SW_REDIS_MAX_REDIRECTS)
+    {
+        return SW_ERR;
+    }
+
+    slot = strtol(p, &addr, 10);
+    if (slot < 0 || slot >= SW_REDIS_CLUSTER_SLOTS || *addr != ' ')
+    {
+        return SW_ERR;
+    }
+    addr++;
+    colon = memrchr(addr, ':', error + error_len - addr);
+    if (colon == NULL)
+    {
+        return SW_ERR;
+    }
+    port = atol(colon + 1);
+
+    target = redis_node_find(redis, addr, colon - addr, port);
+    if (!target)
+    {
+        target = redis_node_new(redis, addr, colon - addr, port);
+    }
+    //ASK is only for this command, MOVED changes the owner of the slot
+    if (!ask)
+    {
+        redis->slots[slot] = redis_node_index(redis, target);
+    }
+    if (!redis_node_alive(target) && redis_node_connect(target TSRMLS_CC) < 0)
+    {
+        return SW_ERR;
+    }
+    if (ask)
+    {
+        redis_request *asking = emalloc(sizeof(redis_request));
+        bzero(asking, sizeof(redis_request));
+        asking->type = SWOOLE_REDIS_REQUEST_DISCARD;
+        swString_clear(redis_packet);
+        swString_append_ptr(redis_packet, ZEND_STRL("*1\r\n$6\r\nASKING\r\n"));
+        redis_node_add(target, redis_packet, asking);
+    }
+
+    req->redirects++;
+    redis_node_add(target, req->packet, req);
+    return SW_OK;
+}
+
+static void redis_connect_callback(swRedisClient *redis, int result TSRMLS_DC)
+{
+    zval *zobject = redis->object;
+    zval *zcallback = redis->onConnect;
+    zval **args[2];
+    zval *retval = NULL;
+    zval *zresult;
+
+    if (!zcallback)
+    {
+        return;
+    }
+#if PHP_MAJOR_VERSION >= 7
+    //connect() may be called again in the callback
+    zval _zcallback;
+    memcpy(&_zcallback, zcallback, sizeof(zval));
+    zcallback = &_zcallback;
+#endif
+    redis->onConnect = NULL;
+
+    SW_MAKE_STD_ZVAL(zresult);
+    ZVAL_BOOL(zresult, result);
+    args[0] = &zobject;
+    args[1] = &zresult;
+    if (sw_call_user_function_ex(EG(function_table), NULL, zcallback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_redis onConnect handler error.");
+    }
+    if (EG(exception))
+    {
+        zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+    }
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+    sw_zval_ptr_dtor(&zresult);
+    sw_zval_ptr_dtor(&zcallback);
+}
+
+static void redis_request_callback(swRedisClient *redis, zval *callback, zval *result TSRMLS_DC)
+{
+    zval *zobject = redis->object;
+    zval **args[2];
+    zval *retval = NULL;
+
+    args[0] = &zobject;
+    args[1] = &result;
+    if (sw_call_user_function_ex(EG(function_table), NULL, callback, &retval, 2, args, 0, NULL TSRMLS_CC) != SUCCESS)
+    {
+        swoole_php_fatal_error(E_WARNING, "swoole_redis callback handler error.");
+    }
+    if (EG(exception))
+    {
+        zend_exception_error(EG(exception), E_ERROR TSRMLS_CC);
+    }
+    if (retval)
+    {
+        sw_zval_ptr_dtor(&retval);
+    }
+}
+
+static void redis_request_free(redis_request *req TSRMLS_DC)
+{
+    if (req->callback)
+    {
+        sw_zval_ptr_dtor(&req->callback);
+    }
+    if (req->packet)
+    {
+        swString_free(req->packet);
+    }
+    efree(req);
+}
+
+#if PHP_MAJOR_VERSION >= 7
+#define REDIS_SET_CALLBACK(object, name, callback)  redis_set_callback(&(object)->name, &(object)->_##name, callback)
+#else
+#define REDIS_SET_CALLBACK(object, name, callback)  redis_set_callback(&(object)->name, NULL, callback)
+#endif
+
+static void redis_set_callback(zval **property, zval *_property, zval *callback)
+{
+    if (*property)
+    {
+        sw_zval_ptr_dtor(property);
+    }
+#if PHP_MAJOR_VERSION >= 7
+    *property = _property;
+    memcpy(*property, callback, sizeof(zval));
+#else
+    *property = callback;
+#endif
+    sw_zval_add_ref(property);
+}
+
+/**
+ * pack the command with the RESP protocol and route it to the node
+ */
+static int redis_command(swRedisClient *redis, zval **argv, int argc, zval *callback TSRMLS_DC)
+{
+    redis_node *node;
+    redis_request *req;
+    char *command;
+    int command_len;
+    int i;
+    int key_index = 1;
+    int subscribe;
+    char head[32];
+
+    if (argc < 1 || Z_TYPE_P(argv[0]) != IS_STRING)
+    {
+        swoole_php_error(E_WARNING, "command is empty.");
+        return SW_ERR;
+    }
+    command = Z_STRVAL_P(argv[0]);
+    command_len = Z_STRLEN_P(argv[0]);
+    subscribe = redis_command_is(command, command_len, "subscribe") || redis_command_is(command, command_len, "psubscribe");
+
+    switch (redis->state)
+    {
+    case SWOOLE_REDIS_STATE_CLOSED:
+        swoole_php_error(E_WARNING, "redis client is not connected.");
+        return SW_ERR;
+    case SWOOLE_REDIS_STATE_CONNECT:
+        if (subscribe)
+        {
+            swoole_php_error(E_WARNING, "SUBSCRIBE can only be used after connected.");
+            return SW_ERR;
+        }
+        break;
+    case SWOOLE_REDIS_STATE_SUBSCRIBE:
+        if (!subscribe && !redis_command_is(command, command_len, "unsubscribe")
+                && !redis_command_is(command, command_len, "punsubscribe"))
+        {
+            swoole_php_error(E_WARNING, "only (P)SUBSCRIBE and (P)UNSUBSCRIBE can be used in subscribe mode.");
+            return SW_ERR;
+        }
+        break;
+    default:
+        break;
+    }
+
+    swString_clear(redis_packet);
+    i = snprintf(head, sizeof(head), "*%d\r\n", argc);
+    swString_append_ptr(redis_packet, head, i);
+    for (i = 0; i < argc; i++)
+    {
+        redis_append_arg(redis_packet, argv[i] TSRMLS_CC);
+    }
+
+    //the messages are received by the seed node
+    if (subscribe || redis->state == SWOOLE_REDIS_STATE_SUBSCRIBE)
+    {
+        if (callback)
+        {
+            REDIS_SET_CALLBACK(redis, onMessage, callback);
+        }
+        redis->state = SWOOLE_REDIS_STATE_SUBSCRIBE;
+        redis_node_add(redis->nodes[0], redis_packet, NULL);
+        return SW_OK;
+    }
+
+    //route by the key
+    node = redis->nodes[0];
+    if (redis->cluster && redis->slots)
+    {
+        if (redis->pinned_node)
+        {
+            node = redis->pinned_node;
+        }
+        else
+        {
+            if (redis_command_is(command, command_len, "eval") || redis_command_is(command, command_len, "evalsha"))
+            {
+                //EVAL script numkeys key [key ...]
+                key_index = 3;
+                if (argc < 3 || (Z_TYPE_P(argv[2]) == IS_STRING && atol(Z_STRVAL_P(argv[2])) <= 0)
+                        || (Z_TYPE_P(argv[2]) == IS_LONG && Z_LVAL_P(argv[2]) <= 0))
+                {
+                    key_index = argc;
+                }
+            }
+            if (argc > key_index && Z_TYPE_P(argv[key_index]) == IS_STRING)
+            {
+                node = redis->nodes[redis->slots[redis_key_slot(Z_STRVAL_P(argv[key_index]), Z_STRLEN_P(argv[key_index]))]];
+            }
+            else if (argc > key_index)
+            {
+                zval copy = *argv[key_index];
+                zval_copy_ctor(&copy);
+                convert_to_string(&copy);
+                node = redis->nodes[redis->slots[redis_key_slot(Z_STRVAL(copy), Z_STRLEN(copy))]];
+                zval_dtor(&copy);
+            }
+            else if (redis->last_node)
+            {
+                //commands without key
+                node = redis->last_node;
+            }
+        }
+        if (!redis_node_alive(node) && redis_node_connect(node TSRMLS_CC) < 0)
+        {
+            swoole_php_error(E_WARNING, "connect to redis-server[%s:%ld] failed.", node->host, node->port);
+            return SW_ERR;
+        }
+        redis->last_node = node;
+    }
+
+    req = emalloc(sizeof(redis_request));
+    bzero(req, sizeof(redis_request));
+    req->type = SWOOLE_REDIS_REQUEST_USER;
+    if (callback)
+    {
+        REDIS_SET_CALLBACK(req, callback, callback);
+    }
+    if (redis->cluster)
+    {
+        req->packet = swString_dup2(redis_packet);
+    }
+
+    if (redis->cluster && redis->slots)
+    {
+        //MULTI is sent with the next command, all of the commands in the transaction are sent to its node
+        if (redis_command_is(command, command_len, "multi"))
+        {
+            if (redis->multi || redis->pinned_node)
+            {
+                swoole_php_error(E_WARNING, "MULTI calls can not be nested.");
+                redis_request_free(req TSRMLS_CC);
+                return SW_ERR;
+            }
+            redis->multi = req;
+            return SW_OK;
+        }
+        if (redis->multi)
+        {
+            redis_node_add(node, redis->multi->packet, redis->multi);
+            redis->multi = NULL;
+            redis->pinned_node = node;
+        }
+        if (redis_command_is(command, command_len, "exec") || redis_command_is(command, command_len, "discard"))
+        {
+            redis->pinned_node = NULL;
+        }
+    }
+
+    redis_node_add(node, redis_packet, req);
+    return SW_OK;
+}
+
+//new swoole_redis(array $settings = null);
+static PHP_METHOD(swoole_redis, __construct)
+{
+    zval *zset = NULL;
+    zval *value;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|z", &zset) == FAILURE)
+    {
+        return;
+    }
+
+    swRedisClient *redis = emalloc(sizeof(swRedisClient));
+    bzero(redis, sizeof(swRedisClient));
+
+#if PHP_MAJOR_VERSION >= 7
+    redis->object = &redis->_object;
+    memcpy(redis->object, getThis(), sizeof(zval));
+#else
+    redis->object = getThis();
+#endif
+    redis->state = SWOOLE_REDIS_STATE_CLOSED;
+    redis->timeout = SW_REDIS_CONNECT_TIMEOUT;
+
+    if (zset && Z_TYPE_P(zset) == IS_ARRAY)
+    {
+        HashTable *vht = Z_ARRVAL_P(zset);
+        //cluster slots routing
+        if (sw_zend_hash_find(vht, ZEND_STRS("cluster"), (void **) &value) == SUCCESS)
+        {
+            convert_to_boolean(value);
+            redis->cluster = Z_BVAL_P(value);
+        }
+        if (sw_zend_hash_find(vht, ZEND_STRS("timeout"), (void **) &value) == SUCCESS)
+        {
+            convert_to_double(value);
+            redis->timeout = Z_DVAL_P(value);
+        }
+    }
+    swoole_set_object(getThis(), redis);
+}
+
+static PHP_METHOD(swoole_redis, __destruct)
+{
+    int i;
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis)
+    {
+        return;
+    }
+    swoole_set_object(getThis(), NULL);
+
+    redis->state = SWOOLE_REDIS_STATE_CLOSED;
+    for (i = 0; i < redis->node_num; i++)
+    {
+        redis_node *node = redis->nodes[i];
+        //destroyed at the end of onClose
+        if (node->cli && node->closing && !node->cli->closed)
+        {
+            redis_node_retire(node);
+        }
+        else
+        {
+            redis_node_free(node TSRMLS_CC);
+        }
+    }
+    if (redis->nodes)
+    {
+        efree(redis->nodes);
+    }
+    if (redis->slots)
+    {
+        efree(redis->slots);
+    }
+    if (redis->multi)
+    {
+        redis_request_free(redis->multi TSRMLS_CC);
+    }
+    if (redis->onConnect)
+    {
+        sw_zval_ptr_dtor(&redis->onConnect);
+    }
+    if (redis->onClose)
+    {
+        sw_zval_ptr_dtor(&redis->onClose);
+    }
+    if (redis->onMessage)
+    {
+        sw_zval_ptr_dtor(&redis->onMessage);
+    }
+    efree(redis);
+}
+
+//$redis->connect($host, $port, function($redis, $result) {});
+static PHP_METHOD(swoole_redis, connect)
+{
+    char *host;
+    zend_size_t host_len;
+    long port;
+    zval *callback;
+    int i;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "slz", &host, &host_len, &port, &callback) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    if (host_len <= 0)
+    {
+        swoole_php_error(E_WARNING, "host is empty.");
+        RETURN_FALSE;
+    }
+
+    if (port <= 1 || port > 65535)
+    {
+        swoole_php_error(E_WARNING, "port is invalid.");
+        RETURN_FALSE;
+    }
+
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis)
+    {
+        RETURN_FALSE;
+    }
+    if (redis->state != SWOOLE_REDIS_STATE_CLOSED)
+    {
+        swoole_php_error(E_WARNING, "redis client is already connected.");
+        RETURN_FALSE;
+    }
+
+    php_swoole_check_reactor();
+    if (redis_packet == NULL)
+    {
+        redis_packet = swString_new(SW_BUFFER_SIZE_BIG);
+    }
+
+    //the nodes of the last connection, connect() may be called in their callbacks
+    for (i = 0; i < redis->node_num; i++)
+    {
+        redis_node_retire(redis->nodes[i]);
+    }
+    redis->node_num = 0;
+    redis->last_node = redis->pinned_node = NULL;
+    if (redis->multi)
+    {
+        redis_request_free(redis->multi TSRMLS_CC);
+        redis->multi = NULL;
+    }
+    if (redis->slots)
+    {
+        efree(redis->slots);
+        redis->slots = NULL;
+    }
+    if (redis->onConnect)
+    {
+        sw_zval_ptr_dtor(&redis->onConnect);
+    }
+#if PHP_MAJOR_VERSION >= 7
+    redis->onConnect = &redis->_onConnect;
+    memcpy(redis->onConnect, callback, sizeof(zval));
+#else
+    redis->onConnect = callback;
+#endif
+    sw_zval_add_ref(&redis->onConnect);
+
+    zend_update_property_stringl(swoole_redis_class_entry_ptr, getThis(), ZEND_STRL("host"), host, host_len TSRMLS_CC);
+    zend_update_property_long(swoole_redis_class_entry_ptr, getThis(), ZEND_STRL("port"), port TSRMLS_CC);
+
+    redis->state = SWOOLE_REDIS_STATE_CONNECT;
+    redis_node *node = redis_node_new(redis, host, host_len, port);
+    if (redis_node_connect(node TSRMLS_CC) < 0)
+    {
+        swoole_php_error(E_WARNING, "connect to redis-server[%s:%d] failed.", host, (int) port);
+        redis->state = SWOOLE_REDIS_STATE_CLOSED;
+        sw_zval_ptr_dtor(&redis->onConnect);
+        redis->onConnect = NULL;
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+
+static PHP_METHOD(swoole_redis, on)
+{
+    char *name;
+    zend_size_t len;
+    zval *cb;
+    zval **property;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sz", &name, &len, &cb) == FAILURE)
+    {
+        return;
+    }
+
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis)
+    {
+        RETURN_FALSE;
+    }
+
+    if (strncasecmp("close", name, len) == 0)
+    {
+        property = &redis->onClose;
+#if PHP_MAJOR_VERSION >= 7
+        if (*property)
+        {
+            sw_zval_ptr_dtor(property);
+        }
+        *property = &redis->_onClose;
+#endif
+    }
+    else if (strncasecmp("message", name, len) == 0)
+    {
+        property = &redis->onMessage;
+#if PHP_MAJOR_VERSION >= 7
+        if (*property)
+        {
+            sw_zval_ptr_dtor(property);
+        }
+        *property = &redis->_onMessage;
+#endif
+    }
+    else
+    {
+        swoole_php_error(E_WARNING, "Unknown event type[%s]", name);
+        RETURN_FALSE;
+    }
+
+#if PHP_MAJOR_VERSION >= 7
+    memcpy(*property, cb, sizeof(zval));
+#else
+    if (*property)
+    {
+        sw_zval_ptr_dtor(property);
+    }
+    *property = cb;
+#endif
+    sw_zval_add_ref(property);
+    RETURN_TRUE;
+}
+
+//$redis->execute("SET key value", function($redis, $result) {});
+static PHP_METHOD(swoole_redis, execute)
+{
+    zval *callback;
+    zval *command;
+    zval *value;
+    zval **argv;
+    int argc = 0;
+    int i;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz", &command, &callback) == FAILURE)
+    {
+        return;
+    }
+
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis)
+    {
+        RETURN_FALSE;
+    }
+
+    //array('SET', 'key', 'value')
+    if (Z_TYPE_P(command) == IS_ARRAY)
+    {
+        argv = ecalloc(php_swoole_array_length(command) + 1, sizeof(zval *));
+        SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(command), value)
+            argv[argc++] = value;
+        SW_HASHTABLE_FOREACH_END();
+        int ret = redis_command(redis, argv, argc, callback TSRMLS_CC);
+        efree(argv);
+        SW_CHECK_RETURN(ret);
+    }
+
+    //split by space, the arguments cannot contain spaces
+    //do not change the argument of the caller, it is shared with the variable in PHP 5
+    zval copy = *command;
+    zval_copy_ctor(&copy);
+    convert_to_string(&copy);
+    char *p = Z_STRVAL(copy);
+    char *end = p + Z_STRLEN(copy);
+    char *word;
+
+    argv = ecalloc(Z_STRLEN(copy) / 2 + 1, sizeof(zval *));
+    while (p < end)
+    {
+        while (p < end && isspace((unsigned char) *p))
+        {
+            p++;
+        }
+        word = p;
+        while (p < end && !isspace((unsigned char) *p))
+        {
+            p++;
+        }
+        if (p > word)
+        {
+            SW_ALLOC_INIT_ZVAL(argv[argc]);
+            SW_ZVAL_STRINGL(argv[argc], word, p - word, 1);
+            argc++;
+        }
+    }
+    int ret = redis_command(redis, argv, argc, callback TSRMLS_CC);
+    for (i = 0; i < argc; i++)
+    {
+        redis_zval_free(argv[i]);
+    }
+    efree(argv);
+    zval_dtor(&copy);
+    SW_CHECK_RETURN(ret);
+}
+
+//$redis->get('key', function($redis, $result) {});
+static PHP_METHOD(swoole_redis, __call)
+{
+    zval *zname;
+    zval *params;
+    zval *value;
+    zval *callback = NULL;
+    zval **argv;
+    int argc = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "za", &zname, &params) == FAILURE)
+    {
+        return;
+    }
+
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis)
+    {
+        RETURN_FALSE;
+    }
+
+    int n = php_swoole_array_length(params);
+    argv = ecalloc(n + 1, sizeof(zval *));
+    argv[argc++] = zname;
+    SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(params), value)
+        argv[argc++] = value;
+    SW_HASHTABLE_FOREACH_END();
+
+    //the last argument is the callback, a function name is taken as a string argument
+    if (argc > 1 && (Z_TYPE_P(argv[argc - 1]) == IS_OBJECT || Z_TYPE_P(argv[argc - 1]) == IS_ARRAY))
+    {
+        char *func_name = NULL;
+        if (sw_zend_is_callable(argv[argc - 1], 0, &func_name TSRMLS_CC))
+        {
+            callback = argv[--argc];
+        }
+        if (func_name)
+        {
+            efree(func_name);
+        }
+    }
+
+    int ret = redis_command(redis, argv, argc, callback TSRMLS_CC);
+    efree(argv);
+    SW_CHECK_RETURN(ret);
+}
+
+static PHP_METHOD(swoole_redis, close)
+{
+    int i;
+    swRedisClient *redis = swoole_get_object(getThis());
+    if (!redis || redis->state == SWOOLE_REDIS_STATE_CLOSED)
+    {
+        RETURN_FALSE;
+    }
+
+    //send the queued commands before closing
+    for (i = 0; i < redis->node_num; i++)
+    {
+        redis_node_flush(redis->nodes[i]);
+    }
+    for (i = redis->node_num - 1; i >= 0; i--)
+    {
+        redis_node *node = redis->nodes[i];
+        //the seed node is the last one, its onClose calls the close callback
+        if (redis_node_alive(node))
+        {
+            node->cli->close(node->cli);
+        }
+    }
+    redis->state = SWOOLE_REDIS_STATE_CLOSED;
+    RETURN_TRUE;
+}
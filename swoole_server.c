@@ -1477,6 +1477,46 @@ PHP_FUNCTION(swoole_server_set)
         convert_to_boolean(v);
         serv->http_parse_post = Z_BVAL_P(v);
     }
+    //stream the http request body to the worker
+    if (sw_zend_hash_find(vht, ZEND_STRS("http_body_stream"), (void **) &v) == SUCCESS)
+    {
+        convert_to_boolean(v);
+        serv->http_body_stream = Z_BVAL_P(v);
+    }
+    //websocket permessage-deflate
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_compression"), (void **) &v) == SUCCESS)
+    {
+        convert_to_boolean(v);
+        serv->websocket_compression = Z_BVAL_P(v);
+    }
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_compression_level"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->websocket_compression_level = Z_LVAL_P(v) < 1 ? 1 : (Z_LVAL_P(v) > 9 ? 9 : Z_LVAL_P(v));
+    }
+    //smaller messages are sent uncompressed
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_compression_threshold"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->websocket_compression_threshold = Z_LVAL_P(v) > 0 ? Z_LVAL_P(v) : 0;
+    }
+    //the window of the client stream, 9 to 15, the inflate stream of each connection uses 1 << bits bytes
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_client_max_window_bits"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->websocket_client_max_window_bits = Z_LVAL_P(v) < 9 ? 9 : (Z_LVAL_P(v) > 15 ? 15 : Z_LVAL_P(v));
+    }
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_server_max_window_bits"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->websocket_server_max_window_bits = Z_LVAL_P(v) < 9 ? 9 : (Z_LVAL_P(v) > 15 ? 15 : Z_LVAL_P(v));
+    }
+    //the client resets the stream for each message, the reactor thread keeps no inflate stream for the connection
+    if (sw_zend_hash_find(vht, ZEND_STRS("websocket_client_no_context_takeover"), (void **) &v) == SUCCESS)
+    {
+        convert_to_boolean(v);
+        serv->websocket_client_no_context_takeover = Z_BVAL_P(v);
+    }
     //buffer: mqtt protocol
     if (sw_zend_hash_find(vht, ZEND_STRS("open_mqtt_protocol"), (void **) &v) == SUCCESS)
     {
@@ -1669,6 +1709,42 @@ PHP_FUNCTION(swoole_server_set)
         convert_to_long(v);
         serv->pipe_buffer_size = (int) Z_LVAL_P(v);
     }
+    //udp receiving threads of each port
+    if (sw_zend_hash_find(vht, ZEND_STRS("dgram_thread_num"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->dgram_thread_num = (int) Z_LVAL_P(v);
+        if (serv->dgram_thread_num <= 0)
+        {
+            serv->dgram_thread_num = 1;
+        }
+    }
+    //recvmmsg batch size of the udp threads
+    if (sw_zend_hash_find(vht, ZEND_STRS("dgram_batch"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        if (Z_LVAL_P(v) > SW_DGRAM_BATCH_MAX)
+        {
+            serv->dgram_batch = SW_DGRAM_BATCH_MAX;
+        }
+        else
+        {
+            serv->dgram_batch = Z_LVAL_P(v) > 0 ? Z_LVAL_P(v) : 0;
+        }
+    }
+    /**
+     * reactor and worker ipc, SWOOLE_IPC_UNSOCK or SWOOLE_IPC_CHANNEL
+     */
+    if (sw_zend_hash_find(vht, ZEND_STRS("ipc_mode"), (void **) &v) == SUCCESS)
+    {
+        convert_to_long(v);
+        serv->ipc_mode = (int) Z_LVAL_P(v);
+        if (serv->ipc_mode != SW_IPC_UNSOCK && serv->ipc_mode != SW_IPC_CHANNEL)
+        {
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "unsupported ipc_mode[%d].", serv->ipc_mode);
+            serv->ipc_mode = SW_IPC_UNSOCK;
+        }
+    }
     //message queue key
     if (sw_zend_hash_find(vht, ZEND_STRS("message_queue_key"), (void **) &v) == SUCCESS)
     {
@@ -2029,6 +2105,39 @@ PHP_FUNCTION(swoole_server_start)
     RETURN_TRUE;
 }
 
+/**
+ * the replies in onPacket are queued by the worker when the packets come in a batch
+ */
+static int php_swoole_udp_sendto(int sock, int ipv6, char *ip, int port, char *data, uint32_t length)
+{
+    swSocketAddress addr;
+    bzero(&addr, sizeof(addr));
+
+    if (ipv6)
+    {
+        if (inet_pton(AF_INET6, ip, &addr.addr.inet_v6.sin6_addr) <= 0)
+        {
+            swWarn("ip[%s] is invalid.", ip);
+            return SW_ERR;
+        }
+        addr.addr.inet_v6.sin6_family = AF_INET6;
+        addr.addr.inet_v6.sin6_port = htons(port);
+        addr.len = sizeof(addr.addr.inet_v6);
+    }
+    else
+    {
+        if (inet_aton(ip, &addr.addr.inet_v4.sin_addr) == 0)
+        {
+            swWarn("ip[%s] is invalid.", ip);
+            return SW_ERR;
+        }
+        addr.addr.inet_v4.sin_family = AF_INET;
+        addr.addr.inet_v4.sin_port = htons(port);
+        addr.len = sizeof(addr.addr.inet_v4);
+    }
+    return swWorker_sendto(sock, (struct sockaddr *) &addr.addr, addr.len, data, length);
+}
+
 PHP_FUNCTION(swoole_server_send)
 {
     zval *zobject = getThis();
@@ -2086,7 +2195,7 @@ PHP_FUNCTION(swoole_server_send)
         {
             php_swoole_udp_t udp_info;
             memcpy(&udp_info, &server_socket, sizeof(udp_info));
-            ret = swSocket_udp_sendto6(udp_info.from_fd, Z_STRVAL_P(zfd), udp_info.port, data, length);
+            ret = php_swoole_udp_sendto(udp_info.from_fd, 1, Z_STRVAL_P(zfd), udp_info.port, data, length);
         }
         //UNIX DGRAM
         else if (Z_STRVAL_P(zfd)[0] == '/')
@@ -2095,7 +2204,7 @@ PHP_FUNCTION(swoole_server_send)
             memcpy(addr_un.sun_path, Z_STRVAL_P(zfd), Z_STRLEN_P(zfd));
             addr_un.sun_family = AF_UNIX;
             addr_un.sun_path[Z_STRLEN_P(zfd)] = 0;
-            ret = swSocket_sendto_blocking(server_socket, data, length, 0, (struct sockaddr *) &addr_un, sizeof(addr_un));
+            ret = swWorker_sendto(server_socket, (struct sockaddr *) &addr_un, sizeof(addr_un), data, length);
         }
         else
         {
@@ -2121,7 +2230,7 @@ PHP_FUNCTION(swoole_server_send)
         addr_in.sin_family = AF_INET;
         addr_in.sin_port = htons(udp_info.port);
         addr_in.sin_addr.s_addr = fd;
-        ret = swSocket_sendto_blocking(udp_info.from_fd, data, length, 0, (struct sockaddr *) &addr_in, sizeof(addr_in));
+        ret = swWorker_sendto(udp_info.from_fd, (struct sockaddr *) &addr_in, sizeof(addr_in), data, length);
         SW_CHECK_RETURN(ret);
     }
     //TCP
@@ -2193,16 +2302,7 @@ PHP_METHOD(swoole_server, sendto)
         sock = ipv6 ?  serv->udp_socket_ipv6 : serv->udp_socket_ipv4;
     }
 
-    int ret;
-    if (ipv6)
-    {
-        ret = swSocket_udp_sendto6(sock, ip, port, data, len);
-    }
-    else
-    {
-        ret = swSocket_udp_sendto(sock, ip, port, data, len);
-    }
-    SW_CHECK_RETURN(ret);
+    SW_CHECK_RETURN(php_swoole_udp_sendto(sock, ipv6, ip, port, data, len));
 }
 
 PHP_FUNCTION(swoole_server_sendfile)
@@ -2212,6 +2312,8 @@ PHP_FUNCTION(swoole_server_sendfile)
 
     char *filename;
     long fd;
+    long offset = 0;
+    long length = 0;
 
     if (SwooleGS->start == 0)
     {
@@ -2226,14 +2328,14 @@ PHP_FUNCTION(swoole_server_sendfile)
 
     if (zobject == NULL)
     {
-        if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "Ols", &zobject, swoole_server_class_entry_ptr, &fd, &filename, &len) == FAILURE)
+        if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "Ols|ll", &zobject, swoole_server_class_entry_ptr, &fd, &filename, &len, &offset, &length) == FAILURE)
         {
             return;
         }
     }
     else
     {
-        if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ls", &fd, &filename, &len) == FAILURE)
+        if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ls|ll", &fd, &filename, &len, &offset, &length) == FAILURE)
         {
             return;
         }
@@ -2246,8 +2348,14 @@ PHP_FUNCTION(swoole_server_sendfile)
         RETURN_FALSE;
     }
 
+    if (offset < 0 || length < 0)
+    {
+        swoole_php_error(E_WARNING, "invalid offset[%ld] or length[%ld].", offset, length);
+        RETURN_FALSE;
+    }
+
     swServer *serv = swoole_get_object(zobject);
-    SW_CHECK_RETURN(swServer_tcp_sendfile(serv, (int) fd, filename, len));
+    SW_CHECK_RETURN(swServer_tcp_sendfile(serv, (int) fd, filename, len, (off_t) offset, (size_t) length));
 }
 
 PHP_FUNCTION(swoole_server_close)
@@ -2301,6 +2409,8 @@ PHP_METHOD(swoole_server, stats)
     sw_add_assoc_long_ex(return_value, ZEND_STRS("close_count"), SwooleStats->close_count);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("tasking_num"), SwooleStats->tasking_num);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("request_count"), SwooleStats->request_count);
+    sw_add_assoc_long_ex(return_value, ZEND_STRS("pause_count"), SwooleStats->pause_count);
+    sw_add_assoc_long_ex(return_value, ZEND_STRS("resume_count"), SwooleStats->resume_count);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("worker_request_count"), SwooleWG.request_count);
     sw_add_assoc_long_ex(return_value, ZEND_STRS("task_process_num"), SwooleGS->task_workers.run_worker_num);
 }
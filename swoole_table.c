@@ -31,6 +31,8 @@ ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_construct, 0, 0, 1)
     ZEND_ARG_INFO(0, table_size)
+    ZEND_ARG_INFO(0, max_size)
+    ZEND_ARG_INFO(0, evict)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_column, 0, 0, 1)
@@ -39,9 +41,23 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_column, 0, 0, 1)
     ZEND_ARG_INFO(0, size)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_create, 0, 0, 0)
+    ZEND_ARG_INFO(0, mapfile)
+ZEND_END_ARG_INFO()
+
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_set, 0, 0, 2)
     ZEND_ARG_INFO(0, key)
     ZEND_ARG_INFO(0, value)
+    ZEND_ARG_INFO(0, ttl)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_setMulti, 0, 0, 1)
+    ZEND_ARG_INFO(0, rows)
+    ZEND_ARG_INFO(0, ttl)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_multi, 0, 0, 1)
+    ZEND_ARG_INFO(0, keys)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_get, 0, 0, 1)
@@ -64,6 +80,20 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_decr, 0, 0, 2)
     ZEND_ARG_INFO(0, decrby)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_cas, 0, 0, 4)
+    ZEND_ARG_INFO(0, key)
+    ZEND_ARG_INFO(0, column)
+    ZEND_ARG_INFO(0, expect)
+    ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_swoole_table_find, 0, 0, 1)
+    ZEND_ARG_INFO(0, conditions)
+    ZEND_ARG_INFO(0, columns)
+    ZEND_ARG_INFO(0, limit)
+    ZEND_ARG_INFO(0, offset)
+ZEND_END_ARG_INFO()
+
 static PHP_METHOD(swoole_table, __construct);
 static PHP_METHOD(swoole_table, column);
 static PHP_METHOD(swoole_table, create);
@@ -71,11 +101,16 @@ static PHP_METHOD(swoole_table, set);
 static PHP_METHOD(swoole_table, get);
 static PHP_METHOD(swoole_table, del);
 static PHP_METHOD(swoole_table, exist);
+static PHP_METHOD(swoole_table, getMulti);
+static PHP_METHOD(swoole_table, setMulti);
+static PHP_METHOD(swoole_table, delMulti);
 static PHP_METHOD(swoole_table, incr);
 static PHP_METHOD(swoole_table, decr);
+static PHP_METHOD(swoole_table, cas);
 static PHP_METHOD(swoole_table, lock);
 static PHP_METHOD(swoole_table, unlock);
 static PHP_METHOD(swoole_table, count);
+static PHP_METHOD(swoole_table, find);
 static PHP_METHOD(swoole_table, destroy);
 
 #ifdef HAVE_PCRE
@@ -90,15 +125,20 @@ static const zend_function_entry swoole_table_methods[] =
 {
     PHP_ME(swoole_table, __construct, arginfo_swoole_table_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
     PHP_ME(swoole_table, column,      arginfo_swoole_table_column, ZEND_ACC_PUBLIC)
-    PHP_ME(swoole_table, create,      arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, create,      arginfo_swoole_table_create, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, destroy,     arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, set,         arginfo_swoole_table_set, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, get,         arginfo_swoole_table_get, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, count,       arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, del,         arginfo_swoole_table_del, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, exist,       arginfo_swoole_table_get, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, getMulti,    arginfo_swoole_table_multi, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, setMulti,    arginfo_swoole_table_setMulti, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, delMulti,    arginfo_swoole_table_multi, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, incr,        arginfo_swoole_table_incr, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, decr,        arginfo_swoole_table_decr, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, cas,         arginfo_swoole_table_cas, ZEND_ACC_PUBLIC)
+    PHP_ME(swoole_table, find,        arginfo_swoole_table_find, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, lock,        arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
     PHP_ME(swoole_table, unlock,      arginfo_swoole_table_void, ZEND_ACC_PUBLIC)
 #ifdef HAVE_PCRE
@@ -111,17 +151,34 @@ static const zend_function_entry swoole_table_methods[] =
     PHP_FE_END
 };
 
+static void php_swoole_table_add_column(swTableRow *row, swTableColumn *col, zval *return_value)
+{
+    swTable_string_length_t vlen = 0;
+    double dval = 0;
+
+    if (col->type == SW_TABLE_STRING)
+    {
+        memcpy(&vlen, row->data + col->index, sizeof(swTable_string_length_t));
+        sw_add_assoc_stringl_ex(return_value, col->name->str, col->name->length + 1, row->data + col->index + sizeof(swTable_string_length_t), vlen, 1);
+    }
+    else if (col->type == SW_TABLE_FLOAT)
+    {
+        memcpy(&dval, row->data + col->index, sizeof(dval));
+        sw_add_assoc_double_ex(return_value, col->name->str, col->name->length + 1, dval);
+    }
+    else
+    {
+        sw_add_assoc_long_ex(return_value, col->name->str, col->name->length + 1, swTableRow_get_long(row, col));
+    }
+}
+
 static void php_swoole_table_row2array(swTable *table, swTableRow *row, zval *return_value)
 {
     array_init(return_value);
 
     swTableColumn *col = NULL;
-    swTable_string_length_t vlen = 0;
-    double dval = 0;
-    int64_t lval = 0;
     char *k;
 
-    sw_spinlock(&row->lock);
     while(1)
     {
         col = swHashMap_each(table->columns, &k);
@@ -129,40 +186,93 @@ static void php_swoole_table_row2array(swTable *table, swTableRow *row, zval *re
         {
             break;
         }
-        if (col->type == SW_TABLE_STRING)
+        php_swoole_table_add_column(row, col, return_value);
+    }
+}
+
+static void php_swoole_table_array2row(swTable *table, swTableRow *row, zval *array)
+{
+    swTableColumn *col;
+    zval *v;
+    char *k;
+    uint32_t klen;
+    int ktype;
+    HashTable *_ht = Z_ARRVAL_P(array);
+
+    SW_HASHTABLE_FOREACH_START2(_ht, k, klen, ktype, v)
+    {
+        //printf("key=%s, klen=%d, ktype=%d\n", k, klen, ktype);
+        col = swTableColumn_get(table, k, klen);
+        if (k == NULL || col == NULL)
         {
-            memcpy(&vlen, row->data + col->index, sizeof(swTable_string_length_t));
-            sw_add_assoc_stringl_ex(return_value, col->name->str, col->name->length + 1, row->data + col->index + sizeof(swTable_string_length_t), vlen, 1);
+            continue;
+        }
+        else if (col->type == SW_TABLE_STRING)
+        {
+            convert_to_string(v);
+            swTableRow_set_value(row, col, Z_STRVAL_P(v), Z_STRLEN_P(v));
         }
         else if (col->type == SW_TABLE_FLOAT)
         {
-            memcpy(&dval, row->data + col->index, sizeof(dval));
-            sw_add_assoc_double_ex(return_value, col->name->str, col->name->length + 1, dval);
+            convert_to_double(v);
+            swTableRow_set_value(row, col, &Z_DVAL_P(v), 0);
         }
         else
         {
-            switch (col->type)
-            {
-            case SW_TABLE_INT8:
-                memcpy(&lval, row->data + col->index, 1);
-                sw_add_assoc_long_ex(return_value, col->name->str, col->name->length + 1, (int8_t) lval);
-                break;
-            case SW_TABLE_INT16:
-                memcpy(&lval, row->data + col->index, 2);
-                sw_add_assoc_long_ex(return_value, col->name->str, col->name->length + 1, (int16_t) lval);
-                break;
-            case SW_TABLE_INT32:
-                memcpy(&lval, row->data + col->index, 4);
-                sw_add_assoc_long_ex(return_value, col->name->str, col->name->length + 1, (int32_t) lval);
-                break;
-            default:
-                memcpy(&lval, row->data + col->index, 8);
-                sw_add_assoc_long_ex(return_value, col->name->str, col->name->length + 1, lval);
-                break;
-            }
+            convert_to_long(v);
+            swTableRow_set_value(row, col, &Z_LVAL_P(v), 0);
         }
     }
-    sw_spinlock_release(&row->lock);
+    SW_HASHTABLE_FOREACH_END();
+}
+
+typedef struct
+{
+    swTable_key *keys;
+    zval **rows;
+    zval *result;
+    long ttl;
+} php_swoole_table_batch;
+
+static void php_swoole_table_get_handler(swTable *table, swTableRow *row, int index, void *arg)
+{
+    php_swoole_table_batch *batch = arg;
+    zval *row_array;
+
+    SW_MAKE_STD_ZVAL(row_array);
+    php_swoole_table_row2array(table, row, row_array);
+    sw_add_assoc_zval_ex(batch->result, batch->keys[index].str, batch->keys[index].length + 1, row_array);
+}
+
+static void php_swoole_table_set_handler(swTable *table, swTableRow *row, int index, void *arg)
+{
+    php_swoole_table_batch *batch = arg;
+
+    php_swoole_table_array2row(table, row, batch->rows[index]);
+    swTableRow_set_ttl(table, row, batch->ttl);
+}
+
+/**
+ * the keys are the values of the array, they point to the strings of the array
+ */
+static swTable_key* php_swoole_table_keys(zval *array, int *n)
+{
+    HashTable *_ht = Z_ARRVAL_P(array);
+    swTable_key *keys = emalloc(sizeof(swTable_key) * (zend_hash_num_elements(_ht) + 1));
+    zval *v;
+    int i = 0;
+
+    SW_HASHTABLE_FOREACH_START(_ht, v)
+    {
+        convert_to_string(v);
+        keys[i].str = Z_STRVAL_P(v);
+        keys[i].length = Z_STRLEN_P(v);
+        i++;
+    }
+    SW_HASHTABLE_FOREACH_END();
+
+    *n = i;
+    return keys;
 }
 
 void swoole_table_init(int module_number TSRMLS_DC)
@@ -177,6 +287,15 @@ void swoole_table_init(int module_number TSRMLS_DC)
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_INT")-1, SW_TABLE_INT TSRMLS_CC);
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_STRING")-1, SW_TABLE_STRING TSRMLS_CC);
     zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("TYPE_FLOAT")-1, SW_TABLE_FLOAT TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("EVICT_LRU")-1, SW_TABLE_EVICT_LRU TSRMLS_CC);
+
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_EQ")-1, SW_TABLE_FIND_EQ TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_NEQ")-1, SW_TABLE_FIND_NEQ TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_GT")-1, SW_TABLE_FIND_GT TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LT")-1, SW_TABLE_FIND_LT TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LEFTLIKE")-1, SW_TABLE_FIND_LEFTLIKE TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_RIGHTLIKE")-1, SW_TABLE_FIND_RIGHTLIKE TSRMLS_CC);
+    zend_declare_class_constant_long(swoole_table_class_entry_ptr, SW_STRL("FIND_LIKE")-1, SW_TABLE_FIND_LIKE TSRMLS_CC);
 }
 
 void swoole_table_column_free(swTableColumn *col)
@@ -187,8 +306,10 @@ void swoole_table_column_free(swTableColumn *col)
 PHP_METHOD(swoole_table, __construct)
 {
     long table_size;
+    long max_size = 0;
+    long evict = SW_TABLE_EVICT_NONE;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &table_size) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l|ll", &table_size, &max_size, &evict) == FAILURE)
     {
         RETURN_FALSE;
     }
@@ -197,7 +318,12 @@ PHP_METHOD(swoole_table, __construct)
         RETURN_FALSE;
     }
 
-    swTable *table = swTable_new(table_size);
+    /**
+     * the table grows from table_size rows to max_size rows when it is filled
+     */
+    swTable *table = swTable_new(table_size, max_size);
+    //the table is a cache, the rows not used recently are evicted when it is full
+    table->evict = evict;
     swoole_set_object(getThis(), table);
 }
 
@@ -227,9 +353,25 @@ PHP_METHOD(swoole_table, column)
     RETURN_TRUE;
 }
 
+/**
+ * the table is backed by the mapfile and attached again after restart, destroy() must be called in the
+ * creating process after the other processes exit, otherwise the table is recovered from the rows.
+ */
 static PHP_METHOD(swoole_table, create)
 {
+    char *mapfile = NULL;
+    zend_size_t mapfile_len = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s", &mapfile, &mapfile_len) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
     swTable *table = swoole_get_object(getThis());
+    if (mapfile_len > 0)
+    {
+        SW_CHECK_RETURN(swTable_create_mmap(table, mapfile));
+    }
     swTable_create(table);
     RETURN_TRUE;
 }
@@ -246,8 +388,9 @@ static PHP_METHOD(swoole_table, set)
     zval *array;
     char *key;
     zend_size_t keylen;
+    long ttl = 0;
 
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sa", &key, &keylen, &array) == FAILURE)
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sa|l", &key, &keylen, &array, &ttl) == FAILURE)
     {
         RETURN_FALSE;
     }
@@ -260,42 +403,9 @@ static PHP_METHOD(swoole_table, set)
         RETURN_FALSE;
     }
 
-    swTableColumn *col;
-    zval *v;
-    char *k;
-    uint32_t klen;
-    int ktype;
-    HashTable *_ht = Z_ARRVAL_P(array);
-
-    sw_atomic_t *lock = &row->lock;
-    sw_spinlock(lock);
-
-    SW_HASHTABLE_FOREACH_START2(_ht, k, klen, ktype, v)
-    {
-        //printf("key=%s, klen=%d, ktype=%d\n", k, klen, ktype);
-        col = swTableColumn_get(table, k, klen);
-        if (k == NULL || col == NULL)
-        {
-            continue;
-        }
-        else if (col->type == SW_TABLE_STRING)
-        {
-            convert_to_string(v);
-            swTableRow_set_value(row, col, Z_STRVAL_P(v), Z_STRLEN_P(v));
-        }
-        else if (col->type == SW_TABLE_FLOAT)
-        {
-            convert_to_double(v);
-            swTableRow_set_value(row, col, &Z_DVAL_P(v), 0);
-        }
-        else
-        {
-            convert_to_long(v);
-            swTableRow_set_value(row, col, &Z_LVAL_P(v), 0);
-        }
-    }
-    SW_HASHTABLE_FOREACH_END();
-    sw_spinlock_release(lock);
+    php_swoole_table_array2row(table, row, array);
+    swTableRow_set_ttl(table, row, ttl);
+    swTableRow_unlock(row);
     RETURN_TRUE;
 }
 
@@ -305,7 +415,7 @@ static PHP_METHOD(swoole_table, incr)
     zend_size_t key_len;
     char *col;
     zend_size_t col_len;
-    zval* incrby = NULL;
+    zval *incrby = NULL;
 
     if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|z", &key, &key_len, &col, &col_len, &incrby) == FAILURE)
     {
@@ -313,18 +423,7 @@ static PHP_METHOD(swoole_table, incr)
     }
 
     swTable *table = swoole_get_object(getThis());
-    swTableRow *row = swTableRow_set(table, key, key_len);
-    if (!row)
-    {
-        php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
-        RETURN_FALSE;
-    }
-
-    swTableColumn *column;
-    sw_atomic_t *lock = &row->lock;
-    sw_spinlock(lock);
-
-    column = swTableColumn_get(table, col, col_len);
+    swTableColumn *column = swTableColumn_get(table, col, col_len);
     if (column == NULL)
     {
         swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", col);
@@ -337,37 +436,34 @@ static PHP_METHOD(swoole_table, incr)
     }
     else if (column->type == SW_TABLE_FLOAT)
     {
-        double set_value = 0;
-        memcpy(&set_value, row->data + column->index, sizeof(set_value));
+        double value, by = 1;
         if (incrby)
         {
             convert_to_double(incrby);
-            set_value += Z_DVAL_P(incrby);
+            by = Z_DVAL_P(incrby);
         }
-        else
+        if (swTableRow_incr_float(table, key, key_len, column, by, &value) < 0)
         {
-            set_value += 1;
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
+            RETURN_FALSE;
         }
-        swTableRow_set_value(row, column, &set_value, 0);
-        RETVAL_DOUBLE(set_value);
+        RETURN_DOUBLE(value);
     }
     else
     {
-        uint64_t set_value = 0;
-        memcpy(&set_value, row->data + column->index, column->size);
+        int64_t value, by = 1;
         if (incrby)
         {
             convert_to_long(incrby);
-            set_value += Z_LVAL_P(incrby);
+            by = Z_LVAL_P(incrby);
         }
-        else
+        if (swTableRow_incr(table, key, key_len, column, by, &value) < 0)
         {
-            set_value += 1;
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
+            RETURN_FALSE;
         }
-        swTableRow_set_value(row, column, &set_value, 0);
-        RETVAL_LONG(set_value);
+        RETURN_LONG(value);
     }
-    sw_spinlock_release(lock);
 }
 
 static PHP_METHOD(swoole_table, decr)
@@ -384,18 +480,7 @@ static PHP_METHOD(swoole_table, decr)
     }
 
     swTable *table = swoole_get_object(getThis());
-    swTableRow *row = swTableRow_set(table, key, key_len);
-    if (!row)
-    {
-        php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
-        RETURN_FALSE;
-    }
-
-    swTableColumn *column;
-    sw_atomic_t *lock = &row->lock;
-    sw_spinlock(lock);
-
-    column = swTableColumn_get(table, col, col_len);
+    swTableColumn *column = swTableColumn_get(table, col, col_len);
     if (column == NULL)
     {
         swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", col);
@@ -403,42 +488,82 @@ static PHP_METHOD(swoole_table, decr)
     }
     else if (column->type == SW_TABLE_STRING)
     {
-        swoole_php_fatal_error(E_WARNING, "cannot use incr with string column.");
+        swoole_php_fatal_error(E_WARNING, "cannot use decr with string column.");
         RETURN_FALSE;
     }
     else if (column->type == SW_TABLE_FLOAT)
     {
-        double set_value = 0;
-        memcpy(&set_value, row->data + column->index, sizeof(set_value));
+        double value, by = 1;
         if (decrby)
         {
             convert_to_double(decrby);
-            set_value -= Z_DVAL_P(decrby);
+            by = Z_DVAL_P(decrby);
         }
-        else
+        if (swTableRow_incr_float(table, key, key_len, column, -by, &value) < 0)
         {
-            set_value -= 1;
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
+            RETURN_FALSE;
         }
-        swTableRow_set_value(row, column, &set_value, 0);
-        RETVAL_DOUBLE(set_value);
+        RETURN_DOUBLE(value);
     }
     else
     {
-        uint64_t set_value = 0;
-        memcpy(&set_value, row->data + column->index, column->size);
+        int64_t value, by = 1;
         if (decrby)
         {
             convert_to_long(decrby);
-            set_value -= Z_LVAL_P(decrby);
+            by = Z_LVAL_P(decrby);
         }
-        else
+        if (swTableRow_incr(table, key, key_len, column, -by, &value) < 0)
         {
-            set_value -= 1;
+            php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
+            RETURN_FALSE;
         }
-        swTableRow_set_value(row, column, &set_value, 0);
-        RETVAL_LONG(set_value);
+        RETURN_LONG(value);
+    }
+}
+
+/**
+ * set the column to value if it is still expect, the row is not locked
+ */
+static PHP_METHOD(swoole_table, cas)
+{
+    char *key;
+    zend_size_t key_len;
+    char *col;
+    zend_size_t col_len;
+    zval *expect;
+    zval *value;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sszz", &key, &key_len, &col, &col_len, &expect, &value) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swTable *table = swoole_get_object(getThis());
+    swTableColumn *column = swTableColumn_get(table, col, col_len);
+    if (column == NULL)
+    {
+        swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", col);
+        RETURN_FALSE;
+    }
+    else if (column->type == SW_TABLE_STRING)
+    {
+        swoole_php_fatal_error(E_WARNING, "cannot use cas with string column.");
+        RETURN_FALSE;
+    }
+    else if (column->type == SW_TABLE_FLOAT)
+    {
+        convert_to_double(expect);
+        convert_to_double(value);
+        SW_CHECK_RETURN(swTableRow_cas_float(table, key, key_len, column, Z_DVAL_P(expect), Z_DVAL_P(value)));
+    }
+    else
+    {
+        convert_to_long(expect);
+        convert_to_long(value);
+        SW_CHECK_RETURN(swTableRow_cas(table, key, key_len, column, Z_LVAL_P(expect), Z_LVAL_P(value)));
     }
-    sw_spinlock_release(lock);
 }
 
 static PHP_METHOD(swoole_table, get)
@@ -457,6 +582,7 @@ static PHP_METHOD(swoole_table, get)
         RETURN_FALSE;
     }
     php_swoole_table_row2array(table, row, return_value);
+    swTableRow_unlock(row);
 }
 
 static PHP_METHOD(swoole_table, exist)
@@ -476,10 +602,100 @@ static PHP_METHOD(swoole_table, exist)
     }
     else
     {
+        swTableRow_unlock(row);
         RETURN_TRUE;
     }
 }
 
+static PHP_METHOD(swoole_table, getMulti)
+{
+    zval *zkeys;
+    php_swoole_table_batch batch;
+    int n;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a", &zkeys) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swTable *table = swoole_get_object(getThis());
+    batch.keys = php_swoole_table_keys(zkeys, &n);
+    batch.result = return_value;
+    array_init(return_value);
+
+    swTableRow_get_multi(table, batch.keys, n, php_swoole_table_get_handler, &batch);
+    efree(batch.keys);
+}
+
+/**
+ * $rows: key => row, return false when some rows are not written
+ */
+static PHP_METHOD(swoole_table, setMulti)
+{
+    zval *zrows;
+    zval *v;
+    char *k;
+    uint32_t klen;
+    int ktype;
+    long ttl = 0;
+    php_swoole_table_batch batch;
+    int n = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|l", &zrows, &ttl) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swTable *table = swoole_get_object(getThis());
+    HashTable *_ht = Z_ARRVAL_P(zrows);
+    int num = zend_hash_num_elements(_ht) + 1;
+
+    batch.keys = emalloc(sizeof(swTable_key) * num);
+    batch.rows = emalloc(sizeof(zval *) * num);
+    batch.ttl = ttl;
+
+    SW_HASHTABLE_FOREACH_START2(_ht, k, klen, ktype, v)
+    {
+        if (k == NULL || Z_TYPE_P(v) != IS_ARRAY)
+        {
+            continue;
+        }
+        batch.keys[n].str = k;
+        batch.keys[n].length = klen;
+        batch.rows[n] = v;
+        n++;
+    }
+    SW_HASHTABLE_FOREACH_END();
+
+    int count = swTableRow_set_multi(table, batch.keys, n, php_swoole_table_set_handler, &batch);
+    efree(batch.keys);
+    efree(batch.rows);
+    if (count != n)
+    {
+        php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to allocate memory.");
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+
+static PHP_METHOD(swoole_table, delMulti)
+{
+    zval *zkeys;
+    swTable_key *keys;
+    int n;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a", &zkeys) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+
+    swTable *table = swoole_get_object(getThis());
+    keys = php_swoole_table_keys(zkeys, &n);
+    n = swTableRow_del_multi(table, keys, n);
+    efree(keys);
+    RETURN_LONG(n);
+}
+
 static PHP_METHOD(swoole_table, del)
 {
     char *key;
@@ -530,6 +746,154 @@ static PHP_METHOD(swoole_table, count)
     }
 }
 
+/**
+ * $table->find(array(array('age', swoole_table::FIND_GT, 18), array('name', swoole_table::FIND_LEFTLIKE, 'li')), array('name'), 10);
+ * return crc32 => row, the same as the key() of the iterator. An empty $columns returns the list of crc32.
+ */
+static PHP_METHOD(swoole_table, find)
+{
+    zval *zconds;
+    zval *zcolumns = NULL;
+    long limit = 0;
+    long offset = 0;
+
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|zll", &zconds, &zcolumns, &limit, &offset) == FAILURE)
+    {
+        RETURN_FALSE;
+    }
+    if (limit < 0 || offset < 0)
+    {
+        swoole_php_fatal_error(E_WARNING, "limit and offset must be positive.");
+        RETURN_FALSE;
+    }
+
+    swTable *table = swoole_get_object(getThis());
+    int cond_n = zend_hash_num_elements(Z_ARRVAL_P(zconds));
+    swTable_condition *conds = ecalloc(cond_n + 1, sizeof(swTable_condition));
+    swTableColumn **columns = NULL;
+    swTableRow *rows = NULL, *row;
+    zval *zcond, *v, *args[3];
+    int i, j, n, column_n = -1;
+
+    i = 0;
+    SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(zconds), zcond)
+    {
+        if (Z_TYPE_P(zcond) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(zcond)) != 3)
+        {
+            swoole_php_fatal_error(E_WARNING, "condition must be array(column, operator, value).");
+            goto _error;
+        }
+        j = 0;
+        SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(zcond), v)
+        {
+            args[j++] = v;
+        }
+        SW_HASHTABLE_FOREACH_END();
+
+        convert_to_string(args[0]);
+        conds[i].column = swTableColumn_get(table, Z_STRVAL_P(args[0]), Z_STRLEN_P(args[0]));
+        if (conds[i].column == NULL)
+        {
+            swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", Z_STRVAL_P(args[0]));
+            goto _error;
+        }
+        convert_to_long(args[1]);
+        conds[i].op = Z_LVAL_P(args[1]);
+
+        if (conds[i].column->type == SW_TABLE_STRING)
+        {
+            convert_to_string(args[2]);
+            conds[i].str = Z_STRVAL_P(args[2]);
+            conds[i].str_len = Z_STRLEN_P(args[2]);
+        }
+        else if (conds[i].column->type == SW_TABLE_FLOAT)
+        {
+            convert_to_double(args[2]);
+            conds[i].dval = Z_DVAL_P(args[2]);
+        }
+        else
+        {
+            convert_to_long(args[2]);
+            conds[i].lval = Z_LVAL_P(args[2]);
+        }
+        i++;
+    }
+    SW_HASHTABLE_FOREACH_END();
+
+    //projection
+    if (zcolumns && Z_TYPE_P(zcolumns) == IS_ARRAY)
+    {
+        columns = ecalloc(zend_hash_num_elements(Z_ARRVAL_P(zcolumns)) + 1, sizeof(swTableColumn *));
+        column_n = 0;
+        SW_HASHTABLE_FOREACH_START(Z_ARRVAL_P(zcolumns), v)
+        {
+            convert_to_string(v);
+            columns[column_n] = swTableColumn_get(table, Z_STRVAL_P(v), Z_STRLEN_P(v));
+            if (columns[column_n] == NULL)
+            {
+                swoole_php_fatal_error(E_WARNING, "column[%s] not exist.", Z_STRVAL_P(v));
+                goto _error;
+            }
+            column_n++;
+        }
+        SW_HASHTABLE_FOREACH_END();
+    }
+
+    n = swTable_find(table, conds, cond_n, offset, limit, &rows);
+    if (n < 0)
+    {
+        goto _error;
+    }
+
+    array_init(return_value);
+    //the rows are copies, they are read without the lock
+    for (i = 0; i < n; i++)
+    {
+        row = swTable_find_row(table, rows, i);
+        if (column_n == 0)
+        {
+            add_next_index_long(return_value, row->crc32);
+        }
+        else if (column_n < 0)
+        {
+            zval *row_array;
+            SW_MAKE_STD_ZVAL(row_array);
+            php_swoole_table_row2array(table, row, row_array);
+            add_index_zval(return_value, row->crc32, row_array);
+        }
+        else
+        {
+            zval *row_array;
+            SW_MAKE_STD_ZVAL(row_array);
+            array_init(row_array);
+            for (j = 0; j < column_n; j++)
+            {
+                php_swoole_table_add_column(row, columns[j], row_array);
+            }
+            add_index_zval(return_value, row->crc32, row_array);
+        }
+    }
+
+    if (rows)
+    {
+        sw_free(rows);
+    }
+    if (columns)
+    {
+        efree(columns);
+    }
+    efree(conds);
+    return;
+
+    _error:
+    if (columns)
+    {
+        efree(columns);
+    }
+    efree(conds);
+    RETURN_FALSE;
+}
+
 #ifdef HAVE_PCRE
 
 static PHP_METHOD(swoole_table, rewind)
@@ -542,7 +906,9 @@ static PHP_METHOD(swoole_table, current)
 {
     swTable *table = swoole_get_object(getThis());
     swTableRow *row = swTable_iterator_current(table);
+    swTableRow_lock(row);
     php_swoole_table_row2array(table, row, return_value);
+    swTableRow_unlock(row);
 }
 
 static PHP_METHOD(swoole_table, key)
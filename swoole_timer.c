@@ -20,7 +20,7 @@
 
 enum swoole_timer_type
 {
-    SW_TIMER_TICK, SW_TIMER_AFTER, SW_TIMER_INTERVAL,
+    SW_TIMER_TICK, SW_TIMER_AFTER, SW_TIMER_INTERVAL, SW_TIMER_INTERNAL,
 };
 
 typedef struct _swTimer_callback
@@ -33,6 +33,8 @@ typedef struct _swTimer_callback
 #endif
     int interval;
     int type;
+    php_swoole_timer_handler handler;
+    void *object;
 } swTimer_callback;
 
 static void php_swoole_onTimeout(swTimer *timer, swTimer_node *event);
@@ -102,6 +104,38 @@ static long php_swoole_add_timer(int ms, zval *callback, zval *param, int is_tic
     return SwooleG.timer.add(&SwooleG.timer, ms, is_tick, cb);
 }
 
+/**
+ * timer for the extension itself, the handler is a C function.
+ */
+long php_swoole_add_timer_internal(int ms, php_swoole_timer_handler handler, void *object, int is_tick)
+{
+    swTimer_callback *cb = emalloc(sizeof(swTimer_callback));
+    bzero(cb, sizeof(swTimer_callback));
+
+    cb->type = SW_TIMER_INTERNAL;
+    cb->interval = ms;
+    cb->handler = handler;
+    cb->object = object;
+
+    php_swoole_check_reactor();
+    php_swoole_check_timer(ms);
+
+    long timer_id = SwooleG.timer.add(&SwooleG.timer, ms, is_tick, cb);
+    if (timer_id < 0)
+    {
+        efree(cb);
+    }
+    return timer_id;
+}
+
+int php_swoole_del_timer_internal(long id)
+{
+#if PHP_MAJOR_VERSION < 7
+    TSRMLS_FETCH_FROM_CTX(sw_thread_ctx ? sw_thread_ctx : NULL);
+#endif
+    return php_swoole_del_timer(id TSRMLS_CC);
+}
+
 static int php_swoole_del_timer(long id TSRMLS_DC)
 {
     swTimer_callback *cb = SwooleG.timer.del(&SwooleG.timer, -1, id);
@@ -132,6 +166,13 @@ static void php_swoole_onTimeout(swTimer *timer, swTimer_node *event)
     zval **args[1];
     int argc = 0;
 
+    if (cb->type == SW_TIMER_INTERNAL)
+    {
+        cb->handler(cb->object);
+        efree(cb);
+        return;
+    }
+
     if (cb->data)
     {
         args[0] = &cb->data;
@@ -188,6 +229,12 @@ static void php_swoole_onTimerInterval(swTimer *timer, swTimer_node *event)
         return;
     }
 
+    if (cb->type == SW_TIMER_INTERNAL)
+    {
+        cb->handler(cb->object);
+        return;
+    }
+
     if (cb->type == SW_TIMER_TICK)
     {
         SW_MAKE_STD_ZVAL(ztimer_id);
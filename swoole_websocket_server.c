@@ -45,6 +45,16 @@ static int websocket_handshake(swoole_http_client *client);
 static void sha1(const char *str, int _len, unsigned char *digest);
 static zval* websocket_callbacks[2];
 
+#ifdef SW_HAVE_ZLIB
+static void websocket_handshake_deflate(swoole_http_client *client, HashTable *ht);
+static int websocket_deflate(swConnection *conn, char *data, size_t length);
+/**
+ * the deflate streams of the worker by the window bits, they are reset for each message
+ */
+static z_stream *websocket_deflate_streams[16];
+static swString *websocket_deflate_buffer;
+#endif
+
 static PHP_METHOD(swoole_websocket_server, on);
 static PHP_METHOD(swoole_websocket_server, push);
 static PHP_METHOD(swoole_websocket_server, exist);
@@ -194,6 +204,12 @@ static int websocket_handshake(swoole_http_client *client)
 
     swString_append_ptr(swoole_http_buffer, _buf, n);
     swString_append_ptr(swoole_http_buffer, ZEND_STRL("Sec-WebSocket-Version: "SW_WEBSOCKET_VERSION"\r\n"));
+#ifdef SW_HAVE_ZLIB
+    if (SwooleG.serv->websocket_compression)
+    {
+        websocket_handshake_deflate(client, ht);
+    }
+#endif
     swString_append_ptr(swoole_http_buffer, ZEND_STRL("Server: "SW_WEBSOCKET_SERVER_SOFTWARE"\r\n\r\n"));
 
     swTrace("websocket header len:%ld\n%s \n", swoole_http_buffer->length, swoole_http_buffer->str);
@@ -201,6 +217,100 @@ static int websocket_handshake(swoole_http_client *client)
     return swServer_tcp_send(SwooleG.serv, client->fd, swoole_http_buffer->str, swoole_http_buffer->length);
 }
 
+#ifdef SW_HAVE_ZLIB
+/**
+ * the reactor thread inflates the messages by the parameters saved in the connection
+ */
+static void websocket_handshake_deflate(swoole_http_client *client, HashTable *ht)
+{
+    swServer *serv = SwooleG.serv;
+    swWebSocket_deflate_param offer;
+    swWebSocket_deflate_param setting;
+    zval *pData;
+    char buf[256];
+    int n;
+
+    if (sw_zend_hash_find(ht, ZEND_STRS("sec-websocket-extensions"), (void **) &pData) == FAILURE || Z_TYPE_P(pData) != IS_STRING)
+    {
+        return;
+    }
+    if (swWebSocket_parse_deflate_offer(Z_STRVAL_P(pData), Z_STRLEN_P(pData), &offer) < 0)
+    {
+        return;
+    }
+
+    bzero(&setting, sizeof(setting));
+    setting.client_no_context_takeover = serv->websocket_client_no_context_takeover;
+    setting.client_max_window_bits = serv->websocket_client_max_window_bits;
+    setting.server_max_window_bits = serv->websocket_server_max_window_bits;
+    n = swWebSocket_accept_deflate_offer(&offer, &setting, buf, sizeof(buf));
+    if (n < 0)
+    {
+        return;
+    }
+
+    swConnection *conn = swWorker_get_connection(serv, client->fd);
+    if (!conn)
+    {
+        return;
+    }
+    conn->websocket_compression = SW_WEBSOCKET_DEFLATE;
+    if (offer.client_no_context_takeover)
+    {
+        conn->websocket_compression |= SW_WEBSOCKET_CLIENT_NO_CONTEXT_TAKEOVER;
+    }
+    conn->websocket_client_window_bits = offer.client_max_window_bits;
+    conn->websocket_server_window_bits = offer.server_max_window_bits;
+    swString_append_ptr(swoole_http_buffer, buf, n);
+}
+
+/**
+ * compress the message into websocket_deflate_buffer, SW_ERR if it is not smaller
+ */
+static int websocket_deflate(swConnection *conn, char *data, size_t length)
+{
+    int window_bits = conn->websocket_server_window_bits ? conn->websocket_server_window_bits : 15;
+    z_stream *stream = websocket_deflate_streams[window_bits];
+
+    if (stream == NULL)
+    {
+        stream = sw_malloc(sizeof(z_stream));
+        if (stream == NULL)
+        {
+            return SW_ERR;
+        }
+        bzero(stream, sizeof(z_stream));
+        //raw deflate
+        if (deflateInit2(stream, SwooleG.serv->websocket_compression_level, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            swWarn("deflateInit2() failed.");
+            sw_free(stream);
+            return SW_ERR;
+        }
+        websocket_deflate_streams[window_bits] = stream;
+    }
+    else
+    {
+        deflateReset(stream);
+    }
+
+    if (websocket_deflate_buffer == NULL)
+    {
+        websocket_deflate_buffer = swString_new(SW_BUFFER_SIZE_BIG);
+        if (websocket_deflate_buffer == NULL)
+        {
+            return SW_ERR;
+        }
+    }
+    swString_clear(websocket_deflate_buffer);
+    if (swWebSocket_deflate(stream, data, length, websocket_deflate_buffer) < 0)
+    {
+        return SW_ERR;
+    }
+    return websocket_deflate_buffer->length < length ? SW_OK : SW_ERR;
+}
+#endif
+
 int swoole_websocket_onMessage(swEventData *req)
 {
 #if PHP_MAJOR_VERSION < 7
@@ -212,9 +322,10 @@ int swoole_websocket_onMessage(swEventData *req)
     SW_MAKE_STD_ZVAL(zdata);
     zdata = php_swoole_get_recv_data(zdata, req TSRMLS_CC);
 
+    //the reactor thread dispatches the complete text and binary messages
     char *buf = Z_STRVAL_P(zdata);
     long finish = buf[0] ? 1 : 0;
-    long opcode = buf[1] ? 1 : 0;
+    long opcode = buf[1];
 
     zval *zframe;
     SW_MAKE_STD_ZVAL(zframe);
@@ -395,7 +506,20 @@ static PHP_METHOD(swoole_websocket_server, push)
         RETURN_FALSE;
     }
     swString_clear(swoole_http_buffer);
-    swWebSocket_encode(swoole_http_buffer, data, length, opcode, (int) fin, 0);
+#ifdef SW_HAVE_ZLIB
+    //the fragments and the control frames are not compressed
+    if ((conn->websocket_compression & SW_WEBSOCKET_DEFLATE) && fin && length >= SwooleG.serv->websocket_compression_threshold
+            && (opcode == WEBSOCKET_OPCODE_TEXT_FRAME || opcode == WEBSOCKET_OPCODE_BINARY_FRAME)
+            && websocket_deflate(conn, data, length) == SW_OK)
+    {
+        swWebSocket_encode(swoole_http_buffer, websocket_deflate_buffer->str, websocket_deflate_buffer->length, opcode, 1, 0);
+        swoole_http_buffer->str[0] |= SW_WEBSOCKET_RSV1;
+    }
+    else
+#endif
+    {
+        swWebSocket_encode(swoole_http_buffer, data, length, opcode, (int) fin, 0);
+    }
     SW_CHECK_RETURN(swServer_tcp_send(SwooleG.serv, fd, swoole_http_buffer->str, swoole_http_buffer->length));
 }
 
@@ -88,3 +88,142 @@ swUnitTest(client_test)
 
 	return 0;
 }
+
+/**
+ * borrow/return, idle timeout, max lifetime and the liveness probe of the client pool
+ */
+#define CLIENT_POOL_TEST_PORT   9510
+
+static int client_pool_test_listen_fd;
+
+static void client_pool_test_free(swClient *cli)
+{
+    sw_free(cli->socket);
+    sw_free(cli);
+}
+
+static swClient* client_pool_test_connect(swClientPool *pool, int *peer_fd)
+{
+    swClient *cli = sw_malloc(sizeof(swClient));
+    if (cli == NULL)
+    {
+        return NULL;
+    }
+    if (swClient_create(cli, SW_SOCK_TCP, SW_SOCK_SYNC) < 0)
+    {
+        sw_free(cli);
+        return NULL;
+    }
+    if (cli->connect(cli, "127.0.0.1", CLIENT_POOL_TEST_PORT, 0.5, 0) < 0)
+    {
+        cli->close(cli);
+        client_pool_test_free(cli);
+        return NULL;
+    }
+    *peer_fd = accept(client_pool_test_listen_fd, NULL, NULL);
+    swClientPool_add(pool, cli);
+    return cli;
+}
+
+swUnitTest(client_pool_test1)
+{
+    swClientPool *pool;
+    swClient *cli, *cli2;
+    int peer_fd, peer_fd2;
+    int ret = 0;
+
+    client_pool_test_listen_fd = swSocket_listen(SW_SOCK_TCP, "127.0.0.1", CLIENT_POOL_TEST_PORT, 128);
+    if (client_pool_test_listen_fd < 0)
+    {
+        return 1;
+    }
+    pool = swClientPool_new(SW_STRL("127.0.0.1:9510") - 1, 0, 2);
+    if (pool == NULL)
+    {
+        return 2;
+    }
+    pool->onFree = client_pool_test_free;
+
+    //borrow from an empty pool, connect and give it back
+    if (swClientPool_get(pool) != NULL)
+    {
+        ret = 3;
+        goto _free;
+    }
+    cli = client_pool_test_connect(pool, &peer_fd);
+    if (cli == NULL || pool->num != 1 || pool->create_count != 1)
+    {
+        ret = 4;
+        goto _free;
+    }
+    if (swClientPool_release(pool, cli) < 0 || pool->idle_list->num != 1)
+    {
+        ret = 5;
+        goto _free;
+    }
+    //the same connection again, the stale data sent by the peer is dropped
+    if (write(peer_fd, SW_STRL("stale") - 1) != 5 || swClientPool_get(pool) != cli || pool->reuse_count != 1)
+    {
+        ret = 6;
+        goto _free;
+    }
+    cli2 = client_pool_test_connect(pool, &peer_fd2);
+    if (cli2 == NULL || !swClientPool_full(pool))
+    {
+        ret = 7;
+        goto _free;
+    }
+    swClientPool_release(pool, cli);
+    swClientPool_release(pool, cli2);
+
+    //the peer closed the first connection, the probe finds it
+    close(peer_fd);
+    usleep(10000);
+    if (swClientPool_check(pool) != 1 || pool->probe_fail_count != 1 || pool->num != 1)
+    {
+        ret = 8;
+        goto _free;
+    }
+
+    //idle timeout, min_size connections are kept
+    cli2->last_time -= pool->idle_timeout + 1;
+    pool->min_size = 1;
+    if (swClientPool_check(pool) != 0 || pool->num != 1)
+    {
+        ret = 9;
+        goto _free;
+    }
+    pool->min_size = 0;
+    if (swClientPool_get(pool) != NULL || pool->num != 0 || pool->close_count != 2)
+    {
+        ret = 10;
+        goto _free;
+    }
+    close(peer_fd2);
+
+    //max lifetime, expired even if it is in use
+    cli = client_pool_test_connect(pool, &peer_fd);
+    if (cli == NULL)
+    {
+        ret = 11;
+        goto _free;
+    }
+    pool->max_lifetime = 10;
+    cli->create_time -= pool->max_lifetime;
+    if (swClientPool_release(pool, cli) != SW_ERR || pool->num != 0 || pool->idle_list->num != 0)
+    {
+        ret = 12;
+        goto _free;
+    }
+    close(peer_fd);
+
+    _free:
+    if (ret > 0)
+    {
+        printf("num=%d, idle=%d, create=%ld, reuse=%ld, close=%ld, probe_fail=%ld\n", pool->num, pool->idle_list->num,
+                (long) pool->create_count, (long) pool->reuse_count, (long) pool->close_count, (long) pool->probe_fail_count);
+    }
+    swClientPool_free(pool);
+    close(client_pool_test_listen_fd);
+    return ret;
+}
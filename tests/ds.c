@@ -103,12 +103,13 @@ swUnitTest(chan_test)
 //			double t1 = microtime();
 			while (1)
 			{
-				swChannel_wait(chan);
-				ret = swChannel_pop(chan, item, BUFSIZE);
-				if (ret < 0)
-					continue;
-				recvn++;
-				printf("Worke[%d] recv[%d]=%s\n", i, recvn, item);
+				swChannel_wait(chan, -1);
+				//only the first push after wait notifies, pop all of the data
+				while (swChannel_pop(chan, item, BUFSIZE) > 0)
+				{
+					recvn++;
+					printf("Worke[%d] recv[%d]=%s\n", i, recvn, item);
+				}
 			}
 			printf("Worker[%d] Finish: recv=%d\n", i, recvn);
 			exit(0);
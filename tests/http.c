@@ -13,11 +13,13 @@
   | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
   +----------------------------------------------------------------------+
 */
-#if 0
 #include "swoole.h"
+#include "Server.h"
 #include "tests.h"
 #include "Http.h"
 
+#if 0
+
 static int http_get_path(http_parser *, const char *at, size_t length);
 
 static int http_get_path(http_parser *parser, const char *at, size_t length)
@@ -81,4 +83,480 @@ swUnitTest(http_test2)
     swString_free(content);
     return 0;
 }
-#endif
\ No newline at end of file
+#endif
+
+static char http_test_request[] = "POST /api/user.php?id=100&name=swoole HTTP/1.1\r\n"
+        "Host: 127.0.0.1:9501\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/45.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, sdch\r\n"
+        "Accept-Language: zh-CN,zh;q=0.8,en;q=0.6\r\n"
+        "Cookie: PHPSESSID=7f8d8e6b2c1a4d5e; uid=100\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length:   12  \r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "sn=123&n=asa";
+
+#define HTTP_TEST_N   1000000
+
+/**
+ * the head is received in pieces, and parsed into the index in one pass
+ */
+swUnitTest(http_test3)
+{
+    swHttpRequest request;
+    swHttpIndex index;
+    int i, ret = SW_WAIT;
+    uint32_t n = sizeof(http_test_request) - 1, length;
+
+    bzero(&request, sizeof(request));
+    request.buffer = swString_new(SW_HTTP_HEADER_MAX_SIZE);
+    for (i = 0; i < n && ret == SW_WAIT; i += 7)
+    {
+        swString_append_ptr(request.buffer, http_test_request + i, i + 7 > n ? n - i : 7);
+        ret = swHttpRequest_parse(&request);
+    }
+    if (ret != SW_OK || request.method != HTTP_POST || request.content_length != 12
+            || request.header_length + 12 != n)
+    {
+        return 1;
+    }
+    //the rest of the body
+    swString_append_ptr(request.buffer, http_test_request + i, n - i);
+    swHttpRequest_append_index(&request);
+
+    length = request.buffer->length;
+    if (swHttpIndex_get(request.buffer->str, &length, &index) < 0 || length != n)
+    {
+        return 2;
+    }
+    char *data = request.buffer->str;
+    if (index.header_num != 9 || index.version != 11 || index.path_length != sizeof("/api/user.php") - 1
+            || memcmp(data + index.uri, "/api/user.php?id=100&name=swoole", index.uri_length) != 0
+            || memcmp(data + index.headers[7].value, "12", index.headers[7].value_length) != 0
+            || memcmp(data + index.body, "sn=123&n=asa", index.content_length) != 0)
+    {
+        return 3;
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < HTTP_TEST_N; i++)
+    {
+        request.state = request.line = request.scan = request.header_length = 0;
+        request.method = 0;
+        bzero(&request.index, sizeof(request.index) - sizeof(request.index.headers));
+        request.buffer->length = n;
+        swHttpRequest_parse(&request);
+    }
+    gettimeofday(&end, NULL);
+    printf("parse %d bytes head: %.1fns\n", request.header_length,
+            ((end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec)) * 1000 / HTTP_TEST_N);
+
+    swString_free(request.buffer);
+    return 0;
+}
+
+/**
+ * upload to a process mode server, the peak memory of the master is compared with and without http_body_stream
+ */
+#define HTTP_TEST_PORT         9508
+#define HTTP_TEST_UPLOAD_SIZE  (32 * 1024 * 1024)
+
+typedef struct
+{
+    uint32_t head_flags;
+    uint32_t content_length;
+    uint32_t received;
+    uint32_t body_events;
+    uint32_t error;
+    sw_atomic_t done;
+} http_test_stats;
+
+static http_test_stats *http_stats;
+
+static int http_test_onReceive(swServer *serv, swEventData *req)
+{
+    swString *buffer;
+    swHttpIndex index;
+    uint32_t length, i;
+
+    switch (req->info.type)
+    {
+    //the head, or the whole request without http_body_stream
+    case SW_EVENT_PACKAGE_END:
+        buffer = swWorker_get_buffer(serv, req->info.from_id);
+        length = buffer->length;
+        if (swHttpIndex_get(buffer->str, &length, &index) < 0)
+        {
+            http_stats->error = 1;
+            break;
+        }
+        http_stats->head_flags = index.flags;
+        http_stats->content_length = index.content_length;
+        if (!(index.flags & SW_HTTP_INDEX_STREAM))
+        {
+            http_stats->received = length - index.body;
+            http_stats->done = 1;
+        }
+        break;
+    case SW_EVENT_HTTP_BODY:
+    case SW_EVENT_HTTP_BODY_END:
+        for (i = 0; i < req->info.len; i++)
+        {
+            if ((uint8_t) req->data[i] != (uint8_t) ((http_stats->received + i) % 251))
+            {
+                http_stats->error = 1;
+                break;
+            }
+        }
+        http_stats->received += req->info.len;
+        http_stats->body_events++;
+        if (req->info.type == SW_EVENT_HTTP_BODY_END)
+        {
+            http_stats->done = 1;
+        }
+        break;
+    default:
+        break;
+    }
+    return SW_OK;
+}
+
+static void http_test_server(int stream)
+{
+    swServer serv;
+
+    swServer_init(&serv);
+    serv.reactor_num = 1;
+    serv.worker_num = 1;
+    serv.factory_mode = SW_MODE_PROCESS;
+    serv.open_http_protocol = 1;
+    serv.http_body_stream = stream;
+    serv.protocol.package_max_length = HTTP_TEST_UPLOAD_SIZE + 1024 * 1024;
+    SwooleG.socket_buffer_size = 8 * 1024 * 1024;
+
+    if (swServer_add_listener(&serv, SW_SOCK_TCP, "127.0.0.1", HTTP_TEST_PORT) < 0 || swServer_create(&serv) < 0)
+    {
+        exit(1);
+    }
+    serv.onReceive = http_test_onReceive;
+    swServer_start(&serv);
+    exit(0);
+}
+
+static long http_test_peak_memory(pid_t pid)
+{
+    char path[64], line[256];
+    long kb = -1;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, "VmHWM:", 6) == 0)
+        {
+            kb = atol(line + 6);
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+static int http_test_upload(int stream)
+{
+    char head[256], body[65536];
+    struct sockaddr_in addr;
+    uint32_t sent = 0, n, i;
+    int sock, status, ret = SW_OK;
+    long idle, peak;
+    pid_t server_pid;
+
+    bzero(http_stats, sizeof(http_test_stats));
+    fflush(stdout);
+    server_pid = fork();
+    if (server_pid < 0)
+    {
+        return SW_ERR;
+    }
+    else if (server_pid == 0)
+    {
+        http_test_server(stream);
+    }
+    usleep(500000);
+    idle = http_test_peak_memory(server_pid);
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(HTTP_TEST_PORT);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        ret = SW_ERR;
+        goto _kill;
+    }
+
+    n = snprintf(head, sizeof(head), "POST /upload HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+            "Content-Type: application/octet-stream\r\nContent-Length: %d\r\n\r\n", HTTP_TEST_UPLOAD_SIZE);
+    if (swSocket_write_blocking(sock, head, n) < 0)
+    {
+        ret = SW_ERR;
+        goto _kill;
+    }
+    while (sent < HTTP_TEST_UPLOAD_SIZE)
+    {
+        n = HTTP_TEST_UPLOAD_SIZE - sent > sizeof(body) ? sizeof(body) : HTTP_TEST_UPLOAD_SIZE - sent;
+        for (i = 0; i < n; i++)
+        {
+            body[i] = (sent + i) % 251;
+        }
+        if (swSocket_write_blocking(sock, body, n) < 0)
+        {
+            ret = SW_ERR;
+            goto _kill;
+        }
+        sent += n;
+    }
+    for (i = 0; i < 500 && !http_stats->done; i++)
+    {
+        usleep(10000);
+    }
+    peak = http_test_peak_memory(server_pid);
+    printf("http_body_stream=%d: %u bytes received in %u body events, master peak memory %ldKB, %ldKB before the upload\n",
+            stream, http_stats->received, http_stats->body_events, peak, idle);
+
+    if (!http_stats->done || http_stats->error || http_stats->received != HTTP_TEST_UPLOAD_SIZE
+            || http_stats->content_length != HTTP_TEST_UPLOAD_SIZE
+            || !(http_stats->head_flags & SW_HTTP_INDEX_STREAM) != !stream)
+    {
+        ret = SW_ERR;
+    }
+
+    _kill:
+    close(sock);
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, &status, 0);
+    return ret;
+}
+
+swUnitTest(http_test4)
+{
+    http_stats = sw_shm_calloc(1, sizeof(http_test_stats));
+    if (http_stats == NULL)
+    {
+        return 1;
+    }
+    if (http_test_upload(0) < 0)
+    {
+        return 2;
+    }
+    if (http_test_upload(1) < 0)
+    {
+        return 3;
+    }
+    sw_shm_free(http_stats);
+    return 0;
+}
+
+/**
+ * the status and Date lines of Http.c must match the lines formatted with snprintf and strftime,
+ * the head built from them by swoole_http_server is checked by tests/swoole_http_server/header.phpt
+ */
+swUnitTest(http_test5)
+{
+    char buf[128];
+    char date[64];
+    char *line;
+    uint32_t length;
+    struct tm tm;
+    time_t now = time(NULL);
+    int i, code, n;
+
+    for (code = SW_HTTP_STATUS_MIN - 1; code <= SW_HTTP_STATUS_MAX; code++)
+    {
+        //the unknown codes are sent as 200
+        n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\n", swHttp_get_status_message(
+                code < SW_HTTP_STATUS_MIN || code >= SW_HTTP_STATUS_MAX ? 200 : code));
+        //the second call returns the cached line
+        for (i = 0; i < 2; i++)
+        {
+            line = swHttp_get_status_line(code, &length);
+            if (line == NULL || length != n || memcmp(line, buf, n) != 0)
+            {
+                printf("code=%d: %.*s", code, n, buf);
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < 10; i++)
+    {
+        now += i * 86400 * 40 + i;
+        gmtime_r(&now, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        n = snprintf(buf, sizeof(buf), "Date: %s\r\n", date);
+        line = swHttp_get_date(now, &length);
+        if (length != n || memcmp(line, buf, n) != 0)
+        {
+            printf("%.*s%.*s", n, buf, (int) length, line);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Range parsing, If-None-Match matching, and the ranges sent by sendfile over a socketpair
+ */
+#define HTTP_TEST_FILE_SIZE   10000
+
+typedef struct
+{
+    char *range;
+    int n;
+    off_t offset[2];
+    off_t length[2];
+} http_test_range;
+
+static http_test_range http_test_ranges[] = {
+    { "bytes=0-499", 1, { 0 }, { 500 } },
+    { "bytes=500-", 1, { 500 }, { 9500 } },
+    { "bytes=-500", 1, { 9500 }, { 500 } },
+    { "bytes=9999-20000", 1, { 9999 }, { 1 } },
+    { "bytes=-20000", 1, { 0 }, { 10000 } },
+    { "bytes=0-0,-1", 2, { 0, 9999 }, { 1, 1 } },
+    { "bytes= 100-199 , 10000-, 300-399", 2, { 100, 300 }, { 100, 100 } },
+    { "bytes=10000-", -1 },
+    { "bytes=-0", -1 },
+    { "bytes=5-2", 0 },
+    { "items=0-1", 0 },
+    { "bytes=0-1,x", 0 },
+    { "bytes=", 0 },
+    { "bytes=0-,0-", 0 },
+    { "bytes=99999999999999999999-", 0 },
+};
+
+typedef struct
+{
+    char *value;
+    char *etag;
+    int match;
+} http_test_etag;
+
+static http_test_etag http_test_etags[] = {
+    { "\"5a1b-2710\"", "\"5a1b-2710\"", 1 },
+    { "W/\"5a1b-2710\"", "\"5a1b-2710\"", 1 },
+    { "\"x\", \"5a1b-2710\"", "W/\"5a1b-2710\"", 1 },
+    { "*", "\"5a1b-2710\"", 1 },
+    { "\"5a1b-2711\"", "\"5a1b-2710\"", 0 },
+    { "\"5a1b-2710", "\"5a1b-2710\"", 0 },
+    { "", "\"5a1b-2710\"", 0 },
+};
+
+static int http_test_sendfile(char *file, char *content, swHttpRange *ranges, int n)
+{
+    int sock[2];
+    int i, ret = SW_OK;
+    ssize_t recv_n;
+    swConnection conn;
+    char buf[HTTP_TEST_FILE_SIZE];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0)
+    {
+        return SW_ERR;
+    }
+    bzero(&conn, sizeof(conn));
+    conn.fd = sock[0];
+
+    for (i = 0; i < n; i++)
+    {
+        if (swConnection_sendfile(&conn, file, ranges[i].offset, ranges[i].length) < 0)
+        {
+            ret = SW_ERR;
+            goto _close;
+        }
+    }
+    //the socket buffer is larger than the file, each range is sent in one call
+    while (!swBuffer_empty(conn.out_buffer))
+    {
+        swConnection_onSendfile(&conn, swBuffer_get_trunk(conn.out_buffer));
+    }
+    for (i = 0; i < n; i++)
+    {
+        recv_n = recv(sock[1], buf, ranges[i].length, MSG_WAITALL);
+        if (recv_n != ranges[i].length || memcmp(buf, content + ranges[i].offset, recv_n) != 0)
+        {
+            ret = SW_ERR;
+            goto _close;
+        }
+    }
+    swBuffer_free(conn.out_buffer);
+
+    _close:
+    close(sock[0]);
+    close(sock[1]);
+    return ret;
+}
+
+swUnitTest(http_test6)
+{
+    swHttpRange ranges[SW_HTTP_RANGE_MAX];
+    http_test_range *t;
+    char content[HTTP_TEST_FILE_SIZE];
+    char file[] = "/tmp/swoole_http_test_XXXXXX";
+    int i, j, n;
+
+    for (i = 0; i < sizeof(http_test_ranges) / sizeof(http_test_ranges[0]); i++)
+    {
+        t = &http_test_ranges[i];
+        n = swHttp_parse_range(t->range, strlen(t->range), HTTP_TEST_FILE_SIZE, ranges, SW_HTTP_RANGE_MAX);
+        if (n != t->n)
+        {
+            printf("%s: %d ranges, expect %d\n", t->range, n, t->n);
+            return 1;
+        }
+        for (j = 0; j < n; j++)
+        {
+            if (ranges[j].offset != t->offset[j] || ranges[j].length != t->length[j])
+            {
+                printf("%s: range#%d is %ld+%ld\n", t->range, j, (long) ranges[j].offset, (long) ranges[j].length);
+                return 2;
+            }
+        }
+    }
+    for (i = 0; i < sizeof(http_test_etags) / sizeof(http_test_etags[0]); i++)
+    {
+        if (swHttp_match_etag(http_test_etags[i].value, strlen(http_test_etags[i].value), http_test_etags[i].etag,
+                strlen(http_test_etags[i].etag)) != http_test_etags[i].match)
+        {
+            printf("If-None-Match: %s, ETag: %s\n", http_test_etags[i].value, http_test_etags[i].etag);
+            return 3;
+        }
+    }
+
+    int fd = mkstemp(file);
+    if (fd < 0)
+    {
+        return 4;
+    }
+    for (i = 0; i < HTTP_TEST_FILE_SIZE; i++)
+    {
+        content[i] = (char) (i * 7 + i / 256);
+    }
+    if (write(fd, content, HTTP_TEST_FILE_SIZE) != HTTP_TEST_FILE_SIZE)
+    {
+        return 5;
+    }
+    close(fd);
+
+    char *multi = "bytes=0-99,5000-5999,-1";
+    n = swHttp_parse_range(multi, strlen(multi), HTTP_TEST_FILE_SIZE, ranges, SW_HTTP_RANGE_MAX);
+    int ret = http_test_sendfile(file, content, ranges, n);
+    unlink(file);
+    return ret < 0 ? 6 : 0;
+}
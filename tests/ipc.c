@@ -0,0 +1,471 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+
+/**
+ * reactor -> worker benchmark, SW_IPC_UNSOCK vs SW_IPC_CHANNEL
+ */
+#define IPC_TEST_BLAST_N      1000000
+#define IPC_TEST_LATENCY_N    50000
+#define IPC_TEST_INTERVAL     10      //us
+#define IPC_TEST_DATA_SIZE    128
+
+typedef struct
+{
+    int count;
+    int total;
+    uint64_t start;
+    uint64_t end;
+    uint64_t *latency;
+} ipc_test_result;
+
+static swServer ipc_server;
+static swServer *ipc_serv = &ipc_server;
+static swPipe ipc_pipe;
+static ipc_test_result *ipc_result;
+
+static uint64_t ipc_test_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int ipc_test_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(uint64_t *) a, y = *(uint64_t *) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void ipc_test_receive(swReactor *reactor, swEventData *data)
+{
+    uint64_t sent, now = ipc_test_now();
+    memcpy(&sent, data->data, sizeof(sent));
+
+    if (ipc_result->count == 0)
+    {
+        ipc_result->start = now;
+    }
+    if (ipc_result->count < IPC_TEST_LATENCY_N)
+    {
+        ipc_result->latency[ipc_result->count] = now - sent;
+    }
+    ipc_result->count++;
+    if (ipc_result->count == ipc_result->total)
+    {
+        ipc_result->end = now;
+        reactor->running = 0;
+    }
+}
+
+static int ipc_test_onPipeReceive(swReactor *reactor, swEvent *event)
+{
+    swEventData data;
+    while (read(event->fd, &data, sizeof(data)) > 0)
+    {
+        ipc_test_receive(reactor, &data);
+    }
+    return SW_OK;
+}
+
+static int ipc_test_onChannelDrain(swReactor *reactor)
+{
+    swEventData data;
+    if (swIPCChannel_pop(swServer_channel_to_worker(ipc_serv, 0, 0), &ipc_serv->reactor_notify[0], &data,
+            sizeof(data)) > 0)
+    {
+        ipc_test_receive(reactor, &data);
+        return 1;
+    }
+    return 0;
+}
+
+static int ipc_test_onChannelNotify(swReactor *reactor, swEvent *event)
+{
+    return swIPCChannel_consume(reactor, &ipc_serv->worker_notify[0], ipc_test_onChannelDrain);
+}
+
+static void ipc_test_worker(int ipc_mode)
+{
+    swReactor reactor;
+    int fd;
+
+    swReactor_create(&reactor, SW_REACTOR_MAXEVENTS);
+    reactor.ptr = ipc_serv;
+    if (ipc_mode == SW_IPC_CHANNEL)
+    {
+        fd = ipc_serv->worker_notify[0].pipe.getFd(&ipc_serv->worker_notify[0].pipe, 0);
+        reactor.add(&reactor, fd, SW_FD_CHANNEL);
+        reactor.setHandle(&reactor, SW_FD_CHANNEL, ipc_test_onChannelNotify);
+    }
+    else
+    {
+        fd = ipc_pipe.getFd(&ipc_pipe, SW_PIPE_WORKER);
+        swSetNonBlock(fd);
+        reactor.add(&reactor, fd, SW_FD_PIPE);
+        reactor.setHandle(&reactor, SW_FD_PIPE, ipc_test_onPipeReceive);
+    }
+    reactor.wait(&reactor, NULL);
+    exit(0);
+}
+
+static void ipc_test_send(int ipc_mode, swEventData *data)
+{
+    static swBuffer *buffer = NULL;
+    uint64_t now = ipc_test_now();
+    memcpy(data->data, &now, sizeof(now));
+
+    if (ipc_mode == SW_IPC_CHANNEL)
+    {
+        swIPCChannel_push(swServer_channel_to_worker(ipc_serv, 0, 0), &ipc_serv->worker_notify[0], &buffer, data,
+                sizeof(data->info) + data->info.len);
+        while (!swBuffer_empty(buffer))
+        {
+            swYield();
+            swIPCChannel_flush(swServer_channel_to_worker(ipc_serv, 0, 0), &ipc_serv->worker_notify[0], buffer);
+        }
+    }
+    else
+    {
+        swSocket_write_blocking(ipc_pipe.getFd(&ipc_pipe, SW_PIPE_MASTER), data, sizeof(data->info) + data->info.len);
+    }
+}
+
+static int ipc_test_run(int ipc_mode, int n, int interval)
+{
+    swEventData data;
+    int i, status;
+    pid_t pid;
+
+    bzero(&data, sizeof(data));
+    data.info.len = IPC_TEST_DATA_SIZE;
+    ipc_result->count = 0;
+    ipc_result->total = n;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+    {
+        return SW_ERR;
+    }
+    else if (pid == 0)
+    {
+        ipc_test_worker(ipc_mode);
+    }
+
+    usleep(100000);
+    for (i = 0; i < n; i++)
+    {
+        //the producer sleeps between the messages, as a reactor thread waiting for the next event
+        if (interval > 0)
+        {
+            usleep(interval);
+        }
+        ipc_test_send(ipc_mode, &data);
+    }
+    waitpid(pid, &status, 0);
+
+    if (interval > 0)
+    {
+        qsort(ipc_result->latency, IPC_TEST_LATENCY_N, sizeof(uint64_t), ipc_test_cmp);
+        printf("%s latency: p50=%.2fus, p99=%.2fus\n", ipc_mode == SW_IPC_CHANNEL ? "channel" : "unsock",
+                ipc_result->latency[n / 2] / 1000.0, ipc_result->latency[n * 99 / 100] / 1000.0);
+    }
+    else
+    {
+        printf("%s throughput: %.0f msg/s\n", ipc_mode == SW_IPC_CHANNEL ? "channel" : "unsock",
+                (double) n * 1000000000 / (ipc_result->end - ipc_result->start));
+    }
+    return ipc_result->count == n ? SW_OK : SW_ERR;
+}
+
+swUnitTest(ipc_test1)
+{
+    bzero(ipc_serv, sizeof(swServer));
+    ipc_serv->reactor_num = 1;
+    ipc_serv->worker_num = 1;
+    ipc_serv->pipe_buffer_size = SW_PIPE_BUFFER_SIZE;
+    SwooleG.serv = ipc_serv;
+
+    ipc_result = sw_shm_malloc(sizeof(ipc_test_result) + sizeof(uint64_t) * IPC_TEST_LATENCY_N);
+    if (ipc_result == NULL)
+    {
+        return 1;
+    }
+    ipc_result->latency = (uint64_t *) (ipc_result + 1);
+
+    if (swPipeUnsock_create(&ipc_pipe, 1, SOCK_DGRAM) < 0 || swIPCChannel_create(ipc_serv) < 0)
+    {
+        return 2;
+    }
+
+    if (ipc_test_run(SW_IPC_UNSOCK, IPC_TEST_BLAST_N, 0) < 0 || ipc_test_run(SW_IPC_CHANNEL, IPC_TEST_BLAST_N, 0) < 0)
+    {
+        return 3;
+    }
+    if (ipc_test_run(SW_IPC_UNSOCK, IPC_TEST_LATENCY_N, IPC_TEST_INTERVAL) < 0
+            || ipc_test_run(SW_IPC_CHANNEL, IPC_TEST_LATENCY_N, IPC_TEST_INTERVAL) < 0)
+    {
+        return 4;
+    }
+
+    swIPCChannel_free(ipc_serv);
+    ipc_pipe.close(&ipc_pipe);
+    sw_shm_free(ipc_result);
+    return 0;
+}
+
+/**
+ * a stalled worker pauses the reads of its connections, the other workers keep flowing
+ */
+#define IPC_TEST_PORT               9511
+#define IPC_TEST_PIPE_BUFFER_SIZE   (1024 * 1024)
+#define IPC_TEST_FLOOD_MAX          (256 * 1024 * 1024)
+
+typedef struct
+{
+    uint32_t stalled_session;
+    sw_atomic_t release;
+    uint64_t stalled_bytes;
+} ipc_test_stall;
+
+static ipc_test_stall *ipc_stall;
+
+static int ipc_test_onReceive(swServer *serv, swEventData *req)
+{
+    if (req->info.type != SW_EVENT_TCP)
+    {
+        return SW_OK;
+    }
+    //the first byte of the stalled connection, hold the worker until the test releases it
+    if (ipc_stall->stalled_session == 0 && req->data[0] == 'S')
+    {
+        ipc_stall->stalled_session = req->info.fd;
+        while (!ipc_stall->release)
+        {
+            usleep(1000);
+        }
+    }
+    if (req->info.fd == ipc_stall->stalled_session)
+    {
+        ipc_stall->stalled_bytes += req->info.len;
+        return SW_OK;
+    }
+    return swServer_tcp_send(serv, req->info.fd, req->data, req->info.len);
+}
+
+static void ipc_test_server(void)
+{
+    swServer serv;
+
+    swServer_init(&serv);
+    serv.reactor_num = 1;
+    serv.worker_num = 2;
+    serv.factory_mode = SW_MODE_PROCESS;
+    serv.dispatch_mode = SW_DISPATCH_FDMOD;
+    serv.pipe_buffer_size = IPC_TEST_PIPE_BUFFER_SIZE;
+    SwooleG.socket_buffer_size = 8 * 1024 * 1024;
+
+    if (swServer_add_listener(&serv, SW_SOCK_TCP, "127.0.0.1", IPC_TEST_PORT) < 0 || swServer_create(&serv) < 0)
+    {
+        exit(1);
+    }
+    serv.onReceive = ipc_test_onReceive;
+    swServer_start(&serv);
+    exit(0);
+}
+
+static int ipc_test_connect(void)
+{
+    struct sockaddr_in addr;
+    struct timeval timeout = {0, 200000};
+    int nodelay = 1;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(IPC_TEST_PORT);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        close(sock);
+        return SW_ERR;
+    }
+    return sock;
+}
+
+static int ipc_test_ping(int sock)
+{
+    char buf[8];
+    if (write(sock, "ping", 4) != 4 || recv(sock, buf, sizeof(buf), MSG_WAITALL) != 4)
+    {
+        return SW_ERR;
+    }
+    return memcmp(buf, "ping", 4) == 0 ? SW_OK : SW_ERR;
+}
+
+/**
+ * write until the server stops reading, return the bytes written
+ */
+static long ipc_test_flood(int sock, char *data, int size)
+{
+    long sent = 0;
+    int n, idle = 0;
+
+    while (sent < IPC_TEST_FLOOD_MAX && idle < 500)
+    {
+        n = write(sock, data, size);
+        if (n > 0)
+        {
+            sent += n;
+            idle = 0;
+        }
+        else if (errno == EAGAIN)
+        {
+            usleep(1000);
+            idle++;
+        }
+        else
+        {
+            return SW_ERR;
+        }
+    }
+    return sent;
+}
+
+static int ipc_test_backpressure(int stalled, int *others, int *other_n)
+{
+    char data[65536];
+    long sent, total;
+    uint32_t pause_count = SwooleStats->pause_count, resume_count = SwooleStats->resume_count;
+    int i, n, sock = -1;
+
+    //the worker of the stalled connection is blocked after the first byte
+    if (write(stalled, "S", 1) != 1)
+    {
+        return 1;
+    }
+    usleep(100000);
+    //a connection of the other worker, the ones of the stalled worker get no echo
+    for (i = 0; i < 4 && *other_n < 4; i++)
+    {
+        if ((sock = ipc_test_connect()) < 0)
+        {
+            return 2;
+        }
+        others[(*other_n)++] = sock;
+        if (ipc_test_ping(sock) == SW_OK)
+        {
+            break;
+        }
+    }
+    if (i == 4)
+    {
+        return 3;
+    }
+
+    memset(data, 'x', sizeof(data));
+    swSetNonBlock(stalled);
+    sent = ipc_test_flood(stalled, data, sizeof(data));
+    if (sent < 0 || sent >= IPC_TEST_FLOOD_MAX || SwooleStats->pause_count == pause_count)
+    {
+        printf("sent=%ld, pause_count=%d\n", sent, SwooleStats->pause_count);
+        return 4;
+    }
+    //paused, the other worker keeps flowing
+    for (i = 0; i < 100; i++)
+    {
+        if (ipc_test_ping(sock) < 0)
+        {
+            return 5;
+        }
+    }
+    if (write(stalled, data, sizeof(data)) > 0 || ipc_stall->stalled_bytes != 0)
+    {
+        return 6;
+    }
+    printf("paused after %ld bytes, pause_count=%d\n", sent, SwooleStats->pause_count - pause_count);
+
+    //the worker drains the pipe, the reads resume below the low watermark
+    ipc_stall->release = 1;
+    total = sent + 1;
+    for (i = 0; i < 3000 && ipc_stall->stalled_bytes < total; i++)
+    {
+        usleep(1000);
+        n = write(stalled, data, sizeof(data));
+        if (n > 0)
+        {
+            total += n;
+        }
+    }
+    for (i = 0; i < 5000 && ipc_stall->stalled_bytes < total; i++)
+    {
+        usleep(1000);
+    }
+    printf("resumed, %ld bytes received, resume_count=%d\n", (long) ipc_stall->stalled_bytes,
+            SwooleStats->resume_count - resume_count);
+    if (ipc_stall->stalled_bytes != total || SwooleStats->resume_count == resume_count || total == sent + 1)
+    {
+        return 7;
+    }
+    return 0;
+}
+
+swUnitTest(ipc_test2)
+{
+    int others[4], other_n = 0;
+    int stalled, status, ret, i;
+    pid_t server_pid;
+
+    ipc_stall = sw_shm_calloc(1, sizeof(ipc_test_stall));
+    if (ipc_stall == NULL)
+    {
+        return 1;
+    }
+    fflush(stdout);
+    server_pid = fork();
+    if (server_pid < 0)
+    {
+        return 2;
+    }
+    else if (server_pid == 0)
+    {
+        ipc_test_server();
+    }
+    usleep(500000);
+
+    if ((stalled = ipc_test_connect()) < 0)
+    {
+        ret = 3;
+    }
+    else
+    {
+        ret = ipc_test_backpressure(stalled, others, &other_n);
+        close(stalled);
+    }
+    for (i = 0; i < other_n; i++)
+    {
+        close(others[i]);
+    }
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, &status, 0);
+    sw_shm_free(ipc_stall);
+    return ret;
+}
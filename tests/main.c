@@ -15,11 +15,25 @@ int main(int argc, char **argv)
 	swUnitTest_steup(mem_test2, 1, "tests for fixed memory pool");
 	swUnitTest_steup(mem_test3, 1, "tests for global memory pool");
 	swUnitTest_steup(mem_test4, 1, "tests for ring buffer memory pool");
+	swUnitTest_steup(mem_test5, 1, "slab memory pool stress benchmark");
+	swUnitTest_steup(mem_test6, 1, "huge pages and numa shared memory");
 
 	swUnitTest_steup(server_test, 1, "socket server test");
 	swUnitTest_steup(client_test, 1, "socket client test");
+	swUnitTest_steup(client_pool_test1, 1, "client connection pool test");
 
 	swUnitTest_steup(chan_test, 1, "channel test");
+	swUnitTest_steup(ipc_test1, 1, "reactor and worker ipc benchmark");
+	swUnitTest_steup(ipc_test2, 1, "stalled worker backpressure");
+	swUnitTest_steup(udp_test1, 1, "udp flood benchmark");
+	swUnitTest_steup(protocol_test1, 1, "length check framing benchmark");
+	swUnitTest_steup(protocol_test2, 1, "length check reactor to worker benchmark");
+	swUnitTest_steup(table_test1, 1, "table find benchmark");
+	swUnitTest_steup(table_test2, 1, "table mmap crash recovery test");
+	swUnitTest_steup(table_test3, 1, "table online resize test");
+	swUnitTest_steup(table_test4, 1, "table lru and ttl test");
+	swUnitTest_steup(table_test5, 1, "table atomic incr and cas test");
+	swUnitTest_steup(table_test6, 1, "table batch get benchmark");
 
 	swUnitTest_steup(ds_test2, 1, "user data struct test");
 	swUnitTest_steup(hashmap_test1, 1, "hashmap data struct test");
@@ -38,13 +52,22 @@ int main(int argc, char **argv)
 	swUnitTest_steup(type_test1, 1, "type test");
 
 	//swUnitTest_steup(ws_test1, 1, "websocket decode test");
+#ifdef SW_HAVE_ZLIB
+	swUnitTest_steup(ws_test2, 1, "websocket permessage-deflate");
+#endif
+	swUnitTest_steup(ws_test3, 1, "websocket reassembly and control frames");
 
 	//swUnitTest_steup(http_test1, 1, "http get test");
 	//swUnitTest_steup(http_test2, 1, "http post test");
+	swUnitTest_steup(http_test3, 1, "http single pass parser");
+	swUnitTest_steup(http_test4, 1, "http request body streaming");
+	swUnitTest_steup(http_test5, 1, "http response head cached lines");
+	swUnitTest_steup(http_test6, 1, "http range and conditional sendfile");
 
 
 	swUnitTest_steup(heap_test1, 1, "heap test");
 
 	swUnitTest_steup(ringbuffer_test1, 1, "ringbuffer test");
+	swUnitTest_steup(string_test1, 1, "strnpos kernels benchmark");
 	return swUnitTest_run(&test);
 }
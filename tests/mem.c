@@ -199,3 +199,171 @@ swUnitTest(mem_test4)
 	}
 	return 0;
 }
+
+/**
+ * slab pool stress benchmark, the processes alloc and free the random sizes
+ */
+#define SLAB_TEST_WORKER   4
+#define SLAB_TEST_OPS      200000
+#define SLAB_TEST_SLOTS    1024
+
+static int slab_test_size(void)
+{
+	int r = rand() % 100;
+	if (r < 80)
+	{
+		return 16 + rand() % 496;
+	}
+	else if (r < 99)
+	{
+		return 512 + rand() % 16000;
+	}
+	return 65536 + rand() % 65536;
+}
+
+static int slab_test_worker(swMemoryPool *pool, int id)
+{
+	char *slots[SLAB_TEST_SLOTS];
+	int sizes[SLAB_TEST_SLOTS];
+	int i, n, errors = 0;
+
+	bzero(slots, sizeof(slots));
+	srand(id);
+	for (i = 0; i < SLAB_TEST_OPS; i++)
+	{
+		n = rand() % SLAB_TEST_SLOTS;
+		if (slots[n])
+		{
+			if (slots[n][0] != (char) id || slots[n][sizes[n] - 1] != (char) n)
+			{
+				errors++;
+			}
+			pool ? pool->free(pool, slots[n]) : sw_shm_free(slots[n]);
+			slots[n] = NULL;
+			continue;
+		}
+		sizes[n] = slab_test_size();
+		slots[n] = pool ? pool->alloc(pool, sizes[n]) : sw_shm_malloc(sizes[n]);
+		if (slots[n] == NULL)
+		{
+			errors++;
+			continue;
+		}
+		slots[n][0] = (char) id;
+		slots[n][sizes[n] - 1] = (char) n;
+	}
+	for (n = 0; n < SLAB_TEST_SLOTS; n++)
+	{
+		if (slots[n])
+		{
+			pool ? pool->free(pool, slots[n]) : sw_shm_free(slots[n]);
+		}
+	}
+	if (pool)
+	{
+		swSlabPool_flush(pool);
+	}
+	return errors;
+}
+
+static int slab_test_run(swMemoryPool *pool)
+{
+	struct timeval start, end;
+	int i, status, errors = 0;
+
+	fflush(stdout);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < SLAB_TEST_WORKER; i++)
+	{
+		if (fork() == 0)
+		{
+			exit(slab_test_worker(pool, i + 1));
+		}
+	}
+	for (i = 0; i < SLAB_TEST_WORKER; i++)
+	{
+		wait(&status);
+		errors += WEXITSTATUS(status);
+	}
+	gettimeofday(&end, NULL);
+
+	double usec = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
+	printf("%s: %d processes, %.0f ops/s, errors=%d\n", pool ? "slab pool" : "sw_shm_malloc", SLAB_TEST_WORKER,
+			SLAB_TEST_WORKER * SLAB_TEST_OPS * 1000000.0 / usec, errors);
+	return errors;
+}
+
+swUnitTest(mem_test5)
+{
+	swSlabPool_stats stats;
+	swMemoryPool *pool = swSlabPool_new(1024 * 1024 * 256, 1);
+	if (pool == NULL)
+	{
+		return 1;
+	}
+	if (slab_test_run(NULL) > 0 || slab_test_run(pool) > 0)
+	{
+		return 2;
+	}
+
+	swSlabPool_get_stats(pool, &stats);
+	printf("pages: used=%d/%d, large=%d. used=%ld, cached=%ld, free=%ld. fragmentation=%.2f%%\n", stats.page_used,
+			stats.page_num, stats.page_large, stats.used, stats.cached, stats.free, stats.fragmentation * 100);
+	printf("alloc=%ld, free=%ld, fail=%ld\n", (long) stats.alloc_num, (long) stats.free_num, (long) stats.fail_num);
+	//all the objects are returned by the processes
+	if (stats.used != 0 || stats.cached != 0 || stats.alloc_num != stats.free_num || stats.page_large != 0
+			|| stats.fragmentation != 0)
+	{
+		return 3;
+	}
+	//only the pages of the size class with a live object are counted
+	void *ptr = pool->alloc(pool, 16);
+	swSlabPool_get_stats(pool, &stats);
+	pool->free(pool, ptr);
+	printf("one object: fragmentation=%.2f%%\n", stats.fragmentation * 100);
+	if (stats.fragmentation <= 0 || stats.fragmentation >= 1)
+	{
+		return 4;
+	}
+	pool->destroy(pool);
+	return 0;
+}
+
+/**
+ * huge pages and numa policy, the mapping falls back when they are not available
+ */
+swUnitTest(mem_test6)
+{
+	uint64_t nodes;
+	size_t i, size = 1024 * 1024 * 8;
+
+	if (swShareMemory_parse_nodes("0-2,5\n", &nodes) < 0 || nodes != 0x27 || swShareMemory_parse_nodes("3-1", &nodes) == 0)
+	{
+		return 1;
+	}
+
+	SwooleG.shm_hugepage = SW_HUGEPAGE_EXPLICIT;
+	SwooleG.shm_numa = SW_NUMA_INTERLEAVE;
+	char *mem = sw_shm_calloc(1, size);
+	if (mem == NULL)
+	{
+		return 2;
+	}
+	for (i = 0; i < size; i += 4096)
+	{
+		if (mem[i] != 0)
+		{
+			return 3;
+		}
+		mem[i] = 1;
+	}
+	mem = sw_shm_realloc(mem, size * 2);
+	if (mem == NULL || mem[size - 4096] != 1)
+	{
+		return 4;
+	}
+	sw_shm_free(mem);
+	SwooleG.shm_hugepage = SW_HUGEPAGE_NONE;
+	SwooleG.shm_numa = SW_NUMA_NONE;
+	return 0;
+}
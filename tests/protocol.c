@@ -0,0 +1,419 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+#include "Connection.h"
+#include "tests.h"
+
+#include <sys/ioctl.h>
+
+/**
+ * length check framing over a socketpair, the packages are checked by the sequence,
+ * and the header + body reads are benchmarked against the multi-package extraction
+ */
+#define PROTOCOL_TEST_CHECK_N    100000
+#define PROTOCOL_TEST_BENCH_N    1000000
+#define PROTOCOL_TEST_BODY_MAX   300
+#define PROTOCOL_TEST_CHUNK      (64 * 1024)
+
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t batch_count;
+    int error;
+} protocol_test_stats;
+
+static protocol_test_stats protocol_stats;
+
+static void protocol_test_check(char *data, uint32_t length)
+{
+    uint32_t body_length = ntohl(*(uint32_t *) data);
+    uint32_t i;
+
+    if (body_length + 4 != length)
+    {
+        protocol_stats.error = 1;
+        return;
+    }
+    for (i = 0; i < body_length; i++)
+    {
+        if ((uint8_t) data[4 + i] != (uint8_t) (protocol_stats.sequence + i))
+        {
+            protocol_stats.error = 1;
+            return;
+        }
+    }
+    protocol_stats.sequence++;
+}
+
+static int protocol_test_onPackage(swConnection *conn, char *data, uint32_t length)
+{
+    protocol_test_check(data, length);
+    return SW_OK;
+}
+
+static int protocol_test_onPackageBatch(swConnection *conn, char *data, uint32_t *lengths, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        protocol_test_check(data, lengths[i]);
+        data += lengths[i];
+    }
+    protocol_stats.batch_count++;
+    return SW_OK;
+}
+
+/**
+ * the header is read first, then the body, two reads for each package
+ */
+static int protocol_test_recv_legacy(swProtocol *protocol, swConnection *conn, swString *buffer)
+{
+    uint32_t header = protocol->package_length_offset + protocol->package_length_size;
+    uint32_t want = buffer->offset > 0 ? buffer->offset : header;
+    int package_length;
+
+    int n = swConnection_recv(conn, buffer->str + buffer->length, want - buffer->length, 0);
+    if (n <= 0)
+    {
+        return n;
+    }
+    buffer->length += n;
+    if (buffer->offset == 0 && buffer->length == header)
+    {
+        package_length = protocol->get_package_length(protocol, conn, buffer->str, buffer->length);
+        if (package_length < 0)
+        {
+            return SW_ERR;
+        }
+        buffer->offset = package_length;
+    }
+    if (buffer->offset > 0 && buffer->length == buffer->offset)
+    {
+        protocol->onPackage(conn, buffer->str, buffer->length);
+        swString_clear(buffer);
+    }
+    return n;
+}
+
+/**
+ * [uint32_t length][body], the body bytes count up from the package sequence
+ */
+static uint32_t protocol_test_fill(char *buf, uint32_t sequence, uint32_t body_length)
+{
+    uint32_t i;
+    *(uint32_t *) buf = htonl(body_length);
+    for (i = 0; i < body_length; i++)
+    {
+        buf[4 + i] = (char) (sequence + i);
+    }
+    return body_length + 4;
+}
+
+static int protocol_test_readable(int fd)
+{
+    int n = 0;
+    ioctl(fd, FIONREAD, &n);
+    return n;
+}
+
+/**
+ * write the packages in random sized chunks, and read all of them after each chunk
+ */
+static int protocol_test_run(swProtocol *protocol, int legacy, uint32_t package_n, int fixed_length, double *elapsed)
+{
+    int sock[2];
+    swConnection conn;
+    swString *buffer = swString_new(SW_BUFFER_SIZE_BIG);
+    char *out = sw_malloc(PROTOCOL_TEST_CHUNK + PROTOCOL_TEST_BODY_MAX + 4);
+    uint32_t sequence = 0, out_length = 0, chunk;
+    struct timeval start, end;
+    int ret = SW_OK;
+
+    if (buffer == NULL || out == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, sock) < 0)
+    {
+        return SW_ERR;
+    }
+    swSetNonBlock(sock[1]);
+    bzero(&conn, sizeof(conn));
+    conn.fd = sock[1];
+    bzero(&protocol_stats, sizeof(protocol_stats));
+
+    gettimeofday(&start, NULL);
+    while (sequence < package_n || out_length > 0)
+    {
+        while (sequence < package_n && out_length < PROTOCOL_TEST_CHUNK)
+        {
+            out_length += protocol_test_fill(out + out_length, sequence,
+                    fixed_length > 0 ? fixed_length : rand() % PROTOCOL_TEST_BODY_MAX);
+            sequence++;
+        }
+        chunk = fixed_length > 0 ? out_length : 1 + rand() % out_length;
+        if (write(sock[0], out, chunk) != chunk)
+        {
+            ret = SW_ERR;
+            break;
+        }
+        memmove(out, out + chunk, out_length - chunk);
+        out_length -= chunk;
+
+        while (protocol_test_readable(sock[1]) > 0)
+        {
+            if (legacy)
+            {
+                protocol_test_recv_legacy(protocol, &conn, buffer);
+            }
+            else if (swProtocol_recv_check_length(protocol, &conn, buffer) < 0)
+            {
+                ret = SW_ERR;
+                break;
+            }
+        }
+    }
+    gettimeofday(&end, NULL);
+    *elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    //no partial package is left
+    if (buffer->length != 0)
+    {
+        ret = SW_ERR;
+    }
+
+    close(sock[0]);
+    close(sock[1]);
+    swString_free(buffer);
+    sw_free(out);
+
+    if (ret < 0 || protocol_stats.error || protocol_stats.sequence != package_n)
+    {
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+swUnitTest(protocol_test1)
+{
+    swProtocol protocol;
+    double elapsed;
+    int i;
+
+    bzero(&protocol, sizeof(protocol));
+    protocol.package_length_type = 'N';
+    protocol.package_length_size = 4;
+    protocol.package_length_offset = 0;
+    protocol.package_body_offset = 4;
+    protocol.package_max_length = 2 * 1024 * 1024;
+    protocol.get_package_length = swProtocol_get_package_length;
+    protocol.onPackage = protocol_test_onPackage;
+
+    srand(1);
+    if (protocol_test_run(&protocol, 0, PROTOCOL_TEST_CHECK_N, 0, &elapsed) < 0)
+    {
+        printf("per package: %u packages checked, error=%d\n", protocol_stats.sequence, protocol_stats.error);
+        return 1;
+    }
+    protocol.onPackageBatch = protocol_test_onPackageBatch;
+    if (protocol_test_run(&protocol, 0, PROTOCOL_TEST_CHECK_N, 0, &elapsed) < 0 || protocol_stats.batch_count == 0)
+    {
+        printf("batch: %u packages checked, error=%d\n", protocol_stats.sequence, protocol_stats.error);
+        return 2;
+    }
+
+    //64 bytes packages
+    for (i = 0; i < 3; i++)
+    {
+        protocol.onPackageBatch = i == 2 ? protocol_test_onPackageBatch : NULL;
+        if (protocol_test_run(&protocol, i == 0, PROTOCOL_TEST_BENCH_N, 60, &elapsed) < 0)
+        {
+            return 3;
+        }
+        printf("%s: %.0f packages/s\n", i == 0 ? "header + body reads" : (i == 1 ? "one read, per package" : "one read, batch"),
+                PROTOCOL_TEST_BENCH_N / elapsed);
+    }
+    return 0;
+}
+
+/**
+ * reactor thread -> worker, the packages of one read sent in one message (FDMOD)
+ * or one message per package (ROUND, the same single worker)
+ */
+#define PROTOCOL_TEST_SERVER_N   1000000
+#define PROTOCOL_TEST_BODY_SIZE  60
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t batch_count;
+    int error;
+} protocol_test_server_stats;
+
+static protocol_test_server_stats *protocol_server_stats;
+
+static int protocol_test_server_onReceive(swServer *serv, swEventData *req)
+{
+    swString *package = swWorker_get_buffer(serv, req->info.from_id);
+    uint32_t sequence;
+
+    if (package->length != PROTOCOL_TEST_BODY_SIZE + 4)
+    {
+        protocol_server_stats->error = 1;
+        return SW_OK;
+    }
+    memcpy(&sequence, package->str + 4, sizeof(sequence));
+    if (sequence != protocol_server_stats->count)
+    {
+        protocol_server_stats->error = 1;
+    }
+    protocol_server_stats->count++;
+    return SW_OK;
+}
+
+static void protocol_test_server(int port, int dispatch_mode)
+{
+    swServer serv;
+
+    swServer_init(&serv);
+    serv.reactor_num = 1;
+    serv.worker_num = 1;
+    serv.factory_mode = SW_MODE_PROCESS;
+    serv.dispatch_mode = dispatch_mode;
+    serv.open_length_check = 1;
+    serv.protocol.package_length_type = 'N';
+    serv.protocol.package_length_size = 4;
+    serv.protocol.package_length_offset = 0;
+    serv.protocol.package_body_offset = 4;
+    serv.protocol.package_max_length = 2 * 1024 * 1024;
+    SwooleG.socket_buffer_size = 8 * 1024 * 1024;
+
+    if (swServer_add_listener(&serv, SW_SOCK_TCP, "127.0.0.1", port) < 0 || swServer_create(&serv) < 0)
+    {
+        exit(1);
+    }
+    serv.onReceive = protocol_test_server_onReceive;
+    swServer_start(&serv);
+    exit(0);
+}
+
+static int protocol_test_server_run(int port, int dispatch_mode, double *elapsed)
+{
+    struct sockaddr_in addr;
+    struct timeval start, end;
+    char *out;
+    uint32_t i, j, n, offset;
+    int sock, status, ret = SW_OK;
+    pid_t pid;
+
+    bzero(protocol_server_stats, sizeof(protocol_test_server_stats));
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+    {
+        return SW_ERR;
+    }
+    else if (pid == 0)
+    {
+        protocol_test_server(port, dispatch_mode);
+    }
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    for (i = 0; i < 50; i++)
+    {
+        usleep(100000);
+        if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+        {
+            break;
+        }
+    }
+    out = sw_malloc(PROTOCOL_TEST_CHUNK);
+    if (i == 50 || out == NULL)
+    {
+        ret = SW_ERR;
+        goto _kill;
+    }
+
+    n = PROTOCOL_TEST_CHUNK / (PROTOCOL_TEST_BODY_SIZE + 4);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < PROTOCOL_TEST_SERVER_N; i += n)
+    {
+        if (PROTOCOL_TEST_SERVER_N - i < n)
+        {
+            n = PROTOCOL_TEST_SERVER_N - i;
+        }
+        for (j = 0, offset = 0; j < n; j++)
+        {
+            *(uint32_t *) (out + offset) = htonl(PROTOCOL_TEST_BODY_SIZE);
+            bzero(out + offset + 4, PROTOCOL_TEST_BODY_SIZE);
+            *(uint32_t *) (out + offset + 4) = i + j;
+            offset += PROTOCOL_TEST_BODY_SIZE + 4;
+        }
+        if (swSocket_write_blocking(sock, out, offset) < 0)
+        {
+            ret = SW_ERR;
+            goto _kill;
+        }
+    }
+    //wait for the worker to handle the last package
+    for (i = 0; i < 30000 && protocol_server_stats->count < PROTOCOL_TEST_SERVER_N && !protocol_server_stats->error; i++)
+    {
+        usleep(1000);
+    }
+    gettimeofday(&end, NULL);
+    *elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    if (protocol_server_stats->count != PROTOCOL_TEST_SERVER_N || protocol_server_stats->error)
+    {
+        ret = SW_ERR;
+    }
+
+    _kill:
+    close(sock);
+    sw_free(out);
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+    return ret;
+}
+
+swUnitTest(protocol_test2)
+{
+    double elapsed;
+    int ret = 0;
+
+    protocol_server_stats = sw_shm_calloc(1, sizeof(protocol_test_server_stats));
+    if (protocol_server_stats == NULL)
+    {
+        return 1;
+    }
+    if (protocol_test_server_run(9521, SW_DISPATCH_ROUND, &elapsed) < 0)
+    {
+        printf("per package: %u packages received, error=%d\n", protocol_server_stats->count, protocol_server_stats->error);
+        ret = 2;
+        goto _free;
+    }
+    printf("one message per package: %.0f packages/s\n", PROTOCOL_TEST_SERVER_N / elapsed);
+    if (protocol_test_server_run(9522, SW_DISPATCH_FDMOD, &elapsed) < 0)
+    {
+        printf("batch: %u packages received, error=%d\n", protocol_server_stats->count, protocol_server_stats->error);
+        ret = 3;
+        goto _free;
+    }
+    printf("one message per read: %.0f packages/s\n", PROTOCOL_TEST_SERVER_N / elapsed);
+
+    _free:
+    sw_shm_free(protocol_server_stats);
+    return ret;
+}
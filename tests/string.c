@@ -0,0 +1,179 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "tests.h"
+
+/**
+ * strnpos kernels, checked against the byte loop and benchmarked over eof framed buffers
+ */
+#define STRING_TEST_CHECK_N    200000
+#define STRING_TEST_BUFFER     (64 * 1024)
+//bytes scanned by each kernel for one buffer
+#define STRING_TEST_BENCH_BYTES  (256 * 1024 * 1024)
+
+static char *string_test_eof[] = { "\n", "\r\n", "\r\n\r\n", "#EOF#", "\r\n--END\n" };
+
+static int string_test_bytes(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    uint32_t i;
+    if (haystack_length < needle_length)
+    {
+        return -1;
+    }
+    for (i = 0; i < haystack_length - needle_length + 1; i++)
+    {
+        if (haystack[i] == needle[0] && memcmp(haystack + i, needle, needle_length) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint64_t string_test_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * http headers like text, the eof is appended at the end
+ */
+static void string_test_fill(char *buf, uint32_t length, char *eof, uint32_t eof_len)
+{
+    static char line[] = "X-Forwarded-For: 192.168.1.100\r\nAccept-Language: en-US,en;q=0.9\r\n";
+    uint32_t i;
+    for (i = 0; i < length - eof_len; i++)
+    {
+        buf[i] = line[i % (sizeof(line) - 1)];
+    }
+    //the header block does not end before the eof
+    if (strcmp(eof, "\r\n\r\n") != 0)
+    {
+        for (i = 0; i < length - eof_len; i++)
+        {
+            if (buf[i] == '\n' || buf[i] == eof[0])
+            {
+                buf[i] = ' ';
+            }
+        }
+    }
+    //the text may end with a line break, which would start the eof early
+    if (i > 0)
+    {
+        buf[i - 1] = ' ';
+    }
+    memcpy(buf + length - eof_len, eof, eof_len);
+}
+
+/**
+ * swoole_strnpos is inline, it is called through this one to be timed with the kernels
+ */
+static int string_test_strnpos(char *haystack, uint32_t haystack_length, char *needle, uint32_t needle_length)
+{
+    return swoole_strnpos(haystack, haystack_length, needle, needle_length);
+}
+
+static double string_test_bench(swoole_strnpos_t func, char *buf, uint32_t length, char *eof, uint32_t eof_len)
+{
+    uint32_t i, n = STRING_TEST_BENCH_BYTES / length;
+    volatile int pos = 0;
+    uint64_t start;
+
+    //warm up the cache and the branch predictor
+    for (i = 0; i < 100; i++)
+    {
+        pos += func(buf, length, eof, eof_len);
+    }
+    start = string_test_now();
+    for (i = 0; i < n; i++)
+    {
+        pos += func(buf, length, eof, eof_len);
+    }
+    return (double) length * n / (string_test_now() - start);
+}
+
+swUnitTest(string_test1)
+{
+    swoole_strnpos_t kernels[] = { swoole_strnpos_generic, swoole_strnpos_sse2, swoole_strnpos_avx2 };
+    char *names[] = { "generic", "sse2", "avx2" };
+    int kernel_n = 3;
+    char *buf = sw_malloc(STRING_TEST_BUFFER);
+    char *eof;
+    uint32_t i, j, k, eof_len, length, offset;
+    int expect;
+
+    if (buf == NULL)
+    {
+        return 1;
+    }
+
+    //the avx2 kernel is only checked on the cpu supporting it, the first call resolves the handler
+    swoole_strnpos_handler(buf, 0, "\n", 1);
+    if (swoole_strnpos_handler != swoole_strnpos_avx2)
+    {
+        kernel_n = 2;
+    }
+
+    srand(1);
+    for (i = 0; i < STRING_TEST_CHECK_N; i++)
+    {
+        eof = string_test_eof[i % 5];
+        eof_len = strlen(eof);
+        //small alphabet and unaligned windows, the last byte is followed by garbage
+        length = rand() % 100;
+        offset = rand() % 32;
+        for (j = 0; j < length + 64; j++)
+        {
+            buf[offset + j] = "\r\n#E-\n"[rand() % 6];
+        }
+        expect = string_test_bytes(buf + offset, length, eof, eof_len);
+        for (k = 0; k < kernel_n; k++)
+        {
+            if (kernels[k](buf + offset, length, eof, eof_len) != expect)
+            {
+                printf("%s: mismatch, eof_len=%d, length=%d\n", names[k], eof_len, length);
+                return 2;
+            }
+        }
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        eof = string_test_eof[i];
+        eof_len = strlen(eof);
+        for (length = 256; length <= STRING_TEST_BUFFER; length *= 4)
+        {
+            string_test_fill(buf, length, eof, eof_len);
+            if (string_test_bytes(buf, length, eof, eof_len) != length - eof_len)
+            {
+                return 3;
+            }
+            printf("eof_len=%d, length=%d, bytes: %.2fGB/s", eof_len, length,
+                    string_test_bench(string_test_bytes, buf, length, eof, eof_len));
+            for (k = 0; k < kernel_n; k++)
+            {
+                printf(", %s: %.2fGB/s", names[k], string_test_bench(kernels[k], buf, length, eof, eof_len));
+            }
+            printf(", strnpos: %.2fGB/s\n", string_test_bench(string_test_strnpos, buf, length, eof, eof_len));
+        }
+    }
+
+    sw_free(buf);
+    return 0;
+}
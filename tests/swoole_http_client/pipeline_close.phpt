@@ -0,0 +1,106 @@
+--TEST--
+swoole_http_client: close or drop the client in the callback of a pipelined response
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9519);
+define('LOG', sys_get_temp_dir() . '/swoole_http_client_pipeline.log');
+
+$server = new swoole_process(function () {
+    $sock = stream_socket_server('tcp://127.0.0.1:' . PORT);
+    $conns = [];
+    while (true)
+    {
+        $read = array_merge([$sock], array_column($conns, 'sock'));
+        $write = $except = null;
+        stream_select($read, $write, $except, null);
+        foreach ($read as $conn)
+        {
+            if ($conn === $sock)
+            {
+                $client = stream_socket_accept($sock);
+                $conns[(int) $client] = ['sock' => $client, 'buffer' => '', 'uris' => []];
+                continue;
+            }
+            $data = fread($conn, 65536);
+            if ($data === '' || $data === false)
+            {
+                fclose($conn);
+                unset($conns[(int) $conn]);
+                continue;
+            }
+            $c = &$conns[(int) $conn];
+            $c['buffer'] .= $data;
+            while (($pos = strpos($c['buffer'], "\r\n\r\n")) !== false)
+            {
+                list($method, $uri) = explode(' ', $c['buffer']);
+                $c['buffer'] = substr($c['buffer'], $pos + 4);
+                $c['uris'][] = $uri;
+                //the responses of the pipelined requests are sent in one write
+                if (substr($uri, -4) == '-end')
+                {
+                    $out = '';
+                    foreach ($c['uris'] as $uri)
+                    {
+                        $out .= "HTTP/1.1 200 OK\r\nContent-Length: " . strlen($uri) . "\r\n\r\n" . $uri;
+                    }
+                    fwrite($conn, $out);
+                    file_put_contents(LOG, implode(' | ', $c['uris']) . "\n", FILE_APPEND);
+                    $c['uris'] = [];
+                }
+            }
+            unset($c);
+        }
+    }
+}, false, false);
+$pid = $server->start();
+usleep(300000);
+
+function drop()
+{
+    //the object is not kept by execute()
+    $cli = $GLOBALS['drop_cli'] = new swoole_http_client('127.0.0.1', PORT);
+    $cli->set(['keep_alive' => 1, 'pipeline' => true]);
+    $cli->execute('/b1', function ($cli) {
+        echo "b1 {$cli->statusCode} {$cli->body}\n";
+        //the object is released after the received data is parsed
+        unset($GLOBALS['drop_cli']);
+    });
+    $cli->execute('/b2-end', function ($cli) {
+        global $pid;
+        echo "b2 {$cli->statusCode} {$cli->body}\n";
+        swoole_process::kill($pid);
+        swoole_process::wait();
+        echo file_get_contents(LOG);
+        unlink(LOG);
+        swoole_event_exit();
+    });
+}
+
+$cli = new swoole_http_client('127.0.0.1', PORT);
+$cli->set(['keep_alive' => 1, 'pipeline' => true]);
+$cli->execute('/a1', function ($cli) {
+    echo "a1 {$cli->statusCode} {$cli->body}\n";
+    //the responses of /a2 and /a3-end are not given to the request on the new connection
+    $cli->close();
+    $cli->execute('/a4-end', function ($cli) {
+        echo "a4 {$cli->statusCode} {$cli->body}\n";
+        drop();
+    });
+});
+$cli->execute('/a2', function ($cli) {
+    echo "a2 {$cli->statusCode} {$cli->body}\n";
+});
+$cli->execute('/a3-end', function ($cli) {
+    echo "a3 {$cli->statusCode} {$cli->body}\n";
+});
+?>
+--EXPECT--
+a1 200 /a1
+a4 200 /a4-end
+b1 200 /b1
+b2 200 /b2-end
+/a1 | /a2 | /a3-end
+/a4-end
+/b1 | /b2-end
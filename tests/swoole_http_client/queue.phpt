@@ -0,0 +1,144 @@
+--TEST--
+swoole_http_client: pipelined queue, reset connection, data callback and download
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9512);
+define('FILE', sys_get_temp_dir() . '/swoole_http_client_download.txt');
+
+function read_request($conn)
+{
+    $head = '';
+    while (strpos($head, "\r\n\r\n") === false)
+    {
+        $data = fread($conn, 1);
+        if ($data === '' || $data === false)
+        {
+            return false;
+        }
+        $head .= $data;
+    }
+    if (preg_match('/Content-Length: (\d+)/i', $head, $match))
+    {
+        fread($conn, $match[1]);
+    }
+    list($method, $uri) = explode(' ', $head);
+    return "$method $uri";
+}
+
+function response($conn, $body)
+{
+    fwrite($conn, "HTTP/1.1 200 OK\r\nContent-Length: " . strlen($body) . "\r\n\r\n" . $body);
+}
+
+$server = new swoole_process(function () {
+    $sock = stream_socket_server('tcp://127.0.0.1:' . PORT);
+    //3 pipelined requests, the connection is closed before the last response
+    $conn = stream_socket_accept($sock);
+    $requests = [read_request($conn), read_request($conn), read_request($conn)];
+    response($conn, '1');
+    response($conn, '2');
+    fclose($conn);
+    //the GET request is sent again, the POST request in flight is not
+    $conn = stream_socket_accept($sock);
+    $requests[] = read_request($conn);
+    response($conn, '3');
+    $requests[] = read_request($conn);
+    fclose($conn);
+    //chunked body in 3 writes
+    $conn = stream_socket_accept($sock);
+    $requests[] = read_request($conn);
+    fwrite($conn, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    foreach (['abc', 'def', 'ghi'] as $chunk)
+    {
+        fwrite($conn, "3\r\n$chunk\r\n");
+        usleep(50000);
+    }
+    fwrite($conn, "0\r\n\r\n");
+    fclose($conn);
+    //download
+    $conn = stream_socket_accept($sock);
+    $requests[] = read_request($conn);
+    response($conn, str_repeat('x', 100000));
+    fclose($conn);
+    file_put_contents(FILE . '.log', implode("\n", $requests));
+}, false, false);
+$pid = $server->start();
+usleep(300000);
+
+function download()
+{
+    //the object is not kept by execute()
+    $cli = $GLOBALS['download_cli'] = new swoole_http_client('127.0.0.1', PORT);
+    $cli->on('error', function ($cli) {
+        echo "error {$cli->errCode}\n";
+    });
+    $cli->download('/file', FILE, function ($cli) {
+        clearstatcache();
+        echo "download {$cli->statusCode} ", filesize(FILE), "\n";
+        swoole_process::wait();
+        echo file_get_contents(FILE . '.log'), "\n";
+        unlink(FILE);
+        unlink(FILE . '.log');
+        swoole_event_exit();
+    });
+}
+
+function stream()
+{
+    //the object is not kept by execute()
+    $cli = $GLOBALS['stream_cli'] = new swoole_http_client('127.0.0.1', PORT);
+    $cli->data = '';
+    $cli->on('error', function ($cli) {
+        echo "error {$cli->errCode}\n";
+    });
+    $cli->on('data', function ($cli, $data) {
+        $cli->data .= $data;
+    });
+    $cli->execute('/stream', function ($cli) {
+        echo "stream {$cli->statusCode} {$cli->data} '{$cli->body}'\n";
+        download();
+    });
+}
+
+$cli = new swoole_http_client('127.0.0.1', PORT);
+$cli->set(['keep_alive' => 1, 'pipeline' => true, 'reconnect' => 1]);
+$cli->on('error', function ($cli) {
+    echo "error {$cli->errCode}\n";
+});
+$cli->on('close', function ($cli) {
+    echo "close\n";
+});
+foreach (['/1', '/2', '/3'] as $uri)
+{
+    $cli->execute($uri, function ($cli) use ($uri) {
+        echo "$uri {$cli->statusCode} {$cli->body}\n";
+        if ($uri != '/3')
+        {
+            return;
+        }
+        $cli->setData('a=1');
+        $cli->execute('/post', function ($cli) {
+            echo "post {$cli->statusCode} {$cli->errCode}\n";
+            stream();
+        });
+    });
+}
+?>
+--EXPECTF--
+/1 200 1
+/2 200 2
+/3 200 3
+%AWarning: %Aconnection is reset by the server, 1 requests are discarded.%A
+post -1 104
+close
+stream 200 abcdefghi ''
+download 200 100000
+GET /1
+GET /2
+GET /3
+GET /3
+POST /post
+GET /stream
+GET /file
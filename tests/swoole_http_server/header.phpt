@@ -0,0 +1,116 @@
+--TEST--
+swoole_http_response: the response head built from the cached status and Date lines
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9520);
+
+$server = new swoole_process(function () {
+    $http = new swoole_http_server('127.0.0.1', PORT, SWOOLE_BASE);
+    $http->set([
+        'worker_num' => 1,
+        'log_file' => '/dev/null',
+        'http_response_header' => ['X-Powered-By' => 'swoole'],
+    ]);
+    $http->on('request', function ($req, $resp) {
+        switch ($req->server['request_uri'])
+        {
+        case '/404':
+            //the default Content-Type is not added, the names are compared case-insensitively
+            $resp->status(404);
+            $resp->header('content-type', 'text/plain');
+            $resp->end('no');
+            break;
+        case '/299':
+            //the unknown codes are sent as 200
+            $resp->status(299);
+            $resp->end();
+            break;
+        default:
+            $resp->end('hello');
+            break;
+        }
+    });
+    $http->start();
+}, false, false);
+$pid = $server->start();
+
+function request($conn, $uri, $close)
+{
+    fwrite($conn, "GET $uri HTTP/1.1\r\nHost: localhost\r\n" . ($close ? "Connection: close\r\n" : '') . "\r\n");
+    $response = '';
+    while (($pos = strpos($response, "\r\n\r\n")) === false || !preg_match('/Content-Length: (\d+)/', $response, $match)
+            || strlen($response) < $pos + 4 + $match[1])
+    {
+        $data = fread($conn, 8192);
+        if ($data === '' || $data === false)
+        {
+            break;
+        }
+        $response .= $data;
+    }
+    $head = preg_replace('/^Date: [A-Z][a-z]{2}, \d{2} [A-Z][a-z]{2} \d{4} \d{2}:\d{2}:\d{2} GMT$/m', 'Date: <date>',
+            str_replace("\r\n", "\n", $response));
+    echo $head, "\n--\n";
+}
+
+for ($i = 0; $i < 50; $i++)
+{
+    usleep(100000);
+    if ($conn = @stream_socket_client('tcp://127.0.0.1:' . PORT))
+    {
+        break;
+    }
+}
+//two responses on a keep-alive connection
+request($conn, '/hello', false);
+request($conn, '/hello', true);
+foreach (['/404', '/299'] as $uri)
+{
+    request(stream_socket_client('tcp://127.0.0.1:' . PORT), $uri, true);
+}
+swoole_process::kill($pid);
+swoole_process::wait();
+?>
+--EXPECT--
+HTTP/1.1 200 OK
+X-Powered-By: swoole
+Server: swoole-http-server
+Content-Type: text/html
+Connection: keep-alive
+Content-Length: 5
+Date: <date>
+
+hello
+--
+HTTP/1.1 200 OK
+X-Powered-By: swoole
+Server: swoole-http-server
+Content-Type: text/html
+Connection: close
+Content-Length: 5
+Date: <date>
+
+hello
+--
+HTTP/1.1 404 Not Found
+content-type: text/plain
+X-Powered-By: swoole
+Server: swoole-http-server
+Connection: close
+Content-Length: 2
+Date: <date>
+
+no
+--
+HTTP/1.1 200 OK
+X-Powered-By: swoole
+Server: swoole-http-server
+Content-Type: text/html
+Connection: close
+Content-Length: 0
+Date: <date>
+
+
+--
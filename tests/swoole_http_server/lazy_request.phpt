@@ -0,0 +1,131 @@
+--TEST--
+swoole_http_request: the arrays are the same when they are built on first access
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9518);
+
+function array_names($req, $dump)
+{
+    $names = [];
+    if ($dump)
+    {
+        ob_start();
+        var_dump($req);
+        preg_match_all('/\["(\w+)"\]=>\s*array/', ob_get_clean(), $match);
+        $names = $match[1];
+    }
+    else
+    {
+        foreach ($req as $name => $value)
+        {
+            if (is_array($value))
+            {
+                $names[] = $name;
+            }
+        }
+    }
+    sort($names);
+    return implode(',', $names);
+}
+
+$server = new swoole_process(function () {
+    $http = new swoole_http_server('127.0.0.1', PORT, SWOOLE_BASE);
+    $http->set(['worker_num' => 1, 'log_file' => '/dev/null']);
+    $http->on('request', function ($req, $resp) {
+        switch ($req->server['request_uri'])
+        {
+        case '/read':
+            $resp->end(json_encode([
+                'header' => $req->header['x-test'],
+                'get' => $req->get,
+                'post' => $req->post,
+                'cookie' => $req->cookie,
+                'method' => $req->server['request_method'],
+                'isset' => isset($req->get['x']),
+            ]));
+            break;
+        case '/write':
+            //the application values are not replaced by the lazy arrays
+            $req->get = ['z' => 1];
+            unset($req->post);
+            $all = (array) $req;
+            $resp->end(json_encode([
+                'get' => $req->get,
+                'post' => isset($req->post),
+                'cookie' => $req->cookie,
+                'all' => [$all['get'], isset($all['post'])],
+            ]));
+            break;
+        case '/clone':
+            $copy = clone $req;
+            $copy->get['x'] = 'copy';
+            $resp->end(json_encode([$copy->get, $copy->header['x-test'], $req->get]));
+            break;
+        case '/dump':
+            $resp->end(array_names($req, true));
+            break;
+        case '/foreach':
+            $resp->end(array_names($req, false));
+            break;
+        case '/time':
+            //request_time is the arrival time, not the time of the first access
+            $start = time();
+            while (time() == $start)
+            {
+                usleep(50000);
+            }
+            $resp->end(var_export($req->server['request_time'] <= $start, true));
+            break;
+        case '/keep':
+            //built when the request is freed, the connection data is gone after that
+            $GLOBALS['kept'] = $req;
+            $resp->end('kept');
+            break;
+        case '/after':
+            $kept = $GLOBALS['kept'];
+            $resp->end(json_encode([$kept->get, $kept->post, $kept->cookie, $kept->header['x-test']]));
+            break;
+        }
+    });
+    $http->start();
+}, false, false);
+$pid = $server->start();
+
+function request($uri)
+{
+    $body = 'p=4';
+    $conn = stream_socket_client('tcp://127.0.0.1:' . PORT);
+    fwrite($conn, "POST $uri?x=1&y=2 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nX-Test: t\r\nCookie: c=3\r\n"
+        . "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " . strlen($body) . "\r\n\r\n" . $body);
+    $response = stream_get_contents($conn);
+    fclose($conn);
+    list(, $body) = explode("\r\n\r\n", $response, 2);
+    echo substr($uri, 1), ' ', $body, "\n";
+}
+
+for ($i = 0; $i < 50; $i++)
+{
+    usleep(100000);
+    if (@stream_socket_client('tcp://127.0.0.1:' . PORT))
+    {
+        break;
+    }
+}
+foreach (['/read', '/write', '/clone', '/dump', '/foreach', '/time', '/keep', '/after'] as $uri)
+{
+    request($uri);
+}
+swoole_process::kill($pid);
+swoole_process::wait();
+?>
+--EXPECT--
+read {"header":"t","get":{"x":"1","y":"2"},"post":{"p":"4"},"cookie":{"c":"3"},"method":"POST","isset":true}
+write {"get":{"z":1},"post":false,"cookie":{"c":"3"},"all":[{"z":1},false]}
+clone [{"x":"copy","y":"2"},"t",{"x":"1","y":"2"}]
+dump cookie,get,header,post,server
+foreach cookie,get,header,post,server
+time true
+keep kept
+after [{"x":"1","y":"2"},{"p":"4"},{"c":"3"},"t"]
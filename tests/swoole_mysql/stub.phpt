@@ -0,0 +1,220 @@
+--TEST--
+swoole_mysql: auth switch, text and binary result sets, pipeline, pool and connect timeout
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9513);
+define('SILENT_PORT', 9514);
+define('LOG', sys_get_temp_dir() . '/swoole_mysql_stub.log');
+
+function packet($payload, $sequence)
+{
+    return substr(pack('V', strlen($payload)), 0, 3) . chr($sequence) . $payload;
+}
+
+function lcs($str)
+{
+    return chr(strlen($str)) . $str;
+}
+
+function column($name, $type, $flags = 0)
+{
+    return lcs('def') . lcs('test') . lcs('t') . lcs('t') . lcs($name) . lcs($name)
+        . "\x0c" . pack('v', 33) . pack('V', 32) . chr($type) . pack('v', $flags) . "\x00\x00\x00";
+}
+
+function read_packet($conn, &$sequence = null)
+{
+    $head = fread($conn, 4);
+    if (strlen($head) < 4)
+    {
+        return false;
+    }
+    $length = unpack('V', substr($head, 0, 3) . "\0");
+    $sequence = ord($head[3]);
+    $payload = '';
+    while (strlen($payload) < $length[1])
+    {
+        $payload .= fread($conn, $length[1] - strlen($payload));
+    }
+    return $payload;
+}
+
+function native_token($password, $scramble)
+{
+    $stage1 = sha1($password, true);
+    return sha1($scramble . sha1($stage1, true), true) ^ $stage1;
+}
+
+function result_set(array $columns, array $rows)
+{
+    $seq = 1;
+    $out = packet(chr(count($columns)), $seq++);
+    foreach ($columns as $col)
+    {
+        $out .= packet($col, $seq++);
+    }
+    $out .= packet("\xfe\x00\x00\x02\x00", $seq++);
+    foreach ($rows as $row)
+    {
+        $out .= packet($row, $seq++);
+    }
+    return $out . packet("\xfe\x00\x00\x02\x00", $seq);
+}
+
+$server = new swoole_process(function () {
+    $sock = stream_socket_server('tcp://127.0.0.1:' . PORT);
+    $conn = stream_socket_accept($sock);
+    $log = [];
+
+    //handshake asks for caching_sha2_password, the client answers with mysql_native_password
+    $caps = 0x1 | 0x4 | 0x8 | 0x200 | 0x2000 | 0x8000 | 0x80000;
+    $scramble = 'abcdefghijklmnopqrst';
+    fwrite($conn, packet("\x0a" . "5.7.0-stub\0" . pack('V', 1) . substr($scramble, 0, 8) . "\0" . pack('v', $caps & 0xffff)
+        . "\x21" . pack('v', 2) . pack('v', $caps >> 16) . "\x15" . str_repeat("\0", 10)
+        . substr($scramble, 8) . "\0" . "caching_sha2_password\0", 0));
+    $payload = read_packet($conn, $seq);
+    $fields = explode("\0", substr($payload, 32));
+    $token = substr($payload, 32 + strlen($fields[0]) + 2, 20);
+    $db = substr($payload, 32 + strlen($fields[0]) + 22);
+    $log[] = "login {$fields[0]} " . strstr($db, "\0", true) . ' ' . ($token === native_token('secret', $scramble) ? 'ok' : 'bad');
+
+    $scramble = 'ABCDEFGHIJKLMNOPQRST';
+    fwrite($conn, packet("\xfe" . "mysql_native_password\0" . $scramble . "\0", $seq + 1));
+    $token = read_packet($conn, $seq);
+    $log[] = 'auth switch ' . ($token === native_token('secret', $scramble) ? 'ok' : 'bad');
+    fwrite($conn, packet("\x00\x00\x00\x02\x00\x00\x00", $seq + 1));
+
+    //the 3 queued requests are sent together after the authentication
+    $out = '';
+    for ($i = 0; $i < 3; $i++)
+    {
+        $payload = read_packet($conn);
+        $log[] = sprintf('command %02x %s', ord($payload[0]), substr($payload, 1));
+    }
+    $out .= result_set([column('id', 3), column('name', 0xfd), column('score', 5), column('note', 0xfd)], [
+        lcs('1') . lcs('swoole') . lcs('1.5') . "\xfb",
+        lcs('2') . lcs('php') . lcs('0.25') . lcs('x'),
+    ]);
+    $out .= packet("\x00\x03\x07\x02\x00\x00\x00", 1);
+    $out .= packet("\x00" . pack('V', 5) . pack('v', 3) . pack('v', 3) . "\x00\x00\x00", 1);
+    for ($i = 0; $i < 3; $i++)
+    {
+        $out .= packet(column('?', 0xfd), 2 + $i);
+    }
+    $out .= packet("\xfe\x00\x00\x02\x00", 5);
+    for ($i = 0; $i < 3; $i++)
+    {
+        $out .= packet(column('c' . $i, 0xfd), 6 + $i);
+    }
+    $out .= packet("\xfe\x00\x00\x02\x00", 9);
+    //the responses arrive in pieces, cut in the middle of a packet
+    foreach (str_split($out, 37) as $piece)
+    {
+        fwrite($conn, $piece);
+        usleep(10000);
+    }
+
+    //stmt id, flags, iteration count, null bitmap, new params bound, types, values
+    $payload = read_packet($conn);
+    $stmt = unpack('Vid', substr($payload, 1, 4));
+    $types = unpack('v3', substr($payload, 12, 6));
+    $values = substr($payload, 18);
+    $log[] = sprintf('execute %d null=%02x types=%02x,%02x,%02x a=%d b=%s', $stmt['id'], ord($payload[10]),
+        $types[1] & 0xff, $types[2] & 0xff, $types[3] & 0xff, unpack('Va', substr($values, 0, 4))['a'], substr($values, 9, ord($values[8])));
+    $datetime = "\x07" . pack('v', 2016) . "\x0a\x01\x0c\x1e\x05";
+    fwrite($conn, result_set([column('a', 8), column('b', 0xfd), column('c', 3), column('d', 12), column('e', 5)], [
+        "\x00\x10" . pack('V', 42) . pack('V', 0) . lcs('abc') . $datetime . pack('d', 2.5),
+    ]));
+
+    //the next client borrows the same connection from the pool
+    $payload = read_packet($conn);
+    $log[] = sprintf('command %02x %s', ord($payload[0]), substr($payload, 1));
+    file_put_contents(LOG, implode("\n", $log));
+    fwrite($conn, packet("\xff" . pack('v', 1146) . "#42S02Table 'test.t2' doesn't exist", 1));
+    fclose($conn);
+}, false, false);
+$server->start();
+usleep(300000);
+
+$config = [
+    'host' => '127.0.0.1',
+    'port' => PORT,
+    'user' => 'root',
+    'password' => 'secret',
+    'database' => 'test',
+    'pipeline' => true,
+    'pool_size' => 1,
+];
+
+function timeout()
+{
+    $silent = stream_socket_server('tcp://127.0.0.1:' . SILENT_PORT);
+    //the object is not kept by connect()
+    $db = $GLOBALS['timeout_db'] = new swoole_mysql;
+    $start = microtime(true);
+    $db->connect(['host' => '127.0.0.1', 'port' => SILENT_PORT, 'user' => 'root', 'timeout' => 0.5], function ($db, $r) use ($start, $silent) {
+        $time = microtime(true) - $start;
+        echo 'timeout ', var_export($r, true), " {$db->connect_errno} {$db->connect_error} ", ($time > 0.4 && $time < 1.0) ? 'in time' : $time, "\n";
+        fclose($silent);
+        swoole_process::wait();
+        echo file_get_contents(LOG), "\n";
+        unlink(LOG);
+        swoole_event_exit();
+    });
+}
+
+function pooled($config)
+{
+    $db = $GLOBALS['pooled_db'] = new swoole_mysql;
+    $db->on('close', function ($db) {
+        echo "close\n";
+        timeout();
+    });
+    $db->connect($config, function ($db, $r) {
+        echo 'pooled ', var_export($r, true), "\n";
+        $db->query('SELECT * FROM t2', function ($db, $r) {
+            echo 'error ', var_export($r, true), " {$db->errno} {$db->error}\n";
+        });
+    });
+}
+
+$db = new swoole_mysql;
+$db->connect($config, function ($db, $r) {
+    echo 'connect ', var_export($r, true), "\n";
+});
+//queued before the authentication is done
+$db->query('SELECT * FROM t', function ($db, $r) {
+    echo 'query ', json_encode($r), "\n";
+});
+$db->query('UPDATE t SET a = 1', function ($db, $r) {
+    echo 'update ', var_export($r, true), " {$db->affected_rows} {$db->insert_id}\n";
+});
+$db->prepare('SELECT ?, ?, ?', function ($db, $stmt) use ($config) {
+    echo "prepare $stmt\n";
+    $db->execute($stmt, [42, 'abc', null], function ($db, $r) use ($config) {
+        echo 'execute ', json_encode($r), "\n";
+        //the idle connection goes back to the pool
+        $db->close();
+        pooled($config);
+    });
+});
+?>
+--EXPECT--
+connect true
+query [{"id":1,"name":"swoole","score":1.5,"note":null},{"id":2,"name":"php","score":0.25,"note":"x"}]
+update true 3 7
+prepare 5
+execute [{"a":42,"b":"abc","c":null,"d":"2016-10-01 12:30:05","e":2.5}]
+pooled true
+error false 1146 Table 'test.t2' doesn't exist
+close
+timeout false 110 connect timeout in time
+login root test ok
+auth switch ok
+command 03 SELECT * FROM t
+command 03 UPDATE t SET a = 1
+command 16 SELECT ?, ?, ?
+execute 5 null=04 types=08,fd,06 a=42 b=abc
+command 03 SELECT * FROM t2
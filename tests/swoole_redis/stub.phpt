@@ -0,0 +1,280 @@
+--TEST--
+swoole_redis: coalesced writes, split replies, MULTI/EXEC, pub/sub and MOVED/ASK
+--SKIPIF--
+<?php if (!extension_loaded('swoole')) print 'skip'; ?>
+--FILE--
+<?php
+define('PORT', 9515);
+define('NODE_A', 9516);
+define('NODE_B', 9517);
+define('LOG', sys_get_temp_dir() . '/swoole_redis_stub.log');
+
+function bulk($str)
+{
+    return $str === null ? "\$-1\r\n" : '$' . strlen($str) . "\r\n$str\r\n";
+}
+
+function multi_bulk(array $items)
+{
+    $out = '*' . count($items) . "\r\n";
+    foreach ($items as $item)
+    {
+        $out .= is_int($item) ? ":$item\r\n" : bulk($item);
+    }
+    return $out;
+}
+
+//take one command from the buffer, null if it is incomplete
+function read_command(&$buffer)
+{
+    if (!preg_match('/^\*(\d+)\r\n/', $buffer, $match))
+    {
+        return null;
+    }
+    $offset = strlen($match[0]);
+    $args = [];
+    for ($i = 0; $i < $match[1]; $i++)
+    {
+        if (!preg_match('/\G\$(\d+)\r\n/', $buffer, $len, 0, $offset) || strlen($buffer) < $offset + strlen($len[0]) + $len[1] + 2)
+        {
+            return null;
+        }
+        $offset += strlen($len[0]);
+        $args[] = substr($buffer, $offset, $len[1]);
+        $offset += $len[1] + 2;
+    }
+    $buffer = substr($buffer, $offset);
+    $args[0] = strtoupper($args[0]);
+    return $args;
+}
+
+function reply($port, array $args)
+{
+    static $ask = true;
+    $command = implode(' ', $args);
+    if ($port == PORT)
+    {
+        switch ($command)
+        {
+        case 'SET k1 v1':
+        case 'MULTI':
+            return "+OK\r\n";
+        case 'GET k1':
+            return bulk('v1');
+        case 'GET missing':
+            return bulk(null);
+        case 'INCR n':
+            return ":42\r\n";
+        case 'LRANGE list 0 -1':
+            return multi_bulk(['one', 'two']);
+        case 'EXEC':
+            return "*4\r\n+OK\r\n:2\r\n" . multi_bulk(['a', 'b']) . "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+        case 'SUBSCRIBE ch1 ch2':
+            return multi_bulk(['subscribe', 'ch1', 1]) . multi_bulk(['subscribe', 'ch2', 2])
+                . multi_bulk(['message', 'ch1', 'hello']) . multi_bulk(['message', 'ch2', 'world']);
+        case 'UNSUBSCRIBE':
+            return multi_bulk(['unsubscribe', 'ch1', 1]) . multi_bulk(['unsubscribe', 'ch2', 0]);
+        default:
+            //the commands in the transaction
+            return "+QUEUED\r\n";
+        }
+    }
+    if ($port == NODE_A)
+    {
+        switch ($command)
+        {
+        case 'CLUSTER SLOTS':
+            return "*1\r\n*3\r\n:0\r\n:16383\r\n" . multi_bulk(['127.0.0.1', NODE_A, 'a']);
+        case 'GET foo':
+            return "-MOVED 12182 127.0.0.1:" . NODE_B . "\r\n";
+        case 'GET bar':
+            $ask = !$ask;
+            return $ask ? bulk('bar-a') : "-ASK 5061 127.0.0.1:" . NODE_B . "\r\n";
+        }
+    }
+    if ($port == NODE_B)
+    {
+        switch ($command)
+        {
+        case 'ASKING':
+            return "+OK\r\n";
+        case 'GET foo':
+            return bulk('foo-b');
+        case 'GET bar':
+            return bulk('bar-b');
+        }
+    }
+    return "-ERR unknown command\r\n";
+}
+
+$server = new swoole_process(function () {
+    $listeners = [];
+    foreach ([PORT, NODE_A, NODE_B] as $port)
+    {
+        $listeners[$port] = stream_socket_server('tcp://127.0.0.1:' . $port);
+    }
+    $conns = [];
+    while (true)
+    {
+        $read = array_merge(array_values($listeners), array_column($conns, 'sock'));
+        $write = $except = null;
+        stream_select($read, $write, $except, null);
+        foreach ($read as $sock)
+        {
+            $port = array_search($sock, $listeners, true);
+            if ($port !== false)
+            {
+                $client = stream_socket_accept($sock);
+                $conns[(int) $client] = ['sock' => $client, 'port' => $port, 'buffer' => ''];
+                continue;
+            }
+            $data = fread($sock, 65536);
+            if ($data === '' || $data === false)
+            {
+                fclose($sock);
+                unset($conns[(int) $sock]);
+                continue;
+            }
+            $conn = &$conns[(int) $sock];
+            //the commands received by one read
+            $conn['buffer'] .= $data;
+            $commands = [];
+            $out = '';
+            while (($args = read_command($conn['buffer'])) !== null)
+            {
+                $commands[] = implode(' ', $args);
+                $out .= reply($conn['port'], $args);
+            }
+            file_put_contents(LOG, $conn['port'] . ': ' . implode(' | ', $commands) . "\n", FILE_APPEND);
+            //the replies arrive in pieces, a reply or a nested array is split
+            foreach (str_split($out, 7) as $piece)
+            {
+                fwrite($sock, $piece);
+                usleep(5000);
+            }
+            unset($conn);
+        }
+    }
+}, false, false);
+$pid = $server->start();
+usleep(300000);
+
+function finish()
+{
+    global $pid;
+    swoole_process::kill($pid);
+    swoole_process::wait();
+    echo file_get_contents(LOG);
+    unlink(LOG);
+    swoole_event_exit();
+}
+
+function cluster()
+{
+    //the object is not kept by connect()
+    $redis = $GLOBALS['cluster'] = new swoole_redis(['cluster' => true]);
+    $redis->connect('127.0.0.1', NODE_A, function ($redis, $r) {
+        echo 'cluster ', json_encode($r), "\n";
+        $redis->get('foo', function ($redis, $r) {
+            echo 'moved ', json_encode($r), "\n";
+            //the slot belongs to the new node now
+            $redis->get('foo', function ($redis, $r) {
+                echo 'moved again ', json_encode($r), "\n";
+                $redis->get('bar', function ($redis, $r) {
+                    echo 'ask ', json_encode($r), "\n";
+                    //ASK does not change the owner of the slot
+                    $redis->get('bar', function ($redis, $r) {
+                        echo 'ask again ', json_encode($r), "\n";
+                        $redis->close();
+                        finish();
+                    });
+                });
+            });
+        });
+    });
+}
+
+$redis = new swoole_redis;
+$redis->on('close', function ($redis) {
+    echo "close\n";
+    cluster();
+});
+$redis->on('message', function ($redis, $message) {
+    echo 'message ', json_encode($message), "\n";
+    if ($message[1] == 'ch2' && $message[0] == 'message')
+    {
+        var_dump($redis->get('k1'));
+        $redis->unsubscribe();
+    }
+    elseif ($message[0] == 'unsubscribe' && $message[2] == 0)
+    {
+        $redis->get('k1', function ($redis, $r) {
+            echo 'get ', json_encode($r), "\n";
+            $redis->close();
+        });
+    }
+});
+$redis->connect('127.0.0.1', PORT, function ($redis, $r) {
+    echo 'connect ', json_encode($r), "\n";
+    $redis->set('k1', 'v1', function ($redis, $r) {
+        echo 'set ', json_encode($r), "\n";
+    });
+    //nothing is sent until the end of this loop
+    usleep(100000);
+    $redis->get('k1', function ($redis, $r) {
+        echo 'get ', json_encode($r), "\n";
+    });
+    $redis->get('missing', function ($redis, $r) {
+        echo 'get ', json_encode($r), "\n";
+    });
+    $redis->incr('n', function ($redis, $r) {
+        echo 'incr ', json_encode($r), "\n";
+    });
+    $redis->lrange('list', 0, -1, function ($redis, $r) {
+        echo 'lrange ', json_encode($r), "\n";
+    });
+    $redis->multi();
+    $redis->set('x', 1);
+    $redis->incr('x');
+    $redis->lrange('x', 0, -1);
+    $redis->lpush('x', 'a');
+    $redis->exec(function ($redis, $r) {
+        echo 'exec ', json_encode($r), "\n";
+        $redis->subscribe('ch1', 'ch2');
+    });
+});
+?>
+--EXPECTF--
+connect true
+set "OK"
+get "v1"
+get null
+incr 42
+lrange ["one","two"]
+exec ["OK",2,["a","b"],false]
+message ["subscribe","ch1",1]
+message ["subscribe","ch2",2]
+message ["message","ch1","hello"]
+message ["message","ch2","world"]
+%AWarning: %Aonly (P)SUBSCRIBE and (P)UNSUBSCRIBE can be used in subscribe mode.%A
+bool(false)
+message ["unsubscribe","ch1",1]
+message ["unsubscribe","ch2",0]
+get "v1"
+close
+cluster true
+moved "foo-b"
+moved again "foo-b"
+ask "bar-b"
+ask again "bar-a"
+9515: SET k1 v1 | GET k1 | GET missing | INCR n | LRANGE list 0 -1 | MULTI | SET x 1 | INCR x | LRANGE x 0 -1 | LPUSH x a | EXEC
+9515: SUBSCRIBE ch1 ch2
+9515: UNSUBSCRIBE
+9515: GET k1
+9516: CLUSTER SLOTS
+9516: GET foo
+9517: GET foo
+9517: GET foo
+9516: GET bar
+9517: ASKING | GET bar
+9516: GET bar
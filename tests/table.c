@@ -0,0 +1,779 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "table.h"
+#include "tests.h"
+
+#define TABLE_TEST_ROWS    1000000
+#define TABLE_TEST_MAPFILE "/tmp/swoole_table_test.data"
+#define TABLE_TEST_KEYS    100000
+
+static uint64_t table_test_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static swTable* table_test_create(int size, int rows)
+{
+    char key[32], name[32];
+    int i, keylen;
+    int64_t age;
+    swTableRow *row;
+
+    swTable *table = swTable_new(size, size);
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    swTableColumn_add(table, SW_STRL("age") - 1, SW_TABLE_INT, 8);
+    swTableColumn_add(table, SW_STRL("name") - 1, SW_TABLE_STRING, 32);
+    swTableColumn_add(table, SW_STRL("score") - 1, SW_TABLE_FLOAT, 0);
+    if (swTable_create(table) < 0)
+    {
+        return NULL;
+    }
+
+    swTableColumn *col_age = swTableColumn_get(table, SW_STRL("age") - 1);
+    swTableColumn *col_name = swTableColumn_get(table, SW_STRL("name") - 1);
+    swTableColumn *col_score = swTableColumn_get(table, SW_STRL("score") - 1);
+    double score;
+
+    for (i = 0; i < rows; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", i);
+        row = swTableRow_set(table, key, keylen);
+        if (row == NULL)
+        {
+            break;
+        }
+        age = i % 100;
+        score = i / 2.0;
+        swTableRow_set_value(row, col_age, &age, 0);
+        swTableRow_set_value(row, col_name, name, snprintf(name, sizeof(name), "user-%d", i));
+        swTableRow_set_value(row, col_score, &score, 0);
+        swTableRow_unlock(row);
+    }
+    return table;
+}
+
+swUnitTest(table_test1)
+{
+    swTable_condition conds[2];
+    swTableRow *rows;
+    uint64_t start;
+    int n, i;
+
+    swTable *table = table_test_create(TABLE_TEST_ROWS * 2, TABLE_TEST_ROWS);
+    if (table == NULL || table->row_num != TABLE_TEST_ROWS)
+    {
+        return 1;
+    }
+
+    bzero(conds, sizeof(conds));
+    conds[0].column = swTableColumn_get(table, SW_STRL("age") - 1);
+    conds[0].op = SW_TABLE_FIND_GT;
+    conds[0].lval = 89;
+
+    start = table_test_now();
+    n = swTable_find(table, conds, 1, 0, 0, &rows);
+    printf("find age>89 in %d rows: %d matched, %.3fms\n", table->row_num, n, (table_test_now() - start) / 1000000.0);
+    for (i = 0; i < n; i++)
+    {
+        if (swTableRow_get_long(swTable_find_row(table, rows, i), conds[0].column) <= 89)
+        {
+            return 2;
+        }
+    }
+    sw_free(rows);
+
+    //limit and offset
+    n = swTable_find(table, conds, 1, 10, 20, &rows);
+    if (n != 20)
+    {
+        return 3;
+    }
+    sw_free(rows);
+
+    conds[1].column = swTableColumn_get(table, SW_STRL("name") - 1);
+    conds[1].op = SW_TABLE_FIND_RIGHTLIKE;
+    conds[1].str = "99";
+    conds[1].str_len = 2;
+    conds[0].op = SW_TABLE_FIND_EQ;
+    conds[0].lval = 99;
+
+    start = table_test_now();
+    n = swTable_find(table, conds, 2, 0, 0, &rows);
+    printf("find age=99 and name like '%%99' in %d rows: %d matched, %.3fms\n", table->row_num, n,
+            (table_test_now() - start) / 1000000.0);
+    sw_free(rows);
+    //age=i%100, the names of these rows always end with 99
+    if (n != TABLE_TEST_ROWS / 100)
+    {
+        return 4;
+    }
+
+    swTable_free(table);
+    return 0;
+}
+
+static swTable* table_test_mmap(void)
+{
+    //the buckets are split while writing
+    swTable *table = swTable_new(1024, TABLE_TEST_KEYS * 2);
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    swTableColumn_add(table, SW_STRL("id") - 1, SW_TABLE_INT, 8);
+    swTableColumn_add(table, SW_STRL("check") - 1, SW_TABLE_INT, 8);
+    if (swTable_create_mmap(table, TABLE_TEST_MAPFILE) < 0)
+    {
+        return NULL;
+    }
+    return table;
+}
+
+static void table_test_write(swTable *table, int n)
+{
+    swTableColumn *col_id = swTableColumn_get(table, SW_STRL("id") - 1);
+    swTableColumn *col_check = swTableColumn_get(table, SW_STRL("check") - 1);
+    swTableRow *row;
+    char key[32];
+    int i, keylen;
+    int64_t id, check;
+
+    for (i = 0; n < 0 || i < n; i++)
+    {
+        id = rand() % TABLE_TEST_KEYS;
+        keylen = snprintf(key, sizeof(key), "key-%d", (int) id);
+        if (rand() % 4 == 0)
+        {
+            swTableRow_del(table, key, keylen);
+            continue;
+        }
+        row = swTableRow_set(table, key, keylen);
+        if (row == NULL)
+        {
+            continue;
+        }
+        check = id * 7;
+        swTableRow_set_value(row, col_id, &id, 0);
+        swTableRow_set_value(row, col_check, &check, 0);
+        swTableRow_unlock(row);
+    }
+}
+
+/**
+ * all the rows can be found by the keys, return the number of the rows written partly
+ */
+static uint32_t table_test_buckets(swTable *table)
+{
+    swTable_header *header = table->memory;
+    return (header->state >> 32) + (uint32_t) header->state;
+}
+
+static int table_test_check(swTable *table)
+{
+    swTableColumn *col_id = swTableColumn_get(table, SW_STRL("id") - 1);
+    swTableColumn *col_check = swTableColumn_get(table, SW_STRL("check") - 1);
+    swTableRow *row;
+    char key[32];
+    uint32_t i, count = 0, list_count = 0;
+    int keylen, broken = 0;
+    int64_t id;
+
+    for (i = 0; i < table_test_buckets(table); i++)
+    {
+        for (row = table->rows[i]; row != NULL && row->active; row = row->next)
+        {
+            count++;
+            if (row->lock != 0)
+            {
+                return -1;
+            }
+            id = swTableRow_get_long(row, col_id);
+            keylen = snprintf(key, sizeof(key), "key-%d", (int) id);
+            if (swoole_crc32(key, keylen) != row->crc32 || swTableRow_get_long(row, col_check) != id * 7)
+            {
+                broken++;
+                continue;
+            }
+            if (swTableRow_get(table, key, keylen) != row)
+            {
+                return -1;
+            }
+            swTableRow_unlock(row);
+        }
+    }
+    for (i = 0; i < table->list_n; i++)
+    {
+        if (table->rows_list[i] != NULL)
+        {
+            list_count++;
+        }
+    }
+    if (count != table->row_num || list_count > count)
+    {
+        return -1;
+    }
+    return broken;
+}
+
+swUnitTest(table_test2)
+{
+    swTable *table;
+    uint64_t start;
+    void *memory;
+    pid_t pid;
+    int status, broken;
+
+    unlink(TABLE_TEST_MAPFILE);
+    table = table_test_mmap();
+    if (table == NULL)
+    {
+        return 1;
+    }
+
+    //the writer is killed while writing
+    pid = fork();
+    if (pid == 0)
+    {
+        table_test_write(table, -1);
+        exit(0);
+    }
+    usleep(300000);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    //the master crashes, the table is not detached
+    memory = table->memory;
+    sw_shm_free(table->memory);
+
+    start = table_test_now();
+    table = table_test_mmap();
+    if (table == NULL)
+    {
+        return 2;
+    }
+    printf("recover %d rows: %.3fms, same address: %d\n", table->row_num, (table_test_now() - start) / 1000000.0,
+            table->memory == memory);
+    broken = table_test_check(table);
+    printf("rows written partly: %d\n", broken);
+    if (broken < 0 || broken > 1)
+    {
+        return 3;
+    }
+
+    //the pool and the lists are usable after recovery
+    table_test_write(table, TABLE_TEST_KEYS);
+    if (table_test_check(table) < 0)
+    {
+        return 4;
+    }
+
+    //detached cleanly, the address is used by others
+    memory = table->memory;
+    swTable_free(table);
+    void *other = mmap(memory - sizeof(swShareMemory), 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+    table = table_test_mmap();
+    if (table == NULL || table->memory == memory || table_test_check(table) < 0)
+    {
+        return 5;
+    }
+    munmap(other, 4096);
+
+    //detached cleanly, attach in constant time
+    memory = table->memory;
+    status = table->row_num;
+    swTable_free(table);
+    start = table_test_now();
+    table = table_test_mmap();
+    printf("attach %d rows: %.3fms, same address: %d\n", table->row_num, (table_test_now() - start) / 1000000.0,
+            table->memory == memory);
+    if (table->row_num != status || table_test_check(table) < 0)
+    {
+        return 6;
+    }
+    table_test_write(table, TABLE_TEST_KEYS);
+    if (table_test_check(table) < 0)
+    {
+        return 7;
+    }
+
+    swTable_free(table);
+    unlink(TABLE_TEST_MAPFILE);
+    return 0;
+}
+
+/**
+ * the processes insert and read the rows while the buckets are split
+ */
+static int table_test_grow(swTable *table, int start, int n)
+{
+    swTableColumn *col_id = swTableColumn_get(table, SW_STRL("id") - 1);
+    swTableRow *row;
+    char key[32];
+    int i, j, keylen;
+    int64_t id;
+
+    for (i = start; i < start + n; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", i);
+        row = swTableRow_set(table, key, keylen);
+        if (row == NULL)
+        {
+            return -1;
+        }
+        id = i;
+        swTableRow_set_value(row, col_id, &id, 0);
+        swTableRow_unlock(row);
+
+        //a key written before
+        j = start + rand() % (i - start + 1);
+        keylen = snprintf(key, sizeof(key), "key-%d", j);
+        row = swTableRow_get(table, key, keylen);
+        if (row == NULL)
+        {
+            return -1;
+        }
+        if (swTableRow_get_long(row, col_id) != j)
+        {
+            swTableRow_unlock(row);
+            return -1;
+        }
+        swTableRow_unlock(row);
+    }
+    return 0;
+}
+
+swUnitTest(table_test3)
+{
+    int i, n = TABLE_TEST_KEYS * 2, status, worker_num = 2;
+    pid_t pid;
+    char key[32];
+    int keylen;
+    uint64_t start;
+    swTableRow *row;
+
+    swTable *table = swTable_new(1024, 1 << 20);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    swTableColumn_add(table, SW_STRL("id") - 1, SW_TABLE_INT, 8);
+    if (swTable_create(table) < 0)
+    {
+        return 1;
+    }
+
+    start = table_test_now();
+    for (i = 0; i < worker_num; i++)
+    {
+        pid = fork();
+        if (pid == 0)
+        {
+            srand(getpid());
+            exit(table_test_grow(table, i * n, n) < 0 ? 1 : 0);
+        }
+    }
+    for (i = 0; i < worker_num; i++)
+    {
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            return 2;
+        }
+    }
+    printf("insert %d rows: %.3fms, buckets: 1024 -> %d\n", table->row_num, (table_test_now() - start) / 1000000.0,
+            table_test_buckets(table));
+
+    if (table->row_num != n * worker_num || table_test_buckets(table) <= 1024)
+    {
+        return 3;
+    }
+    swTableColumn *col_id = swTableColumn_get(table, SW_STRL("id") - 1);
+    for (i = 0; i < n * worker_num; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", i);
+        row = swTableRow_get(table, key, keylen);
+        if (row == NULL)
+        {
+            return 4;
+        }
+        if (swTableRow_get_long(row, col_id) != i)
+        {
+            return 5;
+        }
+        swTableRow_unlock(row);
+    }
+    for (i = 0; i < n * worker_num; i += 2)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", i);
+        if (swTableRow_del(table, key, keylen) < 0)
+        {
+            return 6;
+        }
+    }
+    if (table->row_num != n)
+    {
+        return 7;
+    }
+
+    swTable_free(table);
+    return 0;
+}
+
+/**
+ * the table is a cache: the hot rows stay when it is full, the rows with ttl expire
+ */
+swUnitTest(table_test4)
+{
+    char key[32];
+    int i, j, keylen, hot = 0, hot_n = 100, n = TABLE_TEST_KEYS;
+    swTableRow *row;
+
+    swTable *table = swTable_new(1024, 1024);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    table->evict = SW_TABLE_EVICT_LRU;
+    swTableColumn_add(table, SW_STRL("id") - 1, SW_TABLE_INT, 4);
+    if (swTable_create(table) < 0)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", i);
+        row = swTableRow_set(table, key, keylen);
+        if (row == NULL)
+        {
+            return 2;
+        }
+        swTableRow_unlock(row);
+        //the first rows are read all the time
+        if (i >= hot_n && i % hot_n == 0)
+        {
+            for (j = 0; j < hot_n; j++)
+            {
+                keylen = snprintf(key, sizeof(key), "key-%d", j);
+                row = swTableRow_get(table, key, keylen);
+                if (row)
+                {
+                    swTableRow_unlock(row);
+                }
+            }
+        }
+    }
+    for (j = 0; j < hot_n; j++)
+    {
+        keylen = snprintf(key, sizeof(key), "key-%d", j);
+        row = swTableRow_get(table, key, keylen);
+        if (row)
+        {
+            hot++;
+            swTableRow_unlock(row);
+        }
+    }
+    printf("lru: %d rows, %d/%d hot rows left after %d rows are written\n", table->row_num, hot, hot_n, n);
+    if (table->row_num > table->max_size || hot < hot_n * 9 / 10)
+    {
+        return 3;
+    }
+
+    //the rows with ttl, a few of them may be evicted by the others
+    for (i = 0; i < 500; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "ttl-%d", i);
+        row = swTableRow_set(table, key, keylen);
+        if (row == NULL)
+        {
+            return 4;
+        }
+        swTableRow_set_ttl(table, row, 1);
+        swTableRow_unlock(row);
+    }
+    for (i = 0, hot = 0; i < 500; i++)
+    {
+        keylen = snprintf(key, sizeof(key), "ttl-%d", i);
+        row = swTableRow_get(table, key, keylen);
+        if (row)
+        {
+            hot++;
+            swTableRow_unlock(row);
+        }
+    }
+    sleep(2);
+    //removed when it is accessed
+    keylen = snprintf(key, sizeof(key), "ttl-%d", 499);
+    if (swTableRow_get(table, key, keylen) != NULL)
+    {
+        return 5;
+    }
+    n = table->row_num;
+    i = swTable_sweep(table, table->size);
+    printf("ttl: %d expired rows are swept, %d rows left\n", i, table->row_num);
+    if (i < hot - 1 || i > hot || table->row_num != n - i)
+    {
+        return 6;
+    }
+
+    swTable_free(table);
+    return 0;
+}
+
+#define TABLE_TEST_INCR_N      1000000
+#define TABLE_TEST_INCR_WORKER 4
+
+static void table_test_incr_locked(swTable *table, swTableColumn *col, int n)
+{
+    int i;
+    int64_t value;
+    swTableRow *row;
+
+    for (i = 0; i < n; i++)
+    {
+        //the incr before swTableRow_incr
+        row = swTableRow_set(table, SW_STRL("counter") - 1);
+        memcpy(&value, row->data + col->index, sizeof(value));
+        value++;
+        swTableRow_set_value(row, col, &value, 0);
+        swTableRow_unlock(row);
+    }
+}
+
+static void table_test_incr_atomic(swTable *table, swTableColumn *col, int n)
+{
+    int i;
+    int64_t value;
+
+    for (i = 0; i < n; i++)
+    {
+        swTableRow_incr(table, SW_STRL("counter") - 1, col, 1, &value);
+    }
+}
+
+static int table_test_incr_run(swTable *table, swTableColumn *col, int atomic)
+{
+    int i, status;
+    uint64_t start = table_test_now();
+    swTableRow *row;
+    int64_t value;
+
+    fflush(stdout);
+    for (i = 0; i < TABLE_TEST_INCR_WORKER; i++)
+    {
+        if (fork() == 0)
+        {
+            if (atomic)
+            {
+                table_test_incr_atomic(table, col, TABLE_TEST_INCR_N);
+            }
+            else
+            {
+                table_test_incr_locked(table, col, TABLE_TEST_INCR_N);
+            }
+            exit(0);
+        }
+    }
+    for (i = 0; i < TABLE_TEST_INCR_WORKER; i++)
+    {
+        wait(&status);
+    }
+    printf("%s incr: %d processes, %.0f ops/s\n", atomic ? "atomic" : "locked", TABLE_TEST_INCR_WORKER,
+            (double) TABLE_TEST_INCR_N * TABLE_TEST_INCR_WORKER * 1000000000 / (table_test_now() - start));
+
+    row = swTableRow_get(table, SW_STRL("counter") - 1);
+    value = swTableRow_get_long(row, col);
+    swTableRow_unlock(row);
+    swTableRow_del(table, SW_STRL("counter") - 1);
+    return value == (int64_t) TABLE_TEST_INCR_N * TABLE_TEST_INCR_WORKER ? SW_OK : SW_ERR;
+}
+
+/**
+ * the hot counter: incr with the row lock vs the atomic instruction under the shared lock.
+ * the totals are checked, the timings are only printed
+ */
+swUnitTest(table_test5)
+{
+    int64_t value;
+    double score;
+
+    swTable *table = swTable_new(1024, 1024);
+    if (table == NULL)
+    {
+        return 1;
+    }
+    swTableColumn_add(table, SW_STRL("flag") - 1, SW_TABLE_INT, 1);
+    swTableColumn_add(table, SW_STRL("count") - 1, SW_TABLE_INT, 8);
+    swTableColumn_add(table, SW_STRL("score") - 1, SW_TABLE_FLOAT, 0);
+    if (swTable_create(table) < 0)
+    {
+        return 1;
+    }
+    swTableColumn *col_count = swTableColumn_get(table, SW_STRL("count") - 1);
+    swTableColumn *col_score = swTableColumn_get(table, SW_STRL("score") - 1);
+    swTableColumn *col_flag = swTableColumn_get(table, SW_STRL("flag") - 1);
+    if (col_count->index % 8 != 0)
+    {
+        return 2;
+    }
+
+    if (table_test_incr_run(table, col_count, 0) < 0 || table_test_incr_run(table, col_count, 1) < 0)
+    {
+        return 3;
+    }
+
+    //the new row starts from zero
+    if (swTableRow_incr(table, SW_STRL("key") - 1, col_flag, -3, &value) < 0 || value != -3)
+    {
+        return 4;
+    }
+    if (swTableRow_incr_float(table, SW_STRL("key") - 1, col_score, 1.5, &score) < 0 || score != 1.5)
+    {
+        return 5;
+    }
+    if (swTableRow_cas(table, SW_STRL("key") - 1, col_flag, 0, 1) == SW_OK
+            || swTableRow_cas(table, SW_STRL("key") - 1, col_flag, -3, 1) < 0)
+    {
+        return 6;
+    }
+    if (swTableRow_cas_float(table, SW_STRL("key") - 1, col_score, 1.5, 2.5) < 0
+            || swTableRow_cas(table, SW_STRL("nokey") - 1, col_flag, 0, 1) == SW_OK)
+    {
+        return 7;
+    }
+
+    swTable_free(table);
+    return 0;
+}
+
+#define TABLE_TEST_BATCH_N     50
+#define TABLE_TEST_BATCH_LOOP  20000
+
+static void table_test_batch_set(swTable *table, swTableRow *row, int index, void *arg)
+{
+    int *ids = arg;
+    int64_t age = ids[index];
+    swTableRow_set_value(row, swTableColumn_get(table, SW_STRL("age") - 1), &age, 0);
+}
+
+static void table_test_batch_get(swTable *table, swTableRow *row, int index, void *arg)
+{
+    int *ids = arg;
+    if (swTableRow_get_long(row, swTableColumn_get(table, SW_STRL("age") - 1)) == ids[index] % 100)
+    {
+        ids[index] = -1;
+    }
+}
+
+/**
+ * 50 keys in a request: one by one vs the batch
+ */
+swUnitTest(table_test6)
+{
+    swTable_key keys[TABLE_TEST_BATCH_N];
+    char buf[TABLE_TEST_BATCH_N][32];
+    int ids[TABLE_TEST_BATCH_N];
+    uint64_t start, single, batch;
+    swTableRow *row;
+    int i, j, n;
+
+    swTable *table = table_test_create(TABLE_TEST_ROWS * 2, TABLE_TEST_ROWS);
+    if (table == NULL || table->row_num != TABLE_TEST_ROWS)
+    {
+        return 1;
+    }
+    for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+    {
+        keys[i].str = buf[i];
+    }
+
+    single = batch = 0;
+    for (j = 0; j < TABLE_TEST_BATCH_LOOP; j++)
+    {
+        for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+        {
+            ids[i] = rand() % TABLE_TEST_ROWS;
+            keys[i].length = snprintf(buf[i], sizeof(buf[i]), "key-%d", ids[i]);
+        }
+        start = table_test_now();
+        for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+        {
+            row = swTableRow_get(table, keys[i].str, keys[i].length);
+            if (row)
+            {
+                swTableRow_unlock(row);
+            }
+        }
+        single += table_test_now() - start;
+
+        for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+        {
+            ids[i] = rand() % TABLE_TEST_ROWS;
+            keys[i].length = snprintf(buf[i], sizeof(buf[i]), "key-%d", ids[i]);
+        }
+        start = table_test_now();
+        n = swTableRow_get_multi(table, keys, TABLE_TEST_BATCH_N, table_test_batch_get, ids);
+        batch += table_test_now() - start;
+        if (n != TABLE_TEST_BATCH_N)
+        {
+            return 2;
+        }
+        for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+        {
+            if (ids[i] != -1)
+            {
+                return 3;
+            }
+        }
+    }
+    printf("get %d keys: single %.3fus, batch %.3fus\n", TABLE_TEST_BATCH_N,
+            single / 1000.0 / TABLE_TEST_BATCH_LOOP, batch / 1000.0 / TABLE_TEST_BATCH_LOOP);
+
+    //the new keys and the same key twice
+    for (i = 0; i < TABLE_TEST_BATCH_N; i++)
+    {
+        ids[i] = i == TABLE_TEST_BATCH_N - 1 ? 0 : TABLE_TEST_ROWS + i;
+        keys[i].length = snprintf(buf[i], sizeof(buf[i]), "key-%d", ids[i]);
+    }
+    if (swTableRow_set_multi(table, keys, TABLE_TEST_BATCH_N, table_test_batch_set, ids) != TABLE_TEST_BATCH_N
+            || table->row_num != TABLE_TEST_ROWS + TABLE_TEST_BATCH_N - 1)
+    {
+        return 4;
+    }
+    if (swTableRow_get_multi(table, keys, TABLE_TEST_BATCH_N, table_test_batch_get, ids) != TABLE_TEST_BATCH_N)
+    {
+        return 5;
+    }
+    if (swTableRow_del_multi(table, keys, TABLE_TEST_BATCH_N) != TABLE_TEST_BATCH_N
+            || table->row_num != TABLE_TEST_ROWS - 1)
+    {
+        return 6;
+    }
+    if (swTableRow_get_multi(table, keys, TABLE_TEST_BATCH_N, table_test_batch_get, ids) != 0)
+    {
+        return 7;
+    }
+
+    swTable_free(table);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+  +----------------------------------------------------------------------+
+  | Swoole                                                               |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 2.0 of the Apache license,    |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.apache.org/licenses/LICENSE-2.0.html                      |
+  | If you did not receive a copy of the Apache2.0 license and are unable|
+  | to obtain it through the world-wide-web, please send a note to       |
+  | license@swoole.com so we can mail you a copy immediately.            |
+  +----------------------------------------------------------------------+
+  | Author: Tianfeng Han  <mikan.tenny@gmail.com>                        |
+  +----------------------------------------------------------------------+
+*/
+
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+
+/**
+ * local udp flood, recvfrom per packet vs recvmmsg batches on SO_REUSEPORT threads
+ */
+#define UDP_TEST_PORT         9507
+#define UDP_TEST_FLOODER      2
+#define UDP_TEST_DURATION     2       //seconds
+#define UDP_TEST_PACKET_SIZE  100
+#define UDP_TEST_SEND_BATCH   32
+
+typedef struct
+{
+    sw_atomic_t received;
+    sw_atomic_t replied;
+} udp_test_stats;
+
+static udp_test_stats *udp_stats;
+
+static int udp_test_onPacket(swServer *serv, swEventData *req)
+{
+    swString *buffer = swWorker_get_buffer(serv, req->info.from_id);
+    swDgramPacket *packet = (swDgramPacket *) buffer->str;
+    struct sockaddr_in addr;
+
+    sw_atomic_fetch_add(&udp_stats->received, 1);
+    //ack every 16th packet, as the telemetry sequence check
+    if (packet->data[0] % 16 == 0)
+    {
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(packet->port);
+        addr.sin_addr = packet->addr.v4;
+        if (swWorker_sendto(req->info.from_fd, (struct sockaddr *) &addr, sizeof(addr), "ok", 2) > 0)
+        {
+            sw_atomic_fetch_add(&udp_stats->replied, 1);
+        }
+    }
+    return SW_OK;
+}
+
+static void udp_test_server(int thread_num, int batch)
+{
+    swServer serv;
+
+    swServer_init(&serv);
+    serv.reactor_num = 1;
+    serv.worker_num = 2;
+    serv.factory_mode = SW_MODE_PROCESS;
+    serv.dispatch_mode = SW_DISPATCH_ROUND;
+    serv.dgram_thread_num = thread_num;
+    serv.dgram_batch = batch;
+    serv.onPacket = udp_test_onPacket;
+    SwooleG.socket_buffer_size = 8 * 1024 * 1024;
+
+    if (swServer_create(&serv) < 0 || swServer_add_listener(&serv, SW_SOCK_UDP, "127.0.0.1", UDP_TEST_PORT) < 0)
+    {
+        exit(1);
+    }
+    swServer_start(&serv);
+    exit(0);
+}
+
+static void udp_test_flood(void)
+{
+    struct mmsghdr msgs[UDP_TEST_SEND_BATCH];
+    struct iovec iov[UDP_TEST_SEND_BATCH];
+    char data[UDP_TEST_SEND_BATCH][UDP_TEST_PACKET_SIZE];
+    struct sockaddr_in addr;
+    time_t end = time(NULL) + UDP_TEST_DURATION;
+    int i, j;
+    uint8_t seq = 0;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(UDP_TEST_PORT);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+
+    bzero(msgs, sizeof(msgs));
+    for (i = 0; i < UDP_TEST_SEND_BATCH; i++)
+    {
+        memset(data[i], 'A', UDP_TEST_PACKET_SIZE);
+        iov[i].iov_base = data[i];
+        iov[i].iov_len = UDP_TEST_PACKET_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+    }
+    //the source ports differ, SO_REUSEPORT spreads the flooders over the threads
+    while (time(NULL) < end)
+    {
+        for (j = 0; j < 64; j++)
+        {
+            for (i = 0; i < UDP_TEST_SEND_BATCH; i++)
+            {
+                data[i][0] = seq++;
+            }
+            sendmmsg(sock, msgs, UDP_TEST_SEND_BATCH, 0);
+        }
+    }
+    exit(0);
+}
+
+static int udp_test_run(int thread_num, int batch)
+{
+    pid_t server_pid, flooders[UDP_TEST_FLOODER];
+    int i, status;
+    uint32_t received, replied;
+    double elapsed;
+    struct timeval start, end;
+
+    bzero(udp_stats, sizeof(udp_test_stats));
+    fflush(stdout);
+
+    server_pid = fork();
+    if (server_pid < 0)
+    {
+        return SW_ERR;
+    }
+    else if (server_pid == 0)
+    {
+        udp_test_server(thread_num, batch);
+    }
+    usleep(500000);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < UDP_TEST_FLOODER; i++)
+    {
+        flooders[i] = fork();
+        if (flooders[i] == 0)
+        {
+            udp_test_flood();
+        }
+    }
+    for (i = 0; i < UDP_TEST_FLOODER; i++)
+    {
+        waitpid(flooders[i], &status, 0);
+    }
+    //let the workers drain the socket buffers
+    usleep(200000);
+    gettimeofday(&end, NULL);
+    received = udp_stats->received;
+    replied = udp_stats->replied;
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, &status, 0);
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("dgram_thread_num=%d, dgram_batch=%d: %.0f packets/s, %u received, %u replied\n", thread_num, batch,
+            received / elapsed, received, replied);
+    return received > 0 ? SW_OK : SW_ERR;
+}
+
+swUnitTest(udp_test1)
+{
+    udp_stats = sw_shm_calloc(1, sizeof(udp_test_stats));
+    if (udp_stats == NULL)
+    {
+        return 1;
+    }
+    if (udp_test_run(1, 0) < 0)
+    {
+        return 2;
+    }
+#ifdef HAVE_MMSG
+    if (udp_test_run(1, 32) < 0 || udp_test_run(2, 32) < 0)
+    {
+        return 3;
+    }
+#endif
+    sw_shm_free(udp_stats);
+    return 0;
+}
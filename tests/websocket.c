@@ -29,4 +29,546 @@ swUnitTest(ws_test1)
 	}
 	return 0;
 }
-#endif
\ No newline at end of file
+#endif
+
+#include "swoole.h"
+#include "Server.h"
+#include "tests.h"
+#include "websocket.h"
+
+#ifdef SW_HAVE_ZLIB
+/**
+ * permessage-deflate negotiation cases, and the compressed messages inflated in fragments
+ */
+#define WS_TEST_MESSAGE_N     2000
+#define WS_TEST_MAX_LENGTH    (64 * 1024)
+
+typedef struct
+{
+    char *offer;
+    int client_no_context_takeover;
+    char *response;
+} ws_test_negotiation;
+
+static ws_test_negotiation ws_test_negotiations[] = {
+    { "permessage-deflate", 0, "permessage-deflate; server_no_context_takeover" },
+    { "permessage-deflate; client_max_window_bits", 0, "permessage-deflate; server_no_context_takeover; client_max_window_bits=12" },
+    { "permessage-deflate; client_max_window_bits=10", 1, "permessage-deflate; server_no_context_takeover; client_no_context_takeover" },
+    { "permessage-deflate; server_max_window_bits=\"10\"", 0, "permessage-deflate; server_no_context_takeover; server_max_window_bits=10" },
+    { "x-webkit-deflate-frame, permessage-deflate; foo, PerMessage-Deflate ; client_no_context_takeover", 0,
+            "permessage-deflate; server_no_context_takeover; client_no_context_takeover" },
+    { "permessage-deflate; server_max_window_bits=8", 0, NULL },
+    { "permessage-deflate; server_max_window_bits=16", 0, NULL },
+    { "permessage-deflate; server_no_context_takeover; server_no_context_takeover", 0, NULL },
+    { "permessage-deflate; client_no_context_takeover=1", 0, NULL },
+    { "x-webkit-deflate-frame", 0, NULL },
+};
+
+static int ws_test_negotiate(ws_test_negotiation *c)
+{
+    swWebSocket_deflate_param offer, setting;
+    char buf[256], expect[256];
+    int n;
+
+    bzero(&setting, sizeof(setting));
+    setting.client_no_context_takeover = c->client_no_context_takeover;
+    setting.server_max_window_bits = 15;
+    setting.client_max_window_bits = 12;
+
+    if (swWebSocket_parse_deflate_offer(c->offer, strlen(c->offer), &offer) < 0
+            || (n = swWebSocket_accept_deflate_offer(&offer, &setting, buf, sizeof(buf))) < 0)
+    {
+        return c->response == NULL ? SW_OK : SW_ERR;
+    }
+    snprintf(expect, sizeof(expect), "Sec-WebSocket-Extensions: %s\r\n", c->response ? c->response : "");
+    if (c->response == NULL || n != strlen(expect) || memcmp(buf, expect, n) != 0)
+    {
+        printf("offer: %s\nresponse: %.*s", c->offer, n, buf);
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+/**
+ * json like messages, the keys repeat across the messages
+ */
+static size_t ws_test_message(char *buf, int i)
+{
+    size_t n = sprintf(buf, "{\"id\":%d,\"type\":\"ticker\",\"symbol\":\"SYM%d\",\"bids\":[", i, i % 50);
+    int j;
+    for (j = 0; j < 1 + i % 40; j++)
+    {
+        n += sprintf(buf + n, "%s{\"price\":%d.%02d,\"size\":%d}", j ? "," : "", 100 + (i + j) % 7, j, (i * j) % 1000);
+    }
+    n += sprintf(buf + n, "]}");
+    return n;
+}
+
+static int ws_test_round_trip(int context_takeover, double *ratio, double *elapsed)
+{
+    z_stream deflate_stream, inflate_stream;
+    swString *compressed = swString_new(SW_BUFFER_SIZE_BIG);
+    swString *out = swString_new(256);
+    char message[8192];
+    size_t length, plain = 0, wire = 0, offset, piece;
+    struct timeval start, end;
+    int i, ret = SW_OK;
+
+    bzero(&deflate_stream, sizeof(deflate_stream));
+    bzero(&inflate_stream, sizeof(inflate_stream));
+    if (deflateInit2(&deflate_stream, SW_WEBSOCKET_COMPRESSION_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK
+            || inflateInit2(&inflate_stream, -15) != Z_OK)
+    {
+        return SW_ERR;
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < WS_TEST_MESSAGE_N && ret == SW_OK; i++)
+    {
+        length = ws_test_message(message, i);
+        if (!context_takeover)
+        {
+            deflateReset(&deflate_stream);
+        }
+        swString_clear(compressed);
+        swString_clear(out);
+        if (swWebSocket_deflate(&deflate_stream, message, length, compressed) < 0)
+        {
+            ret = SW_ERR;
+            break;
+        }
+        plain += length;
+        wire += compressed->length;
+
+        //every third message is split into frames of 7 bytes
+        for (offset = 0; offset < compressed->length; offset += piece)
+        {
+            piece = (i % 3 == 0) ? 7 : compressed->length;
+            if (offset + piece > compressed->length)
+            {
+                piece = compressed->length - offset;
+            }
+            if (swWebSocket_inflate(&inflate_stream, compressed->str + offset, piece, offset + piece == compressed->length,
+                    out, WS_TEST_MAX_LENGTH) < 0)
+            {
+                ret = SW_ERR;
+                break;
+            }
+        }
+        if (ret == SW_OK && (out->length != length || memcmp(out->str, message, length) != 0))
+        {
+            printf("message #%d: inflated %ld bytes, expect %ld\n", i, (long) out->length, (long) length);
+            ret = SW_ERR;
+        }
+        if (!context_takeover)
+        {
+            inflateReset(&inflate_stream);
+        }
+    }
+    gettimeofday(&end, NULL);
+    *elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    *ratio = plain ? (double) wire / plain : 0;
+
+    deflateEnd(&deflate_stream);
+    inflateEnd(&inflate_stream);
+    swString_free(compressed);
+    swString_free(out);
+    return ret;
+}
+
+/**
+ * the inflated message is bounded, a small compressed payload cannot expand beyond max_length
+ */
+static int ws_test_bomb(void)
+{
+    z_stream deflate_stream, inflate_stream;
+    swString *compressed = swString_new(SW_BUFFER_SIZE_BIG);
+    swString *out = swString_new(256);
+    char *zeros = sw_calloc(1, WS_TEST_MAX_LENGTH * 4);
+    int ret;
+
+    bzero(&deflate_stream, sizeof(deflate_stream));
+    bzero(&inflate_stream, sizeof(inflate_stream));
+    deflateInit2(&deflate_stream, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    inflateInit2(&inflate_stream, -15);
+
+    swWebSocket_deflate(&deflate_stream, zeros, WS_TEST_MAX_LENGTH * 4, compressed);
+    ret = swWebSocket_inflate(&inflate_stream, compressed->str, compressed->length, 1, out, WS_TEST_MAX_LENGTH);
+    if (ret == SW_OK || out->size > WS_TEST_MAX_LENGTH)
+    {
+        ret = SW_ERR;
+    }
+    else
+    {
+        ret = SW_OK;
+    }
+
+    deflateEnd(&deflate_stream);
+    inflateEnd(&inflate_stream);
+    swString_free(compressed);
+    swString_free(out);
+    sw_free(zeros);
+    return ret;
+}
+
+swUnitTest(ws_test2)
+{
+    double ratio, elapsed;
+    int i;
+
+    for (i = 0; i < sizeof(ws_test_negotiations) / sizeof(ws_test_negotiation); i++)
+    {
+        if (ws_test_negotiate(&ws_test_negotiations[i]) < 0)
+        {
+            return 1;
+        }
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (ws_test_round_trip(i, &ratio, &elapsed) < 0)
+        {
+            return 2;
+        }
+        printf("%s: %.1f%% of the payload on the wire, %.0f messages/s\n",
+                i ? "context takeover" : "no context takeover", ratio * 100, WS_TEST_MESSAGE_N / elapsed);
+    }
+    if (ws_test_bomb() < 0)
+    {
+        return 3;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * the reactor thread reassembles the fragments and answers the control frames,
+ * the worker echoes the messages and counts the wakeups
+ */
+#define WS_TEST_PORT      9509
+#define WS_TEST_PING_N    10000
+
+typedef struct
+{
+    sw_atomic_t messages;
+    sw_atomic_t events;
+} ws_test_stats;
+
+static ws_test_stats *ws_stats;
+
+static int ws_test_onReceive(swServer *serv, swEventData *req)
+{
+    swConnection *conn = swWorker_get_connection(serv, req->info.fd);
+    swString *buffer = swWorker_get_buffer(serv, req->info.from_id);
+    swString *frame;
+    char *data = req->data;
+    uint32_t length = req->info.len;
+    char response[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n";
+
+    sw_atomic_fetch_add(&ws_stats->events, 1);
+    if (req->info.type == SW_EVENT_PACKAGE_END)
+    {
+        data = buffer->str;
+        length = buffer->length;
+    }
+    //the upgrade request, the key is not checked
+    if (conn->websocket_status == 0)
+    {
+        conn->websocket_status = WEBSOCKET_STATUS_HANDSHAKE;
+        conn->websocket_compression = SW_WEBSOCKET_DEFLATE;
+        return swServer_tcp_send(serv, req->info.fd, response, sizeof(response) - 1);
+    }
+    sw_atomic_fetch_add(&ws_stats->messages, 1);
+    frame = swString_new(length + 16);
+    swWebSocket_encode(frame, data + 2, length - 2, data[1], data[0], 0);
+    swServer_tcp_send(serv, req->info.fd, frame->str, frame->length);
+    swString_free(frame);
+    return SW_OK;
+}
+
+static void ws_test_server(void)
+{
+    swServer serv;
+
+    swServer_init(&serv);
+    serv.reactor_num = 1;
+    serv.worker_num = 1;
+    serv.factory_mode = SW_MODE_PROCESS;
+    serv.open_http_protocol = 1;
+    serv.open_websocket_protocol = 1;
+    serv.protocol.package_max_length = 256 * 1024;
+    SwooleG.socket_buffer_size = 8 * 1024 * 1024;
+
+    if (swServer_add_listener(&serv, SW_SOCK_TCP, "127.0.0.1", WS_TEST_PORT) < 0 || swServer_create(&serv) < 0)
+    {
+        exit(1);
+    }
+    serv.onReceive = ws_test_onReceive;
+    swServer_start(&serv);
+    exit(0);
+}
+
+static int ws_test_read(int sock, char *buf, size_t length)
+{
+    size_t n = 0;
+    int ret;
+    while (n < length)
+    {
+        ret = recv(sock, buf + n, length - n, 0);
+        if (ret <= 0)
+        {
+            return SW_ERR;
+        }
+        n += ret;
+    }
+    return SW_OK;
+}
+
+/**
+ * read one frame of the server, the payload is not masked
+ */
+static int ws_test_read_frame(int sock, swString *out, int *opcode)
+{
+    uchar head[10];
+    uint64_t length;
+
+    if (ws_test_read(sock, (char *) head, 2) < 0)
+    {
+        return SW_ERR;
+    }
+    *opcode = head[0] & 0x0f;
+    length = head[1] & 0x7f;
+    if (length == 0x7e)
+    {
+        ws_test_read(sock, (char *) head + 2, 2);
+        length = ntohs(*(uint16_t *) (head + 2));
+    }
+    else if (length == 0x7f)
+    {
+        ws_test_read(sock, (char *) head + 2, 8);
+        length = swoole_ntoh64(*(uint64_t *) (head + 2));
+    }
+    swString_clear(out);
+    if (length > out->size && swString_extend(out, length) < 0)
+    {
+        return SW_ERR;
+    }
+    out->length = length;
+    return ws_test_read(sock, out->str, length);
+}
+
+static int ws_test_send_frame(int sock, char opcode, int fin, int rsv1, char *data, size_t length)
+{
+    swString *frame = swString_new(length + 16);
+    char *payload = sw_malloc(length + 1);
+    int ret;
+
+    //the payload is masked in place
+    memcpy(payload, data, length);
+    swWebSocket_encode(frame, payload, length, opcode, fin, 1);
+    if (rsv1)
+    {
+        frame->str[0] |= SW_WEBSOCKET_RSV1;
+    }
+    ret = swSocket_write_blocking(sock, frame->str, frame->length);
+    swString_free(frame);
+    sw_free(payload);
+    return ret;
+}
+
+static int ws_test_expect(int sock, swString *out, int opcode, char *data, size_t length)
+{
+    int frame_opcode;
+    if (ws_test_read_frame(sock, out, &frame_opcode) < 0 || frame_opcode != opcode || out->length != length
+            || memcmp(out->str, data, length) != 0)
+    {
+        return SW_ERR;
+    }
+    return SW_OK;
+}
+
+static int ws_test_connect(void)
+{
+    struct sockaddr_in addr;
+    char head[] = "GET /ws HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    char response[256];
+    int n = 0, sock = socket(AF_INET, SOCK_STREAM, 0);
+    int nodelay = 1;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(WS_TEST_PORT);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    //the ping and the pong are written one by one
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 || swSocket_write_blocking(sock, head, sizeof(head) - 1) < 0)
+    {
+        close(sock);
+        return SW_ERR;
+    }
+    while (n < sizeof(response) - 1 && ws_test_read(sock, response + n, 1) == SW_OK)
+    {
+        n++;
+        if (n >= 4 && memcmp(response + n - 4, "\r\n\r\n", 4) == 0)
+        {
+            return sock;
+        }
+    }
+    close(sock);
+    return SW_ERR;
+}
+
+static int ws_test_session(swString *out)
+{
+    char big[70000];
+    char close_frame[] = "\x03\xe8" "bye";
+    uint32_t events;
+    int sock, i;
+
+    if ((sock = ws_test_connect()) < 0)
+    {
+        return 1;
+    }
+    //fragmented text message with a ping in the middle
+    if (ws_test_send_frame(sock, WEBSOCKET_OPCODE_TEXT_FRAME, 0, 0, "hello ", 6) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_PING, 1, 0, "p1", 2) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONTINUATION_FRAME, 0, 0, "w\xc3", 2) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONTINUATION_FRAME, 1, 0, "\xa9rld", 4) < 0)
+    {
+        return 2;
+    }
+    if (ws_test_expect(sock, out, WEBSOCKET_OPCODE_PONG, "p1", 2) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_TEXT_FRAME, "hello w\xc3\xa9rld", 12) < 0)
+    {
+        return 3;
+    }
+    //the 16 and 64 bits payload length
+    for (i = 0; i < sizeof(big); i++)
+    {
+        big[i] = i % 251;
+    }
+    if (ws_test_send_frame(sock, WEBSOCKET_OPCODE_BINARY_FRAME, 1, 0, big, 200) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_BINARY_FRAME, big, 200) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_BINARY_FRAME, 1, 0, big, sizeof(big)) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_BINARY_FRAME, big, sizeof(big)) < 0)
+    {
+        return 4;
+    }
+#ifdef SW_HAVE_ZLIB
+    //compressed message in 3 frames, RSV1 only on the first one
+    z_stream stream;
+    swString *compressed = swString_new(1024);
+    char message[] = "{\"type\":\"ticker\",\"bids\":[{\"price\":100},{\"price\":100},{\"price\":100}]}";
+    bzero(&stream, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    swWebSocket_deflate(&stream, message, sizeof(message) - 1, compressed);
+    deflateEnd(&stream);
+    i = ws_test_send_frame(sock, WEBSOCKET_OPCODE_TEXT_FRAME, 0, 1, compressed->str, 5) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONTINUATION_FRAME, 0, 0, compressed->str + 5, 5) < 0
+            || ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONTINUATION_FRAME, 1, 0, compressed->str + 10, compressed->length - 10) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_TEXT_FRAME, message, sizeof(message) - 1) < 0;
+    swString_free(compressed);
+    if (i)
+    {
+        return 5;
+    }
+#endif
+    //the pings do not wake the worker up
+    events = ws_stats->events;
+    for (i = 0; i < WS_TEST_PING_N; i++)
+    {
+        if (ws_test_send_frame(sock, WEBSOCKET_OPCODE_PING, 1, 0, "ping", 4) < 0
+                || ws_test_send_frame(sock, WEBSOCKET_OPCODE_PONG, 1, 0, "", 0) < 0
+                || ws_test_expect(sock, out, WEBSOCKET_OPCODE_PONG, "ping", 4) < 0)
+        {
+            return 6;
+        }
+    }
+    if (ws_stats->events != events)
+    {
+        return 7;
+    }
+    //the close handshake, the status code is echoed
+    if (ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONNECTION_CLOSE, 1, 0, close_frame, 5) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_CONNECTION_CLOSE, "\x03\xe8", 2) < 0
+            || recv(sock, big, 1, 0) != 0)
+    {
+        return 8;
+    }
+    close(sock);
+
+    //invalid utf-8 is closed with 1007
+    if ((sock = ws_test_connect()) < 0 || ws_test_send_frame(sock, WEBSOCKET_OPCODE_TEXT_FRAME, 1, 0, "\xc0\xaf", 2) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_CONNECTION_CLOSE, "\x03\xef", 2) < 0 || recv(sock, big, 1, 0) != 0)
+    {
+        return 9;
+    }
+    close(sock);
+
+    //continuation without the first frame is closed with 1002
+    if ((sock = ws_test_connect()) < 0 || ws_test_send_frame(sock, WEBSOCKET_OPCODE_CONTINUATION_FRAME, 1, 0, "x", 1) < 0
+            || ws_test_expect(sock, out, WEBSOCKET_OPCODE_CONNECTION_CLOSE, "\x03\xea", 2) < 0 || recv(sock, big, 1, 0) != 0)
+    {
+        return 10;
+    }
+    close(sock);
+    return 0;
+}
+
+swUnitTest(ws_test3)
+{
+    char *utf8[] = { "", "plain ascii text", "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", "\xed\x9f\xbf" };
+    char *invalid[] = { "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xc3", "abcdefgh\xff" };
+    swString *out;
+    pid_t server_pid;
+    int i, status, ret;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (swWebSocket_check_utf8(utf8[i], strlen(utf8[i])) < 0)
+        {
+            return 1;
+        }
+    }
+    for (i = 0; i < 6; i++)
+    {
+        if (swWebSocket_check_utf8(invalid[i], strlen(invalid[i])) == SW_OK)
+        {
+            return 2;
+        }
+    }
+    if (swWebSocket_get_close_code("\x03\xe8", 2) != WEBSOCKET_CLOSE_NORMAL
+            || swWebSocket_get_close_code("\x03\xee", 2) != WEBSOCKET_CLOSE_PROTOCOL_ERROR
+            || swWebSocket_get_close_code("\x0f\xa0\xff", 3) != WEBSOCKET_CLOSE_MESSAGE_ERROR
+            || swWebSocket_get_close_code("\x0f\xa0", 1) != WEBSOCKET_CLOSE_PROTOCOL_ERROR)
+    {
+        return 3;
+    }
+
+    ws_stats = sw_shm_calloc(1, sizeof(ws_test_stats));
+    out = swString_new(SW_BUFFER_SIZE_BIG);
+    if (ws_stats == NULL || out == NULL)
+    {
+        return 4;
+    }
+    fflush(stdout);
+    server_pid = fork();
+    if (server_pid < 0)
+    {
+        return 5;
+    }
+    else if (server_pid == 0)
+    {
+        ws_test_server();
+    }
+    usleep(500000);
+
+    ret = ws_test_session(out);
+    printf("%u messages, %u worker events, %d pings answered by the reactor\n", ws_stats->messages, ws_stats->events,
+            WS_TEST_PING_N);
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, &status, 0);
+    swString_free(out);
+    sw_shm_free(ws_stats);
+    return ret ? 10 + ret : 0;
+}